@@ -0,0 +1,66 @@
+/** **************************************************************************
+ * checksum.h
+ * 
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include "libs3.h"
+
+
+// Longest aws-chunked framing emitted at once: the CRLF ending the last data
+// chunk, the zero-length chunk, the checksum trailer, and the final CRLF
+#define CHECKSUM_FRAMING_SIZE 64
+
+// Size of the data chunks that aws-chunked uploads are split into
+#define CHECKSUM_CHUNK_SIZE (64 * 1024)
+
+// Returns the name of the x-amz-checksum- header for the given algorithm
+const char *checksum_header_name(S3ChecksumAlgorithm algorithm);
+
+// Returns the value of the x-amz-checksum-algorithm header for the given
+// algorithm
+const char *checksum_algorithm_name(S3ChecksumAlgorithm algorithm);
+
+// Returns the Content-Length of an aws-chunked body carrying [length] bytes
+// of data followed by a checksum trailer for [algorithm]
+uint64_t checksum_chunked_length(S3ChecksumAlgorithm algorithm,
+                                 uint64_t length);
+
+// Writes the aws-chunked framing that precedes a chunk of [chunkSize] bytes
+// into [buffer]; [first] is nonzero for the first chunk, which is not
+// preceded by the CRLF ending a previous one.  A [chunkSize] of zero writes
+// the final chunk, including the trailer carrying [checksum].  Returns the
+// number of bytes written, which is at most CHECKSUM_FRAMING_SIZE.
+int checksum_chunk_framing(S3ChecksumAlgorithm algorithm, uint64_t checksum,
+                           int first, int chunkSize, char *buffer);
+
+#endif /* CHECKSUM_H */
@@ -81,6 +81,10 @@ S3Status error_parser_add(ErrorParser *errorParser, char *buffer,
 
 void error_parser_convert_status(ErrorParser *errorParser, S3Status *status);
 
+// Converts an S3 error code string, such as "NoSuchKey", into the
+// corresponding S3Status, or S3StatusErrorUnknown if it is not recognized
+S3Status error_parser_code_to_status(const char *code);
+
 // Always call this
 void error_parser_deinitialize(ErrorParser *errorParser);
 
@@ -179,6 +179,20 @@ extern "C" {
 #define S3_MAX_ACL_GRANT_COUNT             100
 
 
+/**
+ * S3_MAX_EXTRA_RESPONSE_HEADERS is the maximum number of extra response
+ * headers that may be registered with S3_set_extra_response_headers.
+ **/
+#define S3_MAX_EXTRA_RESPONSE_HEADERS      16
+
+
+/**
+ * S3_MAX_EXTRA_RESPONSE_HEADER_NAME_SIZE is the maximum length of the name
+ * of an extra response header registered with S3_set_extra_response_headers.
+ **/
+#define S3_MAX_EXTRA_RESPONSE_HEADER_NAME_SIZE 64
+
+
 /**
  * This is the maximum number of characters (including terminating \0) that
  * libs3 supports in an ACL grantee email address.
@@ -200,6 +214,20 @@ extern "C" {
 #define S3_MAX_GRANTEE_DISPLAY_NAME_SIZE   128
 
 
+/**
+ * S3_MAX_DELETE_OBJECTS_COUNT is the maximum number of keys that may be
+ * deleted by a single S3_delete_objects() request
+ **/
+#define S3_MAX_DELETE_OBJECTS_COUNT        1000
+
+
+/**
+ * This is the maximum number of characters (including terminating \0) of
+ * a base64-encoded checksum, as produced by S3_encode_checksum()
+ **/
+#define S3_MAX_CHECKSUM_SIZE               13
+
+
 /**
  * This is the maximum number of characters that will be stored in the
  * return buffer for the utility function which computes an HTTP authenticated
@@ -211,6 +239,19 @@ extern "C" {
      sizeof("&Signature=") + 28 + 1)
 
 
+/**
+ * This is the number of buckets of an S3MetricsHistogram; see
+ * S3_metrics_histogram_bucket_limit()
+ **/
+#define S3_METRICS_HISTOGRAM_BUCKET_COUNT  140
+
+
+/**
+ * This is the number of S3Status values, by which S3Metrics counts requests
+ **/
+#define S3_METRICS_STATUS_COUNT            (S3StatusBadResponseHeaderName + 1)
+
+
 /**
  * This constant is used by the S3_initialize() function, to specify that
  * the winsock library should be initialized by libs3; only relevent on
@@ -225,6 +266,19 @@ extern "C" {
  * basis by calling S3_set_request_context_verify_peer).
  */
 #define S3_INIT_VERIFY_PEER                2
+/**
+ * This constant is used by the S3_initialize() function, to have libs3
+ * collect the network timings of every request and pass them to its
+ * complete callback in the timings field of S3ErrorDetails.  If this is not
+ * set, the timings field is always 0.
+ **/
+#define S3_INIT_REQUEST_TIMINGS            4
+/**
+ * This constant is used by the S3_initialize() function, to have libs3 keep
+ * the metrics of requests, which S3_get_metrics() returns.  If this is not
+ * set, no metrics are kept and every counter stays at 0.
+ **/
+#define S3_INIT_METRICS                    8
 
 
 /**
@@ -240,6 +294,15 @@ extern "C" {
 #define S3_DEFAULT_REGION                  "us-east-1"
 
 
+/**
+ * This constant is used by the S3_open_transfer_journal() function, to
+ * specify that every record appended to the journal is to be flushed to
+ * stable storage before the append returns.  Without it, records survive a
+ * crash of the process but not necessarily a crash of the operating system.
+ **/
+#define S3_JOURNAL_SYNC                    1
+
+
 /** **************************************************************************
  * Enumerations
  ************************************************************************** **/
@@ -399,7 +462,21 @@ typedef enum
     S3StatusHttpErrorForbidden                              ,
     S3StatusHttpErrorNotFound                               ,
     S3StatusHttpErrorConflict                               ,
-    S3StatusHttpErrorUnknown
+    S3StatusHttpErrorUnknown                                ,
+
+    /**
+     * Errors detected by libs3 which were added after the above; they come
+     * last so that the values of the others stay the same
+     **/
+    S3StatusJournalIOError                                  ,
+    S3StatusJournalCorrupt                                  ,
+    S3StatusJournalMismatch                                 ,
+    S3StatusJournalRecordTooLong                            ,
+    S3StatusChecksumMismatch                                ,
+    S3StatusListingIndexIOError                             ,
+    S3StatusListingIndexCorrupt                             ,
+    S3StatusListingIndexMismatch                            ,
+    S3StatusBadResponseHeaderName
 } S3Status;
 
 
@@ -509,6 +586,115 @@ typedef enum
 } S3CannedAcl;
 
 
+/**
+ * S3ChecksumAlgorithm identifies an additional checksum that libs3 computes
+ * over object data as it is streamed to or from S3, and that S3 stores with
+ * the object.
+ * CRC32C is the Castagnoli CRC, computed with SSE 4.2 where available
+ * CRC64NVME is the 64-bit CRC used by NVMe
+ **/
+typedef enum
+{
+    S3ChecksumAlgorithmNone             = 0,
+    S3ChecksumAlgorithmCRC32C           = 1,
+    S3ChecksumAlgorithmCRC64NVME        = 2
+} S3ChecksumAlgorithm;
+
+
+/**
+ * S3MetricsOperation gives the S3 operations that S3Metrics counts
+ * separately, named as in the S3 API.  Each request that libs3 makes is one
+ * of these; for example, S3_list_bucket makes ListObjects requests,
+ * S3_get_acl a GetACL request, and S3_copy_object_range an UploadPartCopy
+ * request when given a part number, else a CopyObject request.
+ **/
+typedef enum
+{
+    S3MetricsOperationListBuckets                           ,
+    S3MetricsOperationGetBucketLocation                     ,
+    S3MetricsOperationCreateBucket                          ,
+    S3MetricsOperationDeleteBucket                          ,
+    S3MetricsOperationListObjects                           ,
+    S3MetricsOperationPutObject                             ,
+    S3MetricsOperationCopyObject                            ,
+    S3MetricsOperationGetObject                             ,
+    S3MetricsOperationHeadObject                            ,
+    S3MetricsOperationDeleteObject                          ,
+    S3MetricsOperationDeleteObjects                         ,
+    S3MetricsOperationGetACL                                ,
+    S3MetricsOperationPutACL                                ,
+    S3MetricsOperationGetBucketLifecycle                    ,
+    S3MetricsOperationPutBucketLifecycle                    ,
+    S3MetricsOperationGetBucketLogging                      ,
+    S3MetricsOperationPutBucketLogging                      ,
+    S3MetricsOperationCreateMultipartUpload                 ,
+    S3MetricsOperationUploadPart                            ,
+    S3MetricsOperationUploadPartCopy                        ,
+    S3MetricsOperationCompleteMultipartUpload               ,
+    S3MetricsOperationAbortMultipartUpload                  ,
+    S3MetricsOperationListMultipartUploads                  ,
+    S3MetricsOperationListParts                             ,
+    S3MetricsOperationCount
+} S3MetricsOperation;
+
+
+/**
+ * S3TracePoint gives the points in the life of a request at which the hooks
+ * registered with S3_set_trace_hooks() are called, in the order in which
+ * they are reached.  A request that fails early skips the points after the
+ * failure, except S3TracePointComplete, which every request reaches.
+ **/
+typedef enum
+{
+    /**
+     * The request is being created, before it is signed
+     **/
+    S3TracePointRequestCreated                              ,
+    /**
+     * The request has been composed and signed
+     **/
+    S3TracePointSigningDone                                 ,
+    /**
+     * A curl handle has been set up to perform the request
+     **/
+    S3TracePointHandleAcquired                              ,
+    /**
+     * A connection has been made or reused, and the request is about to be
+     * sent; only reported with libcurl 7.80.0 or later
+     **/
+    S3TracePointFirstByteSent                               ,
+    /**
+     * The response headers have been received
+     **/
+    S3TracePointHeadersReceived                             ,
+    /**
+     * The first byte of the response body has been received
+     **/
+    S3TracePointFirstBodyByte                               ,
+    /**
+     * The request is complete, and its complete callback is about to be made
+     **/
+    S3TracePointComplete
+} S3TracePoint;
+
+
+/**
+ * S3BulkOperation identifies the action that S3_bulk_operation() applies to
+ * every key under a prefix.
+ * Head fetches the properties of each object
+ * Delete deletes each object, using multi-object delete requests
+ * Copy copies each object to a destination bucket and prefix
+ * Custom issues whatever request the S3BulkCustomCallback issues per key
+ **/
+typedef enum
+{
+    S3BulkOperationHead                 = 0,
+    S3BulkOperationDelete               = 1,
+    S3BulkOperationCopy                 = 2,
+    S3BulkOperationCustom               = 3
+} S3BulkOperation;
+
+
 /** **************************************************************************
  * Data Types
  ************************************************************************** **/
@@ -520,6 +706,46 @@ typedef enum
 typedef struct S3RequestContext S3RequestContext;
 
 
+/**
+ * An S3TransferJournal records the progress of a single upload or download
+ * in a file so that the transfer can be resumed after a crash; see the
+ * S3_XXX_transfer_journal functions below for details
+ **/
+typedef struct S3TransferJournal S3TransferJournal;
+
+
+/**
+ * An S3ListingIndex is a sorted, memory mapped file of the objects listed
+ * under a prefix of a bucket, which can be searched locally and refreshed
+ * incrementally; see the S3_XXX_listing_index functions below for details
+ **/
+typedef struct S3ListingIndex S3ListingIndex;
+
+
+/**
+ * An S3PrefixFollower polls a prefix to which keys are only added in
+ * increasing order, reporting only the keys added since it last polled; see
+ * the S3_XXX_prefix_follower functions below for details
+ **/
+typedef struct S3PrefixFollower S3PrefixFollower;
+
+
+/**
+ * An S3BulkDeleter batches an arbitrarily long stream of keys into
+ * concurrent S3_delete_objects() requests; see the S3_XXX_bulk_deleter
+ * functions below for details
+ **/
+typedef struct S3BulkDeleter S3BulkDeleter;
+
+
+/**
+ * An S3ListIterator returns the results of a bucket, multipart upload, or
+ * part listing one at a time, fetching the following pages as it goes; see
+ * the S3_XXX_list_iterator functions below for details
+ **/
+typedef struct S3ListIterator S3ListIterator;
+
+
 /**
  * S3NameValue represents a single Name - Value pair, used to represent either
  * S3 metadata associated with a key, or S3 error details.
@@ -622,6 +848,34 @@ typedef struct S3ResponseProperties
      * encryption is in effect for the object.
      **/
     char usesServerSideEncryption;
+
+    /**
+     * This optional field gives the base64-encoded CRC32C checksum of the
+     * object, or of the part for an upload part request, if S3 returned one.
+     * A checksum of a multipart object stored with the composite checksum
+     * type is followed by "-" and the number of parts.
+     **/
+    const char *checksumCRC32C;
+
+    /**
+     * This optional field gives the base64-encoded CRC64NVME checksum of the
+     * object, or of the part for an upload part request, if S3 returned one.
+     **/
+    const char *checksumCRC64NVME;
+
+    /**
+     * This is the number of the headers registered with
+     * S3_set_extra_response_headers that were present in the response.
+     **/
+    int extraHeadersCount;
+
+    /**
+     * These are the headers registered with S3_set_extra_response_headers
+     * that were present in the response, in the order in which they were
+     * received.  Each name is spelled as it was registered, and leading and
+     * trailing whitespace will have been stripped from the value.
+     **/
+    const S3NameValue *extraHeaders;
 } S3ResponseProperties;
 
 
@@ -779,6 +1033,74 @@ typedef struct S3ListBucketContent
 } S3ListBucketContent;
 
 
+/**
+ * This is a page of results supplied to the list bucket columns callback by a
+ * call to S3_list_bucket_columns.  Each column is an array with one element
+ * per key listed, in the order that the keys were listed, so that the page
+ * can be filtered or handed to columnar consumers without reshaping.
+ **/
+typedef struct S3ListBucketColumns
+{
+    /**
+     * This is the number of keys in the page.
+     **/
+    int count;
+
+    /**
+     * This is the bytes of all of the keys, one after the other, without
+     * terminating zeroes.
+     **/
+    const char *keys;
+
+    /**
+     * This has count + 1 elements; key i is the bytes of keys from
+     * keyOffsets[i] up to keyOffsets[i + 1].
+     **/
+    const uint32_t *keyOffsets;
+
+    /**
+     * These are the sizes of the objects in bytes.
+     **/
+    const uint64_t *sizes;
+
+    /**
+     * These are the number of seconds since UNIX epoch of the last modified
+     * dates of the objects, or -1 where a date could not be read.
+     **/
+    const int64_t *lastModified;
+
+    /**
+     * This has 16 bytes per key, giving the binary MD5 digest of the ETag of
+     * the object, or zeroes for an ETag which isn't of that form.
+     **/
+    const unsigned char *eTags;
+
+    /**
+     * These are 0 for an ETag which is the MD5 of the object, the number of
+     * parts for an ETag of an object uploaded in parts, or -1 for an ETag of
+     * any other form.
+     **/
+    const int32_t *eTagParts;
+
+    /**
+     * This is the number of common prefixes in the page.
+     **/
+    int commonPrefixesCount;
+
+    /**
+     * This is the bytes of all of the common prefixes, one after the other,
+     * without terminating zeroes.
+     **/
+    const char *commonPrefixes;
+
+    /**
+     * This has commonPrefixesCount + 1 elements, giving the offsets of the
+     * common prefixes in commonPrefixes as keyOffsets does for keys.
+     **/
+    const uint32_t *commonPrefixOffsets;
+} S3ListBucketColumns;
+
+
 /**
  * This is a single entry supplied to the list bucket callback by a call to
  * S3_list_bucket.  It identifies a single matching key from the list
@@ -913,6 +1235,19 @@ typedef struct S3PutProperties
      * response has the usesServerSideEncryption flag set.
      **/
     char useServerSideEncryption;
+
+    /**
+     * If this is not S3ChecksumAlgorithmNone, then libs3 computes a checksum
+     * of the data as it is supplied by the S3PutObjectDataCallback, and sends
+     * it after the data as an x-amz-checksum- trailer (using the aws-chunked
+     * content encoding) so that S3 rejects the object or part if the data it
+     * received does not match.  The data is not read twice.  When passed to
+     * S3_initiate_multipart(), requests that S3 store a full-object checksum
+     * of this type for the completed upload; every part must then be
+     * uploaded with the same algorithm, and S3_combine_checksums() can be
+     * used to compute the full-object checksum from the part checksums.
+     **/
+    S3ChecksumAlgorithm checksumAlgorithm;
 } S3PutProperties;
 
 
@@ -953,13 +1288,224 @@ typedef struct S3GetConditions
      * includes double-quotes.
      **/
     const char *ifNotMatchETag;
+
+    /**
+     * If nonzero, S3 is asked to return the checksum stored with the object,
+     * and libs3 verifies the data received against it as it arrives,
+     * completing the request with S3StatusChecksumMismatch if they differ.
+     * Only full-object checksums of objects retrieved in their entirety can
+     * be verified; otherwise this has no effect.
+     **/
+    int verifyChecksum;
 } S3GetConditions;
 
 
+/**
+ * S3RequestTimings breaks down where the time of a request went, as measured
+ * by libcurl.  Each time is the number of microseconds from the start of the
+ * request until the given stage of it was complete.
+ **/
+typedef struct S3RequestTimings
+{
+    /**
+     * Time until the host name was resolved
+     **/
+    int64_t nameLookupUs;
+
+    /**
+     * Time until the TCP connection to the server was made
+     **/
+    int64_t connectUs;
+
+    /**
+     * Time until the TLS handshake was done, or 0 for unencrypted requests
+     **/
+    int64_t appConnectUs;
+
+    /**
+     * Time until the request was about to be sent
+     **/
+    int64_t preTransferUs;
+
+    /**
+     * Time until the first byte of the response was received
+     **/
+    int64_t startTransferUs;
+
+    /**
+     * Time until the request was complete
+     **/
+    int64_t totalUs;
+
+    /**
+     * The number of bytes of request body sent
+     **/
+    uint64_t bytesUploaded;
+
+    /**
+     * The number of bytes of response body received
+     **/
+    uint64_t bytesDownloaded;
+
+    /**
+     * Nonzero if the request was sent on a connection kept alive from an
+     * earlier request, in which case no name lookup or connect was needed
+     **/
+    int connectionReused;
+
+    /**
+     * The IP address of the server the request was sent to, or an empty
+     * string if no connection was made
+     **/
+    const char *remoteIp;
+} S3RequestTimings;
+
+
+/**
+ * S3MetricsHistogram records the distribution of a duration, in microseconds.
+ * Bucket i counts the durations from the limit of bucket i - 1 (or 0) up to,
+ * but not including, S3_metrics_histogram_bucket_limit(i).  The buckets have
+ * a precision of a quarter of their power of two, as in an HDR histogram;
+ * the last bucket also counts all longer durations.
+ **/
+typedef struct S3MetricsHistogram
+{
+    /**
+     * The number of durations recorded
+     **/
+    uint64_t count;
+
+    /**
+     * The sum of the durations recorded, in microseconds
+     **/
+    uint64_t sumUs;
+
+    /**
+     * The number of durations recorded in each bucket
+     **/
+    uint64_t buckets[S3_METRICS_HISTOGRAM_BUCKET_COUNT];
+} S3MetricsHistogram;
+
+
+/**
+ * S3Metrics is a snapshot of the counters that libs3 keeps of the requests
+ * performed in a request context, or of those performed without one; see
+ * S3_get_metrics().  It consists only of uint64_t counters.
+ **/
+typedef struct S3Metrics
+{
+    /**
+     * The number of requests completed, by operation and by the status
+     * that they completed with
+     **/
+    uint64_t requests[S3MetricsOperationCount][S3_METRICS_STATUS_COUNT];
+
+    /**
+     * The time from the start of each request until it completed, by operation
+     **/
+    S3MetricsHistogram durations[S3MetricsOperationCount];
+
+    /**
+     * The part of the duration of each request not spent by curl in its
+     * transfer; that is, the time spent composing the request and waiting
+     * for the request context to start it and to notice its completion
+     **/
+    S3MetricsHistogram queueTimes;
+
+    /**
+     * The number of bytes of request bodies sent
+     **/
+    uint64_t bytesUploaded;
+
+    /**
+     * The number of bytes of response bodies received
+     **/
+    uint64_t bytesDownloaded;
+
+    /**
+     * The number of requests that completed with a status for which
+     * S3_status_is_retryable() is true; libs3 itself does not retry them
+     **/
+    uint64_t retryableFailures;
+
+    /**
+     * The number of requests throttled by S3, that is, completed with
+     * S3StatusErrorSlowDown
+     **/
+    uint64_t throttles;
+
+    /**
+     * The number of requests sent on a new connection
+     **/
+    uint64_t connectionsNew;
+
+    /**
+     * The number of requests sent on a connection kept alive from an
+     * earlier request
+     **/
+    uint64_t connectionsReused;
+
+    /**
+     * The number of requests for which no pooled curl handle was free, so
+     * that a new one had to be created
+     **/
+    uint64_t handlePoolMisses;
+} S3Metrics;
+
+
+/**
+ * S3TraceEvent describes a point reached by a request, as passed to the
+ * hooks registered with S3_set_trace_hooks().  Its strings are only valid
+ * for the duration of the hook.
+ **/
+typedef struct S3TraceEvent
+{
+    /**
+     * The point reached
+     **/
+    S3TracePoint point;
+
+    /**
+     * The S3 operation of the request
+     **/
+    S3MetricsOperation operation;
+
+    /**
+     * When the point was reached, in microseconds of a monotonic clock
+     **/
+    int64_t timeUs;
+
+    /**
+     * The bucket and key of the request, either of which may be 0; only
+     * given at S3TracePointRequestCreated, else 0
+     **/
+    const char *bucketName;
+    const char *key;
+
+    /**
+     * The URI of the request, from S3TracePointHandleAcquired on, else 0
+     **/
+    const char *uri;
+
+    /**
+     * The x-amz-request-id that S3 returned, from
+     * S3TracePointHeadersReceived on if S3 returned one, else 0
+     **/
+    const char *requestId;
+
+    /**
+     * The status that the request completed with, at S3TracePointComplete;
+     * else S3StatusOK
+     **/
+    S3Status status;
+} S3TraceEvent;
+
+
 /**
  * S3ErrorDetails provides detailed information describing an S3 error.  This
  * is only presented when the error is an S3-generated error (i.e. one of the
- * S3StatusErrorXXX values).
+ * S3StatusErrorXXX values), except for the timings, which are presented for
+ * every request that was performed if they were requested.
  **/
 typedef struct S3ErrorDetails
 {
@@ -992,7 +1538,14 @@ typedef struct S3ErrorDetails
      * additional extra details.
      **/
     S3NameValue *extraDetails;
-} S3ErrorDetails;
+
+    /**
+     * The network timings of the request, if S3_INIT_REQUEST_TIMINGS was
+     * passed to S3_initialize(); else 0.  Also 0 if the request failed
+     * before it could be performed.
+     **/
+    const S3RequestTimings *timings;
+} S3ErrorDetails;
 
 
 /** **************************************************************************
@@ -1075,7 +1628,9 @@ typedef S3Status (S3ListServiceCallback)(const char *ownerId,
  * @param nextMarker if present, gives the largest (alphabetically) key
  *        returned in the response, which, if isTruncated is true, may be used
  *        as the marker in a subsequent list buckets operation to continue
- *        listing
+ *        listing.  For S3_list_bucket_v2(), this is instead the continuation
+ *        token to pass to the next request, and is always present when
+ *        isTruncated is true by the time the last callback is made.
  * @param contentsCount is the number of ListBucketContent structures in the
  *        contents parameter
  * @param contents is an array of ListBucketContent structures, each one
@@ -1101,6 +1656,74 @@ typedef S3Status (S3ListBucketCallback)(int isTruncated,
                                         void *callbackData);
 
 
+/**
+ * This callback is made by a list bucket operation whose handler gives an
+ * S3ListBucketFilter with a filterCallback, once for each object that the
+ * rest of the filter selects, before the object is passed to the
+ * S3ListBucketCallback.  It may be used to select objects by criteria that
+ * the filter does not support, such as regular expressions.
+ *
+ * @param content describes the object; it and the strings it refers to are
+ *        valid only for the duration of this callback
+ * @param callbackData is the callback data as specified when the request
+ *        was issued.
+ * @return nonzero to pass the object to the S3ListBucketCallback, 0 to drop
+ *         it
+ **/
+typedef int (S3ListBucketFilterCallback)(const S3ListBucketContent *content,
+                                         void *callbackData);
+
+
+/**
+ * This callback is made by S3_prefix_follower_poll() with each run of new
+ * objects found under the followed prefix, in key order, and once with no
+ * objects after a poll that found none.
+ *
+ * @param contentsCount is the number of ListBucketContent structures in the
+ *        contents parameter
+ * @param contents is an array of ListBucketContent structures, each one
+ *        describing a new object; these are valid only for the duration of
+ *        the callback
+ * @param lastKey is the last key found so far, which may be saved and passed
+ *        as startAfter to S3_create_prefix_follower() to resume following
+ *        after a restart without reporting any object twice; NULL if no key
+ *        has been found yet and none was given as startAfter
+ * @param callbackData is the callback data as specified when the follower
+ *        was created.
+ * @return S3StatusOK to continue following, anything else to stop; the poll
+ *         then returns this status, and keys after the last one reported
+ *         are reported by the next poll.
+ **/
+typedef S3Status (S3PrefixFollowerCallback)(int contentsCount,
+                                            const S3ListBucketContent *contents,
+                                            const char *lastKey,
+                                            void *callbackData);
+
+
+/**
+ * This callback is made once for each page of results of a list bucket
+ * columns operation, if the page lists anything or gives a continuation
+ * token.
+ *
+ * @param isTruncated is true if the list bucket request was truncated by the
+ *        S3 service, in which case the remainder of the list may be obtained
+ *        by querying again with the continuation token given in nextMarker
+ * @param nextMarker if present, gives the continuation token to pass to the
+ *        next request
+ * @param columns gives the keys and common prefixes of the page; it and the
+ *        arrays that it points to are only valid for the duration of the
+ *        callback
+ * @param callbackData is the callback data as specified when the request
+ *        was issued.
+ * @return S3StatusOK to continue processing the request, anything else to
+ *         immediately abort the request with a status which will be
+ *         passed to the S3ResponseCompleteCallback for this request.
+ **/
+typedef S3Status (S3ListBucketColumnsCallback)
+    (int isTruncated, const char *nextMarker,
+     const S3ListBucketColumns *columns, void *callbackData);
+
+
 /**
  * This callback is made during a put object operation, to obtain the next
  * chunk of data to put to the S3 service as the contents of the object.  This
@@ -1247,6 +1870,87 @@ typedef S3Status (S3MultipartCommitResponseCallback)(const char *location,
                                                      void *callbackData);
 
 
+/**
+ * This callback is made once for every key reported in the response to a
+ * multi-object delete request, as the response is parsed.  Keys deleted
+ * successfully are only reported if the request was not made in quiet mode.
+ *
+ * @param key is the key that was deleted, or that could not be deleted
+ * @param status is S3StatusOK if the key was deleted, or the S3Status
+ *        corresponding to the error S3 reported for this key
+ * @param errorMessage is the error message S3 reported for this key, or
+ *        NULL if the key was deleted
+ * @param callbackData is the callback data as specified when the request
+ *        was issued.
+ * @return S3StatusOK to continue processing the request, anything else to
+ *         immediately abort the request with a status which will be
+ *         passed to the S3ResponseCompleteCallback for this request.
+ *         Typically, this will return either S3StatusOK or
+ *         S3StatusAbortedByCallback.
+ **/
+typedef S3Status (S3DeleteObjectsResultCallback)(const char *key,
+                                                 S3Status status,
+                                                 const char *errorMessage,
+                                                 void *callbackData);
+
+
+/**
+ * This callback is made by S3_bulk_operation() when the response properties
+ * of the request acting on a key have been received.  It is not made for
+ * S3BulkOperationDelete, whose requests cover many keys.
+ *
+ * @param key is the key being acted on
+ * @param properties are the properties of the response
+ * @param callbackData is the callback data as specified when the bulk
+ *        operation was started.
+ * @return S3StatusOK to continue processing the request, anything else to
+ *         immediately abort the request acting on this key with that status
+ **/
+typedef S3Status (S3BulkPropertiesCallback)
+    (const char *key, const S3ResponseProperties *properties,
+     void *callbackData);
+
+
+/**
+ * This callback is made by S3_bulk_operation() once for every key it acts
+ * on, when the action on that key is complete.
+ *
+ * @param key is the key that was acted on
+ * @param status is the status of the action on this key
+ * @param errorDetails are the error details for the request acting on this
+ *        key, if any; for S3BulkOperationDelete, error details are only
+ *        provided when the whole multi-object delete request failed
+ * @param callbackData is the callback data as specified when the bulk
+ *        operation was started.
+ * @return S3StatusOK to continue the bulk operation, anything else to stop
+ *         listing and starting new actions; S3_bulk_operation() then waits
+ *         for the actions in flight and returns this status.
+ **/
+typedef S3Status (S3BulkResultCallback)(const char *key, S3Status status,
+                                        const S3ErrorDetails *errorDetails,
+                                        void *callbackData);
+
+
+/**
+ * This callback is made by S3_list_bucket_parallel() and
+ * S3_list_bucket_split() with each run of objects listed.
+ *
+ * @param contentsCount is the number of ListBucketContent structures in the
+ *        contents parameter
+ * @param contents is an array of ListBucketContent structures, each one
+ *        describing an object in the bucket; these are valid only for the
+ *        duration of the callback
+ * @param callbackData is the callback data as specified when the listing
+ *        was started.
+ * @return S3StatusOK to continue the listing, anything else to stop it;
+ *         S3_list_bucket_parallel() then waits for the requests in flight
+ *         and returns this status.
+ **/
+typedef S3Status (S3ParallelListCallback)(int contentsCount,
+                                          const S3ListBucketContent *contents,
+                                          void *callbackData);
+
+
 /**
  * Mechanism for S3 application to customize each CURL easy request
  * associated with the given S3 request context.
@@ -1269,6 +1973,80 @@ typedef S3Status (*S3SetupCurlCallback)(void *curlMulti, void *curlEasy,
                                         void *setupData);
 
 
+/**
+ * This callback allocates memory for libs3, as malloc() does.
+ *
+ * @param size is the number of bytes to allocate
+ * @param userData is the userData passed to S3_set_allocator
+ * @return the memory allocated, or NULL if out of memory
+ **/
+typedef void *(S3MallocFunction)(size_t size, void *userData);
+
+
+/**
+ * This callback resizes memory allocated by an S3MallocFunction or
+ * S3ReallocFunction, as realloc() does.
+ *
+ * @param ptr is the memory to resize, or NULL to allocate new memory
+ * @param size is the number of bytes to resize it to
+ * @param userData is the userData passed to S3_set_allocator
+ * @return the memory resized, or NULL if out of memory, in which case ptr
+ *         must be left as it was
+ **/
+typedef void *(S3ReallocFunction)(void *ptr, size_t size, void *userData);
+
+
+/**
+ * This callback frees memory allocated by an S3MallocFunction or
+ * S3ReallocFunction, as free() does.
+ *
+ * @param ptr is the memory to free, or NULL
+ * @param userData is the userData passed to S3_set_allocator
+ **/
+typedef void (S3FreeFunction)(void *ptr, void *userData);
+
+
+/**
+ * This callback is made when a request is created, in the thread calling the
+ * libs3 function that makes the request, so that the current span of the
+ * caller's tracing can be found and a span for the request started.
+ *
+ * @param event describes the request, at S3TracePointRequestCreated
+ * @param hookData is the hookData of the S3TraceHooks
+ * @return the span context of the request, which is passed to the other
+ *         hooks called for it; it may be NULL
+ **/
+typedef void *(S3TraceBeginCallback)(const S3TraceEvent *event,
+                                     void *hookData);
+
+
+/**
+ * This callback is made as a request reaches each point from
+ * S3TracePointSigningDone to S3TracePointFirstBodyByte, in whichever thread
+ * is performing the request.
+ *
+ * @param span is the span context returned for the request by the begin
+ *        callback
+ * @param event describes the point reached
+ * @param hookData is the hookData of the S3TraceHooks
+ **/
+typedef void (S3TraceEventCallback)(void *span, const S3TraceEvent *event,
+                                    void *hookData);
+
+
+/**
+ * This callback is made when a request reaches S3TracePointComplete; it is
+ * the last hook called for the request, so the span may be ended and freed.
+ *
+ * @param span is the span context returned for the request by the begin
+ *        callback
+ * @param event describes the completion of the request
+ * @param hookData is the hookData of the S3TraceHooks
+ **/
+typedef void (S3TraceEndCallback)(void *span, const S3TraceEvent *event,
+                                  void *hookData);
+
+
 /** **************************************************************************
  * Callback Structures
  ************************************************************************** **/
@@ -1284,6 +2062,8 @@ typedef struct S3ResponseHandler
      * The propertiesCallback is made when the response properties have
      * successfully been returned from S3.  This function may not be called
      * if the response properties were not successfully returned from S3.
+     * It may be NULL for listings and multi-object deletes, in which case
+     * the response headers are not parsed at all.
      **/
     S3ResponsePropertiesCallback *propertiesCallback;
 
@@ -1316,6 +2096,55 @@ typedef struct S3ListServiceHandler
 } S3ListServiceHandler;
 
 
+/**
+ * An S3ListBucketFilter selects the objects that a list bucket operation
+ * passes to its S3ListBucketCallback.  The filter is applied as each object
+ * is parsed from the response, so that objects which it drops cost neither
+ * conversion nor a place in a batch.  Common prefixes are never filtered.
+ * Each criterion that is set must hold for an object to be selected.
+ **/
+typedef struct S3ListBucketFilter
+{
+    /**
+     * If non-NULL and not empty, selects only keys that match this glob
+     * pattern, in which '*' matches any run of characters including '/',
+     * '?' matches any one character, "[...]" matches any one of a set of
+     * characters or ranges of characters, or any one character not in the
+     * set if it begins with '!', and '\\' matches the character following it
+     * literally.
+     **/
+    const char *keyPattern;
+
+    /**
+     * Selects only objects of at least this many bytes
+     **/
+    uint64_t minSize;
+
+    /**
+     * If nonzero, selects only objects of at most this many bytes
+     **/
+    uint64_t maxSize;
+
+    /**
+     * If nonzero, selects only objects last modified at or after this time,
+     * in seconds since the epoch
+     **/
+    int64_t modifiedSince;
+
+    /**
+     * If nonzero, selects only objects last modified before this time, in
+     * seconds since the epoch
+     **/
+    int64_t modifiedBefore;
+
+    /**
+     * If non-NULL, is called for each object selected by the other
+     * criteria, to make the final selection
+     **/
+    S3ListBucketFilterCallback *filterCallback;
+} S3ListBucketFilter;
+
+
 /**
  * An S3ListBucketHandler defines the callbacks which are made for
  * list_bucket requests.
@@ -1334,9 +2163,45 @@ typedef struct S3ListBucketHandler
      * operation.
      **/
     S3ListBucketCallback *listBucketCallback;
+
+    /**
+     * The most contents, and separately the most common prefixes, to pass to
+     * each call of listBucketCallback.  If 0, each page of results is passed
+     * to a single call as it completes; as S3 returns at most 1000 keys per
+     * page, this is the most efficient way to list.
+     **/
+    int batchSize;
+
+    /**
+     * If non-NULL, selects the objects to pass to listBucketCallback; all
+     * are passed otherwise.  The filter is copied when the request is made.
+     * As dropped objects may leave listBucketCallback with no contents, or
+     * with a last key that is not the last listed, S3_list_bucket() then
+     * always gives the marker to continue listing from in nextMarker.
+     **/
+    const S3ListBucketFilter *filter;
 } S3ListBucketHandler;
 
 
+/**
+ * An S3ListBucketColumnsHandler defines the callbacks which are made for
+ * list bucket columns requests.
+ **/
+typedef struct S3ListBucketColumnsHandler
+{
+    /**
+     * responseHandler provides the properties and complete callback
+     **/
+    S3ResponseHandler responseHandler;
+
+    /**
+     * The listBucketColumnsCallback is called with the page of results once
+     * it has been read.
+     **/
+    S3ListBucketColumnsCallback *listBucketColumnsCallback;
+} S3ListBucketColumnsHandler;
+
+
 /**
  * An S3PutObjectHandler defines the callbacks which are made for
  * put_object requests.
@@ -1435,6 +2300,102 @@ typedef struct S3AbortMultipartUploadHandler
 
 } S3AbortMultipartUploadHandler;
 
+
+/**
+ * An S3DeleteObjectsHandler defines the callbacks which are made for
+ * delete_objects requests and for the requests issued by an S3BulkDeleter.
+ **/
+typedef struct S3DeleteObjectsHandler
+{
+    /**
+     * responseHandler provides the properties and complete callback
+     **/
+    S3ResponseHandler responseHandler;
+
+    /**
+     * The resultCallback is called for each key reported in the response;
+     * it may be NULL if per-key results are not needed.
+     **/
+    S3DeleteObjectsResultCallback *resultCallback;
+} S3DeleteObjectsHandler;
+
+
+/**
+ * This callback is made by S3_bulk_operation() with S3BulkOperationCustom to
+ * start the action on one key.  It must issue exactly one request on
+ * [requestContext], passing [handler] and [handlerData] as the handler and
+ * callbackData of that request, or else call the completeCallback of
+ * [handler] with [handlerData] itself.
+ *
+ * @param bucketContext is the bucket context the bulk operation was started
+ *        with
+ * @param key is the key to act on
+ * @param requestContext is the request context to issue the request on
+ * @param timeoutMs is the timeout the bulk operation was started with
+ * @param handler gives the callbacks to pass to the request
+ * @param handlerData is the callbackData to pass to the request
+ * @param callbackData is the callback data as specified when the bulk
+ *        operation was started.
+ **/
+typedef void (S3BulkCustomCallback)(const S3BucketContext *bucketContext,
+                                    const char *key,
+                                    S3RequestContext *requestContext,
+                                    int timeoutMs,
+                                    const S3ResponseHandler *handler,
+                                    void *handlerData, void *callbackData);
+
+
+/**
+ * An S3BulkHandler defines the callbacks which are made by
+ * S3_bulk_operation().
+ **/
+typedef struct S3BulkHandler
+{
+    /**
+     * The propertiesCallback is optional
+     **/
+    S3BulkPropertiesCallback *propertiesCallback;
+
+    /**
+     * The resultCallback is optional
+     **/
+    S3BulkResultCallback *resultCallback;
+
+    /**
+     * The customCallback is required for S3BulkOperationCustom, and ignored
+     * otherwise
+     **/
+    S3BulkCustomCallback *customCallback;
+} S3BulkHandler;
+
+
+/**
+ * An S3TraceHooks gives the hooks called around the life of every request;
+ * see S3_set_trace_hooks().
+ **/
+typedef struct S3TraceHooks
+{
+    /**
+     * The beginCallback is required
+     **/
+    S3TraceBeginCallback *beginCallback;
+
+    /**
+     * The eventCallback is optional
+     **/
+    S3TraceEventCallback *eventCallback;
+
+    /**
+     * The endCallback is required
+     **/
+    S3TraceEndCallback *endCallback;
+
+    /**
+     * This is passed to each of the hooks
+     **/
+    void *hookData;
+} S3TraceHooks;
+
 /** **************************************************************************
  * General Library Functions
  ************************************************************************** **/
@@ -1481,6 +2442,27 @@ S3Status S3_initialize(const char *userAgentInfo, int flags,
                        const char *defaultS3HostName);
 
 
+/**
+ * Sets the functions through which libs3 allocates all of its memory, in
+ * place of malloc(), realloc() and free().  If libs3 is the first user of
+ * libcurl to initialize it, libcurl is set up to allocate through them too.
+ * This function must be called before S3_initialize(), and the allocator
+ * must not be changed again until after the matching S3_deinitialize().
+ *
+ * @param mallocFunction allocates memory
+ * @param reallocFunction resizes memory
+ * @param freeFunction frees memory
+ * @param userData is passed to each of the functions
+ * @return One of:
+ *         S3StatusOK on success
+ *         S3StatusInternalError if any of the functions is NULL, or libs3
+ *             is already initialized
+ **/
+S3Status S3_set_allocator(S3MallocFunction *mallocFunction,
+                          S3ReallocFunction *reallocFunction,
+                          S3FreeFunction *freeFunction, void *userData);
+
+
 /**
  * Must be called once per program for each call to libs3_initialize().  After
  * this call is complete, no libs3 function may be called except
@@ -1489,6 +2471,48 @@ S3Status S3_initialize(const char *userAgentInfo, int flags,
 void S3_deinitialize();
 
 
+/**
+ * Registers response headers, beyond those that libs3 parses itself, whose
+ * values are to be captured and passed to properties callbacks in the
+ * extraHeaders field of S3ResponseProperties; for example
+ * "x-amz-version-id", "x-amz-storage-class" or "Content-Range".  Header
+ * names are matched case-insensitively.  The registration replaces any
+ * previous one and applies to every request made afterwards, so this
+ * function must not be called while any request is in progress.
+ *
+ * @param count is the number of header names in names; 0 clears the
+ *        registration.  At most S3_MAX_EXTRA_RESPONSE_HEADERS may be
+ *        registered.
+ * @param names gives the header names to capture; they are copied
+ * @return One of:
+ *         S3StatusOK on success
+ *         S3StatusHeadersTooLong if count exceeds
+ *             S3_MAX_EXTRA_RESPONSE_HEADERS or a name is longer than
+ *             S3_MAX_EXTRA_RESPONSE_HEADER_NAME_SIZE
+ *         S3StatusBadResponseHeaderName if a name is empty or contains
+ *             characters not allowed in a header name
+ **/
+S3Status S3_set_extra_response_headers(int count, const char **names);
+
+
+/**
+ * Registers hooks to be called at the points of the life of every request
+ * given by S3TracePoint, so that requests can be attached to a caller's
+ * distributed traces.  When no hooks are registered, each point costs a
+ * single branch.  The registration replaces any previous one and applies to
+ * every request made afterwards, so this function must not be called while
+ * any request is in progress.
+ *
+ * @param hooks gives the hooks, which are copied, or NULL to clear the
+ *        registration
+ * @return One of:
+ *         S3StatusOK on success
+ *         S3StatusInternalError if hooks lacks its beginCallback or its
+ *             endCallback
+ **/
+S3Status S3_set_trace_hooks(const S3TraceHooks *hooks);
+
+
 /**
  * Returns a string with the textual name of an S3Status code
  *
@@ -1799,6 +2823,53 @@ void S3_set_request_context_verify_peer(S3RequestContext *requestContext,
                                         int verifyPeer);
 
 
+/** **************************************************************************
+ * Metrics Functions
+ ************************************************************************** **/
+
+/**
+ * Takes a snapshot of the metrics of the requests performed in a request
+ * context, or of those performed without one.  The counters are updated
+ * without locks as requests complete, so the snapshot may be taken at any
+ * time, from any thread.  Metrics are only kept if S3_INIT_METRICS was
+ * passed to S3_initialize().
+ *
+ * @param requestContext is the request context to get the metrics of, or 0
+ *        to get the metrics of the requests performed without a request
+ *        context
+ * @param metrics returns the snapshot
+ **/
+void S3_get_metrics(S3RequestContext *requestContext, S3Metrics *metrics);
+
+
+/**
+ * Returns the limit of a bucket of an S3MetricsHistogram.
+ *
+ * @param bucket is the index of the bucket, from 0 to
+ *        S3_METRICS_HISTOGRAM_BUCKET_COUNT - 1
+ * @return the number of microseconds that the durations counted in the
+ *         bucket are less than
+ **/
+uint64_t S3_metrics_histogram_bucket_limit(int bucket);
+
+
+/**
+ * Renders metrics in the Prometheus text exposition format.  Request counts
+ * that are zero are left out, as are the durations of kinds of request that
+ * were not made, and histograms are rendered with a bucket per power of two
+ * microseconds.
+ *
+ * @param metrics gives the metrics to render
+ * @param buffer returns the text, which is always zero-terminated, and
+ *        truncated if it does not fit
+ * @param bufferSize gives the size of buffer, in bytes
+ * @return the length of the whole text, not counting the terminating zero;
+ *         if this is not less than bufferSize, the text was truncated
+ **/
+int S3_render_metrics_prometheus(const S3Metrics *metrics, char *buffer,
+                                 int bufferSize);
+
+
 /** **************************************************************************
  * S3 Utility Functions
  ************************************************************************** **/
@@ -2017,22 +3088,26 @@ void S3_list_bucket(const S3BucketContext *bucketContext,
                     const S3ListBucketHandler *handler, void *callbackData);
 
 
-/** **************************************************************************
- * Object Functions
- ************************************************************************** **/
-
 /**
- * Puts object data to S3.  This overwrites any existing object at that key;
- * note that S3 currently only supports full-object upload.  The data to
- * upload will be acquired by calling the handler's putObjectDataCallback.
+ * Lists keys within a bucket using the ListObjectsV2 API.  Pages are chained
+ * with an opaque continuation token that S3 always returns for a truncated
+ * listing, whether or not a delimiter is used.  Owner information is only
+ * returned if requested, which makes responses smaller and cheaper to parse.
  *
  * @param bucketContext gives the bucket and associated parameters for this
  *        request
- * @param key is the key of the object to put to
- * @param contentLength is required and gives the total number of bytes that
- *        will be put
- * @param putProperties optionally provides additional properties to apply to
- *        the object that is being put to
+ * @param prefix if present and non-empty, gives a prefix for matching keys
+ * @param continuationToken if present and non-empty, continues a previous
+ *        listing; this is the nextMarker passed to the S3ListBucketCallback
+ *        of the previous request
+ * @param startAfter if present and non-empty, only keys occuring after this
+ *        value will be listed; ignored by S3 if continuationToken is given
+ * @param delimiter if present and non-empty, causes keys that contain the
+ *        same string between the prefix and the first occurrence of the
+ *        delimiter to be rolled up into a single result element
+ * @param maxkeys is the maximum number of keys to return
+ * @param fetchOwner if nonzero, the ownerId and ownerDisplayName of each
+ *        key are returned; otherwise they are NULL
  * @param requestContext if non-NULL, gives the S3RequestContext to add this
  *        request to, and does not perform the request immediately.  If NULL,
  *        performs the request immediately and synchronously.
@@ -2042,29 +3117,98 @@ void S3_list_bucket(const S3BucketContext *bucketContext,
  * @param callbackData will be passed in as the callbackData parameter to
  *        all callbacks for this request
  **/
-void S3_put_object(const S3BucketContext *bucketContext, const char *key,
-                   uint64_t contentLength,
-                   const S3PutProperties *putProperties,
-                   S3RequestContext *requestContext,
-                   int timeoutMs,
-                   const S3PutObjectHandler *handler, void *callbackData);
+void S3_list_bucket_v2(const S3BucketContext *bucketContext,
+                       const char *prefix, const char *continuationToken,
+                       const char *startAfter, const char *delimiter,
+                       int maxkeys, int fetchOwner,
+                       S3RequestContext *requestContext, int timeoutMs,
+                       const S3ListBucketHandler *handler, void *callbackData);
 
 
 /**
- * Copies an object from one location to another.  The object may be copied
- * back to itself, which is useful for replacing metadata without changing
- * the object.
+ * Lists keys within a bucket using the ListObjectsV2 API, delivering each
+ * page of results as columns rather than as an array of
+ * S3ListBucketContent.  The columns are filled as the response is read, and
+ * owner information is not requested.
  *
- * @param bucketContext gives the source bucket and associated parameters for
- *        this request
- * @param key is the source key
- * @param destinationBucket gives the destination bucket into which to copy
- *        the object.  If NULL, the source bucket will be used.
- * @param destinationKey gives the destination key into which to copy the
- *        object.  If NULL, the source key will be used.
- * @param putProperties optionally provides properties to apply to the object
- *        that is being put to.  If not supplied (i.e. NULL is passed in),
- *        then the copied object will retain the metadata of the copied
+ * @param bucketContext gives the bucket and associated parameters for this
+ *        request
+ * @param prefix if present and non-empty, gives a prefix for matching keys
+ * @param continuationToken if present and non-empty, continues a previous
+ *        listing; this is the nextMarker passed to the
+ *        S3ListBucketColumnsCallback of the previous request
+ * @param startAfter if present and non-empty, only keys occuring after this
+ *        value will be listed; ignored by S3 if continuationToken is given
+ * @param delimiter if present and non-empty, causes keys that contain the
+ *        same string between the prefix and the first occurrence of the
+ *        delimiter to be rolled up into a single result element
+ * @param maxkeys is the maximum number of keys to return
+ * @param requestContext if non-NULL, gives the S3RequestContext to add this
+ *        request to, and does not perform the request immediately.  If NULL,
+ *        performs the request immediately and synchronously.
+ * @param timeoutMs if not 0 contains total request timeout in milliseconds
+ * @param handler gives the callbacks to call as the request is processed and
+ *        completed
+ * @param callbackData will be passed in as the callbackData parameter to
+ *        all callbacks for this request
+ **/
+void S3_list_bucket_columns(const S3BucketContext *bucketContext,
+                            const char *prefix, const char *continuationToken,
+                            const char *startAfter, const char *delimiter,
+                            int maxkeys, S3RequestContext *requestContext,
+                            int timeoutMs,
+                            const S3ListBucketColumnsHandler *handler,
+                            void *callbackData);
+
+
+/** **************************************************************************
+ * Object Functions
+ ************************************************************************** **/
+
+/**
+ * Puts object data to S3.  This overwrites any existing object at that key;
+ * note that S3 currently only supports full-object upload.  The data to
+ * upload will be acquired by calling the handler's putObjectDataCallback.
+ *
+ * @param bucketContext gives the bucket and associated parameters for this
+ *        request
+ * @param key is the key of the object to put to
+ * @param contentLength is required and gives the total number of bytes that
+ *        will be put
+ * @param putProperties optionally provides additional properties to apply to
+ *        the object that is being put to
+ * @param requestContext if non-NULL, gives the S3RequestContext to add this
+ *        request to, and does not perform the request immediately.  If NULL,
+ *        performs the request immediately and synchronously.
+ * @param timeoutMs if not 0 contains total request timeout in milliseconds
+ * @param handler gives the callbacks to call as the request is processed and
+ *        completed
+ * @param callbackData will be passed in as the callbackData parameter to
+ *        all callbacks for this request
+ **/
+void S3_put_object(const S3BucketContext *bucketContext, const char *key,
+                   uint64_t contentLength,
+                   const S3PutProperties *putProperties,
+                   S3RequestContext *requestContext,
+                   int timeoutMs,
+                   const S3PutObjectHandler *handler, void *callbackData);
+
+
+/**
+ * Copies an object from one location to another.  The object may be copied
+ * back to itself, which is useful for replacing metadata without changing
+ * the object.
+ *
+ * @param bucketContext gives the source bucket and associated parameters for
+ *        this request
+ * @param key is the source key
+ * @param destinationBucket gives the destination bucket into which to copy
+ *        the object.  If NULL, the source bucket will be used.
+ * @param destinationKey gives the destination key into which to copy the
+ *        object.  If NULL, the source key will be used.
+ * @param putProperties optionally provides properties to apply to the object
+ *        that is being put to.  If not supplied (i.e. NULL is passed in),
+ *        then the copied object will retain the metadata of the copied
  *        object.
  * @param lastModifiedReturn returns the last modified date of the copied
  *        object
@@ -2219,6 +3363,106 @@ void S3_delete_object(const S3BucketContext *bucketContext, const char *key,
                       const S3ResponseHandler *handler, void *callbackData);
 
 
+/**
+ * Deletes up to S3_MAX_DELETE_OBJECTS_COUNT objects from S3 in a single
+ * request.  The XML request body is generated once, when the request is
+ * made, since S3 requires its MD5 up front; the XML response is parsed as it
+ * is received.  Note that the request completing with S3StatusOK only means
+ * that S3 processed it; the resultCallback reports which keys could not be
+ * deleted.
+ *
+ * @param bucketContext gives the bucket and associated parameters for this
+ *        request
+ * @param keysCount is the number of keys to delete, which must be between 1
+ *        and S3_MAX_DELETE_OBJECTS_COUNT
+ * @param keys are the keys of the objects to delete; they are copied into
+ *        the request body, so need only remain valid for this call
+ * @param quiet if nonzero, asks S3 to report only the keys which could not
+ *        be deleted, which keeps the response small
+ * @param requestContext if non-NULL, gives the S3RequestContext to add this
+ *        request to, and does not perform the request immediately.  If NULL,
+ *        performs the request immediately and synchronously.
+ * @param timeoutMs if not 0 contains total request timeout in milliseconds
+ * @param handler gives the callbacks to call as the request is processed and
+ *        completed
+ * @param callbackData will be passed in as the callbackData parameter to
+ *        all callbacks for this request
+ **/
+void S3_delete_objects(const S3BucketContext *bucketContext, int keysCount,
+                       const char * const *keys, int quiet,
+                       S3RequestContext *requestContext, int timeoutMs,
+                       const S3DeleteObjectsHandler *handler,
+                       void *callbackData);
+
+
+/**
+ * Creates an S3BulkDeleter, which accepts keys one at a time and deletes
+ * them in batches of up to S3_MAX_DELETE_OBJECTS_COUNT keys, keeping up to
+ * [maxConcurrent] S3_delete_objects() requests in flight at once.
+ *
+ * @param bucketContext gives the bucket and associated parameters for the
+ *        requests; the strings it refers to must remain valid until the
+ *        bulk deleter is destroyed
+ * @param quiet is passed to every S3_delete_objects() request
+ * @param maxConcurrent is the largest number of requests that may be in
+ *        flight at once; values less than 1 are treated as 1
+ * @param requestContext gives the S3RequestContext to run the requests
+ *        in.  If NULL, the bulk deleter creates and uses its own.  Other
+ *        requests in a shared context are run too whenever the bulk deleter
+ *        waits for one of its own requests to complete.
+ * @param timeoutMs if not 0 contains total request timeout in milliseconds
+ * @param handler gives the callbacks to call as each request is processed
+ *        and completed; the completeCallback is made once per batch
+ * @param callbackData will be passed in as the callbackData parameter to
+ *        all callbacks
+ * @param bulkDeleterReturn returns the newly-created S3BulkDeleter
+ * @return S3StatusOK on success, S3StatusOutOfMemory or the status of
+ *         creating the request context on failure
+ **/
+S3Status S3_create_bulk_deleter(const S3BucketContext *bucketContext,
+                                int quiet, int maxConcurrent,
+                                S3RequestContext *requestContext,
+                                int timeoutMs,
+                                const S3DeleteObjectsHandler *handler,
+                                void *callbackData,
+                                S3BulkDeleter **bulkDeleterReturn);
+
+
+/**
+ * Adds a key to be deleted.  The key is copied.  When a full batch has been
+ * accumulated it is sent; if [maxConcurrent] requests are already in flight,
+ * this first runs the request context until one of them completes.
+ *
+ * @param bulkDeleter is the S3BulkDeleter to add the key to
+ * @param key is the key of the object to delete
+ * @return S3StatusOK on success, S3StatusKeyTooLong if the key is longer
+ *         than S3_MAX_KEY_SIZE, or the status of the first batch that
+ *         failed, after which no further keys are accepted
+ **/
+S3Status S3_bulk_deleter_add_key(S3BulkDeleter *bulkDeleter, const char *key);
+
+
+/**
+ * Sends any partial batch and runs the request context until every request
+ * issued by the bulk deleter has completed.
+ *
+ * @param bulkDeleter is the S3BulkDeleter to finish
+ * @return S3StatusOK if every batch completed with S3StatusOK, otherwise the
+ *         status of the first batch that failed
+ **/
+S3Status S3_bulk_deleter_finish(S3BulkDeleter *bulkDeleter);
+
+
+/**
+ * Destroys an S3BulkDeleter.  Keys that were added but not yet sent by
+ * S3_bulk_deleter_finish() are discarded.  If requests are still in flight,
+ * they are run to completion first.
+ *
+ * @param bulkDeleter is the S3BulkDeleter to destroy
+ **/
+void S3_destroy_bulk_deleter(S3BulkDeleter *bulkDeleter);
+
+
 /** **************************************************************************
  * Access Control List Functions
  ************************************************************************** **/
@@ -2521,6 +3765,48 @@ void S3_complete_multipart_upload(S3BucketContext *bucketContext,
                                   void *callbackData);
 
 
+/**
+ * This operation completes a multipart upload, like
+ * S3_complete_multipart_upload(), and has S3 check the assembled object
+ * against its full-object checksum.  The checksum is sent in an
+ * x-amz-checksum- header, so that S3 fails the request if the object does
+ * not match it, and is compared with the checksum that S3 returns for the
+ * object, completing the request with S3StatusChecksumMismatch if they
+ * differ.  The upload must have been initiated with the same checksum
+ * algorithm, and its parts uploaded with it; S3_combine_checksums() computes
+ * the full-object checksum from the checksums of the parts.
+ *
+ * @param bucketContext gives the bucket and associated parameters for this
+ *        request
+ * @param key is the key of the object being uploaded
+ * @param handler gives the callbacks to call as the request is processed and
+ *        completed
+ * @param upload_id get from S3_initiate_multipart return
+ * @param contentLength gives the total size of the commit message, in bytes
+ * @param checksumAlgorithm is the algorithm of checksum, or
+ *        S3ChecksumAlgorithmNone to complete the upload without one
+ * @param checksum is the full-object checksum, encoded as by
+ *        S3_encode_checksum()
+ * @param requestContext if non-NULL, gives the S3RequestContext to add this
+ *        request to, and does not perform the request immediately.  If NULL,
+ *        performs the request immediately and synchronously.
+ * @param timeoutMs if not 0 contains total request timeout in milliseconds
+ * @param callbackData will be passed in as the callbackData parameter to
+ *        all callbacks for this request
+ **/
+void S3_complete_multipart_upload_checksum(S3BucketContext *bucketContext,
+                                           const char *key,
+                                           S3MultipartCommitHandler *handler,
+                                           const char *upload_id,
+                                           int contentLength,
+                                           S3ChecksumAlgorithm
+                                           checksumAlgorithm,
+                                           const char *checksum,
+                                           S3RequestContext *requestContext,
+                                           int timeoutMs,
+                                           void *callbackData);
+
+
 /**
  * This operation lists the parts that have been uploaded for a specific
  * multipart upload.
@@ -2615,6 +3901,769 @@ void S3_list_multipart_uploads(S3BucketContext *bucketContext,
                                const S3ListMultipartUploadsHandler *handler,
                                void *callbackData);
 
+/** **************************************************************************
+ * Bulk Operation Functions
+ ************************************************************************** **/
+
+/**
+ * Lists every key under a prefix and applies an operation to each of them,
+ * returning once every key has been acted on.  Keys flow from each page of
+ * the listing straight into concurrent actions.  The next page is requested
+ * while the actions on the current one are still running, but only once
+ * fewer than a page of listed keys is waiting.  This keeps the action stage
+ * busy while bounding the number of keys held in memory.
+ *
+ * @param bucketContext gives the bucket and associated parameters for the
+ *        requests
+ * @param prefix if present and non-empty, restricts the operation to keys
+ *        beginning with this prefix
+ * @param operation gives the action to apply to each key
+ * @param destinationBucket for S3BulkOperationCopy, gives the bucket to copy
+ *        to; if NULL, objects are copied within the source bucket
+ * @param destinationPrefix for S3BulkOperationCopy, replaces [prefix] at
+ *        the start of each destination key; may be NULL
+ * @param maxInFlight is the largest number of action requests that may be
+ *        in flight at once; for S3BulkOperationDelete each request deletes
+ *        up to S3_MAX_DELETE_OBJECTS_COUNT keys.  Values less than 1 are
+ *        treated as 1.
+ * @param requestContext gives the S3RequestContext to run the requests
+ *        in.  If NULL, one is created for the duration of the call.  Other
+ *        requests in a shared context are run too.
+ * @param timeoutMs if not 0 contains the timeout in milliseconds of each
+ *        request
+ * @param handler gives the callbacks to call as keys are acted on
+ * @param callbackData will be passed in as the callbackData parameter to
+ *        all callbacks
+ * @return S3StatusOK if the whole prefix was listed, otherwise the status of
+ *         the failed list request, the status returned by a resultCallback
+ *         which stopped the operation, or the status of driving the request
+ *         context.  Failures acting on individual keys are reported only
+ *         through the resultCallback.
+ **/
+S3Status S3_bulk_operation(const S3BucketContext *bucketContext,
+                           const char *prefix, S3BulkOperation operation,
+                           const char *destinationBucket,
+                           const char *destinationPrefix, int maxInFlight,
+                           S3RequestContext *requestContext, int timeoutMs,
+                           const S3BulkHandler *handler, void *callbackData);
+
+
+/**
+ * Lists every object under a prefix, listing independent prefixes in
+ * parallel.  The prefix is first listed with a delimiter to discover the
+ * common prefixes within it.  Each of those is listed concurrently in the
+ * same way, down to maxDepth levels below the starting prefix, and the
+ * prefixes at that depth are listed in full.  Each prefix is still paged
+ * through one request at a time, so the listing spreads over connections
+ * only as far as the keys are spread over prefixes.
+ *
+ * Objects are delivered by callback either as each page arrives, in no
+ * particular order, or merged into key order, in which case pages which
+ * arrive ahead of earlier keys are held until those have been delivered.
+ * Prefixes are listed in key order, so what is held stays small as long as
+ * the prefixes are of similar size.
+ *
+ * @param bucketContext gives the bucket and associated parameters for the
+ *        requests
+ * @param prefix if present and non-empty, lists only keys beginning with
+ *        this prefix
+ * @param delimiter is the delimiter which separates the levels of the key
+ *        space; if NULL or empty, "/" is used
+ * @param maxDepth is the number of levels of common prefixes below prefix
+ *        to list in parallel; 0 lists prefix in full, sequentially
+ * @param maxInFlight is the largest number of list requests that may be in
+ *        flight at once.  Values less than 1 are treated as 1.
+ * @param ordered if non-zero, delivers objects in key order, as
+ *        S3_list_bucket() without a delimiter would
+ * @param requestContext gives the S3RequestContext to run the requests
+ *        in.  If NULL, one is created for the duration of the call.  Other
+ *        requests in a shared context are run too.
+ * @param timeoutMs if not 0 contains the timeout in milliseconds of each
+ *        request
+ * @param callback is called with the objects listed; it is made while the
+ *        request context is being run, and so must not run it
+ * @param callbackData will be passed in as the callbackData parameter to
+ *        the callback
+ * @return S3StatusOK if the whole prefix was listed, otherwise the status of
+ *         the first failed list request, the status returned by a callback
+ *         which stopped the listing, or the status of running the request
+ *         context
+ **/
+S3Status S3_list_bucket_parallel(const S3BucketContext *bucketContext,
+                                 const char *prefix, const char *delimiter,
+                                 int maxDepth, int maxInFlight, int ordered,
+                                 S3RequestContext *requestContext,
+                                 int timeoutMs,
+                                 S3ParallelListCallback *callback,
+                                 void *callbackData);
+
+
+/**
+ * Lists every object under a prefix by listing disjoint ranges of the key
+ * space in parallel, for buckets whose keys are not organized into
+ * prefixes that S3_list_bucket_parallel() could fan out over, such as hash
+ * named keys.  Ranges are listed with S3_list_bucket() from a marker, and
+ * each stops at the first key past its end.
+ *
+ * The listing starts as a single range.  Whenever a request could be in
+ * flight but no range needs one, the range with the most keys left to list
+ * is split in two at a key estimated to lie halfway through it.  Estimates
+ * treat keys as numbers written in the bytes seen so far in listed keys.
+ * Ranges which turn out to be large are thus split further as the listing
+ * proceeds.
+ *
+ * @param bucketContext gives the bucket and associated parameters for the
+ *        requests
+ * @param prefix if present and non-empty, lists only keys beginning with
+ *        this prefix
+ * @param maxInFlight is the largest number of list requests that may be in
+ *        flight at once.  Values less than 1 are treated as 1.
+ * @param ordered if non-zero, delivers objects in key order, holding the
+ *        pages of later ranges until earlier ranges have been delivered;
+ *        otherwise delivers each page as it arrives
+ * @param requestContext as for S3_list_bucket_parallel()
+ * @param timeoutMs if not 0 contains the timeout in milliseconds of each
+ *        request
+ * @param callback as for S3_list_bucket_parallel()
+ * @param callbackData will be passed in as the callbackData parameter to
+ *        the callback
+ * @return as for S3_list_bucket_parallel()
+ **/
+S3Status S3_list_bucket_split(const S3BucketContext *bucketContext,
+                              const char *prefix, int maxInFlight,
+                              int ordered, S3RequestContext *requestContext,
+                              int timeoutMs, S3ParallelListCallback *callback,
+                              void *callbackData);
+
+
+/** **************************************************************************
+ * List Iterator Functions
+ ************************************************************************** **/
+
+/**
+ * Creates an S3ListIterator over the objects and common prefixes in a
+ * bucket, which are then returned one at a time by
+ * S3_list_iterator_next_content().  The first page is requested right away.
+ * Each following page is requested as soon as the one before it has been
+ * received, so that it arrives while the caller works through the previous
+ * page.  At most two received pages are held at once.
+ *
+ * The strings referenced by bucketContext must remain valid until the
+ * iterator is destroyed.
+ *
+ * @param bucketContext gives the bucket and associated parameters for the
+ *        requests
+ * @param prefix if present and non-empty, lists only keys beginning with
+ *        this prefix
+ * @param startAfter if present and non-empty, lists only keys after this
+ *        one
+ * @param delimiter if present and non-empty, rolls keys containing it after
+ *        the prefix up into common prefixes
+ * @param maxkeys if non-zero, is the number of keys requested per page
+ * @param listVersion is 1 to list with S3_list_bucket() or 2 to list with
+ *        S3_list_bucket_v2()
+ * @param fetchOwner for listVersion 2, if non-zero, requests the owner of
+ *        each object
+ * @param requestContext gives the S3RequestContext to run the requests in.
+ *        If NULL, the iterator creates its own.  Other requests in a shared
+ *        context are run too whenever the iterator runs it.
+ * @param timeoutMs if not 0 contains the timeout in milliseconds of each
+ *        request
+ * @param iteratorReturn returns the newly-created S3ListIterator
+ * @return S3StatusOK on success, or a status describing why the iterator
+ *         could not be created
+ **/
+S3Status S3_create_list_bucket_iterator(const S3BucketContext *bucketContext,
+                                        const char *prefix,
+                                        const char *startAfter,
+                                        const char *delimiter, int maxkeys,
+                                        int listVersion, int fetchOwner,
+                                        S3RequestContext *requestContext,
+                                        int timeoutMs,
+                                        S3ListIterator **iteratorReturn);
+
+
+/**
+ * Creates an S3ListIterator over the multipart uploads in progress in a
+ * bucket, which are then returned one at a time by
+ * S3_list_iterator_next_upload().  Pages are fetched ahead as described for
+ * S3_create_list_bucket_iterator().
+ *
+ * @param bucketContext gives the bucket and associated parameters for the
+ *        requests
+ * @param prefix if present and non-empty, lists only uploads of keys
+ *        beginning with this prefix
+ * @param keyMarker if present and non-empty, lists only uploads of keys
+ *        after this one
+ * @param uploadIdMarker if present and non-empty, together with keyMarker
+ *        lists only uploads after this one
+ * @param delimiter if present and non-empty, rolls keys containing it after
+ *        the prefix up into common prefixes
+ * @param maxuploads if non-zero, is the number of uploads requested per page
+ * @param requestContext as for S3_create_list_bucket_iterator()
+ * @param timeoutMs if not 0 contains the timeout in milliseconds of each
+ *        request
+ * @param iteratorReturn returns the newly-created S3ListIterator
+ * @return S3StatusOK on success, or a status describing why the iterator
+ *         could not be created
+ **/
+S3Status S3_create_list_multipart_uploads_iterator
+    (const S3BucketContext *bucketContext, const char *prefix,
+     const char *keyMarker, const char *uploadIdMarker, const char *delimiter,
+     int maxuploads, S3RequestContext *requestContext, int timeoutMs,
+     S3ListIterator **iteratorReturn);
+
+
+/**
+ * Creates an S3ListIterator over the parts uploaded so far to a multipart
+ * upload, which are then returned one at a time by
+ * S3_list_iterator_next_part().  Pages are fetched ahead as described for
+ * S3_create_list_bucket_iterator().
+ *
+ * @param bucketContext gives the bucket and associated parameters for the
+ *        requests
+ * @param key is the key of the multipart upload
+ * @param uploadId is the upload ID of the multipart upload
+ * @param partNumberMarker if present and non-empty, lists only parts after
+ *        this part number
+ * @param maxparts if non-zero, is the number of parts requested per page
+ * @param requestContext as for S3_create_list_bucket_iterator()
+ * @param timeoutMs if not 0 contains the timeout in milliseconds of each
+ *        request
+ * @param iteratorReturn returns the newly-created S3ListIterator
+ * @return S3StatusOK on success, or a status describing why the iterator
+ *         could not be created
+ **/
+S3Status S3_create_list_parts_iterator(const S3BucketContext *bucketContext,
+                                       const char *key, const char *uploadId,
+                                       const char *partNumberMarker,
+                                       int maxparts,
+                                       S3RequestContext *requestContext,
+                                       int timeoutMs,
+                                       S3ListIterator **iteratorReturn);
+
+
+/**
+ * Returns the next object or common prefix from an iterator created by
+ * S3_create_list_bucket_iterator(), waiting for its page to arrive if
+ * necessary.  Exactly one of contentReturn and commonPrefixReturn is set to
+ * non-NULL, except at the end of the listing, where both are set to NULL.
+ * What they point to remains valid until the next call on the iterator.
+ *
+ * @param iterator is the S3ListIterator to advance
+ * @param contentReturn returns the next object, or NULL
+ * @param commonPrefixReturn returns the next common prefix, or NULL
+ * @return S3StatusOK on success.  If a page could not be listed, its status
+ *         is returned once everything received before it has been returned,
+ *         along with NULLs.
+ **/
+S3Status S3_list_iterator_next_content(S3ListIterator *iterator,
+                                       const S3ListBucketContent **contentReturn,
+                                       const char **commonPrefixReturn);
+
+
+/**
+ * Returns the next multipart upload or common prefix from an iterator
+ * created by S3_create_list_multipart_uploads_iterator(), in the manner of
+ * S3_list_iterator_next_content().
+ *
+ * @param iterator is the S3ListIterator to advance
+ * @param uploadReturn returns the next multipart upload, or NULL
+ * @param commonPrefixReturn returns the next common prefix, or NULL
+ * @return as for S3_list_iterator_next_content()
+ **/
+S3Status S3_list_iterator_next_upload(S3ListIterator *iterator,
+                                      const S3ListMultipartUpload **uploadReturn,
+                                      const char **commonPrefixReturn);
+
+
+/**
+ * Returns the next part from an iterator created by
+ * S3_create_list_parts_iterator(), in the manner of
+ * S3_list_iterator_next_content().
+ *
+ * @param iterator is the S3ListIterator to advance
+ * @param partReturn returns the next part, or NULL at the end of the listing
+ * @return as for S3_list_iterator_next_content()
+ **/
+S3Status S3_list_iterator_next_part(S3ListIterator *iterator,
+                                    const S3ListPart **partReturn);
+
+
+/**
+ * Destroys an S3ListIterator.  A page still in flight is waited for if the
+ * iterator shares its request context, and is interrupted otherwise.
+ *
+ * @param iterator is the S3ListIterator to destroy
+ **/
+void S3_destroy_list_iterator(S3ListIterator *iterator);
+
+
+/** **************************************************************************
+ * Checksum Functions
+ ************************************************************************** **/
+
+/**
+ * Computes, or continues computing, a checksum.
+ *
+ * @param algorithm is the checksum algorithm
+ * @param checksum is the checksum of the data preceding this data, or 0 to
+ *        start a new checksum
+ * @param data is the data
+ * @param length is the number of bytes of data
+ * @return the checksum of the preceding data followed by this data
+ **/
+uint64_t S3_compute_checksum(S3ChecksumAlgorithm algorithm, uint64_t checksum,
+                             const void *data, int length);
+
+
+/**
+ * Computes the checksum of two pieces of data, one following the other, from
+ * their checksums without reading the data again.  This allows the checksum
+ * of an object uploaded in parts to be computed from the checksums of the
+ * parts.
+ *
+ * @param algorithm is the checksum algorithm
+ * @param checksum1 is the checksum of the first piece of data
+ * @param checksum2 is the checksum of the second piece of data
+ * @param length2 is the length of the second piece of data
+ * @return the checksum of the first piece of data followed by the second
+ **/
+uint64_t S3_combine_checksums(S3ChecksumAlgorithm algorithm,
+                              uint64_t checksum1, uint64_t checksum2,
+                              uint64_t length2);
+
+
+/**
+ * Encodes a checksum in the base64 form used by S3 in x-amz-checksum-
+ * headers.
+ *
+ * @param algorithm is the checksum algorithm
+ * @param checksum is the checksum
+ * @param buffer must be at least S3_MAX_CHECKSUM_SIZE bytes long, and
+ *        returns the encoded checksum
+ * @return the length of the encoded checksum
+ **/
+int S3_encode_checksum(S3ChecksumAlgorithm algorithm, uint64_t checksum,
+                       char *buffer);
+
+
+/**
+ * Decodes a checksum in the base64 form used by S3 in x-amz-checksum-
+ * headers, such as those in S3ResponseProperties.
+ *
+ * @param algorithm is the checksum algorithm
+ * @param str is the encoded checksum
+ * @param checksumReturn returns the checksum
+ * @return nonzero on success, 0 if str is not a valid encoded checksum of
+ *         the given algorithm (for example, if it is a composite checksum)
+ **/
+int S3_decode_checksum(S3ChecksumAlgorithm algorithm, const char *str,
+                       uint64_t *checksumReturn);
+
+
+/** **************************************************************************
+ * Transfer Journal Functions
+ ************************************************************************** **/
+
+/**
+ * A transfer journal is an append-only file, accessed via a shared memory
+ * mapping, which records the progress of one multipart upload or ranged
+ * download: the upload id of the multipart upload, the part number and ETag
+ * of every part that has been uploaded, and the byte ranges that have been
+ * transferred.  Because every record is written to the mapping as soon as it
+ * is appended and is validated by a checksum when the journal is re-opened,
+ * a transfer which is killed at any point can be resumed by re-opening its
+ * journal and skipping the work already recorded there, without having to
+ * ask S3 for the parts already uploaded.
+ *
+ * A journal is not safe for use by more than one thread at a time, and
+ * must not be opened by more than one process at a time.
+ *
+ * Opens, or creates, the transfer journal stored in the given file.
+ *
+ * @param path is the path of the journal file
+ * @param transferId is a string identifying the transfer, for example the
+ *        bucket, key, and size of the object being transferred.  The id is
+ *        recorded in a new journal, and an existing journal is only opened
+ *        if it was created with the same id.
+ * @param flags is a bitmask of S3_JOURNAL_XXX flags, or 0
+ * @param journalReturn returns the newly-opened journal on success
+ * @return One of:
+ *         S3StatusOK if the journal was successfully opened
+ *         S3StatusOutOfMemory if the journal could not be allocated
+ *         S3StatusJournalIOError if the journal file could not be opened,
+ *             resized, or mapped
+ *         S3StatusJournalCorrupt if the file is not a transfer journal
+ *         S3StatusJournalMismatch if the journal records a different
+ *             transfer
+ *         S3StatusNotSupported on Windows, where journals are not
+ *             implemented
+ **/
+S3Status S3_open_transfer_journal(const char *path, const char *transferId,
+                                  int flags,
+                                  S3TransferJournal **journalReturn);
+
+
+/**
+ * Closes a transfer journal.
+ *
+ * @param journal is the journal to close
+ * @param discard if nonzero, the transfer is complete and the journal file
+ *        is truncated so that it will not be used to resume the transfer;
+ *        the caller may then remove the file.  If zero, the journal is
+ *        flushed and left in place so that the transfer can be resumed.
+ **/
+void S3_close_transfer_journal(S3TransferJournal *journal, int discard);
+
+
+/**
+ * Returns the most recent upload id recorded in a transfer journal.
+ *
+ * @param journal is the journal
+ * @return the upload id, or NULL if none has been recorded.  The returned
+ *         string is only valid until the next record is added to the
+ *         journal.
+ **/
+const char *S3_transfer_journal_get_upload_id(S3TransferJournal *journal);
+
+
+/**
+ * Records the upload id of the multipart upload which a transfer journal
+ * tracks.  Any parts recorded for a previous upload id are forgotten.
+ *
+ * @param journal is the journal
+ * @param uploadId is the upload id returned by S3_initiate_multipart()
+ * @return S3StatusOK on success, or an error status if the record could not
+ *         be written
+ **/
+S3Status S3_transfer_journal_set_upload_id(S3TransferJournal *journal,
+                                           const char *uploadId);
+
+
+/**
+ * Records the successful upload of a part of a multipart upload.
+ *
+ * @param journal is the journal
+ * @param partNumber is the part number, from 1 to 10,000
+ * @param eTag is the ETag which S3 returned for the part
+ * @param checksum is the checksum which S3 returned for the part, if the
+ *        upload was initiated with a checksum algorithm, or NULL.  It must
+ *        be given again when the upload is completed.
+ * @return S3StatusOK on success, or an error status if the record could not
+ *         be written
+ **/
+S3Status S3_transfer_journal_add_part(S3TransferJournal *journal,
+                                      int partNumber, const char *eTag,
+                                      const char *checksum);
+
+
+/**
+ * Returns the ETag recorded for a part of the multipart upload which a
+ * transfer journal tracks.
+ *
+ * @param journal is the journal
+ * @param partNumber is the part number
+ * @return the ETag of the part, or NULL if the part has not been recorded
+ *         as uploaded.  The returned string is only valid until the next
+ *         record is added to the journal.
+ **/
+const char *S3_transfer_journal_get_part_etag(S3TransferJournal *journal,
+                                              int partNumber);
+
+
+/**
+ * Returns the checksum recorded for a part of the multipart upload which a
+ * transfer journal tracks.
+ *
+ * @param journal is the journal
+ * @param partNumber is the part number
+ * @return the checksum of the part, or NULL if the part has not been
+ *         recorded as uploaded or was recorded without a checksum.  The
+ *         returned string is only valid until the next record is added to
+ *         the journal.
+ **/
+const char *S3_transfer_journal_get_part_checksum(S3TransferJournal *journal,
+                                                  int partNumber);
+
+
+/**
+ * Records that a range of bytes has been completely transferred.  Callers
+ * should make sure that the bytes themselves are durable (for example, by
+ * flushing the file they were written to) before recording them.
+ *
+ * @param journal is the journal
+ * @param start is the offset of the first byte of the range
+ * @param length is the number of bytes in the range
+ * @return S3StatusOK on success, or an error status if the record could not
+ *         be written
+ **/
+S3Status S3_transfer_journal_add_range(S3TransferJournal *journal,
+                                       uint64_t start, uint64_t length);
+
+
+/**
+ * Returns the end of the run of transferred bytes beginning at a given
+ * offset, which is where a resumed transfer of the bytes following that
+ * offset should start.
+ *
+ * @param journal is the journal
+ * @param start is the offset
+ * @return the offset of the first byte at or after start which has not been
+ *         recorded as transferred
+ **/
+uint64_t S3_transfer_journal_get_range_end(S3TransferJournal *journal,
+                                           uint64_t start);
+
+
+/** **************************************************************************
+ * Prefix Follower Functions
+ ************************************************************************** **/
+
+/**
+ * Creates an S3PrefixFollower, which follows a prefix to which keys are
+ * only ever added after all existing keys, such as keys named by time or
+ * sequence number.  Each poll lists only the keys after the last key found,
+ * using it as the marker, so that the cost of following grows with the
+ * number of keys added rather than with the size of the prefix.  Keys added
+ * before the last key found are never reported.
+ *
+ * Polls are made by S3_prefix_follower_run() at an interval which starts
+ * at intervalMs, doubles after each poll that finds nothing, up to
+ * maxIntervalMs, and returns to intervalMs once keys are found.  Doubling
+ * starts from at least maxIntervalMs / 64 (and at least 1 ms), so that an
+ * intervalMs of 0, which polls again immediately while keys are being
+ * found, still backs off while none are; only a maxIntervalMs of 0 polls
+ * continuously.
+ *
+ * The strings referenced by bucketContext must remain valid until the
+ * follower is destroyed.
+ *
+ * @param bucketContext gives the bucket and associated parameters for the
+ *        requests
+ * @param prefix if present and non-empty, follows only keys beginning with
+ *        this prefix
+ * @param startAfter if present and non-empty, reports only keys after this
+ *        one; otherwise the first poll reports every key under the prefix
+ * @param intervalMs is the interval between polls while keys are being
+ *        found, in milliseconds; it may be 0
+ * @param maxIntervalMs is the longest interval between polls while no keys
+ *        are being found, in milliseconds; if less than intervalMs, it is
+ *        taken to be intervalMs
+ * @param timeoutMs if not 0 contains the timeout in milliseconds of each
+ *        request
+ * @param callback is the callback to make with new objects
+ * @param callbackData will be passed in as the callbackData parameter to
+ *        callback
+ * @param followerReturn returns the newly-created S3PrefixFollower
+ * @return S3StatusOK on success, or a status describing why the follower
+ *         could not be created
+ **/
+S3Status S3_create_prefix_follower(const S3BucketContext *bucketContext,
+                                   const char *prefix,
+                                   const char *startAfter, int intervalMs,
+                                   int maxIntervalMs, int timeoutMs,
+                                   S3PrefixFollowerCallback *callback,
+                                   void *callbackData,
+                                   S3PrefixFollower **followerReturn);
+
+
+/**
+ * Destroys an S3PrefixFollower.
+ *
+ * @param follower is the S3PrefixFollower to destroy
+ **/
+void S3_destroy_prefix_follower(S3PrefixFollower *follower);
+
+
+/**
+ * Polls the followed prefix once, listing every key added after the last
+ * key found and making the follower's callback with them.  This call blocks
+ * until the listing is complete.
+ *
+ * @param follower is the S3PrefixFollower to poll
+ * @return S3StatusOK if the poll completed, the status returned by the
+ *         callback if it stopped the poll, or else the status of the list
+ *         request that failed
+ **/
+S3Status S3_prefix_follower_poll(S3PrefixFollower *follower);
+
+
+/**
+ * Returns the number of milliseconds until the next poll of a follower is
+ * due, for callers which poll from their own event loop.
+ *
+ * @param follower is the S3PrefixFollower
+ * @return the milliseconds until the next poll, or 0 if it is due now
+ **/
+int S3_prefix_follower_get_wait_ms(const S3PrefixFollower *follower);
+
+
+/**
+ * Returns the last key found by a follower.
+ *
+ * @param follower is the S3PrefixFollower
+ * @return the last key found, as passed to the callback, or NULL if none
+ **/
+const char *S3_prefix_follower_get_last_key
+    (const S3PrefixFollower *follower);
+
+
+/**
+ * Follows a prefix until stopped, polling whenever a poll is due and
+ * sleeping in between.  Polls that fail with a retryable status are
+ * treated as polls that found nothing, so that following continues through
+ * transient failures.
+ *
+ * @param follower is the S3PrefixFollower to run
+ * @return the status returned by the follower's callback which stopped it,
+ *         or the status of a list request which failed with a status that
+ *         is not retryable
+ **/
+S3Status S3_prefix_follower_run(S3PrefixFollower *follower);
+
+
+/** **************************************************************************
+ * Listing Index Functions
+ ************************************************************************** **/
+
+/**
+ * A listing index is a file holding the key, size, last modified time, and
+ * ETag of every object listed under a prefix of a bucket, sorted by key and
+ * accessed via a shared memory mapping, so that whether a key exists, or
+ * which keys lie in a range, can be answered by binary search without
+ * listing the bucket again.  The index is brought up to date by
+ * S3_refresh_listing_index(), which only lists what may have changed: keys
+ * after the last key indexed for prefixes to which keys are only ever added
+ * in order, or else the sub-prefixes which the caller knows to have
+ * changed.  Each refresh writes a new file and renames it over the old one,
+ * so that the index file is always complete, and processes which have it
+ * open keep the version they mapped.
+ *
+ * An index is not safe for use by more than one thread at a time, and must
+ * not be refreshed by more than one process at a time.
+ *
+ * Opens the listing index stored in the given file.  If the file does not
+ * exist, the index is empty until first refreshed, which creates the file.
+ *
+ * @param path is the path of the index file
+ * @param bucketName is the name of the bucket which is indexed
+ * @param prefix is the prefix of the keys which are indexed, or NULL to
+ *        index the whole bucket.  An existing index is only opened if it was
+ *        created for the same bucket and prefix.
+ * @param indexReturn returns the newly-opened index on success
+ * @return One of:
+ *         S3StatusOK if the index was successfully opened
+ *         S3StatusOutOfMemory if the index could not be allocated
+ *         S3StatusListingIndexIOError if the index file could not be read
+ *             or mapped
+ *         S3StatusListingIndexCorrupt if the file is not a listing index
+ *         S3StatusListingIndexMismatch if the index is of a different
+ *             bucket or prefix
+ *         S3StatusNotSupported on Windows, where listing indexes are not
+ *             implemented
+ **/
+S3Status S3_open_listing_index(const char *path, const char *bucketName,
+                               const char *prefix,
+                               S3ListingIndex **indexReturn);
+
+
+/**
+ * Closes a listing index.
+ *
+ * @param index is the index to close
+ **/
+void S3_close_listing_index(S3ListingIndex *index);
+
+
+/**
+ * Brings a listing index up to date by listing the bucket, using
+ * ListObjectsV2.  This call blocks until the listing is complete.
+ *
+ * @param index is the index to refresh
+ * @param bucketContext gives the bucket and credentials to list with; the
+ *        bucket must be the one indexed
+ * @param appendOnly if nonzero, keys under the indexed prefix are taken to
+ *        be only ever added, each after all existing keys (as with keys
+ *        named by time or sequence number), so that only keys after the
+ *        last key in the index are listed.  changedPrefixes is then ignored.
+ * @param changedPrefixesCount is the number of prefixes in changedPrefixes;
+ *        if 0 and appendOnly is 0, the whole of the indexed prefix is listed
+ *        again
+ * @param changedPrefixes are the prefixes, each beginning with the indexed
+ *        prefix, under which keys may have been added, changed, or deleted
+ *        since the last refresh.  The indexed keys under each of these are
+ *        replaced by a listing of it, and all other indexed keys are kept.
+ * @param timeoutMs if not 0 contains total request timeout in milliseconds
+ * @return One of:
+ *         S3StatusOK if the index was refreshed
+ *         S3StatusOutOfMemory if the listing could not be held in memory
+ *         S3StatusListingIndexIOError if the new index file could not be
+ *             written or mapped
+ *         S3StatusListingIndexMismatch if the bucket is not the one
+ *             indexed, or a changed prefix is not under the indexed prefix
+ *         or the status of the first list request that failed, in which
+ *         case the index is left as it was
+ **/
+S3Status S3_refresh_listing_index(S3ListingIndex *index,
+                                  const S3BucketContext *bucketContext,
+                                  int appendOnly, int changedPrefixesCount,
+                                  const char **changedPrefixes,
+                                  int timeoutMs);
+
+
+/**
+ * Returns the number of objects in a listing index.
+ *
+ * @param index is the index
+ * @return the number of objects in the index
+ **/
+uint64_t S3_listing_index_count(const S3ListingIndex *index);
+
+
+/**
+ * Searches a listing index for the first key which is not less than a given
+ * key.  The keys in a range [start, end) are those from the position of
+ * start up to, but not including, the position of end.
+ *
+ * @param index is the index
+ * @param key is the key to search for
+ * @return the position in the index of the first key which is greater than
+ *         or equal to key, or the count of objects in the index if there is
+ *         none
+ **/
+uint64_t S3_listing_index_search(const S3ListingIndex *index,
+                                 const char *key);
+
+
+/**
+ * Returns the object at a position of a listing index.  The ownerId and
+ * ownerDisplayName of the object are always NULL.
+ *
+ * @param index is the index
+ * @param position is the position of the object, from 0 up to the count of
+ *        objects in the index
+ * @param contentReturn returns the object.  Its strings are only valid
+ *        until the index is next refreshed or is closed.
+ * @return nonzero if there is an object at position, 0 if not
+ **/
+int S3_listing_index_get(const S3ListingIndex *index, uint64_t position,
+                         S3ListBucketContent *contentReturn);
+
+
+/**
+ * Looks up a key in a listing index.
+ *
+ * @param index is the index
+ * @param key is the key to look up
+ * @param contentReturn if not NULL, returns the object if found, as for
+ *        S3_listing_index_get()
+ * @return nonzero if the key is in the index, 0 if not
+ **/
+int S3_listing_index_find(const S3ListingIndex *index, const char *key,
+                          S3ListBucketContent *contentReturn);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,95 @@
+/** **************************************************************************
+ * probes.h
+ * 
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#ifndef PROBES_H
+#define PROBES_H
+
+// USDT (statically defined tracing) probes of the libs3 provider, for
+// bpftrace, perf and other tools that attach to them in running processes.
+// They are compiled in only if LIBS3_USDT is defined, which building with
+// USDT=1 does; otherwise they compile to nothing.  An unattached probe costs
+// a single nop.
+//
+// The probes are:
+//
+//   request__start(operation, bucketName, key)
+//   sign__start(operation)
+//   sign__end(status)
+//   handle__pool__hit()
+//   handle__pool__miss()
+//   request__queued(request)
+//   context__request__done(request, curlCode)
+//   callback__start(kind)
+//   callback__end(kind)
+//   xml__parse__start(length)
+//   xml__parse__end(status)
+//   request__finish(request, operation, status, bytesUploaded,
+//                   bytesDownloaded, latencyUs)
+//
+// where operation is an S3MetricsOperation, status an S3Status, request the
+// address of the Request, which identifies it until request__finish, and
+// kind one of the PROBE_CALLBACK_ values below.
+
+#define PROBE_CALLBACK_PROPERTIES  0
+#define PROBE_CALLBACK_DATA_OUT    1
+#define PROBE_CALLBACK_DATA_IN     2
+#define PROBE_CALLBACK_COMPLETE    3
+
+#ifdef LIBS3_USDT
+
+#include <sys/sdt.h>
+
+#define probe0(name) DTRACE_PROBE(libs3, name)
+#define probe1(name, a) DTRACE_PROBE1(libs3, name, a)
+#define probe2(name, a, b) DTRACE_PROBE2(libs3, name, a, b)
+#define probe3(name, a, b, c) DTRACE_PROBE3(libs3, name, a, b, c)
+#define probe6(name, a, b, c, d, e, f) \
+    DTRACE_PROBE6(libs3, name, a, b, c, d, e, f)
+
+// Set if the probes are compiled in, so that what only they would use must
+// be gathered
+#define PROBES_ENABLED 1
+
+#else
+
+#define probe0(name) do { } while (0)
+#define probe1(name, a) do { } while (0)
+#define probe2(name, a, b) do { } while (0)
+#define probe3(name, a, b, c) do { } while (0)
+#define probe6(name, a, b, c, d, e, f) do { } while (0)
+
+#define PROBES_ENABLED 0
+
+#endif
+
+
+#endif /* PROBES_H */
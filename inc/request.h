@@ -34,7 +34,9 @@
 #define REQUEST_H
 
 #include "libs3.h"
+#include "checksum.h"
 #include "error_parser.h"
+#include "request_arena.h"
 #include "response_headers_handler.h"
 #include "util.h"
 
@@ -59,6 +61,10 @@ typedef struct RequestParams
     // Request type, affects the HTTP verb used
     HttpRequestType httpRequestType;
 
+    // The S3 operation that the request performs, which metrics, traces and
+    // probes report it as
+    S3MetricsOperation operation;
+
     // Bucket context for request
     S3BucketContext bucketContext;
 
@@ -111,6 +117,12 @@ typedef struct RequestParams
 
     // Request timeout. If 0, no timeout will be enforced
     int timeoutMs;
+
+    // When completing a multipart upload, the algorithm and encoded value of
+    // the full-object checksum to send for S3 to check the object against;
+    // checksum is 0 if there is none
+    S3ChecksumAlgorithm checksumAlgorithm;
+    const char *checksum;
 } RequestParams;
 
 
@@ -132,14 +144,17 @@ typedef struct Request
     // errors the same way
     int httpResponseCode;
 
-    // The HTTP headers to use for the curl request
+    // The HTTP headers to use for the curl request, allocated in the arena
     struct curl_slist *headers;
 
     // The CURL structure driving the request
     CURL *curl;
 
+    // The uri, and the response properties, are allocated from here
+    RequestArena arena;
+
     // libcurl requires that the uri be stored outside of the curl handle
-    char uri[MAX_URI_SIZE + 1];
+    char *uri;
 
     // Callback to be made when headers are available.  Might not be called.
     S3ResponsePropertiesCallback *propertiesCallback;
@@ -150,6 +165,26 @@ typedef struct Request
     // Number of bytes total that readCallback has left to supply
     int64_t toS3CallbackBytesRemaining;
 
+    // If not S3ChecksumAlgorithmNone, the data sent is aws-chunked encoded
+    // with a checksum trailer of this algorithm, or the data received is
+    // verified against the checksum of this algorithm that S3 returned
+    S3ChecksumAlgorithm checksumAlgorithm;
+
+    // Running checksum of the data sent or received
+    uint64_t checksum;
+
+    // Nonzero if the data received is to be verified against the checksum
+    // that S3 returned
+    int verifyChecksum;
+
+    // Bytes of the current aws-chunked chunk that readCallback has left to
+    // supply
+    int toS3ChunkRemaining;
+
+    // aws-chunked framing waiting to be sent, and how much has been sent
+    char toS3Framing[CHECKSUM_FRAMING_SIZE];
+    int toS3FramingLen, toS3FramingSent;
+
     // Callback to be made that supplies data read from S3.
     // Might not be called.
     S3GetObjectDataCallback *fromS3Callback;
@@ -167,8 +202,23 @@ typedef struct Request
     // This is set to nonzero after the properties callback has been made
     int propertiesCallbackMade;
 
-    // Parser of errors
-    ErrorParser errorParser;
+    // Parser of errors; this is only allocated once an error response body
+    // starts arriving, which is rare, and is 0 until then
+    ErrorParser *errorParser;
+
+    // The metrics that the request is counted in, or 0 if metrics are not
+    // kept, the kind of request it is counted as, and when it started
+    S3Metrics *metrics;
+    S3MetricsOperation operation;
+    int64_t startUs;
+
+    // The span context returned by the trace begin hook, and a bit for each
+    // S3TracePoint not yet reported; 0 if the request is not traced
+    void *traceSpan;
+    int tracePending;
+
+    // The owner of the request context when the request was added to it
+    void *owner;
 } Request;
 
 
@@ -193,5 +243,10 @@ void request_finish(Request *request);
 // Convert a CURLE code to an S3Status
 S3Status request_curl_code_to_status(CURLcode code);
 
+// Has every request get its error parser up front, as all requests used to,
+// rather than once an error body arrives.  Only testrequestmemory uses this,
+// to measure the memory that getting them lazily saves.
+void request_set_eager_error_parsers(int eager);
+
 
 #endif /* REQUEST_H */
@@ -0,0 +1,110 @@
+/** **************************************************************************
+ * request_arena.h
+ * 
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#ifndef REQUEST_ARENA_H
+#define REQUEST_ARENA_H
+
+#include <pthread.h>
+
+
+// Requests keep their variable-length data - the URI, the request headers,
+// and the strings and arrays filled in from the response headers - in a
+// RequestArena instead of in fixed-size buffers sized for the largest
+// possible request.  The arena takes blocks of REQUEST_SLAB_BLOCK_SIZE bytes
+// from a RequestSlab as it needs them, one or two for almost every request;
+// only an allocation too large for a block, such as the strings of a
+// response carrying a lot of metadata, spills into an overflow block from
+// malloc.
+
+#define REQUEST_SLAB_BLOCK_SIZE 1024
+
+// Number of blocks that a RequestSlab allocates at a time
+#define REQUEST_SLAB_CHUNK_BLOCKS 64
+
+// Smallest overflow block that a RequestArena allocates
+#define REQUEST_ARENA_OVERFLOW_SIZE 4096
+
+
+// Hands out blocks from chunks that are only freed when the slab is.  Each
+// request context has a slab of its own, and requests that are not made in
+// a request context share one.
+typedef struct RequestSlab
+{
+    pthread_mutex_t mutex;
+
+    // Blocks not in use, linked through their first bytes
+    void *freeBlocks;
+
+    // Chunks of blocks allocated, linked through their first bytes
+    void *chunks;
+} RequestSlab;
+
+
+typedef struct RequestArena
+{
+    // The slab from which the block is taken
+    RequestSlab *slab;
+
+    // The slab blocks taken, linked through their first bytes
+    void *blocks;
+
+    // The block, slab or overflow, that allocations are currently made from,
+    // and the number of bytes of it used
+    char *current;
+    int currentSize, currentUsed;
+
+    // Overflow blocks, linked through their first bytes
+    void *overflows;
+} RequestArena;
+
+
+void request_slab_initialize(RequestSlab *slab);
+
+// Frees every block of the slab; no arena may still be using one
+void request_slab_deinitialize(RequestSlab *slab);
+
+void request_arena_initialize(RequestArena *arena, RequestSlab *slab);
+
+// Returns [size] bytes aligned for any of the types that requests keep in
+// their arenas, or 0 if out of memory
+void *request_arena_alloc(RequestArena *arena, int size);
+
+// Returns a copy of the [len] bytes at [str] followed by a terminating 0, or
+// 0 if out of memory
+char *request_arena_strndup(RequestArena *arena, const char *str, int len);
+
+// Returns the slab blocks to the slab and frees any overflow blocks; the
+// arena may then be used again
+void request_arena_deinitialize(RequestArena *arena);
+
+
+#endif /* REQUEST_ARENA_H */
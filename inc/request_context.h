@@ -34,6 +34,7 @@
 #define REQUEST_CONTEXT_H
 
 #include "libs3.h"
+#include "request_arena.h"
 
 
 typedef enum
@@ -55,7 +56,37 @@ struct S3RequestContext
 
     S3SetupCurlCallback setupCurlCallback;
     void *setupCurlCallbackData;
+
+    // The arenas of the requests in the context take their blocks from here
+    RequestSlab slab;
+
+    // The metrics of the requests performed in the context
+    S3Metrics metrics;
+
+    // Requests added to the context are marked as belonging to this, so
+    // that a function driving the context can cancel its own requests
+    void *owner;
 };
 
 
+// Waits for activity on any of the requests in the context, or until curl's
+// timeout expires, and then runs the context once.  Used by functions which
+// drive a request context themselves while keeping work flowing into it.
+S3Status request_context_wait(S3RequestContext *requestContext,
+                              int *requestsRemainingReturn);
+
+
+// Marks the requests added to the context from now on as belonging to
+// [owner], returning the previous owner, which is to be restored once done
+void *request_context_set_owner(S3RequestContext *requestContext,
+                                void *owner);
+
+
+// Completes each request in the context that belongs to [owner] with
+// S3StatusInterrupted.  Used by functions which drive a request context they
+// do not own, when running it fails, since their requests refer to state
+// that goes away when they return.
+void request_context_cancel(S3RequestContext *requestContext, void *owner);
+
+
 #endif /* REQUEST_CONTEXT_H */
@@ -0,0 +1,66 @@
+/** **************************************************************************
+ * request_metrics.h
+ * 
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#ifndef REQUEST_METRICS_H
+#define REQUEST_METRICS_H
+
+#include "libs3.h"
+
+
+// Every request context keeps an S3Metrics of the requests performed in it,
+// and requests performed without a request context are counted in
+// requestMetricsG.  Since requests of a context may complete in any thread
+// that drives it, and those without one complete in the threads that made
+// them, the counters are only ever changed with atomic adds rather than
+// under a lock.
+
+// Adds [value] to the uint64_t [counter] atomically
+#define request_metrics_add(counter, value)                             \
+    ((void) __sync_fetch_and_add(&(counter), (uint64_t) (value)))
+
+
+// The metrics of the requests performed without a request context
+extern S3Metrics requestMetricsG;
+
+
+// Returns the current time of a monotonic clock, in microseconds
+int64_t request_metrics_now_us();
+
+// Records in [metrics] the completion of a request of kind [operation] with
+// [status], which took [durationUs] from start to end, and whose transfer
+// curl measured as [timings]
+void request_metrics_record(S3Metrics *metrics, S3MetricsOperation operation,
+                            S3Status status, int64_t durationUs,
+                            const S3RequestTimings *timings);
+
+
+#endif /* REQUEST_METRICS_H */
@@ -34,10 +34,20 @@
 #define RESPONSE_HEADERS_HANDLER_H
 
 #include "libs3.h"
-#include "string_buffer.h"
+#include "request_arena.h"
 #include "util.h"
 
 
+// x-amz-meta- and extra response headers are collected on lists until the
+// headers are done, and then put into the arrays of S3ResponseProperties
+typedef struct ResponseHeaderEntry
+{
+    S3NameValue nameValue;
+
+    struct ResponseHeaderEntry *next;
+} ResponseHeaderEntry;
+
+
 typedef struct ResponseHeadersHandler
 {
     // The structure to pass to the headers callback.  This is filled in by
@@ -47,19 +57,17 @@ typedef struct ResponseHeadersHandler
     // Set to 1 after the done call has been made
     int done;
 
-    // copied into here.  We allow 128 bytes for each header, plus \0 term.
-    string_multibuffer(responsePropertyStrings, 5 * 129);
-
-    // responseproperties.metaHeaders strings get copied into here
-    string_multibuffer(responseMetaDataStrings, 
-                       COMPACTED_METADATA_BUFFER_SIZE);
+    // The strings, lists and arrays of responseProperties are allocated from
+    // here
+    RequestArena *arena;
 
-    // Response meta data
-    S3NameValue responseMetaData[S3_MAX_METADATA_COUNT];
+    // The meta data and extra headers, most recently received first
+    ResponseHeaderEntry *metaData, *extraHeaders;
 } ResponseHeadersHandler;
 
 
-void response_headers_handler_initialize(ResponseHeadersHandler *handler);
+void response_headers_handler_initialize(ResponseHeadersHandler *handler,
+                                         RequestArena *arena);
 
 void response_headers_handler_add(ResponseHeadersHandler *handler,
                                   char *data, int dataLen);
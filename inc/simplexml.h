@@ -49,18 +49,93 @@
 typedef S3Status (SimpleXmlCallback)(const char *elementPath, const char *data,
                                      int dataLen, void *callbackData);
 
-typedef struct SimpleXml
+
+// Simple XML callback for documents parsed against a table of known element
+// paths.
+//
+// elementId: is the id given in the table to the path of the element, or -1
+// if the path is not in the table.  elementPath is as for SimpleXmlCallback.
+typedef S3Status (SimpleXmlIdCallback)(int elementId, const char *elementPath,
+                                       const char *data, int dataLen,
+                                       void *callbackData);
+
+
+// An entry in a table of known element paths, which should be declared with
+// SIMPLEXML_PATH so that the length of the path is computed at compile time.
+// Every ancestor of a path must also be in the table for that path to be
+// recognized.
+typedef struct SimpleXmlPath
 {
-    void *xmlParser;
+    const char *path;
+
+    int pathLen;
+
+    int id;
+} SimpleXmlPath;
+
+#define SIMPLEXML_PATH(id, path) { path, sizeof(path) - 1, id }
+
 
+// The deepest element path that can be recognized from a table
+#define SIMPLEXML_MAX_KNOWN_DEPTH 16
+
+
+typedef struct SimpleXml
+{
     SimpleXmlCallback *callback;
 
+    SimpleXmlIdCallback *idCallback;
+
     void *callbackData;
 
+    // Table of known element paths, if parsing with element ids
+    const SimpleXmlPath *paths;
+
+    int pathsCount;
+
+    // Ids of the known elements enclosing the text being parsed, outermost
+    // first; elements deeper than knownDepth are not in the table
+    int elementIds[SIMPLEXML_MAX_KNOWN_DEPTH];
+
+    int knownDepth;
+
     char elementPath[512];
 
     int elementPathLen;
 
+    // Tokenizer state, carried between calls to simplexml_add() so that
+    // markup may be split anywhere across them
+    int state;
+
+    // Depth of the element being parsed
+    int depth;
+
+    // For an end tag, the offset in elementPath of the next byte of the
+    // name it must match; for a start tag, the offset of its name
+    int matchOffset;
+
+    // Quote character of the attribute value being skipped, if any
+    char quote;
+
+    // Set when the last byte of a start tag other than space was '/'
+    int emptyElement;
+
+    // Number of consecutive '-', ']' or '?' bytes seen at the point where
+    // they could end a comment, CDATA section or processing instruction
+    int markCount;
+
+    // Depth of '[' in a declaration being skipped
+    int bracketDepth;
+
+    // Set after a carriage return in text, whose following newline is
+    // dropped
+    int afterCarriageReturn;
+
+    // Bytes of an entity reference or of the start of a <! declaration
+    char token[16];
+
+    int tokenLen;
+
     S3Status status;
 } SimpleXml;
 
@@ -72,6 +147,13 @@ typedef struct SimpleXml
 void simplexml_initialize(SimpleXml *simpleXml, SimpleXmlCallback *callback,
                           void *callbackData);
 
+// Parses the document against a table of known element paths, so that the
+// callback can switch on element ids rather than comparing element paths
+void simplexml_initialize_ids(SimpleXml *simpleXml,
+                              const SimpleXmlPath *paths, int pathsCount,
+                              SimpleXmlIdCallback *callback,
+                              void *callbackData);
+
 S3Status simplexml_add(SimpleXml *simpleXml, const char *data, int dataLen);
 
 
@@ -58,17 +58,27 @@
 // character takes 3 characters: %NN)
 #define MAX_URLENCODED_KEY_SIZE (3 * S3_MAX_KEY_SIZE)
 
+// Maximum size of the query parameters of a request.  Those of a listing
+// may carry a prefix, a marker or continuation token, and a key to start
+// after, each of which may be as long as a url encoded key.
+#define MAX_QUERY_PARAMS_SIZE (4 * MAX_URLENCODED_KEY_SIZE)
+
 // This is the maximum size of a URI that could be passed to S3:
-// https://s3.amazonaws.com/${BUCKET}/${KEY}?acl
+// https://s3.amazonaws.com/${BUCKET}/${KEY}?acl&${QUERY_PARAMS}
 // 255 is the maximum bucket length
 #define MAX_URI_SIZE \
     ((sizeof("https:///") - 1) + S3_MAX_HOSTNAME_SIZE + 255 + 1 +       \
-     MAX_URLENCODED_KEY_SIZE + (sizeof("?torrent") - 1) + 1)
+     MAX_URLENCODED_KEY_SIZE + (sizeof("?torrent") - 1) + 1 +           \
+     MAX_QUERY_PARAMS_SIZE)
 
 // Maximum size of a canonicalized resource
 #define MAX_CANONICALIZED_RESOURCE_SIZE \
     (1 + 255 + 1 + MAX_URLENCODED_KEY_SIZE + (sizeof("?torrent") - 1) + 1)
 
+// Maximum size of a canonicalized sub-resource and query string
+#define MAX_CANONICALIZED_QUERY_SIZE \
+    (MAX_CANONICALIZED_RESOURCE_SIZE + 1 + MAX_QUERY_PARAMS_SIZE)
+
 #define MAX_ACCESS_KEY_ID_LENGTH 32
 
 // Maximum length of a credential string
@@ -84,11 +94,38 @@
 // urlEncode, else nonzero is returned.
 int urlEncode(char *dest, const char *src, int maxSrcSize, int encodeSlash);
 
-// Returns < 0 on failure >= 0 on success
+// Parses an ISO 8601 time, such as 2008-02-11T15:04:05.000Z, into seconds
+// since the epoch.  The time is taken to be UTC unless it gives an offset,
+// whatever the local time zone.  Returns < 0 on failure >= 0 on success
 int64_t parseIso8601Time(const char *str);
 
 uint64_t parseUnsignedInt(const char *str);
 
+// Allocate, resize and free memory through the functions set with
+// S3_set_allocator, or malloc, realloc and free if none were set.  All of the
+// library's memory is allocated through these.
+void *s3_malloc(size_t size);
+
+void *s3_realloc(void *ptr, size_t size);
+
+void s3_free(void *ptr);
+
+// Returns nonzero if S3_set_allocator has set the allocation functions
+int s3_allocator_is_set();
+
+// Allocate, resize and free the data that operations keep for the length of
+// a request.  Freed memory is kept in per-size free lists, so that repeating
+// an operation does not allocate once the lists are warm; memory from
+// s3_pool_malloc or s3_pool_realloc must only be freed with s3_pool_free.
+void *s3_pool_malloc(size_t size);
+
+void *s3_pool_realloc(void *ptr, size_t size);
+
+void s3_pool_free(void *ptr);
+
+// Frees all memory held in the pool's free lists
+void s3_pool_drain();
+
 // Because Windows seems to be missing isblank(), use our own; it's a very
 // easy function to write in any case
 int is_blank(char c);
@@ -11,11 +11,9 @@ Buildroot: %{_tmppath}/%{name}-%{version}-%{release}-root
 # and newer Fedora Core uses libcurl-devel ... have to figure out how to
 # handle this problem, but for now, just don't check for any curl libraries
 # Buildrequires: curl-devel
-Buildrequires: libxml2-devel
 Buildrequires: openssl-devel
 Buildrequires: make
 # Requires: libcurl
-Requires: libxml2
 Requires: openssl
 
 %define debug_package %{nil}
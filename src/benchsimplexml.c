@@ -0,0 +1,493 @@
+/** **************************************************************************
+ * benchsimplexml.c
+ * 
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+
+#include <libxml/parser.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include "simplexml.h"
+
+// Measures the throughput of simplexml against the libxml2 SAX based parser
+// that it replaced, and checks that both deliver the same element paths and
+// text.  Files named on the command line are parsed, followed by synthetic
+// ListBucketResult documents of increasing size.  Documents are fed in chunks
+// of the size that curl hands to write callbacks.
+
+#define BENCH_CHUNK_SIZE 16384
+
+#define BENCH_MIN_BYTES (64 * 1024 * 1024)
+
+
+// digest -------------------------------------------------------------------
+
+// Digest of the callback stream.  Consecutive text callbacks for one element
+// are digested as one run so that the two parsers may split text differently.
+typedef struct Digest
+{
+    uint64_t hash;
+
+    char lastPath[512];
+
+    int inText;
+} Digest;
+
+
+static void digest_bytes(Digest *digest, const char *data, int dataLen)
+{
+    uint64_t hash = digest->hash;
+
+    while (dataLen--) {
+        hash ^= (unsigned char) *data++;
+        hash *= 1099511628211ULL;
+    }
+
+    digest->hash = hash;
+}
+
+
+static S3Status digestCallback(const char *elementPath, const char *data,
+                               int dataLen, void *callbackData)
+{
+    Digest *digest = (Digest *) callbackData;
+
+    if (!data) {
+        digest_bytes(digest, "E", 1);
+        digest_bytes(digest, elementPath, strlen(elementPath) + 1);
+        digest->inText = 0;
+        return S3StatusOK;
+    }
+
+    if (!digest->inText || strcmp(digest->lastPath, elementPath)) {
+        digest_bytes(digest, "T", 1);
+        digest_bytes(digest, elementPath, strlen(elementPath) + 1);
+        snprintf(digest->lastPath, sizeof(digest->lastPath), "%s",
+                 elementPath);
+        digest->inText = 1;
+    }
+
+    digest_bytes(digest, data, dataLen);
+
+    return S3StatusOK;
+}
+
+
+// libxml2 reference parser -------------------------------------------------
+
+// This is the libxml2 SAX implementation that simplexml used before it had
+// its own tokenizer, kept here only as a reference to compare against.
+
+typedef struct ReferenceXml
+{
+    void *xmlParser;
+
+    SimpleXmlCallback *callback;
+
+    void *callbackData;
+
+    char elementPath[512];
+
+    int elementPathLen;
+
+    S3Status status;
+} ReferenceXml;
+
+
+static xmlEntityPtr saxGetEntity(void *user_data, const xmlChar *name)
+{
+    (void) user_data;
+
+    return xmlGetPredefinedEntity(name);
+}
+
+
+static void saxStartElement(void *user_data, const xmlChar *nameUtf8,
+                            const xmlChar **attr)
+{
+    (void) attr;
+
+    ReferenceXml *referenceXml = (ReferenceXml *) user_data;
+
+    if (referenceXml->status != S3StatusOK) {
+        return;
+    }
+
+    char *name = (char *) nameUtf8;
+
+    int len = strlen(name);
+
+    if ((referenceXml->elementPathLen + len + 1) >=
+        (int) sizeof(referenceXml->elementPath)) {
+        referenceXml->status = S3StatusXmlParseFailure;
+        return;
+    }
+
+    if (referenceXml->elementPathLen) {
+        referenceXml->elementPath[referenceXml->elementPathLen++] = '/';
+    }
+    strcpy(&(referenceXml->elementPath[referenceXml->elementPathLen]), name);
+    referenceXml->elementPathLen += len;
+}
+
+
+static void saxEndElement(void *user_data, const xmlChar *name)
+{
+    (void) name;
+
+    ReferenceXml *referenceXml = (ReferenceXml *) user_data;
+
+    if (referenceXml->status != S3StatusOK) {
+        return;
+    }
+
+    referenceXml->status = (*(referenceXml->callback))
+        (referenceXml->elementPath, 0, 0, referenceXml->callbackData);
+
+    while ((referenceXml->elementPathLen > 0) &&
+           (referenceXml->elementPath[referenceXml->elementPathLen] != '/')) {
+        referenceXml->elementPathLen--;
+    }
+
+    referenceXml->elementPath[referenceXml->elementPathLen] = 0;
+}
+
+
+static void saxCharacters(void *user_data, const xmlChar *ch, int len)
+{
+    ReferenceXml *referenceXml = (ReferenceXml *) user_data;
+
+    if (referenceXml->status != S3StatusOK) {
+        return;
+    }
+
+    referenceXml->status = (*(referenceXml->callback))
+        (referenceXml->elementPath, (char *) ch, len,
+         referenceXml->callbackData);
+}
+
+
+static void saxError(void *user_data, const char *msg, ...)
+{
+    (void) msg;
+
+    ReferenceXml *referenceXml = (ReferenceXml *) user_data;
+
+    if (referenceXml->status != S3StatusOK) {
+        return;
+    }
+
+    referenceXml->status = S3StatusXmlParseFailure;
+}
+
+
+static xmlSAXHandler saxHandlerG;
+
+
+static S3Status reference_parse(const char *data, int dataLen,
+                                SimpleXmlCallback *callback,
+                                void *callbackData)
+{
+    ReferenceXml referenceXml;
+
+    referenceXml.callback = callback;
+    referenceXml.callbackData = callbackData;
+    referenceXml.elementPathLen = 0;
+    referenceXml.elementPath[0] = 0;
+    referenceXml.status = S3StatusOK;
+
+    if (!(referenceXml.xmlParser = xmlCreatePushParserCtxt
+          (&saxHandlerG, &referenceXml, 0, 0, 0))) {
+        return S3StatusInternalError;
+    }
+
+    S3Status status = S3StatusOK;
+
+    while (dataLen) {
+        int amt = (dataLen > BENCH_CHUNK_SIZE) ? BENCH_CHUNK_SIZE : dataLen;
+        if (xmlParseChunk((xmlParserCtxtPtr) referenceXml.xmlParser,
+                          data, amt, 0)) {
+            status = S3StatusXmlParseFailure;
+            break;
+        }
+        if ((status = referenceXml.status) != S3StatusOK) {
+            break;
+        }
+        data += amt, dataLen -= amt;
+    }
+
+    xmlFreeParserCtxt((xmlParserCtxtPtr) referenceXml.xmlParser);
+
+    return status;
+}
+
+
+// simplexml ----------------------------------------------------------------
+
+static S3Status simplexml_parse(const char *data, int dataLen,
+                                SimpleXmlCallback *callback,
+                                void *callbackData)
+{
+    SimpleXml simpleXml;
+
+    simplexml_initialize(&simpleXml, callback, callbackData);
+
+    S3Status status = S3StatusOK;
+
+    while (dataLen) {
+        int amt = (dataLen > BENCH_CHUNK_SIZE) ? BENCH_CHUNK_SIZE : dataLen;
+        if ((status = simplexml_add(&simpleXml, data, amt)) != S3StatusOK) {
+            break;
+        }
+        data += amt, dataLen -= amt;
+    }
+
+    simplexml_deinitialize(&simpleXml);
+
+    return status;
+}
+
+
+// benchmark ----------------------------------------------------------------
+
+typedef S3Status (ParseFunction)(const char *data, int dataLen,
+                                 SimpleXmlCallback *callback,
+                                 void *callbackData);
+
+
+static double now()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, 0);
+
+    return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+
+static S3Status countCallback(const char *elementPath, const char *data,
+                              int dataLen, void *callbackData)
+{
+    (void) elementPath, (void) data;
+
+    *((int64_t *) callbackData) += dataLen + 1;
+
+    return S3StatusOK;
+}
+
+
+// Parses the document repeatedly with a trivial callback, returning MB/s
+static double measure(ParseFunction *parse, const char *data, int dataLen)
+{
+    int iterations = (BENCH_MIN_BYTES / (dataLen ? dataLen : 1)) + 1;
+
+    int64_t count = 0;
+
+    double start = now();
+
+    int i;
+    for (i = 0; i < iterations; i++) {
+        (*parse)(data, dataLen, &countCallback, &count);
+    }
+
+    double elapsed = now() - start;
+
+    return (((double) dataLen * iterations) / (1024 * 1024)) /
+        ((elapsed > 0) ? elapsed : 1e-9);
+}
+
+
+static S3Status digest(ParseFunction *parse, const char *data, int dataLen,
+                       uint64_t *hashReturn)
+{
+    Digest digest;
+
+    digest.hash = 14695981039346656037ULL;
+    digest.inText = 0;
+
+    S3Status status = (*parse)(data, dataLen, &digestCallback, &digest);
+
+    *hashReturn = digest.hash;
+
+    return status;
+}
+
+
+static int bench(const char *name, const char *data, int dataLen)
+{
+    uint64_t referenceHash, simpleHash;
+
+    S3Status referenceStatus =
+        digest(&reference_parse, data, dataLen, &referenceHash);
+    S3Status simpleStatus =
+        digest(&simplexml_parse, data, dataLen, &simpleHash);
+
+    // Failed documents are only required to fail in both parsers
+    int match = (referenceStatus == simpleStatus) &&
+        ((referenceStatus != S3StatusOK) || (referenceHash == simpleHash));
+
+    double referenceRate = measure(&reference_parse, data, dataLen);
+    double simpleRate = measure(&simplexml_parse, data, dataLen);
+
+    printf("%-28s %10d %10.1f %10.1f %7.2fx  %s\n", name, dataLen,
+           referenceRate, simpleRate, simpleRate / referenceRate,
+           match ? "ok" : "MISMATCH");
+
+    return match;
+}
+
+
+static char *read_file(const char *path, int *lenReturn)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        return 0;
+    }
+
+    char *data = 0;
+    int len = 0, alloced = 0;
+
+    while (!feof(f) && !ferror(f)) {
+        if (len == alloced) {
+            alloced = alloced ? (alloced * 2) : 65536;
+            char *newData = (char *) realloc(data, alloced);
+            if (!newData) {
+                free(data);
+                fclose(f);
+                return 0;
+            }
+            data = newData;
+        }
+        len += fread(&(data[len]), 1, alloced - len, f);
+    }
+
+    fclose(f);
+
+    *lenReturn = len;
+
+    return data;
+}
+
+
+// Generates a ListBucketResult like those S3 returns for a listing of the
+// given number of keys
+static char *synthesize_listing(int keys, int *lenReturn)
+{
+    int alloced = 1024 + (keys * 512);
+    char *data = (char *) malloc(alloced);
+    if (!data) {
+        return 0;
+    }
+
+    int len = snprintf
+        (data, alloced,
+         "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+         "<ListBucketResult xmlns=\"http://s3.amazonaws.com/doc/2006-03-01/\">"
+         "<Name>example-bucket</Name><Prefix>logs/</Prefix>"
+         "<Marker></Marker><MaxKeys>%d</MaxKeys>"
+         "<IsTruncated>false</IsTruncated>", keys);
+
+    int i;
+    for (i = 0; i < keys; i++) {
+        len += snprintf
+            (&(data[len]), alloced - len,
+             "<Contents><Key>logs/2008/%02d/%02d/access-%08d.log.gz</Key>"
+             "<LastModified>2008-%02d-%02dT%02d:%02d:%02d.000Z</LastModified>"
+             "<ETag>&quot;%08x%08x%08x%08x&quot;</ETag>"
+             "<Size>%d</Size>"
+             "<Owner><ID>%064d</ID><DisplayName>owner &amp; co"
+             "</DisplayName></Owner>"
+             "<StorageClass>STANDARD</StorageClass></Contents>",
+             (i % 12) + 1, (i % 28) + 1, i, (i % 12) + 1, (i % 28) + 1,
+             i % 24, i % 60, (i / 60) % 60, i * 2654435761u, i ^ 0x5bd1e995,
+             i * 40503u, ~i, (i * 7919) % 10000000, i);
+    }
+
+    len += snprintf(&(data[len]), alloced - len, "</ListBucketResult>\n");
+
+    *lenReturn = len;
+
+    return data;
+}
+
+
+int main(int argc, char **argv)
+{
+    saxHandlerG.getEntity = &saxGetEntity;
+    saxHandlerG.startElement = &saxStartElement;
+    saxHandlerG.endElement = &saxEndElement;
+    saxHandlerG.characters = &saxCharacters;
+    saxHandlerG.cdataBlock = &saxCharacters;
+    saxHandlerG.error = &saxError;
+    saxHandlerG.fatalError = &saxError;
+
+    xmlInitParser();
+
+    printf("%-28s %10s %10s %10s %8s\n", "document", "bytes", "libxml2",
+           "simplexml", "speedup");
+
+    int ok = 1, i;
+
+    for (i = 1; i < argc; i++) {
+        int len;
+        char *data = read_file(argv[i], &len);
+        if (!data) {
+            fprintf(stderr, "ERROR: Failed to read %s\n", argv[i]);
+            ok = 0;
+            continue;
+        }
+        const char *name = strrchr(argv[i], '/');
+        ok &= bench(name ? (name + 1) : argv[i], data, len);
+        free(data);
+    }
+
+    static const int listingKeys[] = { 1, 100, 1000, 10000 };
+
+    for (i = 0; i < (int) (sizeof(listingKeys) / sizeof(listingKeys[0]));
+         i++) {
+        int len;
+        char *data = synthesize_listing(listingKeys[i], &len);
+        if (!data) {
+            fprintf(stderr, "ERROR: Out of memory\n");
+            return -1;
+        }
+        char name[64];
+        snprintf(name, sizeof(name), "listing-%d-keys", listingKeys[i]);
+        ok &= bench(name, data, len);
+        free(data);
+    }
+
+    xmlCleanupParser();
+
+    return ok ? 0 : -1;
+}
@@ -0,0 +1,256 @@
+/** **************************************************************************
+ * benchutil.c
+ * 
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include "util.h"
+
+// Measures the cost of decoding the LastModified and Size values of listing
+// results with parseIso8601Time() and parseUnsignedInt(), against the mktime() and isdigit() based
+// implementations that they replaced.
+
+#define BENCH_COUNT 1000
+
+#define BENCH_MIN_ITEMS (4 * 1000 * 1000)
+
+
+// reference implementations ------------------------------------------------
+
+static int checkString(const char *str, const char *format)
+{
+    while (*format) {
+        if (*format == 'd') {
+            if (!isdigit(*str)) {
+                return 0;
+            }
+        }
+        else if (*str != *format) {
+            return 0;
+        }
+        str++, format++;
+    }
+
+    return 1;
+}
+
+
+static int64_t referenceParseIso8601Time(const char *str)
+{
+    if (!checkString(str, "dddd-dd-ddTdd:dd:dd")) {
+        return -1;
+    }
+
+#define nextnum() (((*str - '0') * 10) + (*(str + 1) - '0'))
+
+    struct tm stm;
+    memset(&stm, 0, sizeof(stm));
+
+    stm.tm_year = (nextnum() - 19) * 100;
+    str += 2;
+    stm.tm_year += nextnum();
+    str += 3;
+
+    stm.tm_mon = nextnum() - 1;
+    str += 3;
+
+    stm.tm_mday = nextnum();
+    str += 3;
+
+    stm.tm_hour = nextnum();
+    str += 3;
+
+    stm.tm_min = nextnum();
+    str += 3;
+
+    stm.tm_sec = nextnum();
+    str += 2;
+
+    stm.tm_isdst = -1;
+
+    int64_t ret = mktime(&stm);
+
+    if (*str == '.') {
+        str++;
+        while (isdigit(*str)) {
+            str++;
+        }
+    }
+
+    if (checkString(str, "-dd:dd") || checkString(str, "+dd:dd")) {
+        int sign = (*str++ == '-') ? -1 : 1;
+        int hours = nextnum();
+        str += 3;
+        int minutes = nextnum();
+        ret += (-sign * (((hours * 60) + minutes) * 60));
+    }
+
+#undef nextnum
+
+    return ret;
+}
+
+
+static uint64_t referenceParseUnsignedInt(const char *str)
+{
+    while (is_blank(*str)) {
+        str++;
+    }
+
+    uint64_t ret = 0;
+
+    while (isdigit(*str)) {
+        ret *= 10;
+        ret += (*str++ - '0');
+    }
+
+    return ret;
+}
+
+
+// measurement --------------------------------------------------------------
+
+static const char *timeStrsG[BENCH_COUNT];
+
+static const char *sizeStrsG[BENCH_COUNT];
+
+static int64_t timesG[BENCH_COUNT];
+
+static uint64_t sizesG[BENCH_COUNT];
+
+
+static double now()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, 0);
+
+    return tv.tv_sec + (tv.tv_usec / 1000000.0);
+}
+
+
+// Decoders under measurement; each decodes all BENCH_COUNT values
+typedef enum
+{
+    BenchReferenceTimes,
+    BenchTimes,
+    BenchReferenceSizes,
+    BenchSizes
+} BenchDecoder;
+
+
+static void decode(BenchDecoder decoder)
+{
+    int i;
+
+    switch (decoder) {
+    case BenchReferenceTimes:
+        for (i = 0; i < BENCH_COUNT; i++) {
+            timesG[i] = referenceParseIso8601Time(timeStrsG[i]);
+        }
+        break;
+    case BenchTimes:
+        for (i = 0; i < BENCH_COUNT; i++) {
+            timesG[i] = parseIso8601Time(timeStrsG[i]);
+        }
+        break;
+    case BenchReferenceSizes:
+        for (i = 0; i < BENCH_COUNT; i++) {
+            sizesG[i] = referenceParseUnsignedInt(sizeStrsG[i]);
+        }
+        break;
+    case BenchSizes:
+        for (i = 0; i < BENCH_COUNT; i++) {
+            sizesG[i] = parseUnsignedInt(sizeStrsG[i]);
+        }
+        break;
+    }
+}
+
+
+// Returns nanoseconds per decoded item
+static double measure(BenchDecoder decoder)
+{
+    int iterations = BENCH_MIN_ITEMS / BENCH_COUNT, i;
+
+    double start = now();
+
+    for (i = 0; i < iterations; i++) {
+        decode(decoder);
+    }
+
+    double elapsed = now() - start;
+
+    return (elapsed * 1e9) / ((double) iterations * BENCH_COUNT);
+}
+
+
+int main()
+{
+    // The reference gives the intended results only in UTC
+    setenv("TZ", "UTC", 1);
+    tzset();
+
+    static char timeBuf[BENCH_COUNT][32], sizeBuf[BENCH_COUNT][24];
+    int i;
+
+    srand(1);
+
+    for (i = 0; i < BENCH_COUNT; i++) {
+        snprintf(timeBuf[i], sizeof(timeBuf[i]),
+                 "%04d-%02d-%02dT%02d:%02d:%02d.000Z", 2006 + (rand() % 20),
+                 1 + (rand() % 12), 1 + (rand() % 28), rand() % 24,
+                 rand() % 60, rand() % 60);
+        snprintf(sizeBuf[i], sizeof(sizeBuf[i]), "%llu",
+                 ((unsigned long long) rand()) << (rand() % 32));
+        timeStrsG[i] = timeBuf[i];
+        sizeStrsG[i] = sizeBuf[i];
+    }
+
+    double referenceTimes = measure(BenchReferenceTimes);
+    double times = measure(BenchTimes);
+    double referenceSizes = measure(BenchReferenceSizes);
+    double sizes = measure(BenchSizes);
+
+    printf("%-24s %12s %12s %9s\n", "decoder", "ref ns/item", "ns/item",
+           "speedup");
+    printf("%-24s %12.2f %12.2f %8.2fx\n", "LastModified", referenceTimes,
+           times, referenceTimes / times);
+    printf("%-24s %12.2f %12.2f %8.2fx\n", "Size", referenceSizes, sizes,
+           referenceSizes / sizes);
+
+    return 0;
+}
@@ -107,7 +107,7 @@ static void testBucketCompleteCallback(S3Status requestStatus,
 
     simplexml_deinitialize(&(tbData->simpleXml));
 
-    free(tbData);
+    s3_pool_free(tbData);
 }
 
 void S3_test_bucket(S3Protocol protocol, S3UriStyle uriStyle,
@@ -122,7 +122,7 @@ void S3_test_bucket(S3Protocol protocol, S3UriStyle uriStyle,
 {
     // Create the callback data
     TestBucketData *tbData =
-        (TestBucketData *) malloc(sizeof(TestBucketData));
+        (TestBucketData *) s3_pool_malloc(sizeof(TestBucketData));
     if (!tbData) {
         (*(handler->completeCallback))(S3StatusOutOfMemory, 0, callbackData);
         return;
@@ -142,6 +142,7 @@ void S3_test_bucket(S3Protocol protocol, S3UriStyle uriStyle,
     RequestParams params =
     {
         HttpRequestTypeGET,                           // httpRequestType
+        S3MetricsOperationGetBucketLocation,          // operation
         { hostName,                                   // hostName
           bucketName,                                 // bucketName
           protocol,                                   // protocol
@@ -165,7 +166,9 @@ void S3_test_bucket(S3Protocol protocol, S3UriStyle uriStyle,
         &testBucketDataCallback,                      // fromS3Callback
         &testBucketCompleteCallback,                  // completeCallback
         tbData,                                       // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
@@ -230,7 +233,7 @@ static void createBucketCompleteCallback(S3Status requestStatus,
     (*(cbData->responseCompleteCallback))
         (requestStatus, s3ErrorDetails, cbData->callbackData);
 
-    free(cbData);
+    s3_pool_free(cbData);
 }
 
 static S3Status createBucketFromS3Callback(int bufferSize, const char *buffer,
@@ -256,7 +259,7 @@ void S3_create_bucket(S3Protocol protocol, const char *accessKeyId,
 {
     // Create the callback data
     CreateBucketData *cbData =
-        (CreateBucketData *) malloc(sizeof(CreateBucketData));
+        (CreateBucketData *) s3_pool_malloc(sizeof(CreateBucketData));
     if (!cbData) {
         (*(handler->completeCallback))(S3StatusOutOfMemory, 0, callbackData);
         return;
@@ -290,13 +293,15 @@ void S3_create_bucket(S3Protocol protocol, const char *accessKeyId,
         cannedAcl,                               // cannedAcl
         0,                                       // metaDataCount
         0,                                       // metaData
-        0                                        // useServerSideEncryption
+        0,                                       // useServerSideEncryption
+        S3ChecksumAlgorithmNone                  // checksumAlgorithm
     };
 
     // Set up the RequestParams
     RequestParams params =
     {
         HttpRequestTypePUT,                           // httpRequestType
+        S3MetricsOperationCreateBucket,               // operation
         { hostName,                                   // hostName
           bucketName,                                 // bucketName
           protocol,                                   // protocol
@@ -320,7 +325,9 @@ void S3_create_bucket(S3Protocol protocol, const char *accessKeyId,
         createBucketFromS3Callback,                   // fromS3Callback
         &createBucketCompleteCallback,                // completeCallback
         cbData,                                       // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
@@ -357,7 +364,7 @@ static void deleteBucketCompleteCallback(S3Status requestStatus,
     (*(dbData->responseCompleteCallback))
         (requestStatus, s3ErrorDetails, dbData->callbackData);
 
-    free(dbData);
+    s3_pool_free(dbData);
 }
 
 
@@ -371,7 +378,7 @@ void S3_delete_bucket(S3Protocol protocol, S3UriStyle uriStyle,
 {
     // Create the callback data
     DeleteBucketData *dbData =
-        (DeleteBucketData *) malloc(sizeof(DeleteBucketData));
+        (DeleteBucketData *) s3_pool_malloc(sizeof(DeleteBucketData));
     if (!dbData) {
         (*(handler->completeCallback))(S3StatusOutOfMemory, 0, callbackData);
         return;
@@ -385,6 +392,7 @@ void S3_delete_bucket(S3Protocol protocol, S3UriStyle uriStyle,
     RequestParams params =
     {
         HttpRequestTypeDELETE,                        // httpRequestType
+        S3MetricsOperationDeleteBucket,               // operation
         { hostName,                                   // hostName
           bucketName,                                 // bucketName
           protocol,                                   // protocol
@@ -408,7 +416,9 @@ void S3_delete_bucket(S3Protocol protocol, S3UriStyle uriStyle,
         0,                                            // fromS3Callback
         &deleteBucketCompleteCallback,                // completeCallback
         dbData,                                       // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
@@ -418,31 +428,36 @@ void S3_delete_bucket(S3Protocol protocol, S3UriStyle uriStyle,
 
 // list bucket ----------------------------------------------------------------
 
+// A Contents read from the response.  Strings are kept as offsets into the
+// arena of the ListBucketData, since it moves as it grows, and are -1 until
+// any text is read for them.  LastModified and Size are converted as soon as
+// they have been read, and their text dropped from the arena.
 typedef struct ListBucketContents
 {
-    string_buffer(key, 1024);
-    string_buffer(lastModified, 256);
-    string_buffer(eTag, 256);
-    string_buffer(size, 24);
-    string_buffer(ownerId, 256);
-    string_buffer(ownerDisplayName, 256);
+    int key;
+    int eTag;
+    int ownerId;
+    int ownerDisplayName;
+    int64_t lastModified;
+    uint64_t size;
 } ListBucketContents;
 
 
 static void initialize_list_bucket_contents(ListBucketContents *contents)
 {
-    string_buffer_initialize(contents->key);
-    string_buffer_initialize(contents->lastModified);
-    string_buffer_initialize(contents->eTag);
-    string_buffer_initialize(contents->size);
-    string_buffer_initialize(contents->ownerId);
-    string_buffer_initialize(contents->ownerDisplayName);
+    contents->key = -1;
+    contents->eTag = -1;
+    contents->ownerId = -1;
+    contents->ownerDisplayName = -1;
+    contents->lastModified = -1;
+    contents->size = 0;
 }
 
-// We read up to 32 Contents at a time
-#define MAX_CONTENTS 32
-// We read up to 8 CommonPrefixes at a time
-#define MAX_COMMON_PREFIXES 8
+// Batch sizes are unlimited, up to the size of a page, unless the handler
+// gives one; these are only the initial sizes of the arrays and arena
+#define LIST_BUCKET_INITIAL_CONTENTS 64
+#define LIST_BUCKET_INITIAL_COMMON_PREFIXES 8
+#define LIST_BUCKET_INITIAL_ARENA (16 * 1024)
 
 typedef struct ListBucketData
 {
@@ -453,15 +468,45 @@ typedef struct ListBucketData
     S3ResponseCompleteCallback *responseCompleteCallback;
     void *callbackData;
 
-    string_buffer(isTruncated, 64);
-    string_buffer(nextMarker, 1024);
+    // Most contents and common prefixes to pass to each callback, or 0 to
+    // pass all of a page at once
+    int batchSize;
+
+    // Set if the handler gave a filter, which is copied here along with its
+    // keyPattern, which is 0 if it selects all keys
+    int filtered;
+    S3ListBucketFilter filter;
+
+    // Set when the key of the contents being read does not match the filter
+    int contentsRejected;
 
-    int contentsCount;
-    ListBucketContents contents[MAX_CONTENTS];
+    // Set if the key of the last contents read, which lastKey holds, is the
+    // marker to pass to callbacks if S3 gives none
+    int markLastKey;
+    string_buffer(lastKey, S3_MAX_KEY_SIZE);
 
-    int commonPrefixesCount;
-    char commonPrefixes[MAX_COMMON_PREFIXES][1024];
-    int commonPrefixLens[MAX_COMMON_PREFIXES];
+    string_buffer(isTruncated, 64);
+    // NextMarker, or NextContinuationToken for ListObjectsV2, or 0 if
+    // neither has been read
+    char *nextMarker;
+    int nextMarkerLen, nextMarkerSize;
+    // Set when nextMarker has been read but not yet passed to a callback
+    int nextMarkerPending;
+
+    int contentsCount, contentsSize;
+    ListBucketContents *contents;
+
+    // Offsets in the arena of the common prefixes
+    int commonPrefixesCount, commonPrefixesSize;
+    int *commonPrefixes;
+
+    // Zero terminated strings of the contents and common prefixes of the
+    // batch being read
+    char *arena;
+    int arenaLen, arenaSize;
+
+    // Offset in the arena of the string being read, or -1
+    int textStart;
 } ListBucketData;
 
 
@@ -470,8 +515,119 @@ static void initialize_list_bucket_data(ListBucketData *lbData)
     lbData->contentsCount = 0;
     initialize_list_bucket_contents(lbData->contents);
     lbData->commonPrefixesCount = 0;
-    lbData->commonPrefixes[0][0] = 0;
-    lbData->commonPrefixLens[0] = 0;
+    lbData->commonPrefixes[0] = -1;
+    lbData->arenaLen = 0;
+    lbData->textStart = -1;
+}
+
+
+static void free_list_bucket_data(ListBucketData *lbData)
+{
+    simplexml_deinitialize(&(lbData->simpleXml));
+
+    s3_pool_free(lbData->contents);
+    s3_pool_free(lbData->commonPrefixes);
+    s3_pool_free(lbData->arena);
+    s3_pool_free((char *) lbData->filter.keyPattern);
+    s3_free(lbData->nextMarker);
+    s3_pool_free(lbData);
+}
+
+
+// Appends text to [*token], a zero terminated string of [*tokenLen] bytes in
+// a buffer of [*tokenSize] bytes, growing the buffer as needed.  Continuation
+// tokens are opaque, and those of long keys are longer than the keys, so
+// they are not kept in buffers of fixed size.
+static S3Status list_bucket_token_append(char **token, int *tokenLen,
+                                         int *tokenSize, const char *data,
+                                         int dataLen)
+{
+    // Leave room for the terminating zero
+    if ((*tokenLen + dataLen) >= *tokenSize) {
+        int size = *tokenSize ? *tokenSize : 256;
+        while ((*tokenLen + dataLen) >= size) {
+            size *= 2;
+        }
+        char *newToken = (char *) s3_realloc(*token, size);
+        if (!newToken) {
+            return S3StatusOutOfMemory;
+        }
+        *token = newToken;
+        *tokenSize = size;
+    }
+
+    memcpy(&((*token)[*tokenLen]), data, dataLen);
+    *tokenLen += dataLen;
+    (*token)[*tokenLen] = 0;
+
+    return S3StatusOK;
+}
+
+
+// Appends text to the arena, starting a new string if one isn't being read,
+// and sets [*offset] to the string if it has none yet
+static S3Status list_bucket_text(ListBucketData *lbData, int *offset,
+                                 const char *data, int dataLen)
+{
+    // Leave room for the terminating zero
+    if ((lbData->arenaLen + dataLen) >= lbData->arenaSize) {
+        int arenaSize = lbData->arenaSize;
+        while ((lbData->arenaLen + dataLen) >= arenaSize) {
+            arenaSize *= 2;
+        }
+        char *arena = (char *) s3_pool_realloc(lbData->arena, arenaSize);
+        if (!arena) {
+            return S3StatusOutOfMemory;
+        }
+        lbData->arena = arena;
+        lbData->arenaSize = arenaSize;
+    }
+
+    if (lbData->textStart < 0) {
+        lbData->textStart = lbData->arenaLen;
+        if (*offset < 0) {
+            *offset = lbData->textStart;
+        }
+    }
+
+    memcpy(&(lbData->arena[lbData->arenaLen]), data, dataLen);
+    lbData->arenaLen += dataLen;
+
+    return S3StatusOK;
+}
+
+
+// Terminates the string being read, if any, returning it
+static const char *list_bucket_text_end(ListBucketData *lbData)
+{
+    if (lbData->textStart < 0) {
+        return "";
+    }
+
+    lbData->arena[lbData->arenaLen++] = 0;
+
+    const char *text = &(lbData->arena[lbData->textStart]);
+
+    lbData->textStart = -1;
+
+    return text;
+}
+
+
+// Fills in [dest] from the contents [src] read into the arena
+static void list_bucket_content(const ListBucketData *lbData,
+                                const ListBucketContents *src,
+                                S3ListBucketContent *dest)
+{
+    const char *arena = lbData->arena;
+
+    dest->key = (src->key < 0) ? "" : &(arena[src->key]);
+    dest->lastModified = src->lastModified;
+    dest->eTag = (src->eTag < 0) ? "" : &(arena[src->eTag]);
+    dest->size = src->size;
+    dest->ownerId = (src->ownerId < 0) ? 0 : &(arena[src->ownerId]);
+    dest->ownerDisplayName = (src->ownerDisplayName < 0) ? 0 :
+        &(arena[src->ownerDisplayName]);
 }
 
 
@@ -483,136 +639,384 @@ static S3Status make_list_bucket_callback(ListBucketData *lbData)
     int isTruncated = (!strcmp(lbData->isTruncated, "true") ||
                        !strcmp(lbData->isTruncated, "1")) ? 1 : 0;
 
-    // Convert the contents
-    S3ListBucketContent contents[lbData->contentsCount];
+    const char *arena = lbData->arena;
 
+    // Convert the contents
     int contentsCount = lbData->contentsCount;
-    for (i = 0; i < contentsCount; i++) {
-        S3ListBucketContent *contentDest = &(contents[i]);
-        ListBucketContents *contentSrc = &(lbData->contents[i]);
-        contentDest->key = contentSrc->key;
-        contentDest->lastModified =
-            parseIso8601Time(contentSrc->lastModified);
-        contentDest->eTag = contentSrc->eTag;
-        contentDest->size = parseUnsignedInt(contentSrc->size);
-        contentDest->ownerId =
-            contentSrc->ownerId[0] ?contentSrc->ownerId : 0;
-        contentDest->ownerDisplayName = (contentSrc->ownerDisplayName[0] ?
-                                         contentSrc->ownerDisplayName : 0);
-    }
+    S3ListBucketContent *contents = (S3ListBucketContent *)
+        s3_pool_malloc((contentsCount ? contentsCount : 1) *
+               sizeof(S3ListBucketContent));
 
     // Make the common prefixes array
     int commonPrefixesCount = lbData->commonPrefixesCount;
-    char *commonPrefixes[commonPrefixesCount];
+    const char **commonPrefixes = (const char **)
+        s3_pool_malloc((commonPrefixesCount ? commonPrefixesCount : 1) *
+               sizeof(const char *));
+
+    if (!contents || !commonPrefixes) {
+        s3_pool_free(contents);
+        s3_pool_free(commonPrefixes);
+        return S3StatusOutOfMemory;
+    }
+
+    for (i = 0; i < contentsCount; i++) {
+        list_bucket_content(lbData, &(lbData->contents[i]), &(contents[i]));
+    }
+
     for (i = 0; i < commonPrefixesCount; i++) {
-        commonPrefixes[i] = lbData->commonPrefixes[i];
+        commonPrefixes[i] = (lbData->commonPrefixes[i] < 0) ? "" :
+            &(arena[lbData->commonPrefixes[i]]);
+    }
+
+    // Contents dropped by the filter may include the last key, from which
+    // callers would otherwise continue listing
+    const char *nextMarker = lbData->nextMarker ? lbData->nextMarker : "";
+    if (!nextMarker[0] && lbData->markLastKey) {
+        nextMarker = lbData->lastKey;
     }
 
-    return (*(lbData->listBucketCallback))
-        (isTruncated, lbData->nextMarker,
+    lbData->nextMarkerPending = 0;
+
+    S3Status status = (*(lbData->listBucketCallback))
+        (isTruncated, nextMarker,
          contentsCount, contents, commonPrefixesCount,
-         (const char **) commonPrefixes, lbData->callbackData);
+         commonPrefixes, lbData->callbackData);
+
+    s3_pool_free(contents);
+    s3_pool_free(commonPrefixes);
+
+    return status;
+}
+
+
+// Returns nonzero if [key] matches the glob [pattern], as described for
+// S3ListBucketFilter
+static int list_bucket_key_matches(const char *pattern, const char *key)
+{
+    // Where to resume matching after the last '*', matching one more
+    // character of key to it
+    const char *starPattern = 0, *starKey = 0;
+
+    while (*key) {
+        unsigned char c = *key;
+        const char *next = pattern + 1;
+        int matched;
+
+        switch (*pattern) {
+        case '*':
+            starPattern = ++pattern;
+            starKey = key;
+            continue;
+        case 0:
+            next = pattern;
+            matched = 0;
+            break;
+        case '?':
+            matched = 1;
+            break;
+        case '\\':
+            if (pattern[1]) {
+                next = pattern + 2;
+            }
+            matched = ((unsigned char) next[-1] == c);
+            break;
+        case '[': {
+            const char *p = pattern + 1;
+            int negate = (*p == '!');
+            if (negate) {
+                p++;
+            }
+            // A ']' first in the set is one of its characters
+            const char *first = p;
+            matched = 0;
+            while (*p && ((*p != ']') || (p == first))) {
+                unsigned char lo = *p, hi = lo;
+                if ((p[1] == '-') && p[2] && (p[2] != ']')) {
+                    hi = p[2];
+                    p += 2;
+                }
+                if ((c >= lo) && (c <= hi)) {
+                    matched = 1;
+                }
+                p++;
+            }
+            if (*p) {
+                next = p + 1;
+                matched = (matched != negate);
+            }
+            else {
+                // Unterminated, so the '[' is literal
+                matched = (c == '[');
+            }
+            break;
+        }
+        default:
+            matched = ((unsigned char) *pattern == c);
+            break;
+        }
+
+        if (matched) {
+            pattern = next;
+            key++;
+        }
+        else if (starPattern) {
+            pattern = starPattern;
+            key = ++starKey;
+        }
+        else {
+            return 0;
+        }
+    }
+
+    while (*pattern == '*') {
+        pattern++;
+    }
+
+    return !*pattern;
 }
 
 
-static S3Status listBucketXmlCallback(const char *elementPath,
+// Returns nonzero if the filter selects [contents], which has been read
+static int list_bucket_filter_selects(ListBucketData *lbData,
+                                      const ListBucketContents *contents)
+{
+    const S3ListBucketFilter *filter = &(lbData->filter);
+
+    if (lbData->contentsRejected ||
+        (contents->size < filter->minSize) ||
+        (filter->maxSize && (contents->size > filter->maxSize)) ||
+        (filter->modifiedSince &&
+         (contents->lastModified < filter->modifiedSince)) ||
+        (filter->modifiedBefore &&
+         (contents->lastModified >= filter->modifiedBefore))) {
+        return 0;
+    }
+
+    if (filter->filterCallback) {
+        S3ListBucketContent content;
+        list_bucket_content(lbData, contents, &content);
+        return (*(filter->filterCallback))(&content, lbData->callbackData);
+    }
+
+    return 1;
+}
+
+
+// Drops [contents], which has been read, and its text, which is the last in
+// the arena since contents are read one after another
+static void list_bucket_drop_contents(ListBucketData *lbData,
+                                      ListBucketContents *contents)
+{
+    int offsets[4] = { contents->key, contents->eTag, contents->ownerId,
+                       contents->ownerDisplayName };
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        if ((offsets[i] >= 0) && (offsets[i] < lbData->arenaLen)) {
+            lbData->arenaLen = offsets[i];
+        }
+    }
+
+    initialize_list_bucket_contents(contents);
+    lbData->contentsRejected = 0;
+    // Callers must still be told the marker, and whether truncated, even
+    // if everything is dropped
+    lbData->nextMarkerPending = 1;
+}
+
+
+// Makes the callback for the batch read so far if it is full
+static S3Status list_bucket_batch_done(ListBucketData *lbData)
+{
+    if (!lbData->batchSize ||
+        ((lbData->contentsCount < lbData->batchSize) &&
+         (lbData->commonPrefixesCount < lbData->batchSize))) {
+        return S3StatusOK;
+    }
+
+    S3Status status = make_list_bucket_callback(lbData);
+
+    initialize_list_bucket_data(lbData);
+
+    return status;
+}
+
+
+// Ids of the elements of a ListBucketResult, for listBucketXmlCallback
+enum
+{
+    ListBucketResult,
+    ListBucketResultIsTruncated,
+    ListBucketResultNextMarker,
+    ListBucketResultNextContinuationToken,
+    ListBucketResultContents,
+    ListBucketResultContentsKey,
+    ListBucketResultContentsLastModified,
+    ListBucketResultContentsETag,
+    ListBucketResultContentsSize,
+    ListBucketResultContentsOwner,
+    ListBucketResultContentsOwnerID,
+    ListBucketResultContentsOwnerDisplayName,
+    ListBucketResultCommonPrefixes,
+    ListBucketResultCommonPrefixesPrefix
+};
+
+static const SimpleXmlPath listBucketPathsG[] =
+{
+    SIMPLEXML_PATH(ListBucketResult, "ListBucketResult"),
+    SIMPLEXML_PATH(ListBucketResultIsTruncated,
+                   "ListBucketResult/IsTruncated"),
+    SIMPLEXML_PATH(ListBucketResultNextMarker, "ListBucketResult/NextMarker"),
+    SIMPLEXML_PATH(ListBucketResultNextContinuationToken,
+                   "ListBucketResult/NextContinuationToken"),
+    SIMPLEXML_PATH(ListBucketResultContents, "ListBucketResult/Contents"),
+    SIMPLEXML_PATH(ListBucketResultContentsKey,
+                   "ListBucketResult/Contents/Key"),
+    SIMPLEXML_PATH(ListBucketResultContentsLastModified,
+                   "ListBucketResult/Contents/LastModified"),
+    SIMPLEXML_PATH(ListBucketResultContentsETag,
+                   "ListBucketResult/Contents/ETag"),
+    SIMPLEXML_PATH(ListBucketResultContentsSize,
+                   "ListBucketResult/Contents/Size"),
+    SIMPLEXML_PATH(ListBucketResultContentsOwner,
+                   "ListBucketResult/Contents/Owner"),
+    SIMPLEXML_PATH(ListBucketResultContentsOwnerID,
+                   "ListBucketResult/Contents/Owner/ID"),
+    SIMPLEXML_PATH(ListBucketResultContentsOwnerDisplayName,
+                   "ListBucketResult/Contents/Owner/DisplayName"),
+    SIMPLEXML_PATH(ListBucketResultCommonPrefixes,
+                   "ListBucketResult/CommonPrefixes"),
+    SIMPLEXML_PATH(ListBucketResultCommonPrefixesPrefix,
+                   "ListBucketResult/CommonPrefixes/Prefix")
+};
+
+
+static S3Status listBucketXmlCallback(int elementId, const char *elementPath,
                                       const char *data, int dataLen,
                                       void *callbackData)
 {
+    (void) elementPath;
+
     ListBucketData *lbData = (ListBucketData *) callbackData;
 
-    int fit;
+    ListBucketContents *contents =
+        &(lbData->contents[lbData->contentsCount]);
+
+    int fit, unused = -1;
+
+    // Skip the rest of contents whose key the filter rejected; this relies
+    // on the order of the ids of the elements of Contents
+    if (lbData->contentsRejected &&
+        (elementId > ListBucketResultContentsKey) &&
+        (elementId <= ListBucketResultContentsOwnerDisplayName)) {
+        return S3StatusOK;
+    }
 
     if (data) {
-        if (!strcmp(elementPath, "ListBucketResult/IsTruncated")) {
+        switch (elementId) {
+        case ListBucketResultIsTruncated:
             string_buffer_append(lbData->isTruncated, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath, "ListBucketResult/NextMarker")) {
-            string_buffer_append(lbData->nextMarker, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath, "ListBucketResult/Contents/Key")) {
-            ListBucketContents *contents =
-                &(lbData->contents[lbData->contentsCount]);
-            string_buffer_append(contents->key, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath,
-                         "ListBucketResult/Contents/LastModified")) {
-            ListBucketContents *contents =
-                &(lbData->contents[lbData->contentsCount]);
-            string_buffer_append(contents->lastModified, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath, "ListBucketResult/Contents/ETag")) {
-            ListBucketContents *contents =
-                &(lbData->contents[lbData->contentsCount]);
-            string_buffer_append(contents->eTag, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath, "ListBucketResult/Contents/Size")) {
-            ListBucketContents *contents =
-                &(lbData->contents[lbData->contentsCount]);
-            string_buffer_append(contents->size, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath, "ListBucketResult/Contents/Owner/ID")) {
-            ListBucketContents *contents =
-                &(lbData->contents[lbData->contentsCount]);
-            string_buffer_append(contents->ownerId, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath,
-                         "ListBucketResult/Contents/Owner/DisplayName")) {
-            ListBucketContents *contents =
-                &(lbData->contents[lbData->contentsCount]);
-            string_buffer_append
-                (contents->ownerDisplayName, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath,
-                         "ListBucketResult/CommonPrefixes/Prefix")) {
-            int which = lbData->commonPrefixesCount;
-            size_t oldLen = lbData->commonPrefixLens[which];
-            lbData->commonPrefixLens[which] +=
-                snprintf(lbData->commonPrefixes[which]+oldLen,
-                         sizeof(lbData->commonPrefixes[which]) -
-                         oldLen - 1,
-                         "%.*s", dataLen, data);
-            if (lbData->commonPrefixLens[which] >=
-                (int) sizeof(lbData->commonPrefixes[which])) {
-                return S3StatusXmlParseFailure;
-            }
+            break;
+        case ListBucketResultNextMarker:
+        case ListBucketResultNextContinuationToken:
+            lbData->nextMarkerPending = 1;
+            return list_bucket_token_append
+                (&(lbData->nextMarker), &(lbData->nextMarkerLen),
+                 &(lbData->nextMarkerSize), data, dataLen);
+        case ListBucketResultContentsKey:
+            return list_bucket_text(lbData, &(contents->key), data, dataLen);
+        case ListBucketResultContentsETag:
+            return list_bucket_text(lbData, &(contents->eTag), data, dataLen);
+        case ListBucketResultContentsOwnerID:
+            return list_bucket_text(lbData, &(contents->ownerId), data,
+                                    dataLen);
+        case ListBucketResultContentsOwnerDisplayName:
+            return list_bucket_text(lbData, &(contents->ownerDisplayName),
+                                    data, dataLen);
+        case ListBucketResultContentsLastModified:
+        case ListBucketResultContentsSize:
+            // Read into the arena only until converted
+            return list_bucket_text(lbData, &unused, data, dataLen);
+        case ListBucketResultCommonPrefixesPrefix:
+            return list_bucket_text
+                (lbData, &(lbData->commonPrefixes
+                           [lbData->commonPrefixesCount]), data, dataLen);
         }
     }
     else {
-        if (!strcmp(elementPath, "ListBucketResult/Contents")) {
-            // Finished a Contents
-            lbData->contentsCount++;
-            if (lbData->contentsCount == MAX_CONTENTS) {
-                // Make the callback
-                S3Status status = make_list_bucket_callback(lbData);
-                if (status != S3StatusOK) {
-                    return status;
-                }
-                initialize_list_bucket_data(lbData);
+        switch (elementId) {
+        case ListBucketResultContentsKey: {
+            const char *key = list_bucket_text_end(lbData);
+            if (lbData->markLastKey) {
+                string_buffer_initialize(lbData->lastKey);
+                string_buffer_append(lbData->lastKey, key, strlen(key), fit);
+            }
+            if (lbData->filter.keyPattern &&
+                !list_bucket_key_matches(lbData->filter.keyPattern, key)) {
+                lbData->contentsRejected = 1;
+            }
+            break;
+        }
+        case ListBucketResultContentsETag:
+        case ListBucketResultContentsOwnerID:
+        case ListBucketResultContentsOwnerDisplayName:
+            list_bucket_text_end(lbData);
+            break;
+        case ListBucketResultContentsLastModified:
+        case ListBucketResultContentsSize: {
+            int textStart = lbData->textStart;
+            const char *text = list_bucket_text_end(lbData);
+            if (elementId == ListBucketResultContentsLastModified) {
+                contents->lastModified = parseIso8601Time(text);
             }
             else {
-                // Initialize the next one
-                initialize_list_bucket_contents
-                    (&(lbData->contents[lbData->contentsCount]));
+                contents->size = parseUnsignedInt(text);
+            }
+            if (textStart >= 0) {
+                lbData->arenaLen = textStart;
             }
+            break;
         }
-        else if (!strcmp(elementPath,
-                         "ListBucketResult/CommonPrefixes/Prefix")) {
-            // Finished a Prefix
-            lbData->commonPrefixesCount++;
-            if (lbData->commonPrefixesCount == MAX_COMMON_PREFIXES) {
-                // Make the callback
-                S3Status status = make_list_bucket_callback(lbData);
-                if (status != S3StatusOK) {
-                    return status;
+        case ListBucketResultContents:
+            // Finished a Contents
+            if (lbData->filtered &&
+                !list_bucket_filter_selects(lbData, contents)) {
+                list_bucket_drop_contents(lbData, contents);
+                break;
+            }
+            if (++(lbData->contentsCount) == lbData->contentsSize) {
+                int contentsSize = lbData->contentsSize * 2;
+                ListBucketContents *newContents = (ListBucketContents *)
+                    s3_pool_realloc(lbData->contents,
+                            contentsSize * sizeof(ListBucketContents));
+                if (!newContents) {
+                    return S3StatusOutOfMemory;
                 }
-                initialize_list_bucket_data(lbData);
+                lbData->contents = newContents;
+                lbData->contentsSize = contentsSize;
             }
-            else {
-                // Initialize the next one
-                lbData->commonPrefixes[lbData->commonPrefixesCount][0] = 0;
-                lbData->commonPrefixLens[lbData->commonPrefixesCount] = 0;
+            // Initialize the next one
+            initialize_list_bucket_contents
+                (&(lbData->contents[lbData->contentsCount]));
+            return list_bucket_batch_done(lbData);
+        case ListBucketResultCommonPrefixesPrefix:
+            // Finished a Prefix
+            list_bucket_text_end(lbData);
+            if (++(lbData->commonPrefixesCount) ==
+                lbData->commonPrefixesSize) {
+                int commonPrefixesSize = lbData->commonPrefixesSize * 2;
+                int *newCommonPrefixes = (int *)
+                    s3_pool_realloc(lbData->commonPrefixes,
+                            commonPrefixesSize * sizeof(int));
+                if (!newCommonPrefixes) {
+                    return S3StatusOutOfMemory;
+                }
+                lbData->commonPrefixes = newCommonPrefixes;
+                lbData->commonPrefixesSize = commonPrefixesSize;
             }
+            // Initialize the next one
+            lbData->commonPrefixes[lbData->commonPrefixesCount] = -1;
+            return list_bucket_batch_done(lbData);
         }
     }
 
@@ -628,6 +1032,9 @@ static S3Status listBucketPropertiesCallback
 {
     ListBucketData *lbData = (ListBucketData *) callbackData;
 
+    if (!lbData->responsePropertiesCallback) {
+        return S3StatusOK;
+    }
     return (*(lbData->responsePropertiesCallback))
         (responseProperties, lbData->callbackData);
 }
@@ -648,72 +1055,103 @@ static void listBucketCompleteCallback(S3Status requestStatus,
 {
     ListBucketData *lbData = (ListBucketData *) callbackData;
 
-    // Make the callback if there is anything
-    if (lbData->contentsCount || lbData->commonPrefixesCount) {
+    // Make the callback if there is anything, including a NextMarker that
+    // followed the last batch of contents
+    if (lbData->contentsCount || lbData->commonPrefixesCount ||
+        lbData->nextMarkerPending) {
         make_list_bucket_callback(lbData);
     }
 
     (*(lbData->responseCompleteCallback))
         (requestStatus, s3ErrorDetails, lbData->callbackData);
 
-    simplexml_deinitialize(&(lbData->simpleXml));
+    free_list_bucket_data(lbData);
+}
+
+
+// Query parameters of a list bucket request, which are as long as the
+// prefix, marker or continuation token, and key to start after that they
+// carry
+typedef struct ListBucketQuery
+{
+    char *queryParams;
+    int queryParamsLen, queryParamsSize;
+} ListBucketQuery;
+
+
+// Appends [name]=[value] to the query parameters, url encoding [value]
+static S3Status list_bucket_query_append(ListBucketQuery *query,
+                                         const char *name, const char *value)
+{
+    int nameLen = strlen(name), valueLen = strlen(value);
+
+    // Each character of the value may take three once url encoded, and
+    // there is an '&', an '=' and a terminating zero
+    int size = query->queryParamsLen + nameLen + (3 * valueLen) + 3;
+    if (size > query->queryParamsSize) {
+        char *queryParams = (char *) s3_realloc(query->queryParams, size);
+        if (!queryParams) {
+            return S3StatusOutOfMemory;
+        }
+        query->queryParams = queryParams;
+        query->queryParamsSize = size;
+    }
 
-    free(lbData);
+    char *dest = &(query->queryParams[query->queryParamsLen]);
+    if (query->queryParamsLen) {
+        *dest++ = '&';
+    }
+    memcpy(dest, name, nameLen);
+    dest += nameLen;
+    *dest++ = '=';
+    urlEncode(dest, value, valueLen, 1);
+    query->queryParamsLen = (dest - query->queryParams) + strlen(dest);
+
+    return S3StatusOK;
 }
 
 
-void S3_list_bucket(const S3BucketContext *bucketContext, const char *prefix,
-                    const char *marker, const char *delimiter, int maxkeys,
-                    S3RequestContext *requestContext,
-                    int timeoutMs,
-                    const S3ListBucketHandler *handler, void *callbackData)
+// Composes the query parameters for either a ListObjects request, using
+// [marker], or a ListObjectsV2 request if [listType2] is nonzero, using
+// [continuationToken], [startAfter] and [fetchOwner]
+static S3Status compose_list_bucket_query(ListBucketQuery *query,
+                                          const char *prefix,
+                                          const char *marker, int listType2,
+                                          const char *continuationToken,
+                                          const char *startAfter,
+                                          int fetchOwner,
+                                          const char *delimiter, int maxkeys)
 {
-    // Compose the query params
-    string_buffer(queryParams, 4096);
-    string_buffer_initialize(queryParams);
+    query->queryParams = 0;
+    query->queryParamsLen = 0;
+    query->queryParamsSize = 0;
 
 #define safe_append(name, value)                                        \
     do {                                                                \
-        int fit;                                                        \
-        if (amp) {                                                      \
-            string_buffer_append(queryParams, "&", 1, fit);             \
-            if (!fit) {                                                 \
-                (*(handler->responseHandler.completeCallback))          \
-                    (S3StatusQueryParamsTooLong, 0, callbackData);      \
-                return;                                                 \
-            }                                                           \
-        }                                                               \
-        string_buffer_append(queryParams, name "=",                     \
-                             sizeof(name "=") - 1, fit);                \
-        if (!fit) {                                                     \
-            (*(handler->responseHandler.completeCallback))              \
-                (S3StatusQueryParamsTooLong, 0, callbackData);          \
-            return;                                                     \
-        }                                                               \
-        amp = 1;                                                        \
-        char encoded[3 * 1024];                                         \
-        if (!urlEncode(encoded, value, 1024, 1)) {                   \
-            (*(handler->responseHandler.completeCallback))              \
-                (S3StatusQueryParamsTooLong, 0, callbackData);          \
-            return;                                                     \
-        }                                                               \
-        string_buffer_append(queryParams, encoded, strlen(encoded),     \
-                             fit);                                      \
-        if (!fit) {                                                     \
-            (*(handler->responseHandler.completeCallback))              \
-                (S3StatusQueryParamsTooLong, 0, callbackData);          \
-            return;                                                     \
+        S3Status status = list_bucket_query_append(query, name, value); \
+        if (status != S3StatusOK) {                                     \
+            return status;                                              \
         }                                                               \
     } while (0)
 
-
-    int amp = 0;
+    if (listType2) {
+        safe_append("list-type", "2");
+    }
     if (prefix && *prefix) {
         safe_append("prefix", prefix);
     }
     if (marker && *marker) {
         safe_append("marker", marker);
     }
+    if (continuationToken && *continuationToken) {
+        safe_append("continuation-token", continuationToken);
+    }
+    if (startAfter && *startAfter) {
+        safe_append("start-after", startAfter);
+    }
+    if (listType2 && fetchOwner) {
+        safe_append("fetch-owner", "true");
+    }
     if (delimiter && *delimiter) {
         safe_append("delimiter", delimiter);
     }
@@ -723,32 +1161,26 @@ void S3_list_bucket(const S3BucketContext *bucketContext, const char *prefix,
         safe_append("max-keys", maxKeysString);
     }
 
-    ListBucketData *lbData =
-        (ListBucketData *) malloc(sizeof(ListBucketData));
-
-    if (!lbData) {
-        (*(handler->responseHandler.completeCallback))
-            (S3StatusOutOfMemory, 0, callbackData);
-        return;
-    }
-
-    simplexml_initialize(&(lbData->simpleXml), &listBucketXmlCallback, lbData);
+#undef safe_append
 
-    lbData->responsePropertiesCallback =
-        handler->responseHandler.propertiesCallback;
-    lbData->listBucketCallback = handler->listBucketCallback;
-    lbData->responseCompleteCallback =
-        handler->responseHandler.completeCallback;
-    lbData->callbackData = callbackData;
+    return (query->queryParamsLen > MAX_QUERY_PARAMS_SIZE) ?
+        S3StatusQueryParamsTooLong : S3StatusOK;
+}
 
-    string_buffer_initialize(lbData->isTruncated);
-    string_buffer_initialize(lbData->nextMarker);
-    initialize_list_bucket_data(lbData);
 
+// Performs a list bucket request with the given query parameters
+static void perform_list_bucket
+    (const S3BucketContext *bucketContext, const ListBucketQuery *query,
+     S3ResponsePropertiesCallback *propertiesCallback,
+     S3GetObjectDataCallback *dataCallback,
+     S3ResponseCompleteCallback *completeCallback, void *callbackData,
+     S3RequestContext *requestContext, int timeoutMs)
+{
     // Set up the RequestParams
     RequestParams params =
     {
         HttpRequestTypeGET,                           // httpRequestType
+        S3MetricsOperationListObjects,                // operation
         { bucketContext->hostName,                    // hostName
           bucketContext->bucketName,                  // bucketName
           bucketContext->protocol,                    // protocol
@@ -758,7 +1190,7 @@ void S3_list_bucket(const S3BucketContext *bucketContext, const char *prefix,
           bucketContext->securityToken,               // securityToken
           bucketContext->authRegion },                // authRegion
         0,                                            // key
-        queryParams[0] ? queryParams : 0,             // queryParams
+        query->queryParamsLen ? query->queryParams : 0, // queryParams
         0,                                            // subResource
         0,                                            // copySourceBucketName
         0,                                            // copySourceKey
@@ -766,15 +1198,581 @@ void S3_list_bucket(const S3BucketContext *bucketContext, const char *prefix,
         0,                                            // startByte
         0,                                            // byteCount
         0,                                            // putProperties
-        &listBucketPropertiesCallback,                // propertiesCallback
+        propertiesCallback,                           // propertiesCallback
         0,                                            // toS3Callback
         0,                                            // toS3CallbackTotalSize
-        &listBucketDataCallback,                      // fromS3Callback
-        &listBucketCompleteCallback,                  // completeCallback
-        lbData,                                       // callbackData
-        timeoutMs                                     // timeoutMs
+        dataCallback,                                 // fromS3Callback
+        completeCallback,                             // completeCallback
+        callbackData,                                 // callbackData
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
     request_perform(&params, requestContext);
 }
+
+
+// Issues either a ListObjects request, using [marker], or a ListObjectsV2
+// request if [listType2] is nonzero, using [continuationToken],
+// [startAfter] and [fetchOwner]
+static void list_bucket(const S3BucketContext *bucketContext,
+                        const char *prefix, const char *marker,
+                        int listType2, const char *continuationToken,
+                        const char *startAfter, int fetchOwner,
+                        const char *delimiter, int maxkeys,
+                        S3RequestContext *requestContext, int timeoutMs,
+                        const S3ListBucketHandler *handler,
+                        void *callbackData)
+{
+    ListBucketData *lbData =
+        (ListBucketData *) s3_pool_malloc(sizeof(ListBucketData));
+
+    if (!lbData) {
+        (*(handler->responseHandler.completeCallback))
+            (S3StatusOutOfMemory, 0, callbackData);
+        return;
+    }
+
+    lbData->contentsSize = LIST_BUCKET_INITIAL_CONTENTS;
+    lbData->contents = (ListBucketContents *)
+        s3_pool_malloc(lbData->contentsSize * sizeof(ListBucketContents));
+    lbData->commonPrefixesSize = LIST_BUCKET_INITIAL_COMMON_PREFIXES;
+    lbData->commonPrefixes = (int *)
+        s3_pool_malloc(lbData->commonPrefixesSize * sizeof(int));
+    lbData->arenaSize = LIST_BUCKET_INITIAL_ARENA;
+    lbData->arena = (char *) s3_pool_malloc(lbData->arenaSize);
+
+    if (!lbData->contents || !lbData->commonPrefixes || !lbData->arena) {
+        s3_pool_free(lbData->contents);
+        s3_pool_free(lbData->commonPrefixes);
+        s3_pool_free(lbData->arena);
+        s3_pool_free(lbData);
+        (*(handler->responseHandler.completeCallback))
+            (S3StatusOutOfMemory, 0, callbackData);
+        return;
+    }
+
+    simplexml_initialize_ids(&(lbData->simpleXml), listBucketPathsG,
+                             sizeof(listBucketPathsG) /
+                             sizeof(listBucketPathsG[0]),
+                             &listBucketXmlCallback, lbData);
+
+    lbData->nextMarker = 0;
+    lbData->nextMarkerLen = 0;
+    lbData->nextMarkerSize = 0;
+
+    lbData->responsePropertiesCallback =
+        handler->responseHandler.propertiesCallback;
+    lbData->listBucketCallback = handler->listBucketCallback;
+    lbData->responseCompleteCallback =
+        handler->responseHandler.completeCallback;
+    lbData->callbackData = callbackData;
+    lbData->batchSize = (handler->batchSize > 0) ? handler->batchSize : 0;
+
+    lbData->filtered = (handler->filter != 0);
+    if (lbData->filtered) {
+        lbData->filter = *(handler->filter);
+    }
+    else {
+        memset(&(lbData->filter), 0, sizeof(lbData->filter));
+    }
+    const char *keyPattern = lbData->filter.keyPattern;
+    lbData->filter.keyPattern = 0;
+    if (keyPattern && *keyPattern) {
+        int len = strlen(keyPattern) + 1;
+        char *copy = (char *) s3_pool_malloc(len);
+        if (!copy) {
+            free_list_bucket_data(lbData);
+            (*(handler->responseHandler.completeCallback))
+                (S3StatusOutOfMemory, 0, callbackData);
+            return;
+        }
+        lbData->filter.keyPattern = (const char *) memcpy(copy, keyPattern,
+                                                          len);
+    }
+    lbData->contentsRejected = 0;
+    // ListObjectsV2 always gives a continuation token if truncated
+    lbData->markLastKey = lbData->filtered && !listType2;
+    string_buffer_initialize(lbData->lastKey);
+
+    string_buffer_initialize(lbData->isTruncated);
+    lbData->nextMarkerPending = 0;
+    initialize_list_bucket_data(lbData);
+
+    ListBucketQuery query;
+
+    S3Status status = compose_list_bucket_query
+        (&query, prefix, marker, listType2, continuationToken, startAfter,
+         fetchOwner, delimiter, maxkeys);
+    if (status != S3StatusOK) {
+        s3_free(query.queryParams);
+        free_list_bucket_data(lbData);
+        (*(handler->responseHandler.completeCallback))
+            (status, 0, callbackData);
+        return;
+    }
+
+    // Only register a properties callback when the caller supplied one, so
+    // that response headers are not parsed for nothing
+    perform_list_bucket(bucketContext, &query,
+                        handler->responseHandler.propertiesCallback ?
+                        &listBucketPropertiesCallback : 0,
+                        &listBucketDataCallback, &listBucketCompleteCallback,
+                        lbData, requestContext, timeoutMs);
+
+    s3_free(query.queryParams);
+}
+
+
+void S3_list_bucket(const S3BucketContext *bucketContext, const char *prefix,
+                    const char *marker, const char *delimiter, int maxkeys,
+                    S3RequestContext *requestContext,
+                    int timeoutMs,
+                    const S3ListBucketHandler *handler, void *callbackData)
+{
+    list_bucket(bucketContext, prefix, marker, 0, 0, 0, 0, delimiter,
+                maxkeys, requestContext, timeoutMs, handler, callbackData);
+}
+
+
+void S3_list_bucket_v2(const S3BucketContext *bucketContext,
+                       const char *prefix, const char *continuationToken,
+                       const char *startAfter, const char *delimiter,
+                       int maxkeys, int fetchOwner,
+                       S3RequestContext *requestContext, int timeoutMs,
+                       const S3ListBucketHandler *handler, void *callbackData)
+{
+    list_bucket(bucketContext, prefix, 0, 1, continuationToken, startAfter,
+                fetchOwner, delimiter, maxkeys, requestContext, timeoutMs,
+                handler, callbackData);
+}
+
+
+// list bucket columns --------------------------------------------------------
+
+// Rows and bytes of keys and common prefixes are only the initial sizes of
+// the columns, which grow as needed
+#define LIST_COLUMNS_INITIAL_ROWS 256
+#define LIST_COLUMNS_INITIAL_BYTES (16 * 1024)
+#define LIST_COLUMNS_INITIAL_COMMON_PREFIXES 8
+
+typedef struct ListColumnsData
+{
+    SimpleXml simpleXml;
+
+    S3ResponsePropertiesCallback *responsePropertiesCallback;
+    S3ListBucketColumnsCallback *listBucketColumnsCallback;
+    S3ResponseCompleteCallback *responseCompleteCallback;
+    void *callbackData;
+
+    string_buffer(isTruncated, 64);
+    // NextContinuationToken, or 0 if it has not been read
+    char *nextContinuationToken;
+    int nextContinuationTokenLen, nextContinuationTokenSize;
+
+    // Text of the LastModified, Size or ETag being read
+    string_buffer(value, 256);
+
+    // Columns of the keys read so far, and of the one being read, for which
+    // there is always room
+    int count, rowsSize;
+    char *keys;
+    uint32_t keysLen, keysSize;
+    uint32_t *keyOffsets;
+    uint64_t *sizes;
+    int64_t *lastModified;
+    unsigned char *eTags;
+    int32_t *eTagParts;
+
+    // Likewise for the common prefixes
+    int commonPrefixesCount, commonPrefixesSize;
+    char *commonPrefixes;
+    uint32_t commonPrefixesLen, commonPrefixesBytes;
+    uint32_t *commonPrefixOffsets;
+} ListColumnsData;
+
+
+static void free_list_columns_data(ListColumnsData *lcData)
+{
+    simplexml_deinitialize(&(lcData->simpleXml));
+
+    s3_free(lcData->keys);
+    s3_free(lcData->keyOffsets);
+    s3_free(lcData->sizes);
+    s3_free(lcData->lastModified);
+    s3_free(lcData->eTags);
+    s3_free(lcData->eTagParts);
+    s3_free(lcData->commonPrefixes);
+    s3_free(lcData->commonPrefixOffsets);
+    s3_free(lcData->nextContinuationToken);
+    s3_free(lcData);
+}
+
+
+// Appends bytes to a column of strings
+static S3Status list_columns_append(char **bytes, uint32_t *len,
+                                    uint32_t *size, const char *data,
+                                    int dataLen)
+{
+    if ((*len + dataLen) > *size) {
+        uint32_t newSize = *size;
+        while ((*len + dataLen) > newSize) {
+            newSize *= 2;
+        }
+        char *newBytes = (char *) s3_realloc(*bytes, newSize);
+        if (!newBytes) {
+            return S3StatusOutOfMemory;
+        }
+        *bytes = newBytes;
+        *size = newSize;
+    }
+
+    memcpy(&((*bytes)[*len]), data, dataLen);
+    *len += dataLen;
+
+    return S3StatusOK;
+}
+
+
+// Sets up the columns of the key after the last one read, growing them if
+// necessary
+static S3Status list_columns_start_row(ListColumnsData *lcData)
+{
+    int row = lcData->count;
+
+    // keyOffsets has a row more than the others, for the end of the last key
+    if ((row + 1) >= lcData->rowsSize) {
+        int rowsSize = lcData->rowsSize * 2;
+#define grow(column)                                                    \
+        do {                                                            \
+            void *newColumn = s3_realloc(lcData->column, rowsSize *        \
+                                      sizeof(lcData->column[0]));       \
+            if (!newColumn) {                                           \
+                return S3StatusOutOfMemory;                             \
+            }                                                           \
+            lcData->column = newColumn;                                 \
+        } while (0)
+        grow(keyOffsets);
+        grow(sizes);
+        grow(lastModified);
+        grow(eTagParts);
+#undef grow
+        unsigned char *eTags =
+            (unsigned char *) s3_realloc(lcData->eTags, rowsSize * 16);
+        if (!eTags) {
+            return S3StatusOutOfMemory;
+        }
+        lcData->eTags = eTags;
+        lcData->rowsSize = rowsSize;
+    }
+
+    lcData->keyOffsets[row] = lcData->keysLen;
+    lcData->sizes[row] = 0;
+    lcData->lastModified[row] = -1;
+    memset(&(lcData->eTags[row * 16]), 0, 16);
+    lcData->eTagParts[row] = -1;
+
+    return S3StatusOK;
+}
+
+
+static int hex_digit(char c)
+{
+    if ((c >= '0') && (c <= '9')) {
+        return c - '0';
+    }
+    else if ((c >= 'a') && (c <= 'f')) {
+        return c - 'a' + 10;
+    }
+    else if ((c >= 'A') && (c <= 'F')) {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+
+// Converts an ETag, which is the quoted hex MD5 of an object or, for an
+// object uploaded in parts, that of its parts followed by '-' and the number
+// of them
+static void list_columns_etag(ListColumnsData *lcData, const char *eTag)
+{
+    unsigned char digest[16];
+    int32_t parts = 0;
+
+    if (*eTag == '"') {
+        eTag++;
+    }
+
+    int i;
+    for (i = 0; i < 16; i++) {
+        int high = hex_digit(eTag[0]), low = (high < 0) ? -1 :
+            hex_digit(eTag[1]);
+        if (low < 0) {
+            return;
+        }
+        digest[i] = (high << 4) | low;
+        eTag += 2;
+    }
+
+    if (*eTag == '-') {
+        eTag++;
+        if ((*eTag < '0') || (*eTag > '9')) {
+            return;
+        }
+        while ((*eTag >= '0') && (*eTag <= '9')) {
+            parts = (parts * 10) + (*eTag++ - '0');
+            if (parts > 100000) {
+                return;
+            }
+        }
+    }
+
+    if (*eTag == '"') {
+        eTag++;
+    }
+
+    if (*eTag) {
+        return;
+    }
+
+    memcpy(&(lcData->eTags[lcData->count * 16]), digest, 16);
+    lcData->eTagParts[lcData->count] = parts;
+}
+
+
+static S3Status listColumnsXmlCallback(int elementId,
+                                       const char *elementPath,
+                                       const char *data, int dataLen,
+                                       void *callbackData)
+{
+    (void) elementPath;
+
+    ListColumnsData *lcData = (ListColumnsData *) callbackData;
+
+    int fit;
+
+    if (data) {
+        switch (elementId) {
+        case ListBucketResultIsTruncated:
+            string_buffer_append(lcData->isTruncated, data, dataLen, fit);
+            break;
+        case ListBucketResultNextContinuationToken:
+            return list_bucket_token_append
+                (&(lcData->nextContinuationToken),
+                 &(lcData->nextContinuationTokenLen),
+                 &(lcData->nextContinuationTokenSize), data, dataLen);
+        case ListBucketResultContentsKey:
+            return list_columns_append(&(lcData->keys), &(lcData->keysLen),
+                                       &(lcData->keysSize), data, dataLen);
+        case ListBucketResultContentsLastModified:
+        case ListBucketResultContentsSize:
+        case ListBucketResultContentsETag:
+            string_buffer_append(lcData->value, data, dataLen, fit);
+            break;
+        case ListBucketResultCommonPrefixesPrefix:
+            return list_columns_append
+                (&(lcData->commonPrefixes), &(lcData->commonPrefixesLen),
+                 &(lcData->commonPrefixesBytes), data, dataLen);
+        }
+    }
+    else {
+        switch (elementId) {
+        case ListBucketResultContentsLastModified:
+            lcData->lastModified[lcData->count] =
+                parseIso8601Time(lcData->value);
+            string_buffer_initialize(lcData->value);
+            break;
+        case ListBucketResultContentsSize:
+            lcData->sizes[lcData->count] = parseUnsignedInt(lcData->value);
+            string_buffer_initialize(lcData->value);
+            break;
+        case ListBucketResultContentsETag:
+            list_columns_etag(lcData, lcData->value);
+            string_buffer_initialize(lcData->value);
+            break;
+        case ListBucketResultContents:
+            // Finished a Contents
+            lcData->count++;
+            return list_columns_start_row(lcData);
+        case ListBucketResultCommonPrefixesPrefix:
+            // Finished a Prefix
+            if (++(lcData->commonPrefixesCount) ==
+                lcData->commonPrefixesSize) {
+                int commonPrefixesSize = lcData->commonPrefixesSize * 2;
+                uint32_t *commonPrefixOffsets = (uint32_t *)
+                    s3_realloc(lcData->commonPrefixOffsets,
+                            (commonPrefixesSize + 1) * sizeof(uint32_t));
+                if (!commonPrefixOffsets) {
+                    return S3StatusOutOfMemory;
+                }
+                lcData->commonPrefixOffsets = commonPrefixOffsets;
+                lcData->commonPrefixesSize = commonPrefixesSize;
+            }
+            lcData->commonPrefixOffsets[lcData->commonPrefixesCount] =
+                lcData->commonPrefixesLen;
+            break;
+        }
+    }
+
+    /* Avoid compiler error about variable set but not used */
+    (void) fit;
+
+    return S3StatusOK;
+}
+
+
+static S3Status listColumnsPropertiesCallback
+    (const S3ResponseProperties *responseProperties, void *callbackData)
+{
+    ListColumnsData *lcData = (ListColumnsData *) callbackData;
+
+    if (!lcData->responsePropertiesCallback) {
+        return S3StatusOK;
+    }
+    return (*(lcData->responsePropertiesCallback))
+        (responseProperties, lcData->callbackData);
+}
+
+
+static S3Status listColumnsDataCallback(int bufferSize, const char *buffer,
+                                        void *callbackData)
+{
+    ListColumnsData *lcData = (ListColumnsData *) callbackData;
+
+    return simplexml_add(&(lcData->simpleXml), buffer, bufferSize);
+}
+
+
+static void listColumnsCompleteCallback(S3Status requestStatus,
+                                        const S3ErrorDetails *s3ErrorDetails,
+                                        void *callbackData)
+{
+    ListColumnsData *lcData = (ListColumnsData *) callbackData;
+
+    if (lcData->count || lcData->commonPrefixesCount ||
+        lcData->nextContinuationToken) {
+        // Leave out any key or common prefix that was only partly read
+        lcData->keysLen = lcData->keyOffsets[lcData->count];
+        lcData->commonPrefixesLen =
+            lcData->commonPrefixOffsets[lcData->commonPrefixesCount];
+
+        S3ListBucketColumns columns =
+        {
+            lcData->count,
+            lcData->keys,
+            lcData->keyOffsets,
+            lcData->sizes,
+            lcData->lastModified,
+            lcData->eTags,
+            lcData->eTagParts,
+            lcData->commonPrefixesCount,
+            lcData->commonPrefixes,
+            lcData->commonPrefixOffsets
+        };
+
+        int isTruncated = (!strcmp(lcData->isTruncated, "true") ||
+                           !strcmp(lcData->isTruncated, "1")) ? 1 : 0;
+
+        S3Status status = (*(lcData->listBucketColumnsCallback))
+            (isTruncated, lcData->nextContinuationToken ?
+             lcData->nextContinuationToken : "", &columns,
+             lcData->callbackData);
+
+        if ((requestStatus == S3StatusOK) && (status != S3StatusOK)) {
+            requestStatus = status;
+        }
+    }
+
+    (*(lcData->responseCompleteCallback))
+        (requestStatus, s3ErrorDetails, lcData->callbackData);
+
+    free_list_columns_data(lcData);
+}
+
+
+void S3_list_bucket_columns(const S3BucketContext *bucketContext,
+                            const char *prefix, const char *continuationToken,
+                            const char *startAfter, const char *delimiter,
+                            int maxkeys, S3RequestContext *requestContext,
+                            int timeoutMs,
+                            const S3ListBucketColumnsHandler *handler,
+                            void *callbackData)
+{
+    ListColumnsData *lcData =
+        (ListColumnsData *) s3_malloc(sizeof(ListColumnsData));
+
+    if (!lcData) {
+        (*(handler->responseHandler.completeCallback))
+            (S3StatusOutOfMemory, 0, callbackData);
+        return;
+    }
+
+    memset(lcData, 0, sizeof(ListColumnsData));
+
+    lcData->rowsSize = LIST_COLUMNS_INITIAL_ROWS;
+    lcData->keysSize = LIST_COLUMNS_INITIAL_BYTES;
+    lcData->keys = (char *) s3_malloc(lcData->keysSize);
+    lcData->keyOffsets =
+        (uint32_t *) s3_malloc(lcData->rowsSize * sizeof(uint32_t));
+    lcData->sizes = (uint64_t *) s3_malloc(lcData->rowsSize * sizeof(uint64_t));
+    lcData->lastModified =
+        (int64_t *) s3_malloc(lcData->rowsSize * sizeof(int64_t));
+    lcData->eTags = (unsigned char *) s3_malloc(lcData->rowsSize * 16);
+    lcData->eTagParts =
+        (int32_t *) s3_malloc(lcData->rowsSize * sizeof(int32_t));
+    lcData->commonPrefixesSize = LIST_COLUMNS_INITIAL_COMMON_PREFIXES;
+    lcData->commonPrefixesBytes = LIST_COLUMNS_INITIAL_BYTES;
+    lcData->commonPrefixes = (char *) s3_malloc(lcData->commonPrefixesBytes);
+    lcData->commonPrefixOffsets = (uint32_t *)
+        s3_malloc((lcData->commonPrefixesSize + 1) * sizeof(uint32_t));
+
+    if (!lcData->keys || !lcData->keyOffsets || !lcData->sizes ||
+        !lcData->lastModified || !lcData->eTags || !lcData->eTagParts ||
+        !lcData->commonPrefixes || !lcData->commonPrefixOffsets) {
+        free_list_columns_data(lcData);
+        (*(handler->responseHandler.completeCallback))
+            (S3StatusOutOfMemory, 0, callbackData);
+        return;
+    }
+
+    simplexml_initialize_ids(&(lcData->simpleXml), listBucketPathsG,
+                             sizeof(listBucketPathsG) /
+                             sizeof(listBucketPathsG[0]),
+                             &listColumnsXmlCallback, lcData);
+
+    lcData->responsePropertiesCallback =
+        handler->responseHandler.propertiesCallback;
+    lcData->listBucketColumnsCallback = handler->listBucketColumnsCallback;
+    lcData->responseCompleteCallback =
+        handler->responseHandler.completeCallback;
+    lcData->callbackData = callbackData;
+
+    string_buffer_initialize(lcData->isTruncated);
+    string_buffer_initialize(lcData->value);
+    list_columns_start_row(lcData);
+    lcData->commonPrefixOffsets[0] = 0;
+
+    ListBucketQuery query;
+
+    S3Status status = compose_list_bucket_query
+        (&query, prefix, 0, 1, continuationToken, startAfter, 0, delimiter,
+         maxkeys);
+    if (status != S3StatusOK) {
+        s3_free(query.queryParams);
+        free_list_columns_data(lcData);
+        (*(handler->responseHandler.completeCallback))
+            (status, 0, callbackData);
+        return;
+    }
+
+    perform_list_bucket(bucketContext, &query,
+                        handler->responseHandler.propertiesCallback ?
+                        &listColumnsPropertiesCallback : 0,
+                        &listColumnsDataCallback,
+                        &listColumnsCompleteCallback, lcData, requestContext,
+                        timeoutMs);
+
+    s3_free(query.queryParams);
+}
@@ -104,7 +104,7 @@ static void getAclCompleteCallback(S3Status requestStatus,
     (*(gaData->responseCompleteCallback))
         (requestStatus, s3ErrorDetails, gaData->callbackData);
 
-    free(gaData);
+    s3_pool_free(gaData);
 }
 
 
@@ -116,7 +116,7 @@ void S3_get_acl(const S3BucketContext *bucketContext, const char *key,
                 const S3ResponseHandler *handler, void *callbackData)
 {
     // Create the callback data
-    GetAclData *gaData = (GetAclData *) malloc(sizeof(GetAclData));
+    GetAclData *gaData = (GetAclData *) s3_pool_malloc(sizeof(GetAclData));
     if (!gaData) {
         (*(handler->completeCallback))(S3StatusOutOfMemory, 0, callbackData);
         return;
@@ -137,6 +137,7 @@ void S3_get_acl(const S3BucketContext *bucketContext, const char *key,
     RequestParams params =
     {
         HttpRequestTypeGET,                           // httpRequestType
+        S3MetricsOperationGetACL,                     // operation
         { bucketContext->hostName,                    // hostName
           bucketContext->bucketName,                  // bucketName
           bucketContext->protocol,                    // protocol
@@ -160,7 +161,9 @@ void S3_get_acl(const S3BucketContext *bucketContext, const char *key,
         &getAclDataCallback,                          // fromS3Callback
         &getAclCompleteCallback,                      // completeCallback
         gaData,                                       // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
@@ -295,7 +298,7 @@ static void setXmlCompleteCallback(S3Status requestStatus,
     (*(paData->responseCompleteCallback))
         (requestStatus, s3ErrorDetails, paData->callbackData);
 
-    free(paData);
+    s3_pool_free(paData);
 }
 
 
@@ -314,7 +317,7 @@ void S3_set_acl(const S3BucketContext *bucketContext, const char *key,
         return;
     }
 
-    SetXmlData *data = (SetXmlData *) malloc(sizeof(SetXmlData));
+    SetXmlData *data = (SetXmlData *) s3_pool_malloc(sizeof(SetXmlData));
     if (!data) {
         (*(handler->completeCallback))(S3StatusOutOfMemory, 0, callbackData);
         return;
@@ -328,7 +331,7 @@ void S3_set_acl(const S3BucketContext *bucketContext, const char *key,
          &(data->xmlDocumentLen), aclBuffer,
          sizeof(aclBuffer));
     if (status != S3StatusOK) {
-        free(data);
+        s3_pool_free(data);
         (*(handler->completeCallback))(status, 0, callbackData);
         return;
     }
@@ -343,6 +346,7 @@ void S3_set_acl(const S3BucketContext *bucketContext, const char *key,
     RequestParams params =
     {
         HttpRequestTypePUT,                           // httpRequestType
+        S3MetricsOperationPutACL,                     // operation
         { bucketContext->hostName,                    // hostName
           bucketContext->bucketName,                  // bucketName
           bucketContext->protocol,                    // protocol
@@ -366,7 +370,9 @@ void S3_set_acl(const S3BucketContext *bucketContext, const char *key,
         0,                                            // fromS3Callback
         &setXmlCompleteCallback,                      // completeCallback
         data,                                         // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
@@ -422,7 +428,7 @@ static void getLifecycleCompleteCallback(S3Status requestStatus,
     (*(gaData->responseCompleteCallback))
         (requestStatus, s3ErrorDetails, gaData->callbackData);
 
-    free(gaData);
+    s3_pool_free(gaData);
 }
 
 
@@ -433,7 +439,8 @@ void S3_get_lifecycle(const S3BucketContext *bucketContext,
                       const S3ResponseHandler *handler, void *callbackData)
 {
     // Create the callback data
-    GetLifecycleData *gaData = (GetLifecycleData *) malloc(sizeof(GetLifecycleData));
+    GetLifecycleData *gaData =
+        (GetLifecycleData *) s3_pool_malloc(sizeof(GetLifecycleData));
     if (!gaData) {
         (*(handler->completeCallback))(S3StatusOutOfMemory, 0, callbackData);
         return;
@@ -451,6 +458,7 @@ void S3_get_lifecycle(const S3BucketContext *bucketContext,
     RequestParams params =
     {
         HttpRequestTypeGET,                           // httpRequestType
+        S3MetricsOperationGetBucketLifecycle,         // operation
         { bucketContext->hostName,                    // hostName
           bucketContext->bucketName,                  // bucketName
           bucketContext->protocol,                    // protocol
@@ -474,7 +482,9 @@ void S3_get_lifecycle(const S3BucketContext *bucketContext,
         &getLifecycleDataCallback,                    // fromS3Callback
         &getLifecycleCompleteCallback,                // completeCallback
         gaData,                                       // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
@@ -537,7 +547,7 @@ void S3_set_lifecycle(const S3BucketContext *bucketContext,
 #else
     char md5Base64[MD5_DIGEST_LENGTH * 2];
 
-    SetXmlData *data = (SetXmlData *) malloc(sizeof(SetXmlData));
+    SetXmlData *data = (SetXmlData *) s3_pool_malloc(sizeof(SetXmlData));
     if (!data) {
         (*(handler->completeCallback))(S3StatusOutOfMemory, 0, callbackData);
         return;
@@ -568,13 +578,15 @@ void S3_set_lifecycle(const S3BucketContext *bucketContext,
         0,                                       // cannedAcl
         0,                                       // metaDataCount
         0,                                       // metaData
-        0                                        // useServerSideEncryption
+        0,                                       // useServerSideEncryption
+        S3ChecksumAlgorithmNone                  // checksumAlgorithm
     };
 
     // Set up the RequestParams
     RequestParams params =
     {
         HttpRequestTypePUT,                           // httpRequestType
+        S3MetricsOperationPutBucketLifecycle,         // operation
         { bucketContext->hostName,                    // hostName
           bucketContext->bucketName,                  // bucketName
           bucketContext->protocol,                    // protocol
@@ -598,7 +610,9 @@ void S3_set_lifecycle(const S3BucketContext *bucketContext,
         0,                                            // fromS3Callback
         &setXmlCompleteCallback,                      // completeCallback
         data,                                         // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
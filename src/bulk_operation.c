@@ -0,0 +1,559 @@
+/** **************************************************************************
+ * bulk_operation.c
+ *
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#include <stdlib.h>
+#include <string.h>
+#include "libs3.h"
+#include "request.h"
+#include "request_context.h"
+
+
+// Listed keys wait for their action in a FIFO of blocks, each holding
+// NUL-terminated keys back to back
+#define KEY_BLOCK_SIZE (64 * 1024)
+
+// A new page of the listing is requested whenever fewer than this many
+// listed keys are waiting; this is also the size of the pages S3 returns
+#define LIST_LOW_WATER 1000
+
+typedef struct KeyBlock
+{
+    struct KeyBlock *next;
+    int readOffset;
+    int writeOffset;
+    char data[KEY_BLOCK_SIZE];
+} KeyBlock;
+
+
+typedef struct BulkOperationData
+{
+    const S3BucketContext *bucketContext;
+    const char *prefix;
+    int prefixLen;
+    S3BulkOperation operation;
+    const char *destinationBucket;
+    const char *destinationPrefix;
+    int maxInFlight;
+    S3RequestContext *requestContext;
+    int timeoutMs;
+    S3BulkHandler handler;
+    void *callbackData;
+
+    // Listed keys not yet acted on
+    KeyBlock *head, *tail;
+    int queuedCount;
+
+    // State of the listing
+    int listOutstanding;
+    int listDone;
+    int listIsTruncated;
+    int listPageCount;
+    string_buffer(marker, S3_MAX_KEY_SIZE);
+
+    // Number of action requests in flight
+    int inFlight;
+
+    // Set by the first failure which stops the whole operation
+    S3Status status;
+} BulkOperationData;
+
+
+static void bulk_stop(BulkOperationData *bo, S3Status status)
+{
+    if ((status != S3StatusOK) && (bo->status == S3StatusOK)) {
+        bo->status = status;
+    }
+}
+
+
+// key queue -----------------------------------------------------------------
+
+static S3Status key_queue_push(BulkOperationData *bo, const char *key)
+{
+    int size = strlen(key) + 1;
+
+    if (!bo->tail || ((bo->tail->writeOffset + size) > KEY_BLOCK_SIZE)) {
+        KeyBlock *block = (KeyBlock *) s3_malloc(sizeof(KeyBlock));
+        if (!block) {
+            return S3StatusOutOfMemory;
+        }
+        block->next = 0;
+        block->readOffset = 0;
+        block->writeOffset = 0;
+        if (bo->tail) {
+            bo->tail->next = block;
+        }
+        else {
+            bo->head = block;
+        }
+        bo->tail = block;
+    }
+
+    memcpy(&(bo->tail->data[bo->tail->writeOffset]), key, size);
+    bo->tail->writeOffset += size;
+    bo->queuedCount++;
+
+    return S3StatusOK;
+}
+
+
+// Returns the oldest queued key, which remains valid until it is popped
+static const char *key_queue_front(BulkOperationData *bo)
+{
+    return &(bo->head->data[bo->head->readOffset]);
+}
+
+
+static void key_queue_pop(BulkOperationData *bo)
+{
+    KeyBlock *block = bo->head;
+
+    block->readOffset += strlen(&(block->data[block->readOffset])) + 1;
+    bo->queuedCount--;
+
+    if (block->readOffset == block->writeOffset) {
+        if (block->next) {
+            bo->head = block->next;
+            s3_free(block);
+        }
+        else {
+            block->readOffset = block->writeOffset = 0;
+        }
+    }
+}
+
+
+static void key_queue_free(BulkOperationData *bo)
+{
+    while (bo->head) {
+        KeyBlock *next = bo->head->next;
+        s3_free(bo->head);
+        bo->head = next;
+    }
+    bo->tail = 0;
+    bo->queuedCount = 0;
+}
+
+
+// listing -------------------------------------------------------------------
+
+static S3Status bulkListCallback(int isTruncated, const char *nextMarker,
+                                 int contentsCount,
+                                 const S3ListBucketContent *contents,
+                                 int commonPrefixesCount,
+                                 const char **commonPrefixes,
+                                 void *callbackData)
+{
+    (void) nextMarker;
+    (void) commonPrefixesCount;
+    (void) commonPrefixes;
+
+    BulkOperationData *bo = (BulkOperationData *) callbackData;
+
+    int i, fit;
+    for (i = 0; i < contentsCount; i++) {
+        S3Status status = key_queue_push(bo, contents[i].key);
+        if (status != S3StatusOK) {
+            return status;
+        }
+    }
+
+    if (contentsCount) {
+        string_buffer_initialize(bo->marker);
+        string_buffer_append(bo->marker, contents[contentsCount - 1].key,
+                             strlen(contents[contentsCount - 1].key), fit);
+        (void) fit;
+    }
+
+    bo->listIsTruncated = isTruncated;
+    bo->listPageCount += contentsCount;
+
+    return S3StatusOK;
+}
+
+
+static void bulkListCompleteCallback(S3Status status,
+                                     const S3ErrorDetails *errorDetails,
+                                     void *callbackData)
+{
+    (void) errorDetails;
+
+    BulkOperationData *bo = (BulkOperationData *) callbackData;
+
+    bo->listOutstanding = 0;
+
+    if (status != S3StatusOK) {
+        bulk_stop(bo, status);
+    }
+    // A truncated page with no keys in it would have us ask for the same
+    // page again forever
+    else if (!bo->listIsTruncated || !bo->listPageCount) {
+        bo->listDone = 1;
+    }
+}
+
+
+static const S3ListBucketHandler bulkListHandlerG =
+{
+    { 0, &bulkListCompleteCallback },
+    &bulkListCallback,
+    0,
+    0
+};
+
+
+static void bulk_list_next_page(BulkOperationData *bo)
+{
+    bo->listOutstanding = 1;
+    bo->listIsTruncated = 0;
+    bo->listPageCount = 0;
+
+    S3_list_bucket(bo->bucketContext, bo->prefix,
+                   bo->markerLen ? bo->marker : 0, 0, 0, bo->requestContext,
+                   bo->timeoutMs, &bulkListHandlerG, bo);
+}
+
+
+// per-key actions -----------------------------------------------------------
+
+typedef struct BulkAction
+{
+    BulkOperationData *bo;
+    char key[S3_MAX_KEY_SIZE + 1];
+    char destinationKey[S3_MAX_KEY_SIZE + 1];
+} BulkAction;
+
+
+static S3Status bulkActionPropertiesCallback
+    (const S3ResponseProperties *properties, void *callbackData)
+{
+    BulkAction *action = (BulkAction *) callbackData;
+    BulkOperationData *bo = action->bo;
+
+    if (bo->handler.propertiesCallback) {
+        return (*(bo->handler.propertiesCallback))
+            (action->key, properties, bo->callbackData);
+    }
+    return S3StatusOK;
+}
+
+
+static void bulkActionCompleteCallback(S3Status status,
+                                       const S3ErrorDetails *errorDetails,
+                                       void *callbackData)
+{
+    BulkAction *action = (BulkAction *) callbackData;
+    BulkOperationData *bo = action->bo;
+
+    if (bo->handler.resultCallback) {
+        bulk_stop(bo, (*(bo->handler.resultCallback))
+                  (action->key, status, errorDetails, bo->callbackData));
+    }
+
+    bo->inFlight--;
+
+    s3_free(action);
+}
+
+
+static const S3ResponseHandler bulkActionHandlerG =
+{
+    &bulkActionPropertiesCallback, &bulkActionCompleteCallback
+};
+
+
+static void bulk_start_action(BulkOperationData *bo)
+{
+    BulkAction *action = (BulkAction *) s3_malloc(sizeof(BulkAction));
+    if (!action) {
+        bulk_stop(bo, S3StatusOutOfMemory);
+        return;
+    }
+
+    action->bo = bo;
+    strcpy(action->key, key_queue_front(bo));
+    key_queue_pop(bo);
+
+    bo->inFlight++;
+
+    switch (bo->operation) {
+    case S3BulkOperationHead:
+        S3_head_object(bo->bucketContext, action->key, bo->requestContext,
+                       bo->timeoutMs, &bulkActionHandlerG, action);
+        break;
+    case S3BulkOperationCopy: {
+        const char *destinationPrefix =
+            bo->destinationPrefix ? bo->destinationPrefix : "";
+        int len = snprintf(action->destinationKey,
+                           sizeof(action->destinationKey), "%s%s",
+                           destinationPrefix, &(action->key[bo->prefixLen]));
+        if (len >= (int) sizeof(action->destinationKey)) {
+            bulkActionCompleteCallback(S3StatusKeyTooLong, 0, action);
+            break;
+        }
+        S3_copy_object(bo->bucketContext, action->key,
+                       bo->destinationBucket ? bo->destinationBucket :
+                       bo->bucketContext->bucketName, action->destinationKey,
+                       0, 0, 0, 0, bo->requestContext, bo->timeoutMs,
+                       &bulkActionHandlerG, action);
+        break;
+    }
+    default: // S3BulkOperationCustom
+        (*(bo->handler.customCallback))
+            (bo->bucketContext, action->key, bo->requestContext,
+             bo->timeoutMs, &bulkActionHandlerG, action, bo->callbackData);
+        break;
+    }
+}
+
+
+// deletes -------------------------------------------------------------------
+
+typedef struct BulkDeleteBatch
+{
+    BulkOperationData *bo;
+    int keysCount;
+    const char *keys[S3_MAX_DELETE_OBJECTS_COUNT];
+    int keyOffsets[S3_MAX_DELETE_OBJECTS_COUNT];
+    char *keyData;
+} BulkDeleteBatch;
+
+
+static S3Status bulkDeleteResultCallback(const char *key, S3Status status,
+                                         const char *errorMessage,
+                                         void *callbackData)
+{
+    (void) errorMessage;
+
+    BulkDeleteBatch *batch = (BulkDeleteBatch *) callbackData;
+    BulkOperationData *bo = batch->bo;
+
+    if (bo->handler.resultCallback) {
+        bulk_stop(bo, (*(bo->handler.resultCallback))
+                  (key, status, 0, bo->callbackData));
+    }
+
+    return S3StatusOK;
+}
+
+
+static void bulkDeleteCompleteCallback(S3Status status,
+                                       const S3ErrorDetails *errorDetails,
+                                       void *callbackData)
+{
+    BulkDeleteBatch *batch = (BulkDeleteBatch *) callbackData;
+    BulkOperationData *bo = batch->bo;
+
+    // When the request as a whole fails, no key was reported individually
+    if ((status != S3StatusOK) && bo->handler.resultCallback) {
+        int i;
+        for (i = 0; i < batch->keysCount; i++) {
+            bulk_stop(bo, (*(bo->handler.resultCallback))
+                      (batch->keys[i], status, errorDetails,
+                       bo->callbackData));
+        }
+    }
+
+    bo->inFlight--;
+
+    s3_free(batch->keyData);
+    s3_free(batch);
+}
+
+
+static const S3DeleteObjectsHandler bulkDeleteHandlerG =
+{
+    { 0, &bulkDeleteCompleteCallback },
+    &bulkDeleteResultCallback
+};
+
+
+static void bulk_start_delete(BulkOperationData *bo)
+{
+    BulkDeleteBatch *batch =
+        (BulkDeleteBatch *) s3_malloc(sizeof(BulkDeleteBatch));
+    if (!batch) {
+        bulk_stop(bo, S3StatusOutOfMemory);
+        return;
+    }
+
+    batch->bo = bo;
+    batch->keysCount = 0;
+    batch->keyData = 0;
+
+    int keyDataLen = 0, keyDataSize = 0;
+
+    while (bo->queuedCount &&
+           (batch->keysCount < S3_MAX_DELETE_OBJECTS_COUNT)) {
+        const char *key = key_queue_front(bo);
+        int size = strlen(key) + 1;
+        if ((keyDataLen + size) > keyDataSize) {
+            int newSize = keyDataSize ? (keyDataSize * 2) : 16384;
+            while (newSize < (keyDataLen + size)) {
+                newSize *= 2;
+            }
+            char *newData = (char *) s3_realloc(batch->keyData, newSize);
+            if (!newData) {
+                s3_free(batch->keyData);
+                s3_free(batch);
+                bulk_stop(bo, S3StatusOutOfMemory);
+                return;
+            }
+            batch->keyData = newData;
+            keyDataSize = newSize;
+        }
+        batch->keyOffsets[batch->keysCount++] = keyDataLen;
+        memcpy(&(batch->keyData[keyDataLen]), key, size);
+        keyDataLen += size;
+        key_queue_pop(bo);
+    }
+
+    int i;
+    for (i = 0; i < batch->keysCount; i++) {
+        batch->keys[i] = &(batch->keyData[batch->keyOffsets[i]]);
+    }
+
+    bo->inFlight++;
+
+    S3_delete_objects(bo->bucketContext, batch->keysCount, batch->keys, 0,
+                      bo->requestContext, bo->timeoutMs, &bulkDeleteHandlerG,
+                      batch);
+}
+
+
+// bulk operation ------------------------------------------------------------
+
+S3Status S3_bulk_operation(const S3BucketContext *bucketContext,
+                           const char *prefix, S3BulkOperation operation,
+                           const char *destinationBucket,
+                           const char *destinationPrefix, int maxInFlight,
+                           S3RequestContext *requestContext, int timeoutMs,
+                           const S3BulkHandler *handler, void *callbackData)
+{
+    if ((operation == S3BulkOperationCustom) && !handler->customCallback) {
+        return S3StatusInternalError;
+    }
+
+    BulkOperationData bo;
+
+    bo.bucketContext = bucketContext;
+    bo.prefix = (prefix && prefix[0]) ? prefix : 0;
+    bo.prefixLen = bo.prefix ? strlen(bo.prefix) : 0;
+    bo.operation = operation;
+    bo.destinationBucket = destinationBucket;
+    bo.destinationPrefix = destinationPrefix;
+    bo.maxInFlight = (maxInFlight < 1) ? 1 : maxInFlight;
+    bo.timeoutMs = timeoutMs;
+    bo.handler = *handler;
+    bo.callbackData = callbackData;
+    bo.head = bo.tail = 0;
+    bo.queuedCount = 0;
+    bo.listOutstanding = 0;
+    bo.listDone = 0;
+    bo.listIsTruncated = 0;
+    bo.listPageCount = 0;
+    string_buffer_initialize(bo.marker);
+    bo.inFlight = 0;
+    bo.status = S3StatusOK;
+
+    if (requestContext) {
+        bo.requestContext = requestContext;
+    }
+    else {
+        S3Status status = S3_create_request_context(&(bo.requestContext));
+        if (status != S3StatusOK) {
+            return status;
+        }
+    }
+
+    // The requests which the bulk operation adds to the context are its own,
+    // so that they can be cancelled if it has to give up on the context
+    void *owner = request_context_set_owner(bo.requestContext, &bo);
+
+    while (1) {
+        if (bo.status == S3StatusOK) {
+            // Start as many actions as there are free slots for.  Deletes
+            // wait for a full batch unless the listing is complete.
+            while ((bo.status == S3StatusOK) && bo.queuedCount &&
+                   (bo.inFlight < bo.maxInFlight)) {
+                if (operation == S3BulkOperationDelete) {
+                    if ((bo.queuedCount < S3_MAX_DELETE_OBJECTS_COUNT) &&
+                        !bo.listDone) {
+                        break;
+                    }
+                    bulk_start_delete(&bo);
+                }
+                else {
+                    bulk_start_action(&bo);
+                }
+            }
+            // Fetch the next page ahead of need, but only once the keys
+            // already listed are running low
+            if ((bo.status == S3StatusOK) && !bo.listOutstanding &&
+                !bo.listDone && (bo.queuedCount < LIST_LOW_WATER)) {
+                bulk_list_next_page(&bo);
+                // The list request may have failed to start
+                continue;
+            }
+        }
+
+        if (!bo.inFlight && !bo.listOutstanding &&
+            ((bo.status != S3StatusOK) ||
+             (bo.listDone && !bo.queuedCount))) {
+            break;
+        }
+
+        // Requests which the callbacks add are not the bulk operation's
+        int requestsRemaining;
+        request_context_set_owner(bo.requestContext, owner);
+        S3Status status = request_context_wait(bo.requestContext,
+                                               &requestsRemaining);
+        request_context_set_owner(bo.requestContext, &bo);
+        if (status != S3StatusOK) {
+            bulk_stop(&bo, status);
+            // Whatever is still in flight reports to bo, which is about to
+            // go away
+            request_context_cancel(bo.requestContext, &bo);
+            break;
+        }
+    }
+
+    request_context_set_owner(bo.requestContext, owner);
+
+    if (!requestContext) {
+        S3_destroy_request_context(bo.requestContext);
+    }
+
+    key_queue_free(&bo);
+
+    return bo.status;
+}
@@ -0,0 +1,475 @@
+/** **************************************************************************
+ * checksum.c
+ *
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include "checksum.h"
+
+
+// Both checksums are the reflected form of their polynomials, with an initial
+// value and final xor of all ones, so they share the table layout, update
+// loop shape, and combination method used by zlib's crc32.
+#define CRC32C_POLY     0x82F63B78U
+#define CRC64NVME_POLY  0x9A6C9329AC4BC9B5ULL
+
+static pthread_once_t checksumOnceG = PTHREAD_ONCE_INIT;
+
+// Slicing-by-8 tables
+static uint32_t crc32cTableG[8][256];
+
+static uint64_t crc64nvmeTableG[8][256];
+
+static uint32_t (*crc32cUpdateG)(uint32_t crc, const unsigned char *data,
+                                 size_t length);
+
+
+static uint32_t crc32c_update_sw(uint32_t crc, const unsigned char *data,
+                                 size_t length)
+{
+    while (length && ((uintptr_t) data & 7)) {
+        crc = crc32cTableG[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+        length--;
+    }
+
+    while (length >= 8) {
+        crc ^= ((uint32_t) data[0] | ((uint32_t) data[1] << 8) |
+                ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24));
+        crc = (crc32cTableG[7][crc & 0xFF] ^
+               crc32cTableG[6][(crc >> 8) & 0xFF] ^
+               crc32cTableG[5][(crc >> 16) & 0xFF] ^
+               crc32cTableG[4][crc >> 24] ^
+               crc32cTableG[3][data[4]] ^
+               crc32cTableG[2][data[5]] ^
+               crc32cTableG[1][data[6]] ^
+               crc32cTableG[0][data[7]]);
+        data += 8;
+        length -= 8;
+    }
+
+    while (length--) {
+        crc = crc32cTableG[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+
+#if defined(__GNUC__) && defined(__x86_64__)
+
+// SSE 4.2 has an instruction computing exactly CRC32C
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_update_sse42(uint32_t crc, const unsigned char *data,
+                                    size_t length)
+{
+    while (length && ((uintptr_t) data & 7)) {
+        crc = __builtin_ia32_crc32qi(crc, *data++);
+        length--;
+    }
+
+    uint64_t crc64 = crc;
+
+    while (length >= 8) {
+        uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        crc64 = __builtin_ia32_crc32di(crc64, word);
+        data += 8;
+        length -= 8;
+    }
+
+    crc = (uint32_t) crc64;
+
+    while (length--) {
+        crc = __builtin_ia32_crc32qi(crc, *data++);
+    }
+
+    return crc;
+}
+
+#endif
+
+
+static uint64_t crc64nvme_update_sw(uint64_t crc, const unsigned char *data,
+                                    size_t length)
+{
+    while (length && ((uintptr_t) data & 7)) {
+        crc = crc64nvmeTableG[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+        length--;
+    }
+
+    while (length >= 8) {
+        crc ^= ((uint64_t) data[0] | ((uint64_t) data[1] << 8) |
+                ((uint64_t) data[2] << 16) | ((uint64_t) data[3] << 24) |
+                ((uint64_t) data[4] << 32) | ((uint64_t) data[5] << 40) |
+                ((uint64_t) data[6] << 48) | ((uint64_t) data[7] << 56));
+        crc = (crc64nvmeTableG[7][crc & 0xFF] ^
+               crc64nvmeTableG[6][(crc >> 8) & 0xFF] ^
+               crc64nvmeTableG[5][(crc >> 16) & 0xFF] ^
+               crc64nvmeTableG[4][(crc >> 24) & 0xFF] ^
+               crc64nvmeTableG[3][(crc >> 32) & 0xFF] ^
+               crc64nvmeTableG[2][(crc >> 40) & 0xFF] ^
+               crc64nvmeTableG[1][(crc >> 48) & 0xFF] ^
+               crc64nvmeTableG[0][crc >> 56]);
+        data += 8;
+        length -= 8;
+    }
+
+    while (length--) {
+        crc = crc64nvmeTableG[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+
+static void checksum_initialize()
+{
+    int i, j;
+
+    for (i = 0; i < 256; i++) {
+        uint32_t c32 = i;
+        uint64_t c64 = i;
+        for (j = 0; j < 8; j++) {
+            c32 = (c32 & 1) ? ((c32 >> 1) ^ CRC32C_POLY) : (c32 >> 1);
+            c64 = (c64 & 1) ? ((c64 >> 1) ^ CRC64NVME_POLY) : (c64 >> 1);
+        }
+        crc32cTableG[0][i] = c32;
+        crc64nvmeTableG[0][i] = c64;
+    }
+
+    for (j = 1; j < 8; j++) {
+        for (i = 0; i < 256; i++) {
+            uint32_t c32 = crc32cTableG[j - 1][i];
+            uint64_t c64 = crc64nvmeTableG[j - 1][i];
+            crc32cTableG[j][i] = (c32 >> 8) ^ crc32cTableG[0][c32 & 0xFF];
+            crc64nvmeTableG[j][i] =
+                (c64 >> 8) ^ crc64nvmeTableG[0][c64 & 0xFF];
+        }
+    }
+
+    crc32cUpdateG = &crc32c_update_sw;
+
+#if defined(__GNUC__) && defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.2")) {
+        crc32cUpdateG = &crc32c_update_sse42;
+    }
+#endif
+}
+
+
+uint64_t S3_compute_checksum(S3ChecksumAlgorithm algorithm, uint64_t checksum,
+                             const void *data, int length)
+{
+    pthread_once(&checksumOnceG, &checksum_initialize);
+
+    if (length <= 0) {
+        return checksum;
+    }
+
+    switch (algorithm) {
+    case S3ChecksumAlgorithmCRC32C:
+        return ~(*crc32cUpdateG)
+            (~((uint32_t) checksum), (const unsigned char *) data, length) &
+            0xFFFFFFFFU;
+    case S3ChecksumAlgorithmCRC64NVME:
+        return ~crc64nvme_update_sw
+            (~checksum, (const unsigned char *) data, length);
+    default:
+        return 0;
+    }
+}
+
+
+// GF(2) matrix helpers for combining checksums, as in zlib's crc32_combine
+static uint64_t gf2_matrix_times(const uint64_t *matrix, uint64_t vector)
+{
+    uint64_t sum = 0;
+
+    while (vector) {
+        if (vector & 1) {
+            sum ^= *matrix;
+        }
+        vector >>= 1;
+        matrix++;
+    }
+
+    return sum;
+}
+
+
+static void gf2_matrix_square(uint64_t *square, const uint64_t *matrix,
+                              int width)
+{
+    int i;
+
+    for (i = 0; i < width; i++) {
+        square[i] = gf2_matrix_times(matrix, matrix[i]);
+    }
+}
+
+
+uint64_t S3_combine_checksums(S3ChecksumAlgorithm algorithm,
+                              uint64_t checksum1, uint64_t checksum2,
+                              uint64_t length2)
+{
+    uint64_t even[64], odd[64], row;
+    int width, i;
+
+    switch (algorithm) {
+    case S3ChecksumAlgorithmCRC32C:
+        width = 32;
+        odd[0] = CRC32C_POLY;
+        break;
+    case S3ChecksumAlgorithmCRC64NVME:
+        width = 64;
+        odd[0] = CRC64NVME_POLY;
+        break;
+    default:
+        return 0;
+    }
+
+    if (!length2) {
+        return checksum1;
+    }
+
+    // odd is the operator for one zero bit
+    row = 1;
+    for (i = 1; i < width; i++) {
+        odd[i] = row;
+        row <<= 1;
+    }
+
+    // even is the operator for two zero bits, then odd for four
+    gf2_matrix_square(even, odd, width);
+    gf2_matrix_square(odd, even, width);
+
+    // Apply length2 zero bytes to checksum1; the first square below puts the
+    // operator for one zero byte in even
+    do {
+        gf2_matrix_square(even, odd, width);
+        if (length2 & 1) {
+            checksum1 = gf2_matrix_times(even, checksum1);
+        }
+        length2 >>= 1;
+        if (!length2) {
+            break;
+        }
+        gf2_matrix_square(odd, even, width);
+        if (length2 & 1) {
+            checksum1 = gf2_matrix_times(odd, checksum1);
+        }
+        length2 >>= 1;
+    } while (length2);
+
+    return checksum1 ^ checksum2;
+}
+
+
+static int checksum_size(S3ChecksumAlgorithm algorithm)
+{
+    switch (algorithm) {
+    case S3ChecksumAlgorithmCRC32C:
+        return 4;
+    case S3ChecksumAlgorithmCRC64NVME:
+        return 8;
+    default:
+        return 0;
+    }
+}
+
+
+static const char base64CharsG[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+
+int S3_encode_checksum(S3ChecksumAlgorithm algorithm, uint64_t checksum,
+                       char *buffer)
+{
+    int size = checksum_size(algorithm), i, len = 0;
+    unsigned char bytes[9];
+
+    if (!size) {
+        buffer[0] = 0;
+        return 0;
+    }
+
+    // S3 sends checksums big-endian
+    for (i = 0; i < size; i++) {
+        bytes[i] = (unsigned char) (checksum >> (8 * (size - 1 - i)));
+    }
+    bytes[size] = 0;
+
+    for (i = 0; i < size; i += 3) {
+        uint32_t v = ((uint32_t) bytes[i] << 16) | ((uint32_t) bytes[i + 1] << 8);
+        if ((i + 2) < size) {
+            v |= bytes[i + 2];
+        }
+        buffer[len++] = base64CharsG[(v >> 18) & 0x3F];
+        buffer[len++] = base64CharsG[(v >> 12) & 0x3F];
+        buffer[len++] = ((i + 1) < size) ? base64CharsG[(v >> 6) & 0x3F] : '=';
+        buffer[len++] = ((i + 2) < size) ? base64CharsG[v & 0x3F] : '=';
+    }
+
+    buffer[len] = 0;
+
+    return len;
+}
+
+
+int S3_decode_checksum(S3ChecksumAlgorithm algorithm, const char *str,
+                       uint64_t *checksumReturn)
+{
+    int size = checksum_size(algorithm), bits = 0, bytes = 0;
+    uint64_t checksum = 0;
+    uint32_t acc = 0;
+
+    if (!size || !str) {
+        return 0;
+    }
+
+    for (; *str && (*str != '='); str++) {
+        const char *p = strchr(base64CharsG, *str);
+        if (!p) {
+            return 0;
+        }
+        acc = (acc << 6) | (uint32_t) (p - base64CharsG);
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            if (bytes == size) {
+                return 0;
+            }
+            checksum = (checksum << 8) | ((acc >> bits) & 0xFF);
+            bytes++;
+        }
+    }
+
+    // Only padding may follow, so that composite checksums, which have a
+    // part count after the padding, are rejected
+    while (*str == '=') {
+        str++;
+    }
+
+    if (*str || (bytes != size)) {
+        return 0;
+    }
+
+    *checksumReturn = checksum;
+
+    return 1;
+}
+
+
+const char *checksum_header_name(S3ChecksumAlgorithm algorithm)
+{
+    switch (algorithm) {
+    case S3ChecksumAlgorithmCRC32C:
+        return "x-amz-checksum-crc32c";
+    case S3ChecksumAlgorithmCRC64NVME:
+        return "x-amz-checksum-crc64nvme";
+    default:
+        return 0;
+    }
+}
+
+
+const char *checksum_algorithm_name(S3ChecksumAlgorithm algorithm)
+{
+    switch (algorithm) {
+    case S3ChecksumAlgorithmCRC32C:
+        return "CRC32C";
+    case S3ChecksumAlgorithmCRC64NVME:
+        return "CRC64NVME";
+    default:
+        return 0;
+    }
+}
+
+
+// Number of hex digits needed for [value]
+static int hex_digits(uint64_t value)
+{
+    int digits = 1;
+
+    while (value >>= 4) {
+        digits++;
+    }
+
+    return digits;
+}
+
+
+uint64_t checksum_chunked_length(S3ChecksumAlgorithm algorithm,
+                                 uint64_t length)
+{
+    uint64_t fullChunks = length / CHECKSUM_CHUNK_SIZE;
+    uint64_t lastChunk = length % CHECKSUM_CHUNK_SIZE;
+
+    // <hex size>\r\n<data>\r\n for every data chunk
+    uint64_t total = fullChunks *
+        (hex_digits(CHECKSUM_CHUNK_SIZE) + 2 + CHECKSUM_CHUNK_SIZE + 2);
+    if (lastChunk) {
+        total += hex_digits(lastChunk) + 2 + lastChunk + 2;
+    }
+
+    // 0\r\n<header>:<base64>\r\n\r\n
+    total += 3 + strlen(checksum_header_name(algorithm)) + 1 +
+        (4 * ((checksum_size(algorithm) + 2) / 3)) + 2 + 2;
+
+    return total;
+}
+
+
+int checksum_chunk_framing(S3ChecksumAlgorithm algorithm, uint64_t checksum,
+                           int first, int chunkSize, char *buffer)
+{
+    int len = 0;
+
+    if (!first) {
+        buffer[len++] = '\r';
+        buffer[len++] = '\n';
+    }
+
+    if (chunkSize) {
+        len += snprintf(&(buffer[len]), CHECKSUM_FRAMING_SIZE - len,
+                        "%x\r\n", chunkSize);
+    }
+    else {
+        len += snprintf(&(buffer[len]), CHECKSUM_FRAMING_SIZE - len,
+                        "0\r\n%s:", checksum_header_name(algorithm));
+        len += S3_encode_checksum(algorithm, checksum, &(buffer[len]));
+        len += snprintf(&(buffer[len]), CHECKSUM_FRAMING_SIZE - len,
+                        "\r\n\r\n");
+    }
+
+    return len;
+}
@@ -0,0 +1,744 @@
+/** **************************************************************************
+ * delete_objects.c
+ *
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef __APPLE__
+    #include <openssl/evp.h>
+#endif
+
+#include "libs3.h"
+#include "error_parser.h"
+#include "request.h"
+#include "request_context.h"
+#include "simplexml.h"
+
+
+// delete objects ------------------------------------------------------------
+
+typedef struct DeleteObjectsData
+{
+    SimpleXml simpleXml;
+
+    S3DeleteObjectsHandler handler;
+    void *callbackData;
+
+    // The request body, and how much of it has been sent
+    char *body;
+    int bodyLen, bodySize;
+    int bodyOffset;
+
+    string_buffer(key, S3_MAX_KEY_SIZE);
+    string_buffer(code, 256);
+    string_buffer(message, 1024);
+} DeleteObjectsData;
+
+
+// Appends [key] to [buffer] with XML special characters escaped, returning
+// the number of characters written.  Carriage returns and newlines are
+// escaped too, as XML parsers would otherwise normalize them.
+static int xml_escape_key(const char *key, char *buffer)
+{
+    char *p = buffer;
+
+    while (*key) {
+        const char *escape;
+        switch (*key) {
+        case '&':
+            escape = "&amp;";
+            break;
+        case '<':
+            escape = "&lt;";
+            break;
+        case '>':
+            escape = "&gt;";
+            break;
+        case '"':
+            escape = "&quot;";
+            break;
+        case '\'':
+            escape = "&apos;";
+            break;
+        case '\r':
+            escape = "&#13;";
+            break;
+        case '\n':
+            escape = "&#10;";
+            break;
+        default:
+            *p++ = *key++;
+            continue;
+        }
+        while (*escape) {
+            *p++ = *escape++;
+        }
+        key++;
+    }
+
+    return p - buffer;
+}
+
+
+// Makes room in the request body for [len] more bytes
+static int delete_xml_reserve(DeleteObjectsData *data, int len)
+{
+    if ((data->bodyLen + len) <= data->bodySize) {
+        return 1;
+    }
+
+    int newSize = data->bodySize ? (data->bodySize * 2) : 16384;
+    while (newSize < (data->bodyLen + len)) {
+        newSize *= 2;
+    }
+    char *newBody = (char *) s3_realloc(data->body, newSize);
+    if (!newBody) {
+        return 0;
+    }
+    data->body = newBody;
+    data->bodySize = newSize;
+    return 1;
+}
+
+
+// Appends [str] to the request body as is
+static int delete_xml_append(DeleteObjectsData *data, const char *str)
+{
+    int len = strlen(str);
+
+    if (!delete_xml_reserve(data, len)) {
+        return 0;
+    }
+    memcpy(&(data->body[data->bodyLen]), str, len);
+    data->bodyLen += len;
+    return 1;
+}
+
+
+// Renders the request body, returning 0 if memory runs out.  Each key takes
+// at most 6 bytes per character once escaped.
+static int delete_xml_render(DeleteObjectsData *data, int keysCount,
+                             const char * const *keys, int quiet)
+{
+    if (!delete_xml_append(data, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>"
+                           "<Delete>") ||
+        (quiet && !delete_xml_append(data, "<Quiet>true</Quiet>"))) {
+        return 0;
+    }
+
+    int i;
+    for (i = 0; i < keysCount; i++) {
+        if (!delete_xml_append(data, "<Object><Key>") ||
+            !delete_xml_reserve(data, strlen(keys[i]) * 6)) {
+            return 0;
+        }
+        data->bodyLen += xml_escape_key(keys[i], &(data->body[data->bodyLen]));
+        if (!delete_xml_append(data, "</Key></Object>")) {
+            return 0;
+        }
+    }
+
+    return delete_xml_append(data, "</Delete>");
+}
+
+
+// Ids of the elements of a DeleteResult, for deleteObjectsXmlCallback
+enum
+{
+    DeleteResult,
+    DeleteResultDeleted,
+    DeleteResultDeletedKey,
+    DeleteResultError,
+    DeleteResultErrorKey,
+    DeleteResultErrorCode,
+    DeleteResultErrorMessage
+};
+
+static const SimpleXmlPath deleteObjectsPathsG[] =
+{
+    SIMPLEXML_PATH(DeleteResult, "DeleteResult"),
+    SIMPLEXML_PATH(DeleteResultDeleted, "DeleteResult/Deleted"),
+    SIMPLEXML_PATH(DeleteResultDeletedKey, "DeleteResult/Deleted/Key"),
+    SIMPLEXML_PATH(DeleteResultError, "DeleteResult/Error"),
+    SIMPLEXML_PATH(DeleteResultErrorKey, "DeleteResult/Error/Key"),
+    SIMPLEXML_PATH(DeleteResultErrorCode, "DeleteResult/Error/Code"),
+    SIMPLEXML_PATH(DeleteResultErrorMessage, "DeleteResult/Error/Message")
+};
+
+
+static S3Status deleteObjectsXmlCallback(int elementId,
+                                         const char *elementPath,
+                                         const char *data, int dataLen,
+                                         void *callbackData)
+{
+    (void) elementPath;
+
+    DeleteObjectsData *doData = (DeleteObjectsData *) callbackData;
+
+    int fit;
+
+    if (data) {
+        switch (elementId) {
+        case DeleteResultDeletedKey:
+        case DeleteResultErrorKey:
+            string_buffer_append(doData->key, data, dataLen, fit);
+            break;
+        case DeleteResultErrorCode:
+            string_buffer_append(doData->code, data, dataLen, fit);
+            break;
+        case DeleteResultErrorMessage:
+            string_buffer_append(doData->message, data, dataLen, fit);
+            break;
+        default:
+            break;
+        }
+    }
+    else {
+        S3Status status = S3StatusOK;
+        switch (elementId) {
+        case DeleteResultDeleted:
+            if (doData->handler.resultCallback) {
+                status = (*(doData->handler.resultCallback))
+                    (doData->key, S3StatusOK, 0, doData->callbackData);
+            }
+            break;
+        case DeleteResultError:
+            if (doData->handler.resultCallback) {
+                status = (*(doData->handler.resultCallback))
+                    (doData->key, error_parser_code_to_status(doData->code),
+                     doData->message, doData->callbackData);
+            }
+            break;
+        default:
+            return S3StatusOK;
+        }
+        string_buffer_initialize(doData->key);
+        string_buffer_initialize(doData->code);
+        string_buffer_initialize(doData->message);
+        return status;
+    }
+
+    (void) fit;
+
+    return S3StatusOK;
+}
+
+
+static S3Status deleteObjectsPropertiesCallback
+    (const S3ResponseProperties *responseProperties, void *callbackData)
+{
+    DeleteObjectsData *doData = (DeleteObjectsData *) callbackData;
+
+    if (doData->handler.responseHandler.propertiesCallback) {
+        return (*(doData->handler.responseHandler.propertiesCallback))
+            (responseProperties, doData->callbackData);
+    }
+    return S3StatusOK;
+}
+
+
+static int deleteObjectsDataCallback(int bufferSize, char *buffer,
+                                     void *callbackData)
+{
+    DeleteObjectsData *doData = (DeleteObjectsData *) callbackData;
+
+    int toCopy = doData->bodyLen - doData->bodyOffset;
+    if (toCopy > bufferSize) {
+        toCopy = bufferSize;
+    }
+    memcpy(buffer, &(doData->body[doData->bodyOffset]), toCopy);
+    doData->bodyOffset += toCopy;
+
+    return toCopy;
+}
+
+
+static S3Status deleteObjectsFromS3Callback(int bufferSize,
+                                            const char *buffer,
+                                            void *callbackData)
+{
+    DeleteObjectsData *doData = (DeleteObjectsData *) callbackData;
+
+    return simplexml_add(&(doData->simpleXml), buffer, bufferSize);
+}
+
+
+static void deleteObjectsCompleteCallback(S3Status requestStatus,
+                                          const S3ErrorDetails *s3ErrorDetails,
+                                          void *callbackData)
+{
+    DeleteObjectsData *doData = (DeleteObjectsData *) callbackData;
+
+    (*(doData->handler.responseHandler.completeCallback))
+        (requestStatus, s3ErrorDetails, doData->callbackData);
+
+    simplexml_deinitialize(&(doData->simpleXml));
+
+    s3_free(doData->body);
+    s3_pool_free(doData);
+}
+
+
+void S3_delete_objects(const S3BucketContext *bucketContext, int keysCount,
+                       const char * const *keys, int quiet,
+                       S3RequestContext *requestContext, int timeoutMs,
+                       const S3DeleteObjectsHandler *handler,
+                       void *callbackData)
+{
+#ifdef __APPLE__
+    /* This request requires calculating MD5 sum.
+     * MD5 sum requires OpenSSL library, which is not used on Apple.
+     */
+    (void) bucketContext;
+    (void) keysCount;
+    (void) keys;
+    (void) quiet;
+    (void) requestContext;
+    (void) timeoutMs;
+    (*(handler->responseHandler.completeCallback))
+        (S3StatusNotSupported, 0, callbackData);
+    return;
+#else
+    if ((keysCount < 1) || (keysCount > S3_MAX_DELETE_OBJECTS_COUNT)) {
+        (*(handler->responseHandler.completeCallback))
+            (S3StatusInternalError, 0, callbackData);
+        return;
+    }
+
+    int i;
+    for (i = 0; i < keysCount; i++) {
+        if (strlen(keys[i]) > S3_MAX_KEY_SIZE) {
+            (*(handler->responseHandler.completeCallback))
+                (S3StatusKeyTooLong, 0, callbackData);
+            return;
+        }
+    }
+
+    DeleteObjectsData *data =
+        (DeleteObjectsData *) s3_pool_malloc(sizeof(DeleteObjectsData));
+    if (!data) {
+        (*(handler->responseHandler.completeCallback))
+            (S3StatusOutOfMemory, 0, callbackData);
+        return;
+    }
+
+    simplexml_initialize_ids(&(data->simpleXml), deleteObjectsPathsG,
+                             sizeof(deleteObjectsPathsG) /
+                             sizeof(deleteObjectsPathsG[0]),
+                             &deleteObjectsXmlCallback, data);
+
+    data->handler = *handler;
+    data->callbackData = callbackData;
+    data->body = 0;
+    data->bodyLen = data->bodySize = data->bodyOffset = 0;
+    string_buffer_initialize(data->key);
+    string_buffer_initialize(data->code);
+    string_buffer_initialize(data->message);
+
+    // S3 requires a Content-MD5 header on this request, so the document is
+    // rendered up front, which also gives its length
+    unsigned char md5[EVP_MAX_MD_SIZE];
+    unsigned int md5Len;
+    char md5Base64[EVP_MAX_MD_SIZE * 2];
+
+    if (!delete_xml_render(data, keysCount, keys, quiet)) {
+        simplexml_deinitialize(&(data->simpleXml));
+        s3_free(data->body);
+        s3_pool_free(data);
+        (*(handler->responseHandler.completeCallback))
+            (S3StatusOutOfMemory, 0, callbackData);
+        return;
+    }
+    if (!EVP_Digest(data->body, data->bodyLen, md5, &md5Len, EVP_md5(), 0)) {
+        simplexml_deinitialize(&(data->simpleXml));
+        s3_free(data->body);
+        s3_pool_free(data);
+        (*(handler->responseHandler.completeCallback))
+            (S3StatusInternalError, 0, callbackData);
+        return;
+    }
+    EVP_EncodeBlock((unsigned char *) md5Base64, md5, md5Len);
+
+    // Set up S3PutProperties
+    S3PutProperties properties =
+    {
+        "application/xml",                       // contentType
+        md5Base64,                               // md5
+        0,                                       // cacheControl
+        0,                                       // contentDispositionFilename
+        0,                                       // contentEncoding
+       -1,                                       // expires
+        0,                                       // cannedAcl
+        0,                                       // metaDataCount
+        0,                                       // metaData
+        0,                                       // useServerSideEncryption
+        S3ChecksumAlgorithmNone                  // checksumAlgorithm
+    };
+
+    // Set up the RequestParams
+    RequestParams params =
+    {
+        HttpRequestTypePOST,                          // httpRequestType
+        S3MetricsOperationDeleteObjects,              // operation
+        { bucketContext->hostName,                    // hostName
+          bucketContext->bucketName,                  // bucketName
+          bucketContext->protocol,                    // protocol
+          bucketContext->uriStyle,                    // uriStyle
+          bucketContext->accessKeyId,                 // accessKeyId
+          bucketContext->secretAccessKey,             // secretAccessKey
+          bucketContext->securityToken,               // securityToken
+          bucketContext->authRegion },                // authRegion
+        0,                                            // key
+        0,                                            // queryParams
+        "delete",                                     // subResource
+        0,                                            // copySourceBucketName
+        0,                                            // copySourceKey
+        0,                                            // getConditions
+        0,                                            // startByte
+        0,                                            // byteCount
+        &properties,                                  // putProperties
+        data->handler.responseHandler.propertiesCallback ?
+        &deleteObjectsPropertiesCallback : 0,         // propertiesCallback
+        &deleteObjectsDataCallback,                   // toS3Callback
+        data->bodyLen,                                // toS3CallbackTotalSize
+        &deleteObjectsFromS3Callback,                 // fromS3Callback
+        &deleteObjectsCompleteCallback,               // completeCallback
+        data,                                         // callbackData
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
+    };
+
+    // Perform the request
+    request_perform(&params, requestContext);
+#endif
+}
+
+
+// bulk deleter --------------------------------------------------------------
+
+typedef struct DeleteBatch
+{
+    S3BulkDeleter *bulkDeleter;
+
+    int keysCount;
+    const char *keys[S3_MAX_DELETE_OBJECTS_COUNT];
+
+    // The keys are stored back to back in keyData; keys[] is only filled in
+    // from keyOffsets[] when the batch is sent, since keyData may move as it
+    // grows
+    int keyOffsets[S3_MAX_DELETE_OBJECTS_COUNT];
+    char *keyData;
+    int keyDataLen, keyDataSize;
+} DeleteBatch;
+
+
+struct S3BulkDeleter
+{
+    S3BucketContext bucketContext;
+    int quiet;
+    int maxConcurrent;
+    int timeoutMs;
+    S3DeleteObjectsHandler handler;
+    void *callbackData;
+
+    S3RequestContext *requestContext;
+    int ownsRequestContext;
+
+    // The batch currently being filled, or NULL
+    DeleteBatch *batch;
+
+    int inFlight;
+
+    // Status of the first batch that did not complete with S3StatusOK
+    S3Status status;
+};
+
+
+static S3Status batchPropertiesCallback
+    (const S3ResponseProperties *responseProperties, void *callbackData)
+{
+    DeleteBatch *batch = (DeleteBatch *) callbackData;
+    S3BulkDeleter *bd = batch->bulkDeleter;
+
+    if (bd->handler.responseHandler.propertiesCallback) {
+        return (*(bd->handler.responseHandler.propertiesCallback))
+            (responseProperties, bd->callbackData);
+    }
+    return S3StatusOK;
+}
+
+
+static S3Status batchResultCallback(const char *key, S3Status status,
+                                    const char *errorMessage,
+                                    void *callbackData)
+{
+    DeleteBatch *batch = (DeleteBatch *) callbackData;
+    S3BulkDeleter *bd = batch->bulkDeleter;
+
+    if (bd->handler.resultCallback) {
+        return (*(bd->handler.resultCallback))
+            (key, status, errorMessage, bd->callbackData);
+    }
+    return S3StatusOK;
+}
+
+
+static void batchCompleteCallback(S3Status requestStatus,
+                                  const S3ErrorDetails *s3ErrorDetails,
+                                  void *callbackData)
+{
+    DeleteBatch *batch = (DeleteBatch *) callbackData;
+    S3BulkDeleter *bd = batch->bulkDeleter;
+
+    if ((requestStatus != S3StatusOK) && (bd->status == S3StatusOK)) {
+        bd->status = requestStatus;
+    }
+
+    (*(bd->handler.responseHandler.completeCallback))
+        (requestStatus, s3ErrorDetails, bd->callbackData);
+
+    bd->inFlight--;
+
+    s3_free(batch->keyData);
+    s3_free(batch);
+}
+
+
+static const S3DeleteObjectsHandler batchHandlerG =
+{
+    { &batchPropertiesCallback, &batchCompleteCallback },
+    &batchResultCallback
+};
+
+
+// Used when the bulk deleter's caller has no properties callback, so that
+// the response headers of its batches are not parsed
+static const S3DeleteObjectsHandler batchNoPropertiesHandlerG =
+{
+    { 0, &batchCompleteCallback },
+    &batchResultCallback
+};
+
+
+// Runs the request context until no more than [maxInFlight] of the bulk
+// deleter's requests remain in flight.  If running it fails, the batches
+// still in flight are completed with S3StatusInterrupted, so that none of
+// them refer to the bulk deleter any more.
+static S3Status bulk_deleter_wait(S3BulkDeleter *bd, int maxInFlight)
+{
+    while (bd->inFlight > maxInFlight) {
+        int requestsRemaining;
+        S3Status status = request_context_wait(bd->requestContext,
+                                               &requestsRemaining);
+        if (status != S3StatusOK) {
+            if (bd->status == S3StatusOK) {
+                bd->status = status;
+            }
+            request_context_cancel(bd->requestContext, bd);
+            return status;
+        }
+    }
+
+    return S3StatusOK;
+}
+
+
+// Sends the batch currently being filled, first waiting for a request slot
+// if necessary
+static S3Status bulk_deleter_send(S3BulkDeleter *bd)
+{
+    DeleteBatch *batch = bd->batch;
+
+    S3Status status = bulk_deleter_wait(bd, bd->maxConcurrent - 1);
+    if (status != S3StatusOK) {
+        return status;
+    }
+
+    int i;
+    for (i = 0; i < batch->keysCount; i++) {
+        batch->keys[i] = &(batch->keyData[batch->keyOffsets[i]]);
+    }
+
+    bd->batch = 0;
+    bd->inFlight++;
+
+    // The batch is the bulk deleter's own, so that it can be cancelled if
+    // the bulk deleter has to give up on a shared request context
+    void *owner = request_context_set_owner(bd->requestContext, bd);
+
+    S3_delete_objects(&(bd->bucketContext), batch->keysCount, batch->keys,
+                      bd->quiet, bd->requestContext, bd->timeoutMs,
+                      bd->handler.responseHandler.propertiesCallback ?
+                      &batchHandlerG : &batchNoPropertiesHandlerG, batch);
+
+    request_context_set_owner(bd->requestContext, owner);
+
+    return S3StatusOK;
+}
+
+
+S3Status S3_create_bulk_deleter(const S3BucketContext *bucketContext,
+                                int quiet, int maxConcurrent,
+                                S3RequestContext *requestContext,
+                                int timeoutMs,
+                                const S3DeleteObjectsHandler *handler,
+                                void *callbackData,
+                                S3BulkDeleter **bulkDeleterReturn)
+{
+    S3BulkDeleter *bd = (S3BulkDeleter *) s3_malloc(sizeof(S3BulkDeleter));
+    if (!bd) {
+        return S3StatusOutOfMemory;
+    }
+
+    if (requestContext) {
+        bd->requestContext = requestContext;
+        bd->ownsRequestContext = 0;
+    }
+    else {
+        S3Status status = S3_create_request_context(&(bd->requestContext));
+        if (status != S3StatusOK) {
+            s3_free(bd);
+            return status;
+        }
+        bd->ownsRequestContext = 1;
+    }
+
+    bd->bucketContext = *bucketContext;
+    bd->quiet = quiet;
+    bd->maxConcurrent = (maxConcurrent < 1) ? 1 : maxConcurrent;
+    bd->timeoutMs = timeoutMs;
+    bd->handler = *handler;
+    bd->callbackData = callbackData;
+    bd->batch = 0;
+    bd->inFlight = 0;
+    bd->status = S3StatusOK;
+
+    *bulkDeleterReturn = bd;
+
+    return S3StatusOK;
+}
+
+
+S3Status S3_bulk_deleter_add_key(S3BulkDeleter *bulkDeleter, const char *key)
+{
+    S3BulkDeleter *bd = bulkDeleter;
+
+    if (bd->status != S3StatusOK) {
+        return bd->status;
+    }
+
+    int len = strlen(key);
+    if (len > S3_MAX_KEY_SIZE) {
+        return S3StatusKeyTooLong;
+    }
+
+    if (!bd->batch) {
+        if (!(bd->batch = (DeleteBatch *) s3_malloc(sizeof(DeleteBatch)))) {
+            return S3StatusOutOfMemory;
+        }
+        bd->batch->bulkDeleter = bd;
+        bd->batch->keysCount = 0;
+        bd->batch->keyData = 0;
+        bd->batch->keyDataLen = 0;
+        bd->batch->keyDataSize = 0;
+    }
+
+    DeleteBatch *batch = bd->batch;
+
+    if ((batch->keyDataLen + len + 1) > batch->keyDataSize) {
+        int newSize = batch->keyDataSize ? (batch->keyDataSize * 2) : 16384;
+        while (newSize < (batch->keyDataLen + len + 1)) {
+            newSize *= 2;
+        }
+        char *newData = (char *) s3_realloc(batch->keyData, newSize);
+        if (!newData) {
+            return S3StatusOutOfMemory;
+        }
+        batch->keyData = newData;
+        batch->keyDataSize = newSize;
+    }
+
+    batch->keyOffsets[batch->keysCount++] = batch->keyDataLen;
+    memcpy(&(batch->keyData[batch->keyDataLen]), key, len + 1);
+    batch->keyDataLen += len + 1;
+
+    if (batch->keysCount == S3_MAX_DELETE_OBJECTS_COUNT) {
+        S3Status status = bulk_deleter_send(bd);
+        if (status != S3StatusOK) {
+            return status;
+        }
+    }
+
+    return bd->status;
+}
+
+
+S3Status S3_bulk_deleter_finish(S3BulkDeleter *bulkDeleter)
+{
+    S3BulkDeleter *bd = bulkDeleter;
+
+    if (bd->batch && (bd->status == S3StatusOK)) {
+        S3Status status = bulk_deleter_send(bd);
+        if (status != S3StatusOK) {
+            return status;
+        }
+    }
+
+    S3Status status = bulk_deleter_wait(bd, 0);
+    if (status != S3StatusOK) {
+        return status;
+    }
+
+    return bd->status;
+}
+
+
+void S3_destroy_bulk_deleter(S3BulkDeleter *bulkDeleter)
+{
+    S3BulkDeleter *bd = bulkDeleter;
+
+    // Nothing is left in flight afterwards, even if running the request
+    // context fails
+    (void) bulk_deleter_wait(bd, 0);
+
+    if (bd->batch) {
+        s3_free(bd->batch->keyData);
+        s3_free(bd->batch);
+    }
+
+    if (bd->ownsRequestContext) {
+        S3_destroy_request_context(bd->requestContext);
+    }
+
+    s3_free(bd);
+}
@@ -34,8 +34,29 @@
 #include "error_parser.h"
 
 
-static S3Status errorXmlCallback(const char *elementPath, const char *data,
-                                 int dataLen, void *callbackData)
+// Ids of the elements of an Error, for errorXmlCallback
+enum
+{
+    Error,
+    ErrorCode,
+    ErrorMessage,
+    ErrorResource,
+    ErrorFurtherDetails
+};
+
+static const SimpleXmlPath errorPathsG[] =
+{
+    SIMPLEXML_PATH(Error, "Error"),
+    SIMPLEXML_PATH(ErrorCode, "Error/Code"),
+    SIMPLEXML_PATH(ErrorMessage, "Error/Message"),
+    SIMPLEXML_PATH(ErrorResource, "Error/Resource"),
+    SIMPLEXML_PATH(ErrorFurtherDetails, "Error/FurtherDetails")
+};
+
+
+static S3Status errorXmlCallback(int elementId, const char *elementPath,
+                                 const char *data, int dataLen,
+                                 void *callbackData)
 {
     // We ignore end of element callbacks because we don't care about them
     if (!data) {
@@ -46,26 +67,27 @@ static S3Status errorXmlCallback(const char *elementPath, const char *data,
 
     int fit;
 
-    if (!strcmp(elementPath, "Error")) {
+    switch (elementId) {
+    case Error:
         // Ignore, this is the Error element itself, we only care about subs
-    }
-    else if (!strcmp(elementPath, "Error/Code")) {
+        break;
+    case ErrorCode:
         string_buffer_append(errorParser->code, data, dataLen, fit);
-    }
-    else if (!strcmp(elementPath, "Error/Message")) {
+        break;
+    case ErrorMessage:
         string_buffer_append(errorParser->message, data, dataLen, fit);
         errorParser->s3ErrorDetails.message = errorParser->message;
-    }
-    else if (!strcmp(elementPath, "Error/Resource")) {
+        break;
+    case ErrorResource:
         string_buffer_append(errorParser->resource, data, dataLen, fit);
         errorParser->s3ErrorDetails.resource = errorParser->resource;
-    }
-    else if (!strcmp(elementPath, "Error/FurtherDetails")) {
+        break;
+    case ErrorFurtherDetails:
         string_buffer_append(errorParser->furtherDetails, data, dataLen, fit);
         errorParser->s3ErrorDetails.furtherDetails = 
             errorParser->furtherDetails;
-    }
-    else {
+        break;
+    default: {
         if (strncmp(elementPath, "Error/", sizeof("Error/") - 1)) {
             // If for some weird reason it's not within the Error element,
             // ignore it
@@ -115,6 +137,8 @@ static S3Status errorXmlCallback(const char *elementPath, const char *data,
               [errorParser->s3ErrorDetails.extraDetailsCount++]);
         nv->name = name;
         nv->value = value;
+        break;
+    }
     }
 
     return S3StatusOK;
@@ -128,6 +152,7 @@ void error_parser_initialize(ErrorParser *errorParser)
     errorParser->s3ErrorDetails.furtherDetails = 0;
     errorParser->s3ErrorDetails.extraDetailsCount = 0;
     errorParser->s3ErrorDetails.extraDetails = errorParser->extraDetails;
+    errorParser->s3ErrorDetails.timings = 0;
     errorParser->errorXmlParserInitialized = 0;
     string_buffer_initialize(errorParser->code);
     string_buffer_initialize(errorParser->message);
@@ -141,8 +166,10 @@ S3Status error_parser_add(ErrorParser *errorParser, char *buffer,
                           int bufferSize)
 {
     if (!errorParser->errorXmlParserInitialized) {
-        simplexml_initialize(&(errorParser->errorXmlParser), &errorXmlCallback,
-                             errorParser);
+        simplexml_initialize_ids(&(errorParser->errorXmlParser),
+                                 errorPathsG,
+                                 sizeof(errorPathsG) / sizeof(errorPathsG[0]),
+                                 &errorXmlCallback, errorParser);
         errorParser->errorXmlParserInitialized = 1;
     }
 
@@ -150,18 +177,12 @@ S3Status error_parser_add(ErrorParser *errorParser, char *buffer,
 }
 
 
-void error_parser_convert_status(ErrorParser *errorParser, S3Status *status)
+S3Status error_parser_code_to_status(const char *code)
 {
-    // Convert the error status string into a code
-    if (!errorParser->codeLen) {
-        return;
-    }
-
 #define HANDLE_CODE(name)                                       \
     do {                                                        \
-        if (!strcmp(errorParser->code, #name)) {                \
-            *status = S3StatusError##name;                      \
-            goto code_set;                                      \
+        if (!strcmp(code, #name)) {                             \
+            return S3StatusError##name;                         \
         }                                                       \
     } while (0)
     
@@ -244,11 +265,19 @@ void error_parser_convert_status(ErrorParser *errorParser, S3Status *status)
     HANDLE_CODE(UnresolvableGrantByEmailAddress);
     HANDLE_CODE(UserKeyMustBeSpecified);
     HANDLE_CODE(QuotaExceeded);
-    *status = S3StatusErrorUnknown;
 
- code_set:
+    return S3StatusErrorUnknown;
+}
+
+
+void error_parser_convert_status(ErrorParser *errorParser, S3Status *status)
+{
+    // Convert the error status string into a code
+    if (!errorParser->codeLen) {
+        return;
+    }
 
-    return;
+    *status = error_parser_code_to_status(errorParser->code);
 }
 
 
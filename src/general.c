@@ -31,6 +31,8 @@
  ************************************************************************** **/
 
 #include <ctype.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
 #include "request.h"
 #include "simplexml.h"
@@ -38,6 +40,207 @@
 
 static int initializeCountG = 0;
 
+static S3MallocFunction *mallocFunctionG = 0;
+
+static S3ReallocFunction *reallocFunctionG = 0;
+
+static S3FreeFunction *freeFunctionG = 0;
+
+static void *allocatorDataG = 0;
+
+
+S3Status S3_set_allocator(S3MallocFunction *mallocFunction,
+                          S3ReallocFunction *reallocFunction,
+                          S3FreeFunction *freeFunction, void *userData)
+{
+    if (!mallocFunction || !reallocFunction || !freeFunction ||
+        initializeCountG) {
+        return S3StatusInternalError;
+    }
+
+    mallocFunctionG = mallocFunction;
+    reallocFunctionG = reallocFunction;
+    freeFunctionG = freeFunction;
+    allocatorDataG = userData;
+
+    return S3StatusOK;
+}
+
+
+int s3_allocator_is_set()
+{
+    return (mallocFunctionG != 0);
+}
+
+
+void *s3_malloc(size_t size)
+{
+    return mallocFunctionG ?
+        (*mallocFunctionG)(size, allocatorDataG) : malloc(size);
+}
+
+
+void *s3_realloc(void *ptr, size_t size)
+{
+    return reallocFunctionG ?
+        (*reallocFunctionG)(ptr, size, allocatorDataG) : realloc(ptr, size);
+}
+
+
+void s3_free(void *ptr)
+{
+    if (freeFunctionG) {
+        (*freeFunctionG)(ptr, allocatorDataG);
+    }
+    else {
+        free(ptr);
+    }
+}
+
+
+// pool ----------------------------------------------------------------------
+
+// Pool allocations are rounded up to a power of two from
+// (1 << POOL_MIN_SHIFT) bytes; larger ones than the largest class bypass the
+// free lists
+#define POOL_MIN_SHIFT 7
+
+#define POOL_CLASS_COUNT 12
+
+// The most freed allocations kept in each class
+#define POOL_FREE_LIST_SIZE 8
+
+// Each allocation is preceded by a header holding its class, padded so that
+// what follows keeps the alignment that malloc gave
+#define POOL_HEADER_SIZE 16
+
+static pthread_mutex_t poolMutexG = PTHREAD_MUTEX_INITIALIZER;
+
+static void *poolFreeListsG[POOL_CLASS_COUNT][POOL_FREE_LIST_SIZE];
+
+static int poolFreeCountsG[POOL_CLASS_COUNT];
+
+
+// Returns the class of allocations of [size] bytes, or POOL_CLASS_COUNT if
+// there is none large enough
+static int pool_class(size_t size)
+{
+    int c = 0;
+
+    while ((c < POOL_CLASS_COUNT) &&
+           (size > ((size_t) 1 << (POOL_MIN_SHIFT + c)))) {
+        c++;
+    }
+
+    return c;
+}
+
+
+#define pool_header_class(block) (*((int *) (block)))
+
+
+void *s3_pool_malloc(size_t size)
+{
+    int c = pool_class(size);
+    char *block = 0;
+
+    if (c < POOL_CLASS_COUNT) {
+        pthread_mutex_lock(&poolMutexG);
+        if (poolFreeCountsG[c]) {
+            block = (char *) poolFreeListsG[c][--poolFreeCountsG[c]];
+        }
+        pthread_mutex_unlock(&poolMutexG);
+        size = (size_t) 1 << (POOL_MIN_SHIFT + c);
+    }
+
+    if (!block) {
+        if (!(block = (char *) s3_malloc(POOL_HEADER_SIZE + size))) {
+            return 0;
+        }
+        pool_header_class(block) = c;
+    }
+
+    return &(block[POOL_HEADER_SIZE]);
+}
+
+
+void *s3_pool_realloc(void *ptr, size_t size)
+{
+    if (!ptr) {
+        return s3_pool_malloc(size);
+    }
+
+    char *block = &(((char *) ptr)[-POOL_HEADER_SIZE]);
+    int c = pool_header_class(block);
+
+    // Allocations too large for the pool are resized in place
+    if (c == POOL_CLASS_COUNT) {
+        if (pool_class(size) < POOL_CLASS_COUNT) {
+            return ptr;
+        }
+        if (!(block = (char *) s3_realloc(block, POOL_HEADER_SIZE + size))) {
+            return 0;
+        }
+        return &(block[POOL_HEADER_SIZE]);
+    }
+
+    size_t classSize = (size_t) 1 << (POOL_MIN_SHIFT + c);
+    if (size <= classSize) {
+        return ptr;
+    }
+
+    void *newPtr = s3_pool_malloc(size);
+    if (newPtr) {
+        memcpy(newPtr, ptr, classSize);
+        s3_pool_free(ptr);
+    }
+
+    return newPtr;
+}
+
+
+void s3_pool_free(void *ptr)
+{
+    if (!ptr) {
+        return;
+    }
+
+    char *block = &(((char *) ptr)[-POOL_HEADER_SIZE]);
+    int c = pool_header_class(block);
+
+    if (c < POOL_CLASS_COUNT) {
+        pthread_mutex_lock(&poolMutexG);
+        if (poolFreeCountsG[c] < POOL_FREE_LIST_SIZE) {
+            poolFreeListsG[c][poolFreeCountsG[c]++] = block;
+            block = 0;
+        }
+        pthread_mutex_unlock(&poolMutexG);
+    }
+
+    if (block) {
+        s3_free(block);
+    }
+}
+
+
+void s3_pool_drain()
+{
+    int c;
+
+    pthread_mutex_lock(&poolMutexG);
+
+    for (c = 0; c < POOL_CLASS_COUNT; c++) {
+        while (poolFreeCountsG[c]) {
+            s3_free(poolFreeListsG[c][--poolFreeCountsG[c]]);
+        }
+    }
+
+    pthread_mutex_unlock(&poolMutexG);
+}
+
+
+// initialization ------------------------------------------------------------
+
 S3Status S3_initialize(const char *userAgentInfo, int flags,
                        const char *defaultS3HostName)
 {
@@ -56,6 +259,8 @@ void S3_deinitialize()
     }
 
     request_api_deinitialize();
+
+    s3_pool_drain();
 }
 
 const char *S3_get_status_name(S3Status status)
@@ -200,6 +405,15 @@ const char *S3_get_status_name(S3Status status)
         handlecase(HttpErrorNotFound);
         handlecase(HttpErrorConflict);
         handlecase(HttpErrorUnknown);
+        handlecase(JournalIOError);
+        handlecase(JournalCorrupt);
+        handlecase(JournalMismatch);
+        handlecase(JournalRecordTooLong);
+        handlecase(ChecksumMismatch);
+        handlecase(ListingIndexIOError);
+        handlecase(ListingIndexCorrupt);
+        handlecase(ListingIndexMismatch);
+        handlecase(BadResponseHeaderName);
     }
 
     return "Unknown";
@@ -0,0 +1,855 @@
+/** **************************************************************************
+ * list_iterator.c
+ *
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libs3.h"
+#include "request.h"
+#include "request_context.h"
+
+
+// Items of a page, and the strings they refer to, are copied into blocks of
+// this size, so that they stay put while more of the page arrives
+#define LIST_ARENA_BLOCK_SIZE (64 * 1024)
+
+// At most this many received pages, including the one being consumed, are
+// held before the next page is requested
+#define LIST_MAX_PAGES 2
+
+// While a page is in flight, the request context is run without waiting
+// after every this many items are consumed, so that the page keeps arriving
+// while the caller works through the previous one
+#define LIST_RUN_INTERVAL 32
+
+typedef enum
+{
+    ListIteratorTypeBucket,
+    ListIteratorTypeMultipartUploads,
+    ListIteratorTypeParts
+} ListIteratorType;
+
+
+typedef struct ListArenaBlock
+{
+    struct ListArenaBlock *next;
+    int used, size;
+    char data[];
+} ListArenaBlock;
+
+
+typedef struct ListItem
+{
+    // One of these is set
+    const void *record;
+    const char *commonPrefix;
+} ListItem;
+
+
+typedef struct ListPage
+{
+    struct ListPage *next;
+
+    ListArenaBlock *blocks;
+
+    int itemsCount, itemsSize, itemsConsumed;
+    ListItem *items;
+
+    // From the response: whether more pages follow, and the markers to
+    // request them with, which are kept in the page's arena since
+    // continuation tokens have no fixed length; 0 if not given
+    int isTruncated;
+    const char *nextMarker;
+    const char *nextUploadIdMarker;
+
+    // The last item's key, upload ID, or part number, used when the
+    // response does not give the next markers, or 0
+    const char *lastMarker;
+    const char *lastUploadId;
+} ListPage;
+
+
+struct S3ListIterator
+{
+    ListIteratorType type;
+
+    S3BucketContext bucketContext;
+    int listVersion;
+    int fetchOwner;
+    int maxkeys;
+    int timeoutMs;
+    char *prefix, *delimiter, *key, *uploadId;
+
+    // Where the next page starts, or 0
+    char *marker, *uploadIdMarker;
+
+    // Set once the marker comes from a response rather than the caller
+    int continued;
+
+    S3RequestContext *requestContext;
+    int ownsRequestContext;
+
+    // The page being received, if a request is outstanding
+    ListPage *filling;
+
+    // Received pages; the head is the one being consumed
+    ListPage *head, *tail;
+    int pagesCount;
+
+    // Set when a page should be requested as soon as a page is released
+    int requestDeferred;
+
+    // Set while the iterator is being destroyed
+    int destroying;
+
+    S3Status status;
+};
+
+
+// arena ---------------------------------------------------------------------
+
+static void *list_page_alloc(ListPage *page, int size)
+{
+    // Keep everything pointer-aligned
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+    ListArenaBlock *block = page->blocks;
+
+    if (!block || ((block->used + size) > block->size)) {
+        int blockSize = (size > LIST_ARENA_BLOCK_SIZE) ?
+            size : LIST_ARENA_BLOCK_SIZE;
+        block = (ListArenaBlock *)
+            s3_malloc(sizeof(ListArenaBlock) + blockSize);
+        if (!block) {
+            return 0;
+        }
+        block->next = page->blocks;
+        block->used = 0;
+        block->size = blockSize;
+        page->blocks = block;
+    }
+
+    void *ret = &(block->data[block->used]);
+    block->used += size;
+    return ret;
+}
+
+
+// Copies [str] onto the heap, returning NULL for NULL and setting [*oom] if
+// memory runs out
+static char *list_iterator_strdup(const char *str, int *oom)
+{
+    if (!str) {
+        return 0;
+    }
+
+    int len = strlen(str) + 1;
+    char *ret = (char *) s3_malloc(len);
+    if (!ret) {
+        *oom = 1;
+        return 0;
+    }
+    memcpy(ret, str, len);
+    return ret;
+}
+
+
+// Copies [str] into the page, returning NULL for NULL and setting [*oom] if
+// memory runs out
+static const char *list_page_strdup(ListPage *page, const char *str, int *oom)
+{
+    if (!str) {
+        return 0;
+    }
+
+    int len = strlen(str) + 1;
+    char *ret = (char *) list_page_alloc(page, len);
+    if (!ret) {
+        *oom = 1;
+        return 0;
+    }
+    memcpy(ret, str, len);
+    return ret;
+}
+
+
+static S3Status list_page_add_item(ListPage *page, const void *record,
+                                   const char *commonPrefix)
+{
+    if (page->itemsCount == page->itemsSize) {
+        int newSize = page->itemsSize ? (page->itemsSize * 2) : 256;
+        ListItem *newItems =
+            (ListItem *) s3_realloc(page->items, newSize * sizeof(ListItem));
+        if (!newItems) {
+            return S3StatusOutOfMemory;
+        }
+        page->items = newItems;
+        page->itemsSize = newSize;
+    }
+
+    page->items[page->itemsCount].record = record;
+    page->items[page->itemsCount].commonPrefix = commonPrefix;
+    page->itemsCount++;
+
+    return S3StatusOK;
+}
+
+
+static S3Status list_page_add_common_prefixes(ListPage *page,
+                                              int commonPrefixesCount,
+                                              const char **commonPrefixes)
+{
+    int i, oom = 0;
+    for (i = 0; i < commonPrefixesCount; i++) {
+        const char *commonPrefix =
+            list_page_strdup(page, commonPrefixes[i], &oom);
+        if (oom || (list_page_add_item(page, 0, commonPrefix) !=
+                    S3StatusOK)) {
+            return S3StatusOutOfMemory;
+        }
+    }
+
+    return S3StatusOK;
+}
+
+
+static void list_page_free(ListPage *page)
+{
+    while (page->blocks) {
+        ListArenaBlock *next = page->blocks->next;
+        s3_free(page->blocks);
+        page->blocks = next;
+    }
+    s3_free(page->items);
+    s3_free(page);
+}
+
+
+// Records a marker from a response or from the last item, if it is not empty
+static S3Status list_page_set(ListPage *page, const char **field,
+                              const char *value)
+{
+    if (value && value[0]) {
+        int oom = 0;
+        *field = list_page_strdup(page, value, &oom);
+        if (oom) {
+            return S3StatusOutOfMemory;
+        }
+    }
+
+    return S3StatusOK;
+}
+
+
+// callbacks -----------------------------------------------------------------
+
+static S3Status listIteratorBucketCallback(int isTruncated,
+                                           const char *nextMarker,
+                                           int contentsCount,
+                                           const S3ListBucketContent *contents,
+                                           int commonPrefixesCount,
+                                           const char **commonPrefixes,
+                                           void *callbackData)
+{
+    S3ListIterator *it = (S3ListIterator *) callbackData;
+    ListPage *page = it->filling;
+
+    page->isTruncated = isTruncated;
+    if (list_page_set(page, &(page->nextMarker), nextMarker) != S3StatusOK) {
+        return S3StatusOutOfMemory;
+    }
+
+    int i, oom = 0;
+    for (i = 0; i < contentsCount; i++) {
+        S3ListBucketContent *content = (S3ListBucketContent *)
+            list_page_alloc(page, sizeof(S3ListBucketContent));
+        if (!content) {
+            return S3StatusOutOfMemory;
+        }
+        *content = contents[i];
+        content->key = list_page_strdup(page, contents[i].key, &oom);
+        content->eTag = list_page_strdup(page, contents[i].eTag, &oom);
+        content->ownerId = list_page_strdup(page, contents[i].ownerId, &oom);
+        content->ownerDisplayName =
+            list_page_strdup(page, contents[i].ownerDisplayName, &oom);
+        if (oom || (list_page_add_item(page, content, 0) != S3StatusOK)) {
+            return S3StatusOutOfMemory;
+        }
+    }
+
+    if (contentsCount) {
+        // The key has already been copied into the page
+        const S3ListBucketContent *last = (const S3ListBucketContent *)
+            page->items[page->itemsCount - 1].record;
+        page->lastMarker = last->key;
+    }
+
+    return list_page_add_common_prefixes(page, commonPrefixesCount,
+                                         commonPrefixes);
+}
+
+
+static S3Status listIteratorUploadsCallback
+    (int isTruncated, const char *nextKeyMarker,
+     const char *nextUploadIdMarker, int uploadsCount,
+     const S3ListMultipartUpload *uploads, int commonPrefixesCount,
+     const char **commonPrefixes, void *callbackData)
+{
+    S3ListIterator *it = (S3ListIterator *) callbackData;
+    ListPage *page = it->filling;
+
+    page->isTruncated = isTruncated;
+    if ((list_page_set(page, &(page->nextMarker), nextKeyMarker) !=
+         S3StatusOK) ||
+        (list_page_set(page, &(page->nextUploadIdMarker),
+                       nextUploadIdMarker) != S3StatusOK)) {
+        return S3StatusOutOfMemory;
+    }
+
+    int i, oom = 0;
+    for (i = 0; i < uploadsCount; i++) {
+        S3ListMultipartUpload *upload = (S3ListMultipartUpload *)
+            list_page_alloc(page, sizeof(S3ListMultipartUpload));
+        if (!upload) {
+            return S3StatusOutOfMemory;
+        }
+        *upload = uploads[i];
+        upload->key = list_page_strdup(page, uploads[i].key, &oom);
+        upload->uploadId = list_page_strdup(page, uploads[i].uploadId, &oom);
+        upload->initiatorId =
+            list_page_strdup(page, uploads[i].initiatorId, &oom);
+        upload->initiatorDisplayName =
+            list_page_strdup(page, uploads[i].initiatorDisplayName, &oom);
+        upload->ownerId = list_page_strdup(page, uploads[i].ownerId, &oom);
+        upload->ownerDisplayName =
+            list_page_strdup(page, uploads[i].ownerDisplayName, &oom);
+        upload->storageClass =
+            list_page_strdup(page, uploads[i].storageClass, &oom);
+        if (oom || (list_page_add_item(page, upload, 0) != S3StatusOK)) {
+            return S3StatusOutOfMemory;
+        }
+    }
+
+    if (uploadsCount) {
+        // The key and upload ID have already been copied into the page
+        const S3ListMultipartUpload *last = (const S3ListMultipartUpload *)
+            page->items[page->itemsCount - 1].record;
+        page->lastMarker = last->key;
+        page->lastUploadId = last->uploadId;
+    }
+
+    return list_page_add_common_prefixes(page, commonPrefixesCount,
+                                         commonPrefixes);
+}
+
+
+static S3Status listIteratorPartsCallback
+    (int isTruncated, const char *nextPartNumberMarker,
+     const char *initiatorId, const char *initiatorDisplayName,
+     const char *ownerId, const char *ownerDisplayName,
+     const char *storageClass, int partsCount, int lastPartNumber,
+     const S3ListPart *parts, void *callbackData)
+{
+    (void) initiatorId;
+    (void) initiatorDisplayName;
+    (void) ownerId;
+    (void) ownerDisplayName;
+    (void) storageClass;
+    (void) lastPartNumber;
+
+    S3ListIterator *it = (S3ListIterator *) callbackData;
+    ListPage *page = it->filling;
+
+    page->isTruncated = isTruncated;
+    if (list_page_set(page, &(page->nextMarker), nextPartNumberMarker) !=
+        S3StatusOK) {
+        return S3StatusOutOfMemory;
+    }
+
+    int i, oom = 0;
+    for (i = 0; i < partsCount; i++) {
+        S3ListPart *part = (S3ListPart *)
+            list_page_alloc(page, sizeof(S3ListPart));
+        if (!part) {
+            return S3StatusOutOfMemory;
+        }
+        *part = parts[i];
+        part->eTag = list_page_strdup(page, parts[i].eTag, &oom);
+        if (oom || (list_page_add_item(page, part, 0) != S3StatusOK)) {
+            return S3StatusOutOfMemory;
+        }
+    }
+
+    if (partsCount) {
+        char partNumber[32];
+        snprintf(partNumber, sizeof(partNumber), "%llu",
+                 (unsigned long long) parts[partsCount - 1].partNumber);
+        return list_page_set(page, &(page->lastMarker), partNumber);
+    }
+
+    return S3StatusOK;
+}
+
+
+static void list_iterator_request(S3ListIterator *it);
+
+
+static void listIteratorCompleteCallback(S3Status status,
+                                         const S3ErrorDetails *errorDetails,
+                                         void *callbackData)
+{
+    (void) errorDetails;
+
+    S3ListIterator *it = (S3ListIterator *) callbackData;
+    ListPage *page = it->filling;
+
+    it->filling = 0;
+
+    if (status != S3StatusOK) {
+        list_page_free(page);
+        it->status = status;
+        return;
+    }
+
+    // Queue the page, even if empty, so that its release triggers any
+    // deferred request
+    if (it->tail) {
+        it->tail->next = page;
+    }
+    else {
+        it->head = page;
+    }
+    it->tail = page;
+    it->pagesCount++;
+
+    // A truncated page which gave no way to continue ends the listing
+    // rather than repeating it forever
+    if (!page->isTruncated || (!page->nextMarker && !page->lastMarker)) {
+        return;
+    }
+
+    // Continue from the markers given by the response, or else from the
+    // last item.  ListObjectsV2 must be continued with its token.  The
+    // markers are copied, since the page may be released before the next
+    // page is requested.
+    const char *marker, *uploadIdMarker;
+    if (page->nextMarker) {
+        marker = page->nextMarker;
+        uploadIdMarker = page->nextUploadIdMarker;
+    }
+    else if (it->listVersion == 2) {
+        return;
+    }
+    else {
+        marker = page->lastMarker;
+        uploadIdMarker = page->lastUploadId;
+    }
+    int oom = 0;
+    s3_free(it->marker);
+    s3_free(it->uploadIdMarker);
+    it->marker = list_iterator_strdup(marker, &oom);
+    it->uploadIdMarker = list_iterator_strdup(uploadIdMarker, &oom);
+    if (oom) {
+        it->status = S3StatusOutOfMemory;
+        return;
+    }
+    it->continued = 1;
+
+    // Ask for the next page right away, so that it arrives while this one
+    // is consumed, unless enough pages are already waiting
+    if (it->destroying) {
+        return;
+    }
+
+    if (it->pagesCount < LIST_MAX_PAGES) {
+        list_iterator_request(it);
+    }
+    else {
+        it->requestDeferred = 1;
+    }
+}
+
+
+static const S3ListBucketHandler listIteratorBucketHandlerG =
+{
+    { 0, &listIteratorCompleteCallback },
+    &listIteratorBucketCallback,
+    0,
+    0
+};
+
+
+static const S3ListMultipartUploadsHandler listIteratorUploadsHandlerG =
+{
+    { 0, &listIteratorCompleteCallback },
+    &listIteratorUploadsCallback
+};
+
+
+static const S3ListPartsHandler listIteratorPartsHandlerG =
+{
+    { 0, &listIteratorCompleteCallback },
+    &listIteratorPartsCallback
+};
+
+
+static void list_iterator_request(S3ListIterator *it)
+{
+    ListPage *page = (ListPage *) s3_malloc(sizeof(ListPage));
+    if (!page) {
+        it->status = S3StatusOutOfMemory;
+        return;
+    }
+
+    page->next = 0;
+    page->blocks = 0;
+    page->itemsCount = page->itemsSize = page->itemsConsumed = 0;
+    page->items = 0;
+    page->isTruncated = 0;
+    page->nextMarker = 0;
+    page->nextUploadIdMarker = 0;
+    page->lastMarker = 0;
+    page->lastUploadId = 0;
+
+    it->filling = page;
+
+    const char *marker = it->marker;
+
+    // The page request is the iterator's own, so that it can be cancelled
+    // if the iterator has to give up on a shared request context
+    void *owner = request_context_set_owner(it->requestContext, it);
+
+    switch (it->type) {
+    case ListIteratorTypeBucket:
+        if (it->listVersion == 2) {
+            // The first request starts after the caller's marker, the rest
+            // continue from a token
+            S3_list_bucket_v2(&(it->bucketContext), it->prefix,
+                              it->continued ? marker : 0,
+                              it->continued ? 0 : marker,
+                              it->delimiter, it->maxkeys, it->fetchOwner,
+                              it->requestContext, it->timeoutMs,
+                              &listIteratorBucketHandlerG, it);
+        }
+        else {
+            S3_list_bucket(&(it->bucketContext), it->prefix, marker,
+                           it->delimiter, it->maxkeys, it->requestContext,
+                           it->timeoutMs, &listIteratorBucketHandlerG, it);
+        }
+        break;
+    case ListIteratorTypeMultipartUploads:
+        S3_list_multipart_uploads(&(it->bucketContext), it->prefix, marker,
+                                  it->uploadIdMarker, 0, it->delimiter,
+                                  it->maxkeys, it->requestContext,
+                                  it->timeoutMs, &listIteratorUploadsHandlerG,
+                                  it);
+        break;
+    default: // ListIteratorTypeParts
+        S3_list_parts(&(it->bucketContext), it->key, marker, it->uploadId, 0,
+                      it->maxkeys, it->requestContext, it->timeoutMs,
+                      &listIteratorPartsHandlerG, it);
+        break;
+    }
+
+    request_context_set_owner(it->requestContext, owner);
+}
+
+
+// iterator ------------------------------------------------------------------
+
+static void list_iterator_free(S3ListIterator *it)
+{
+    while (it->head) {
+        ListPage *next = it->head->next;
+        list_page_free(it->head);
+        it->head = next;
+    }
+    if (it->ownsRequestContext) {
+        S3_destroy_request_context(it->requestContext);
+    }
+    s3_free(it->prefix);
+    s3_free(it->delimiter);
+    s3_free(it->key);
+    s3_free(it->uploadId);
+    s3_free(it->marker);
+    s3_free(it->uploadIdMarker);
+    s3_free(it);
+}
+
+
+static S3Status list_iterator_create(ListIteratorType type,
+                                     const S3BucketContext *bucketContext,
+                                     const char *prefix, const char *marker,
+                                     const char *uploadIdMarker,
+                                     const char *delimiter, const char *key,
+                                     const char *uploadId, int maxkeys,
+                                     S3RequestContext *requestContext,
+                                     int timeoutMs,
+                                     S3ListIterator **iteratorReturn)
+{
+    S3ListIterator *it = (S3ListIterator *) s3_malloc(sizeof(S3ListIterator));
+    if (!it) {
+        return S3StatusOutOfMemory;
+    }
+
+    memset(it, 0, sizeof(S3ListIterator));
+
+    it->type = type;
+    it->bucketContext = *bucketContext;
+    it->listVersion = 1;
+    it->maxkeys = maxkeys;
+    it->timeoutMs = timeoutMs;
+    it->status = S3StatusOK;
+
+    if (marker && (strlen(marker) > S3_MAX_KEY_SIZE)) {
+        list_iterator_free(it);
+        return S3StatusKeyTooLong;
+    }
+
+    int oom = 0;
+    it->prefix = list_iterator_strdup(prefix, &oom);
+    it->delimiter = list_iterator_strdup(delimiter, &oom);
+    it->key = list_iterator_strdup(key, &oom);
+    it->uploadId = list_iterator_strdup(uploadId, &oom);
+    // Empty markers are as none
+    it->marker = (marker && marker[0]) ?
+        list_iterator_strdup(marker, &oom) : 0;
+    it->uploadIdMarker = (uploadIdMarker && uploadIdMarker[0]) ?
+        list_iterator_strdup(uploadIdMarker, &oom) : 0;
+    if (oom) {
+        list_iterator_free(it);
+        return S3StatusOutOfMemory;
+    }
+
+    if (requestContext) {
+        it->requestContext = requestContext;
+    }
+    else {
+        S3Status status = S3_create_request_context(&(it->requestContext));
+        if (status != S3StatusOK) {
+            list_iterator_free(it);
+            return status;
+        }
+        it->ownsRequestContext = 1;
+    }
+
+    *iteratorReturn = it;
+
+    return S3StatusOK;
+}
+
+
+S3Status S3_create_list_bucket_iterator(const S3BucketContext *bucketContext,
+                                        const char *prefix,
+                                        const char *startAfter,
+                                        const char *delimiter, int maxkeys,
+                                        int listVersion, int fetchOwner,
+                                        S3RequestContext *requestContext,
+                                        int timeoutMs,
+                                        S3ListIterator **iteratorReturn)
+{
+    if ((listVersion != 1) && (listVersion != 2)) {
+        return S3StatusInternalError;
+    }
+
+    S3Status status = list_iterator_create
+        (ListIteratorTypeBucket, bucketContext, prefix, startAfter, 0,
+         delimiter, 0, 0, maxkeys, requestContext, timeoutMs, iteratorReturn);
+
+    if (status == S3StatusOK) {
+        (*iteratorReturn)->listVersion = listVersion;
+        (*iteratorReturn)->fetchOwner = fetchOwner;
+        list_iterator_request(*iteratorReturn);
+    }
+
+    return status;
+}
+
+
+S3Status S3_create_list_multipart_uploads_iterator
+    (const S3BucketContext *bucketContext, const char *prefix,
+     const char *keyMarker, const char *uploadIdMarker, const char *delimiter,
+     int maxuploads, S3RequestContext *requestContext, int timeoutMs,
+     S3ListIterator **iteratorReturn)
+{
+    S3Status status = list_iterator_create
+        (ListIteratorTypeMultipartUploads, bucketContext, prefix, keyMarker,
+         uploadIdMarker, delimiter, 0, 0, maxuploads, requestContext,
+         timeoutMs, iteratorReturn);
+
+    if (status == S3StatusOK) {
+        list_iterator_request(*iteratorReturn);
+    }
+
+    return status;
+}
+
+
+S3Status S3_create_list_parts_iterator(const S3BucketContext *bucketContext,
+                                       const char *key, const char *uploadId,
+                                       const char *partNumberMarker,
+                                       int maxparts,
+                                       S3RequestContext *requestContext,
+                                       int timeoutMs,
+                                       S3ListIterator **iteratorReturn)
+{
+    if (!key || !uploadId) {
+        return S3StatusInternalError;
+    }
+
+    S3Status status = list_iterator_create
+        (ListIteratorTypeParts, bucketContext, 0, partNumberMarker, 0, 0, key,
+         uploadId, maxparts, requestContext, timeoutMs, iteratorReturn);
+
+    if (status == S3StatusOK) {
+        list_iterator_request(*iteratorReturn);
+    }
+
+    return status;
+}
+
+
+// Returns the next item, or NULL at the end of the listing
+static S3Status list_iterator_next(S3ListIterator *it, ListItem **itemReturn)
+{
+    while (1) {
+        ListPage *page = it->head;
+
+        if (page && (page->itemsConsumed < page->itemsCount)) {
+            *itemReturn = &(page->items[page->itemsConsumed++]);
+            // Let the page in flight make progress without waiting for it
+            if (it->filling &&
+                !(page->itemsConsumed % LIST_RUN_INTERVAL)) {
+                int requestsRemaining;
+                S3_runonce_request_context(it->requestContext,
+                                           &requestsRemaining);
+            }
+            return S3StatusOK;
+        }
+
+        if (page) {
+            // The items returned from this page are no longer needed
+            it->head = page->next;
+            if (!it->head) {
+                it->tail = 0;
+            }
+            it->pagesCount--;
+            list_page_free(page);
+            if (it->requestDeferred) {
+                it->requestDeferred = 0;
+                list_iterator_request(it);
+            }
+            continue;
+        }
+
+        if (it->filling) {
+            int requestsRemaining;
+            S3Status status = request_context_wait(it->requestContext,
+                                                   &requestsRemaining);
+            if (status != S3StatusOK) {
+                *itemReturn = 0;
+                return status;
+            }
+            continue;
+        }
+
+        // Nothing received and nothing in flight: the listing is over
+        *itemReturn = 0;
+        return it->status;
+    }
+}
+
+
+S3Status S3_list_iterator_next_content(S3ListIterator *iterator,
+                                       const S3ListBucketContent **contentReturn,
+                                       const char **commonPrefixReturn)
+{
+    ListItem *item;
+    S3Status status = list_iterator_next(iterator, &item);
+
+    *contentReturn = item ? (const S3ListBucketContent *) item->record : 0;
+    *commonPrefixReturn = item ? item->commonPrefix : 0;
+
+    return status;
+}
+
+
+S3Status S3_list_iterator_next_upload(S3ListIterator *iterator,
+                                      const S3ListMultipartUpload **uploadReturn,
+                                      const char **commonPrefixReturn)
+{
+    ListItem *item;
+    S3Status status = list_iterator_next(iterator, &item);
+
+    *uploadReturn = item ? (const S3ListMultipartUpload *) item->record : 0;
+    *commonPrefixReturn = item ? item->commonPrefix : 0;
+
+    return status;
+}
+
+
+S3Status S3_list_iterator_next_part(S3ListIterator *iterator,
+                                    const S3ListPart **partReturn)
+{
+    ListItem *item;
+    S3Status status = list_iterator_next(iterator, &item);
+
+    *partReturn = item ? (const S3ListPart *) item->record : 0;
+
+    return status;
+}
+
+
+void S3_destroy_list_iterator(S3ListIterator *iterator)
+{
+    iterator->destroying = 1;
+
+    // A page in flight on a shared request context must finish before the
+    // iterator it reports to goes away; an owned one is simply torn down
+    if (!iterator->ownsRequestContext) {
+        while (iterator->filling) {
+            int requestsRemaining;
+            if (request_context_wait(iterator->requestContext,
+                                     &requestsRemaining) != S3StatusOK) {
+                // The page cannot finish, so complete it here instead
+                request_context_cancel(iterator->requestContext, iterator);
+                break;
+            }
+        }
+    }
+    else if (iterator->filling) {
+        S3_destroy_request_context(iterator->requestContext);
+        iterator->ownsRequestContext = 0;
+    }
+
+    list_iterator_free(iterator);
+}
@@ -0,0 +1,842 @@
+/** **************************************************************************
+ * listing_index.c
+ *
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+#include "libs3.h"
+#include "util.h"
+
+
+#ifdef _WIN32
+
+/* The index is read through a file mapping, which is not implemented for
+ * Windows; an index cannot be opened there, so none of the other functions
+ * can be called with one.
+ */
+
+S3Status S3_open_listing_index(const char *path, const char *bucketName,
+                               const char *prefix,
+                               S3ListingIndex **indexReturn)
+{
+    (void) path;
+    (void) bucketName;
+    (void) prefix;
+    (void) indexReturn;
+    return S3StatusNotSupported;
+}
+
+
+void S3_close_listing_index(S3ListingIndex *index)
+{
+    (void) index;
+}
+
+
+S3Status S3_refresh_listing_index(S3ListingIndex *index,
+                                  const S3BucketContext *bucketContext,
+                                  int appendOnly, int changedPrefixesCount,
+                                  const char **changedPrefixes,
+                                  int timeoutMs)
+{
+    (void) index;
+    (void) bucketContext;
+    (void) appendOnly;
+    (void) changedPrefixesCount;
+    (void) changedPrefixes;
+    (void) timeoutMs;
+    return S3StatusNotSupported;
+}
+
+
+uint64_t S3_listing_index_count(const S3ListingIndex *index)
+{
+    (void) index;
+    return 0;
+}
+
+
+uint64_t S3_listing_index_search(const S3ListingIndex *index,
+                                 const char *key)
+{
+    (void) index;
+    (void) key;
+    return 0;
+}
+
+
+int S3_listing_index_get(const S3ListingIndex *index, uint64_t position,
+                         S3ListBucketContent *contentReturn)
+{
+    (void) index;
+    (void) position;
+    (void) contentReturn;
+    return 0;
+}
+
+
+int S3_listing_index_find(const S3ListingIndex *index, const char *key,
+                          S3ListBucketContent *contentReturn)
+{
+    (void) index;
+    (void) key;
+    (void) contentReturn;
+    return 0;
+}
+
+#else
+
+
+// The index file is a fixed header, the zero terminated bucket name and
+// prefix, then an array of fixed size records sorted by key, then the zero
+// terminated keys and ETags that the records refer to:
+//
+//   char     magic[8]
+//   uint64_t count           (of records)
+//   uint64_t recordsOffset   (8-byte aligned)
+//   uint64_t stringsOffset
+//   uint64_t stringsSize
+//   uint32_t bucketNameLength
+//   uint32_t prefixLength
+//
+// The file is never modified in place; a refresh writes a complete new file
+// and renames it over the old one.
+
+#define INDEX_MAGIC              "libs3li1"
+#define INDEX_MAGIC_SIZE         8
+#define INDEX_HEADER_SIZE        64
+#define INDEX_INITIAL_RECORDS    1024
+#define INDEX_INITIAL_STRINGS    (64 * 1024)
+
+#define INDEX_ALIGN(x)           (((x) + 7) & ~((uint64_t) 7))
+
+typedef struct IndexHeader
+{
+    char magic[INDEX_MAGIC_SIZE];
+    uint64_t count;
+    uint64_t recordsOffset;
+    uint64_t stringsOffset;
+    uint64_t stringsSize;
+    uint32_t bucketNameLength;
+    uint32_t prefixLength;
+} IndexHeader;
+
+
+// Offsets are from the start of the strings
+typedef struct IndexRecord
+{
+    uint64_t keyOffset;
+    uint64_t eTagOffset;
+    uint64_t size;
+    int64_t lastModified;
+    uint32_t keyLength;
+    uint32_t eTagLength;
+} IndexRecord;
+
+
+struct S3ListingIndex
+{
+    char *path;
+
+    char *bucketName;
+
+    char *prefix;
+
+    // The mapped file, or 0 if there is none yet
+    char *map;
+
+    size_t mapSize;
+
+    uint64_t count;
+
+    const IndexRecord *records;
+
+    const char *strings;
+};
+
+
+// Records and strings read from a listing, or to be written to a new index
+typedef struct IndexBuilder
+{
+    IndexRecord *records;
+
+    uint64_t count, size;
+
+    char *strings;
+
+    uint64_t stringsLen, stringsSize;
+} IndexBuilder;
+
+
+static char *index_strdup(const char *str)
+{
+    size_t len = strlen(str) + 1;
+    char *ret = (char *) s3_malloc(len);
+
+    return ret ? (char *) memcpy(ret, str, len) : 0;
+}
+
+
+static void index_unmap(S3ListingIndex *index)
+{
+    if (index->map) {
+        munmap(index->map, index->mapSize);
+        index->map = 0;
+        index->mapSize = 0;
+    }
+
+    index->count = 0;
+    index->records = 0;
+    index->strings = 0;
+}
+
+
+// Validates the mapped file of [index], setting up its records and strings
+static S3Status index_validate(S3ListingIndex *index)
+{
+    IndexHeader header;
+    uint64_t i;
+
+    if (index->mapSize < INDEX_HEADER_SIZE) {
+        return S3StatusListingIndexCorrupt;
+    }
+
+    memcpy(&header, index->map, sizeof(header));
+
+    if (memcmp(header.magic, INDEX_MAGIC, INDEX_MAGIC_SIZE)) {
+        return S3StatusListingIndexCorrupt;
+    }
+
+    // Check the sizes in an order that avoids overflow
+    uint64_t namesSize = (uint64_t) header.bucketNameLength +
+        header.prefixLength + 2;
+    if ((header.recordsOffset != INDEX_ALIGN(INDEX_HEADER_SIZE + namesSize)) ||
+        (header.recordsOffset > index->mapSize) ||
+        (header.count > ((index->mapSize - header.recordsOffset) /
+                         sizeof(IndexRecord))) ||
+        (header.stringsOffset !=
+         (header.recordsOffset + (header.count * sizeof(IndexRecord)))) ||
+        (header.stringsSize != (index->mapSize - header.stringsOffset))) {
+        return S3StatusListingIndexCorrupt;
+    }
+
+    const char *bucketName = &(index->map[INDEX_HEADER_SIZE]);
+    const char *prefix = &(bucketName[header.bucketNameLength + 1]);
+
+    if (bucketName[header.bucketNameLength] ||
+        prefix[header.prefixLength]) {
+        return S3StatusListingIndexCorrupt;
+    }
+
+    if (strcmp(bucketName, index->bucketName) ||
+        strcmp(prefix, index->prefix)) {
+        return S3StatusListingIndexMismatch;
+    }
+
+    const IndexRecord *records =
+        (const IndexRecord *) &(index->map[header.recordsOffset]);
+    const char *strings = &(index->map[header.stringsOffset]);
+
+    // Every string must lie within the strings and be terminated, so that
+    // they can be returned directly from the map
+    for (i = 0; i < header.count; i++) {
+        const IndexRecord *record = &(records[i]);
+        if ((record->keyOffset >= header.stringsSize) ||
+            (record->keyLength >= (header.stringsSize - record->keyOffset)) ||
+            strings[record->keyOffset + record->keyLength] ||
+            (record->eTagOffset >= header.stringsSize) ||
+            (record->eTagLength >=
+             (header.stringsSize - record->eTagOffset)) ||
+            strings[record->eTagOffset + record->eTagLength]) {
+            return S3StatusListingIndexCorrupt;
+        }
+    }
+
+    index->count = header.count;
+    index->records = records;
+    index->strings = strings;
+
+    return S3StatusOK;
+}
+
+
+// Maps the index file, if it exists, in place of what was mapped
+static S3Status index_map(S3ListingIndex *index)
+{
+    index_unmap(index);
+
+    int fd = open(index->path, O_RDONLY);
+
+    if (fd == -1) {
+        return (errno == ENOENT) ? S3StatusOK : S3StatusListingIndexIOError;
+    }
+
+    struct stat statbuf;
+
+    if (fstat(fd, &statbuf) == -1) {
+        close(fd);
+        return S3StatusListingIndexIOError;
+    }
+
+    if (statbuf.st_size < INDEX_HEADER_SIZE) {
+        close(fd);
+        return S3StatusListingIndexCorrupt;
+    }
+
+    void *map = mmap(0, statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    // The mapping remains valid after the file is closed
+    close(fd);
+
+    if (map == MAP_FAILED) {
+        return S3StatusListingIndexIOError;
+    }
+
+    index->map = (char *) map;
+    index->mapSize = statbuf.st_size;
+
+    S3Status status = index_validate(index);
+
+    if (status != S3StatusOK) {
+        index_unmap(index);
+    }
+
+    return status;
+}
+
+
+// Returns the key of the record at [position]
+#define index_key(index, position)                                      \
+    (&((index)->strings[(index)->records[position].keyOffset]))
+
+
+// Returns the position of the first key, from [start] on, which is not less
+// than [key], or if [isPrefix], which is greater than [key] and does not
+// begin with it
+static uint64_t index_search(const S3ListingIndex *index, uint64_t start,
+                             const char *key, int isPrefix)
+{
+    uint64_t lo = start, hi = index->count;
+    size_t keyLen = strlen(key);
+
+    while (lo < hi) {
+        uint64_t mid = lo + ((hi - lo) / 2);
+        int cmp = isPrefix ? strncmp(index_key(index, mid), key, keyLen) :
+            strcmp(index_key(index, mid), key);
+        if (cmp < (isPrefix ? 1 : 0)) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+
+// builder ------------------------------------------------------------------
+
+static void builder_free(IndexBuilder *builder)
+{
+    s3_free(builder->records);
+    s3_free(builder->strings);
+}
+
+
+static S3Status builder_append_string(IndexBuilder *builder, const char *str,
+                                      uint64_t len, uint64_t *offsetReturn)
+{
+    if ((builder->stringsLen + len + 1) > builder->stringsSize) {
+        uint64_t size = builder->stringsSize ? builder->stringsSize :
+            INDEX_INITIAL_STRINGS;
+        while ((builder->stringsLen + len + 1) > size) {
+            size *= 2;
+        }
+        char *strings = (char *) s3_realloc(builder->strings, size);
+        if (!strings) {
+            return S3StatusOutOfMemory;
+        }
+        builder->strings = strings;
+        builder->stringsSize = size;
+    }
+
+    memcpy(&(builder->strings[builder->stringsLen]), str, len);
+    builder->strings[builder->stringsLen + len] = 0;
+    *offsetReturn = builder->stringsLen;
+    builder->stringsLen += len + 1;
+
+    return S3StatusOK;
+}
+
+
+static S3Status builder_append(IndexBuilder *builder, const char *key,
+                               uint64_t keyLength, const char *eTag,
+                               uint64_t eTagLength, uint64_t size,
+                               int64_t lastModified)
+{
+    if (builder->count == builder->size) {
+        uint64_t count = builder->size ? (builder->size * 2) :
+            INDEX_INITIAL_RECORDS;
+        IndexRecord *records = (IndexRecord *) s3_realloc
+            (builder->records, count * sizeof(IndexRecord));
+        if (!records) {
+            return S3StatusOutOfMemory;
+        }
+        builder->records = records;
+        builder->size = count;
+    }
+
+    IndexRecord *record = &(builder->records[builder->count]);
+    S3Status status;
+
+    if (((status = builder_append_string(builder, key, keyLength,
+                                         &(record->keyOffset))) !=
+         S3StatusOK) ||
+        ((status = builder_append_string(builder, eTag, eTagLength,
+                                         &(record->eTagOffset))) !=
+         S3StatusOK)) {
+        return status;
+    }
+
+    record->keyLength = keyLength;
+    record->eTagLength = eTagLength;
+    record->size = size;
+    record->lastModified = lastModified;
+    builder->count++;
+
+    return S3StatusOK;
+}
+
+
+// Appends the records [start, end) of [records] and [strings]
+static S3Status builder_append_records(IndexBuilder *builder,
+                                       const IndexRecord *records,
+                                       const char *strings, uint64_t start,
+                                       uint64_t end)
+{
+    for (; start < end; start++) {
+        const IndexRecord *record = &(records[start]);
+        S3Status status = builder_append
+            (builder, &(strings[record->keyOffset]), record->keyLength,
+             &(strings[record->eTagOffset]), record->eTagLength,
+             record->size, record->lastModified);
+        if (status != S3StatusOK) {
+            return status;
+        }
+    }
+
+    return S3StatusOK;
+}
+
+
+// listing ------------------------------------------------------------------
+
+typedef struct IndexListData
+{
+    IndexBuilder *builder;
+
+    int isTruncated;
+
+    // The continuation token for the next request, or 0.  Tokens are
+    // opaque and may be longer than any key, so this is on the heap.
+    char *nextMarker;
+
+    S3Status status;
+} IndexListData;
+
+
+static S3Status indexListCallback(int isTruncated, const char *nextMarker,
+                                  int contentsCount,
+                                  const S3ListBucketContent *contents,
+                                  int commonPrefixesCount,
+                                  const char **commonPrefixes,
+                                  void *callbackData)
+{
+    (void) commonPrefixesCount;
+    (void) commonPrefixes;
+
+    IndexListData *ld = (IndexListData *) callbackData;
+    int i;
+
+    ld->isTruncated = isTruncated;
+    s3_free(ld->nextMarker);
+    ld->nextMarker = 0;
+    if (nextMarker && nextMarker[0] &&
+        !(ld->nextMarker = index_strdup(nextMarker))) {
+        return S3StatusOutOfMemory;
+    }
+
+    for (i = 0; i < contentsCount; i++) {
+        const S3ListBucketContent *content = &(contents[i]);
+        S3Status status = builder_append
+            (ld->builder, content->key, strlen(content->key), content->eTag,
+             strlen(content->eTag), content->size, content->lastModified);
+        if (status != S3StatusOK) {
+            return status;
+        }
+    }
+
+    return S3StatusOK;
+}
+
+
+static void indexListCompleteCallback(S3Status status,
+                                      const S3ErrorDetails *errorDetails,
+                                      void *callbackData)
+{
+    (void) errorDetails;
+
+    ((IndexListData *) callbackData)->status = status;
+}
+
+
+static const S3ListBucketHandler indexListHandlerG =
+{
+    { 0, &indexListCompleteCallback },
+    &indexListCallback,
+    0,
+    0
+};
+
+
+// Appends every key under [prefix] after [startAfter] to [builder]
+static S3Status index_list(const S3BucketContext *bucketContext,
+                           const char *prefix, const char *startAfter,
+                           int timeoutMs, IndexBuilder *builder)
+{
+    IndexListData ld;
+
+    ld.builder = builder;
+    ld.nextMarker = 0;
+
+    do {
+        ld.isTruncated = 0;
+        ld.status = S3StatusOK;
+        S3_list_bucket_v2(bucketContext, prefix[0] ? prefix : 0,
+                          ld.nextMarker, ld.nextMarker ? 0 : startAfter, 0,
+                          0, 0, 0, timeoutMs, &indexListHandlerG, &ld);
+    } while ((ld.status == S3StatusOK) && ld.isTruncated && ld.nextMarker);
+
+    s3_free(ld.nextMarker);
+
+    return ld.status;
+}
+
+
+// Writes the records of [builder], which are sorted, as the new index file
+// and maps it
+static S3Status index_write(S3ListingIndex *index, IndexBuilder *builder)
+{
+    size_t pathLen = strlen(index->path);
+    char *tmpPath = (char *) s3_malloc(pathLen + sizeof(".tmp"));
+
+    if (!tmpPath) {
+        return S3StatusOutOfMemory;
+    }
+
+    memcpy(tmpPath, index->path, pathLen);
+    memcpy(&(tmpPath[pathLen]), ".tmp", sizeof(".tmp"));
+
+    IndexHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INDEX_MAGIC, INDEX_MAGIC_SIZE);
+    header.count = builder->count;
+    header.bucketNameLength = strlen(index->bucketName);
+    header.prefixLength = strlen(index->prefix);
+    header.recordsOffset = INDEX_ALIGN(INDEX_HEADER_SIZE +
+                                       header.bucketNameLength +
+                                       header.prefixLength + 2);
+    header.stringsOffset = header.recordsOffset +
+        (builder->count * sizeof(IndexRecord));
+    header.stringsSize = builder->stringsLen;
+
+    size_t size = header.stringsOffset + header.stringsSize;
+    S3Status status = S3StatusListingIndexIOError;
+    void *map = MAP_FAILED;
+
+    int fd = open(tmpPath, O_RDWR | O_CREAT | O_TRUNC, 0600);
+
+    if ((fd == -1) || (ftruncate(fd, size) == -1) ||
+        ((map = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) ==
+         MAP_FAILED)) {
+        goto done;
+    }
+
+    char *out = (char *) map;
+    memcpy(out, &header, sizeof(header));
+    memcpy(&(out[INDEX_HEADER_SIZE]), index->bucketName,
+           header.bucketNameLength + 1);
+    memcpy(&(out[INDEX_HEADER_SIZE + header.bucketNameLength + 1]),
+           index->prefix, header.prefixLength + 1);
+    memcpy(&(out[header.recordsOffset]), builder->records,
+           builder->count * sizeof(IndexRecord));
+    memcpy(&(out[header.stringsOffset]), builder->strings,
+           builder->stringsLen);
+
+    // The new file must be complete on disk before it replaces the old one
+    if ((msync(map, size, MS_SYNC) == -1) ||
+        (rename(tmpPath, index->path) == -1)) {
+        goto done;
+    }
+
+    status = index_map(index);
+
+ done:
+    if (map != MAP_FAILED) {
+        munmap(map, size);
+    }
+    if (fd != -1) {
+        close(fd);
+    }
+    if (status == S3StatusListingIndexIOError) {
+        unlink(tmpPath);
+    }
+    s3_free(tmpPath);
+
+    return status;
+}
+
+
+static int index_compare_prefixes(const void *a, const void *b)
+{
+    return strcmp(*((const char **) a), *((const char **) b));
+}
+
+
+// Lists the sorted, non-nested [prefixes], replacing the indexed keys under
+// each of them with those listed, into [builder]
+static S3Status index_relist(S3ListingIndex *index,
+                             const S3BucketContext *bucketContext,
+                             int prefixesCount, const char **prefixes,
+                             int timeoutMs, IndexBuilder *builder)
+{
+    uint64_t position = 0;
+    int i;
+
+    for (i = 0; i < prefixesCount; i++) {
+        uint64_t start = index_search(index, position, prefixes[i], 0);
+        uint64_t end = index_search(index, start, prefixes[i], 1);
+        S3Status status;
+        if (((status = builder_append_records
+              (builder, index->records, index->strings, position, start)) !=
+             S3StatusOK) ||
+            ((status = index_list(bucketContext, prefixes[i], 0, timeoutMs,
+                                  builder)) != S3StatusOK)) {
+            return status;
+        }
+        position = end;
+    }
+
+    return builder_append_records(builder, index->records, index->strings,
+                                  position, index->count);
+}
+
+
+// index --------------------------------------------------------------------
+
+S3Status S3_open_listing_index(const char *path, const char *bucketName,
+                               const char *prefix,
+                               S3ListingIndex **indexReturn)
+{
+    S3ListingIndex *index =
+        (S3ListingIndex *) s3_malloc(sizeof(S3ListingIndex));
+
+    if (!index) {
+        return S3StatusOutOfMemory;
+    }
+
+    memset(index, 0, sizeof(S3ListingIndex));
+
+    if (!(index->path = index_strdup(path)) ||
+        !(index->bucketName = index_strdup(bucketName)) ||
+        !(index->prefix = index_strdup(prefix ? prefix : ""))) {
+        S3_close_listing_index(index);
+        return S3StatusOutOfMemory;
+    }
+
+    S3Status status = index_map(index);
+
+    if (status != S3StatusOK) {
+        S3_close_listing_index(index);
+        return status;
+    }
+
+    *indexReturn = index;
+
+    return S3StatusOK;
+}
+
+
+void S3_close_listing_index(S3ListingIndex *index)
+{
+    index_unmap(index);
+
+    s3_free(index->path);
+    s3_free(index->bucketName);
+    s3_free(index->prefix);
+    s3_free(index);
+}
+
+
+S3Status S3_refresh_listing_index(S3ListingIndex *index,
+                                  const S3BucketContext *bucketContext,
+                                  int appendOnly, int changedPrefixesCount,
+                                  const char **changedPrefixes,
+                                  int timeoutMs)
+{
+    if (strcmp(bucketContext->bucketName, index->bucketName)) {
+        return S3StatusListingIndexMismatch;
+    }
+
+    IndexBuilder builder;
+    memset(&builder, 0, sizeof(builder));
+
+    S3Status status;
+
+    if (appendOnly) {
+        // Keep everything, then list what follows the last key
+        const char *lastKey = index->count ?
+            index_key(index, index->count - 1) : 0;
+        if ((status = builder_append_records
+             (&builder, index->records, index->strings, 0, index->count)) ==
+            S3StatusOK) {
+            status = index_list(bucketContext, index->prefix, lastKey,
+                                timeoutMs, &builder);
+        }
+    }
+    else if (!changedPrefixesCount) {
+        status = index_list(bucketContext, index->prefix, 0, timeoutMs,
+                            &builder);
+    }
+    else {
+        size_t prefixLen = strlen(index->prefix);
+        const char **prefixes = (const char **)
+            s3_malloc(changedPrefixesCount * sizeof(const char *));
+        if (!prefixes) {
+            return S3StatusOutOfMemory;
+        }
+        memcpy(prefixes, changedPrefixes,
+               changedPrefixesCount * sizeof(const char *));
+        qsort(prefixes, changedPrefixesCount, sizeof(const char *),
+              &index_compare_prefixes);
+
+        // Drop prefixes under other prefixes, which sort just after them
+        int count = 0, i;
+        status = S3StatusOK;
+        for (i = 0; i < changedPrefixesCount; i++) {
+            if (strncmp(prefixes[i], index->prefix, prefixLen)) {
+                status = S3StatusListingIndexMismatch;
+                break;
+            }
+            if (!count || strncmp(prefixes[i], prefixes[count - 1],
+                                  strlen(prefixes[count - 1]))) {
+                prefixes[count++] = prefixes[i];
+            }
+        }
+
+        if (status == S3StatusOK) {
+            status = index_relist(index, bucketContext, count, prefixes,
+                                  timeoutMs, &builder);
+        }
+
+        s3_free(prefixes);
+    }
+
+    if (status == S3StatusOK) {
+        status = index_write(index, &builder);
+    }
+
+    builder_free(&builder);
+
+    return status;
+}
+
+
+uint64_t S3_listing_index_count(const S3ListingIndex *index)
+{
+    return index->count;
+}
+
+
+uint64_t S3_listing_index_search(const S3ListingIndex *index,
+                                 const char *key)
+{
+    return index_search(index, 0, key, 0);
+}
+
+
+int S3_listing_index_get(const S3ListingIndex *index, uint64_t position,
+                         S3ListBucketContent *contentReturn)
+{
+    if (position >= index->count) {
+        return 0;
+    }
+
+    const IndexRecord *record = &(index->records[position]);
+
+    contentReturn->key = &(index->strings[record->keyOffset]);
+    contentReturn->lastModified = record->lastModified;
+    contentReturn->eTag = &(index->strings[record->eTagOffset]);
+    contentReturn->size = record->size;
+    contentReturn->ownerId = 0;
+    contentReturn->ownerDisplayName = 0;
+
+    return 1;
+}
+
+
+int S3_listing_index_find(const S3ListingIndex *index, const char *key,
+                          S3ListBucketContent *contentReturn)
+{
+    uint64_t position = index_search(index, 0, key, 0);
+
+    if ((position == index->count) ||
+        strcmp(index_key(index, position), key)) {
+        return 0;
+    }
+
+    if (contentReturn) {
+        S3_listing_index_get(index, position, contentReturn);
+    }
+
+    return 1;
+}
+
+#endif
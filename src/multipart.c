@@ -70,7 +70,7 @@ static void InitialMultipartCompleteCallback
     }
 
     simplexml_deinitialize(&(mdata->simpleXml));
-    free(mdata);
+    s3_pool_free(mdata);
 }
 
 static void AbortMultipartUploadCompleteCallback
@@ -116,7 +116,7 @@ void S3_initiate_multipart(S3BucketContext *bucketContext, const char *key,
                           void *callbackData)
 {
     InitialMultipartData *mdata =
-        (InitialMultipartData *) malloc(sizeof(InitialMultipartData));
+        (InitialMultipartData *) s3_pool_malloc(sizeof(InitialMultipartData));
     simplexml_initialize(&(mdata->simpleXml), &initialMultipartXmlCallback,
                          mdata);
     string_buffer_initialize(mdata->upload_id);
@@ -126,6 +126,7 @@ void S3_initiate_multipart(S3BucketContext *bucketContext, const char *key,
     RequestParams params =
     {
         HttpRequestTypePOST,                          // httpRequestType
+        S3MetricsOperationCreateMultipartUpload,      // operation
         { bucketContext->hostName,                    // hostName
           bucketContext->bucketName,                  // bucketName
           bucketContext->protocol,                    // protocol
@@ -149,7 +150,9 @@ void S3_initiate_multipart(S3BucketContext *bucketContext, const char *key,
         InitialMultipartCallback,                     // fromS3Callback
         InitialMultipartCompleteCallback,             // completeCallback
         mdata,                                        // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
@@ -168,6 +171,7 @@ void S3_abort_multipart_upload(S3BucketContext *bucketContext, const char *key,
     RequestParams params =
     {
         HttpRequestTypeDELETE,                        // httpRequestType
+        S3MetricsOperationAbortMultipartUpload,       // operation
         { bucketContext->hostName,                    // hostName
      	  bucketContext->bucketName,                  // bucketName
           bucketContext->protocol,                    // protocol
@@ -191,7 +195,9 @@ void S3_abort_multipart_upload(S3BucketContext *bucketContext, const char *key,
         0,                                            // fromS3Callback
         AbortMultipartUploadCompleteCallback,         // completeCallback
         0,                                            // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
@@ -217,6 +223,7 @@ void S3_upload_part(S3BucketContext *bucketContext, const char *key,
     RequestParams params =
     {
         HttpRequestTypePUT,                           // httpRequestType
+        S3MetricsOperationUploadPart,                 // operation
         { bucketContext->hostName,                    // hostName
           bucketContext->bucketName,                  // bucketName
           bucketContext->protocol,                    // protocol
@@ -240,7 +247,9 @@ void S3_upload_part(S3BucketContext *bucketContext, const char *key,
         0,                                            // fromS3Callback
         handler->responseHandler.completeCallback,    // completeCallback
         callbackData,                                 // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     request_perform(&params, requestContext);
@@ -259,22 +268,73 @@ typedef struct CommitMultiPartData {
     //response parsed from
     string_buffer(location,128);
     string_buffer(etag,128);
+    // The full-object checksum given to S3, if any, and that of the object
+    // that S3 assembled, if it gave it
+    S3ChecksumAlgorithm checksumAlgorithm;
+    string_buffer(checksum, S3_MAX_CHECKSUM_SIZE);
+    string_buffer(resultChecksum, S3_MAX_CHECKSUM_SIZE);
 } CommitMultiPartData;
 
 
-static S3Status commitMultipartResponseXMLcallback(const char *elementPath,
+// Ids of the elements of a CompleteMultipartUploadResult, for
+// commitMultipartResponseXMLcallback
+enum
+{
+    CompleteMultipartUploadResult,
+    CompleteMultipartUploadResultLocation,
+    CompleteMultipartUploadResultETag,
+    CompleteMultipartUploadResultChecksumCRC32C,
+    CompleteMultipartUploadResultChecksumCRC64NVME
+};
+
+static const SimpleXmlPath commitMultipartPathsG[] =
+{
+    SIMPLEXML_PATH(CompleteMultipartUploadResult,
+                   "CompleteMultipartUploadResult"),
+    SIMPLEXML_PATH(CompleteMultipartUploadResultLocation,
+                   "CompleteMultipartUploadResult/Location"),
+    SIMPLEXML_PATH(CompleteMultipartUploadResultETag,
+                   "CompleteMultipartUploadResult/ETag"),
+    SIMPLEXML_PATH(CompleteMultipartUploadResultChecksumCRC32C,
+                   "CompleteMultipartUploadResult/ChecksumCRC32C"),
+    SIMPLEXML_PATH(CompleteMultipartUploadResultChecksumCRC64NVME,
+                   "CompleteMultipartUploadResult/ChecksumCRC64NVME")
+};
+
+
+static S3Status commitMultipartResponseXMLcallback(int elementId,
+                                                   const char *elementPath,
                                                    const char *data,
                                                    int dataLen,
                                                    void *callbackData)
 {
+    (void) elementPath;
+
     int fit;
     CommitMultiPartData *commit_data = (CommitMultiPartData *) callbackData;
     if (data) {
-        if (!strcmp(elementPath, "CompleteMultipartUploadResult/Location")) {
+        switch (elementId) {
+        case CompleteMultipartUploadResultLocation:
             string_buffer_append(commit_data->location, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath, "CompleteMultipartUploadResult/ETag")) {
+            break;
+        case CompleteMultipartUploadResultETag:
             string_buffer_append(commit_data->etag, data, dataLen, fit);
+            break;
+        case CompleteMultipartUploadResultChecksumCRC32C:
+            if (commit_data->checksumAlgorithm == S3ChecksumAlgorithmCRC32C) {
+                string_buffer_append(commit_data->resultChecksum, data,
+                                     dataLen, fit);
+            }
+            break;
+        case CompleteMultipartUploadResultChecksumCRC64NVME:
+            if (commit_data->checksumAlgorithm ==
+                S3ChecksumAlgorithmCRC64NVME) {
+                string_buffer_append(commit_data->resultChecksum, data,
+                                     dataLen, fit);
+            }
+            break;
+        default:
+            break;
         }
     }
     (void) fit;
@@ -308,6 +368,12 @@ static void commitMultipartCompleteCallback
      void *callbackData)
 {
     CommitMultiPartData *data = (CommitMultiPartData*) callbackData;
+    // The object S3 assembled must have the checksum it was given
+    if ((requestStatus == S3StatusOK) && data->checksumLen &&
+        data->resultChecksumLen &&
+        strcmp(data->checksum, data->resultChecksum)) {
+        requestStatus = S3StatusChecksumMismatch;
+    }
     if (data->handler->responseHandler.completeCallback) {
         (*(data->handler->responseHandler.completeCallback))
             (requestStatus, s3ErrorDetails, data->userdata);
@@ -317,7 +383,7 @@ static void commitMultipartCompleteCallback
                                               data->userdata);
     }
     simplexml_deinitialize(&(data->simplexml));
-    free(data);
+    s3_pool_free(data);
 }
 
 
@@ -342,21 +408,61 @@ void S3_complete_multipart_upload(S3BucketContext *bucketContext,
                                   int timeoutMs,
                                   void *callbackData)
 {
+    S3_complete_multipart_upload_checksum(bucketContext, key, handler,
+                                          upload_id, contentLength,
+                                          S3ChecksumAlgorithmNone, 0,
+                                          requestContext, timeoutMs,
+                                          callbackData);
+}
+
+
+void S3_complete_multipart_upload_checksum(S3BucketContext *bucketContext,
+                                           const char *key,
+                                           S3MultipartCommitHandler *handler,
+                                           const char *upload_id,
+                                           int contentLength,
+                                           S3ChecksumAlgorithm
+                                           checksumAlgorithm,
+                                           const char *checksum,
+                                           S3RequestContext *requestContext,
+                                           int timeoutMs,
+                                           void *callbackData)
+{
+    if (!checksumAlgorithm) {
+        checksum = 0;
+    }
+    else if (!checksum || (strlen(checksum) >= S3_MAX_CHECKSUM_SIZE)) {
+        (*(handler->responseHandler.completeCallback))
+            (S3StatusInternalError, 0, callbackData);
+        return;
+    }
+
     char queryParams[512];
     snprintf(queryParams, 512, "uploadId=%s", upload_id);
     CommitMultiPartData *data =
-        (CommitMultiPartData *) malloc(sizeof(CommitMultiPartData));
+        (CommitMultiPartData *) s3_pool_malloc(sizeof(CommitMultiPartData));
     data->userdata = callbackData;
     data->handler = handler;
     string_buffer_initialize(data->location);
     string_buffer_initialize(data->etag);
+    data->checksumAlgorithm = checksumAlgorithm;
+    string_buffer_initialize(data->checksum);
+    string_buffer_initialize(data->resultChecksum);
+    if (checksum) {
+        int fit;
+        string_buffer_append(data->checksum, checksum, strlen(checksum), fit);
+        (void) fit;
+    }
 
-    simplexml_initialize(&(data->simplexml),
-                         commitMultipartResponseXMLcallback, data);
+    simplexml_initialize_ids(&(data->simplexml), commitMultipartPathsG,
+                             sizeof(commitMultipartPathsG) /
+                             sizeof(commitMultipartPathsG[0]),
+                             commitMultipartResponseXMLcallback, data);
 
     RequestParams params =
     {
         HttpRequestTypePOST,                          // httpRequestType
+        S3MetricsOperationCompleteMultipartUpload,    // operation
         { bucketContext->hostName,                    // hostName
           bucketContext->bucketName,                  // bucketName
           bucketContext->protocol,                    // protocol
@@ -380,7 +486,9 @@ void S3_complete_multipart_upload(S3BucketContext *bucketContext,
         commitMultipartCallback,                      // fromS3Callback
         commitMultipartCompleteCallback,              // completeCallback
         data,                                         // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        checksumAlgorithm,                            // checksumAlgorithm
+        checksum                                      // checksum
     };
 
     request_perform(&params, requestContext);
@@ -503,6 +611,9 @@ static S3Status listMultipartPropertiesCallback
 {
     ListMultipartData *lmData = (ListMultipartData *) callbackData;
 
+    if (!lmData->responsePropertiesCallback) {
+        return S3StatusOK;
+    }
     return (*(lmData->responsePropertiesCallback))
         (responseProperties, lmData->callbackData);
 }
@@ -513,6 +624,9 @@ static S3Status listPartsPropertiesCallback
 {
     ListPartsData *lpData = (ListPartsData *) callbackData;
 
+    if (!lpData->responsePropertiesCallback) {
+        return S3StatusOK;
+    }
     return (*(lpData->responsePropertiesCallback))
         (responseProperties, lpData->callbackData);
 }
@@ -621,7 +735,7 @@ static void listMultipartCompleteCallback(S3Status requestStatus,
 
     simplexml_deinitialize(&(lmData->simpleXml));
 
-    free(lmData);
+    s3_pool_free(lmData);
 }
 
 
@@ -641,85 +755,123 @@ static void listPartsCompleteCallback(S3Status requestStatus,
 
     simplexml_deinitialize(&(lpData->simpleXml));
 
-    free(lpData);
+    s3_pool_free(lpData);
 }
 
 
-static S3Status listMultipartXmlCallback(const char *elementPath,
+// Ids of the elements of a ListMultipartUploadsResult, for
+// listMultipartXmlCallback
+enum
+{
+    ListMultipartUploadsResult,
+    ListMultipartUploadsResultIsTruncated,
+    ListMultipartUploadsResultNextKeyMarker,
+    ListMultipartUploadsResultNextUploadIdMarker,
+    ListMultipartUploadsResultUpload,
+    ListMultipartUploadsResultUploadKey,
+    ListMultipartUploadsResultUploadInitiated,
+    ListMultipartUploadsResultUploadUploadId,
+    ListMultipartUploadsResultUploadInitiator,
+    ListMultipartUploadsResultUploadInitiatorID,
+    ListMultipartUploadsResultUploadInitiatorDisplayName,
+    ListMultipartUploadsResultUploadOwner,
+    ListMultipartUploadsResultUploadOwnerID,
+    ListMultipartUploadsResultUploadOwnerDisplayName,
+    ListMultipartUploadsResultUploadStorageClass,
+    ListMultipartUploadsResultCommonPrefixes,
+    ListMultipartUploadsResultCommonPrefixesPrefix
+};
+
+static const SimpleXmlPath listMultipartPathsG[] =
+{
+    SIMPLEXML_PATH(ListMultipartUploadsResult, "ListMultipartUploadsResult"),
+    SIMPLEXML_PATH(ListMultipartUploadsResultIsTruncated,
+                   "ListMultipartUploadsResult/IsTruncated"),
+    SIMPLEXML_PATH(ListMultipartUploadsResultNextKeyMarker,
+                   "ListMultipartUploadsResult/NextKeyMarker"),
+    SIMPLEXML_PATH(ListMultipartUploadsResultNextUploadIdMarker,
+                   "ListMultipartUploadsResult/NextUploadIdMarker"),
+    SIMPLEXML_PATH(ListMultipartUploadsResultUpload,
+                   "ListMultipartUploadsResult/Upload"),
+    SIMPLEXML_PATH(ListMultipartUploadsResultUploadKey,
+                   "ListMultipartUploadsResult/Upload/Key"),
+    SIMPLEXML_PATH(ListMultipartUploadsResultUploadInitiated,
+                   "ListMultipartUploadsResult/Upload/Initiated"),
+    SIMPLEXML_PATH(ListMultipartUploadsResultUploadUploadId,
+                   "ListMultipartUploadsResult/Upload/UploadId"),
+    SIMPLEXML_PATH(ListMultipartUploadsResultUploadInitiator,
+                   "ListMultipartUploadsResult/Upload/Initiator"),
+    SIMPLEXML_PATH(ListMultipartUploadsResultUploadInitiatorID,
+                   "ListMultipartUploadsResult/Upload/Initiator/ID"),
+    SIMPLEXML_PATH(ListMultipartUploadsResultUploadInitiatorDisplayName,
+                   "ListMultipartUploadsResult/Upload/Initiator/DisplayName"),
+    SIMPLEXML_PATH(ListMultipartUploadsResultUploadOwner,
+                   "ListMultipartUploadsResult/Upload/Owner"),
+    SIMPLEXML_PATH(ListMultipartUploadsResultUploadOwnerID,
+                   "ListMultipartUploadsResult/Upload/Owner/ID"),
+    SIMPLEXML_PATH(ListMultipartUploadsResultUploadOwnerDisplayName,
+                   "ListMultipartUploadsResult/Upload/Owner/DisplayName"),
+    SIMPLEXML_PATH(ListMultipartUploadsResultUploadStorageClass,
+                   "ListMultipartUploadsResult/Upload/StorageClass"),
+    SIMPLEXML_PATH(ListMultipartUploadsResultCommonPrefixes,
+                   "ListMultipartUploadsResult/CommonPrefixes"),
+    SIMPLEXML_PATH(ListMultipartUploadsResultCommonPrefixesPrefix,
+                   "ListMultipartUploadsResult/CommonPrefixes/Prefix")
+};
+
+
+static S3Status listMultipartXmlCallback(int elementId,
+                                         const char *elementPath,
                                          const char *data, int dataLen,
                                          void *callbackData)
 {
+    (void) elementPath;
+
     ListMultipartData *lmData = (ListMultipartData *) callbackData;
 
+    ListMultipartUpload *uploads = &(lmData->uploads[lmData->uploadsCount]);
+
     int fit;
 
     if (data) {
-        if (!strcmp(elementPath, "ListMultipartUploadsResult/IsTruncated")) {
+        switch (elementId) {
+        case ListMultipartUploadsResultIsTruncated:
             string_buffer_append(lmData->isTruncated, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath,
-                         "ListMultipartUploadsResult/NextKeyMarker")) {
+            break;
+        case ListMultipartUploadsResultNextKeyMarker:
             string_buffer_append(lmData->nextKeyMarker, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath,
-                         "ListMultipartUploadsResult/NextUploadIdMarker")) {
+            break;
+        case ListMultipartUploadsResultNextUploadIdMarker:
             string_buffer_append(lmData->nextUploadIdMarker, data, dataLen,
                                  fit);
-        }
-        else if (!strcmp(elementPath,
-                         "ListMultipartUploadsResult/Upload/Key")) {
-            ListMultipartUpload *uploads =
-                &(lmData->uploads[lmData->uploadsCount]);
+            break;
+        case ListMultipartUploadsResultUploadKey:
             string_buffer_append(uploads->key, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath,
-                         "ListMultipartUploadsResult/Upload/Initiated")) {
-            ListMultipartUpload *uploads =
-                &(lmData->uploads[lmData->uploadsCount]);
+            break;
+        case ListMultipartUploadsResultUploadInitiated:
             string_buffer_append(uploads->initiated, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath,
-                         "ListMultipartUploadsResult/Upload/UploadId")) {
-            ListMultipartUpload *uploads =
-                &(lmData->uploads[lmData->uploadsCount]);
+            break;
+        case ListMultipartUploadsResultUploadUploadId:
             string_buffer_append(uploads->uploadId, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath,
-                         "ListMultipartUploadsResult/Upload/Initiator/ID")) {
-            ListMultipartUpload *uploads =
-                &(lmData->uploads[lmData->uploadsCount]);
+            break;
+        case ListMultipartUploadsResultUploadInitiatorID:
             string_buffer_append(uploads->initiatorId, data, dataLen, fit);
-        }
-        else if (!strcmp
-                 (elementPath,
-                  "ListMultipartUploadsResult/Upload/Initiator/DisplayName")) {
-            ListMultipartUpload *uploads =
-                &(lmData->uploads[lmData->uploadsCount]);
+            break;
+        case ListMultipartUploadsResultUploadInitiatorDisplayName:
             string_buffer_append(uploads->initiatorDisplayName, data, dataLen,
                                  fit);
-        }
-        else if (!strcmp(elementPath,
-                         "ListMultipartUploadsResult/Upload/Owner/ID")) {
-            ListMultipartUpload *uploads =
-                &(lmData->uploads[lmData->uploadsCount]);
+            break;
+        case ListMultipartUploadsResultUploadOwnerID:
             string_buffer_append(uploads->ownerId, data, dataLen, fit);
-        }
-        else if (!strcmp
-                 (elementPath,
-                  "ListMultipartUploadsResult/Upload/Owner/DisplayName")) {
-            ListMultipartUpload *uploads =
-                &(lmData->uploads[lmData->uploadsCount]);
+            break;
+        case ListMultipartUploadsResultUploadOwnerDisplayName:
             string_buffer_append
                 (uploads->ownerDisplayName, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath,
-                         "ListMultipartUploadsResult/Upload/StorageClass")) {
-            ListMultipartUpload *uploads =
-                &(lmData->uploads[lmData->uploadsCount]);
+            break;
+        case ListMultipartUploadsResultUploadStorageClass:
             string_buffer_append(uploads->storageClass, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath,
-                         "ListMultipartUploadsResult/CommonPrefixes/Prefix")) {
+            break;
+        case ListMultipartUploadsResultCommonPrefixesPrefix: {
             int which = lmData->commonPrefixesCount;
             lmData->commonPrefixLens[which] +=
                 snprintf(lmData->commonPrefixes[which],
@@ -730,43 +882,42 @@ static S3Status listMultipartXmlCallback(const char *elementPath,
                 (int) sizeof(lmData->commonPrefixes[which])) {
                 return S3StatusXmlParseFailure;
             }
+            break;
+        }
         }
     }
-    else {
-        if (!strcmp(elementPath, "ListMultipartUploadsResult/Upload")) {
-            // Finished a Contents
-            lmData->uploadsCount++;
-            if (lmData->uploadsCount == MAX_UPLOADS) {
-                // Make the callback
-                S3Status status = make_list_multipart_callback(lmData);
-                if (status != S3StatusOK) {
-                    return status;
-                }
-                initialize_list_multipart_data(lmData);
-            }
-            else {
-                // Initialize the next one
-                initialize_list_multipart_upload
-                    (&(lmData->uploads[lmData->uploadsCount]));
+    else if (elementId == ListMultipartUploadsResultUpload) {
+        // Finished a Contents
+        lmData->uploadsCount++;
+        if (lmData->uploadsCount == MAX_UPLOADS) {
+            // Make the callback
+            S3Status status = make_list_multipart_callback(lmData);
+            if (status != S3StatusOK) {
+                return status;
             }
+            initialize_list_multipart_data(lmData);
         }
-        else if (!strcmp(elementPath,
-                         "ListMultipartUploadsResult/CommonPrefixes/Prefix")) {
-            // Finished a Prefix
-            lmData->commonPrefixesCount++;
-            if (lmData->commonPrefixesCount == MAX_COMMON_PREFIXES) {
-                // Make the callback
-                S3Status status = make_list_multipart_callback(lmData);
-                if (status != S3StatusOK) {
-                    return status;
-                }
-                initialize_list_multipart_data(lmData);
-            }
-            else {
-                // Initialize the next one
-                lmData->commonPrefixes[lmData->commonPrefixesCount][0] = 0;
-                lmData->commonPrefixLens[lmData->commonPrefixesCount] = 0;
+        else {
+            // Initialize the next one
+            initialize_list_multipart_upload
+                (&(lmData->uploads[lmData->uploadsCount]));
+        }
+    }
+    else if (elementId == ListMultipartUploadsResultCommonPrefixesPrefix) {
+        // Finished a Prefix
+        lmData->commonPrefixesCount++;
+        if (lmData->commonPrefixesCount == MAX_COMMON_PREFIXES) {
+            // Make the callback
+            S3Status status = make_list_multipart_callback(lmData);
+            if (status != S3StatusOK) {
+                return status;
             }
+            initialize_list_multipart_data(lmData);
+        }
+        else {
+            // Initialize the next one
+            lmData->commonPrefixes[lmData->commonPrefixesCount][0] = 0;
+            lmData->commonPrefixLens[lmData->commonPrefixesCount] = 0;
         }
     }
 
@@ -777,72 +928,118 @@ static S3Status listMultipartXmlCallback(const char *elementPath,
 }
 
 
-static S3Status listPartsXmlCallback(const char *elementPath,
-                                      const char *data, int dataLen,
-                                      void *callbackData)
+// Ids of the elements of a ListPartsResult, for listPartsXmlCallback
+enum
+{
+    ListPartsResult,
+    ListPartsResultIsTruncated,
+    ListPartsResultNextPartNumberMarker,
+    ListPartsResultStorageClass,
+    ListPartsResultInitiator,
+    ListPartsResultInitiatorID,
+    ListPartsResultInitiatorDisplayName,
+    ListPartsResultOwner,
+    ListPartsResultOwnerID,
+    ListPartsResultOwnerDisplayName,
+    ListPartsResultPart,
+    ListPartsResultPartPartNumber,
+    ListPartsResultPartLastModified,
+    ListPartsResultPartETag,
+    ListPartsResultPartSize
+};
+
+static const SimpleXmlPath listPartsPathsG[] =
+{
+    SIMPLEXML_PATH(ListPartsResult, "ListPartsResult"),
+    SIMPLEXML_PATH(ListPartsResultIsTruncated, "ListPartsResult/IsTruncated"),
+    SIMPLEXML_PATH(ListPartsResultNextPartNumberMarker,
+                   "ListPartsResult/NextPartNumberMarker"),
+    SIMPLEXML_PATH(ListPartsResultStorageClass,
+                   "ListPartsResult/StorageClass"),
+    SIMPLEXML_PATH(ListPartsResultInitiator, "ListPartsResult/Initiator"),
+    SIMPLEXML_PATH(ListPartsResultInitiatorID, "ListPartsResult/Initiator/ID"),
+    SIMPLEXML_PATH(ListPartsResultInitiatorDisplayName,
+                   "ListPartsResult/Initiator/DisplayName"),
+    SIMPLEXML_PATH(ListPartsResultOwner, "ListPartsResult/Owner"),
+    SIMPLEXML_PATH(ListPartsResultOwnerID, "ListPartsResult/Owner/ID"),
+    SIMPLEXML_PATH(ListPartsResultOwnerDisplayName,
+                   "ListPartsResult/Owner/DisplayName"),
+    SIMPLEXML_PATH(ListPartsResultPart, "ListPartsResult/Part"),
+    SIMPLEXML_PATH(ListPartsResultPartPartNumber,
+                   "ListPartsResult/Part/PartNumber"),
+    SIMPLEXML_PATH(ListPartsResultPartLastModified,
+                   "ListPartsResult/Part/LastModified"),
+    SIMPLEXML_PATH(ListPartsResultPartETag, "ListPartsResult/Part/ETag"),
+    SIMPLEXML_PATH(ListPartsResultPartSize, "ListPartsResult/Part/Size")
+};
+
+
+static S3Status listPartsXmlCallback(int elementId, const char *elementPath,
+                                     const char *data, int dataLen,
+                                     void *callbackData)
 {
+    (void) elementPath;
+
     ListPartsData *lpData = (ListPartsData *) callbackData;
+
+    ListPart *parts = &(lpData->parts[lpData->partsCount]);
+
     int fit;
+
     if (data) {
-        if (!strcmp(elementPath, "ListPartsResult/IsTruncated")) {
+        switch (elementId) {
+        case ListPartsResultIsTruncated:
             string_buffer_append(lpData->isTruncated, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath,
-                         "ListPartsResult/NextPartNumberMarker")) {
+            break;
+        case ListPartsResultNextPartNumberMarker:
             string_buffer_append(lpData->nextPartNumberMarker, data, dataLen,
                                  fit);
-        }
-        else if (!strcmp(elementPath, "ListPartsResult/StorageClass")) {
+            break;
+        case ListPartsResultStorageClass:
             string_buffer_append(lpData->storageClass, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath, "ListPartsResult/Initiator/ID")) {
+            break;
+        case ListPartsResultInitiatorID:
             string_buffer_append(lpData->initiatorId, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath,
-                         "ListPartsResult/Initiator/DisplayName")) {
+            break;
+        case ListPartsResultInitiatorDisplayName:
             string_buffer_append(lpData->initiatorDisplayName, data, dataLen,
                                  fit);
-        }
-        else if (!strcmp(elementPath, "ListPartsResult/Owner/ID")) {
+            break;
+        case ListPartsResultOwnerID:
             string_buffer_append(lpData->ownerId, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath, "ListPartsResult/Owner/DisplayName")) {
+            break;
+        case ListPartsResultOwnerDisplayName:
             string_buffer_append(lpData->ownerDisplayName, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath, "ListPartsResult/Part/PartNumber")) {
-            ListPart *parts = &(lpData->parts[lpData->partsCount]);
+            break;
+        case ListPartsResultPartPartNumber:
             string_buffer_append(parts->partNumber, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath, "ListPartsResult/Part/LastModified")) {
-            ListPart *parts = &(lpData->parts[lpData->partsCount]);
+            break;
+        case ListPartsResultPartLastModified:
             string_buffer_append(parts->lastModified, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath, "ListPartsResult/Part/ETag")) {
-            ListPart *parts = &(lpData->parts[lpData->partsCount]);
+            break;
+        case ListPartsResultPartETag:
             string_buffer_append(parts->eTag, data, dataLen, fit);
-        }
-        else if (!strcmp(elementPath, "ListPartsResult/Part/Size")) {
-            ListPart *parts = &(lpData->parts[lpData->partsCount]);
+            break;
+        case ListPartsResultPartSize:
             string_buffer_append(parts->size, data, dataLen, fit);
+            break;
         }
     }
-    else {
-        if (!strcmp(elementPath, "ListPartsResult/Part")) {
-            // Finished a Contents
-            lpData->partsCount++;
-            if (lpData->partsCount == MAX_PARTS) {
-                // Make the callback
-                S3Status status = make_list_parts_callback(lpData);
-                if (status != S3StatusOK) {
-                    return status;
-                }
-                lpData->handlePartsStart += lpData->partsCount;
-                initialize_list_parts_data(lpData);
-            }
-            else {
-                // Initialize the next one
-                initialize_list_part(&(lpData->parts[lpData->partsCount]));
+    else if (elementId == ListPartsResultPart) {
+        // Finished a Contents
+        lpData->partsCount++;
+        if (lpData->partsCount == MAX_PARTS) {
+            // Make the callback
+            S3Status status = make_list_parts_callback(lpData);
+            if (status != S3StatusOK) {
+                return status;
             }
+            lpData->handlePartsStart += lpData->partsCount;
+            initialize_list_parts_data(lpData);
+        }
+        else {
+            // Initialize the next one
+            initialize_list_part(&(lpData->parts[lpData->partsCount]));
         }
     }
 
@@ -925,7 +1122,7 @@ void S3_list_multipart_uploads(S3BucketContext *bucketContext,
         }
 
         ListMultipartData *lmData =
-            (ListMultipartData *) malloc(sizeof(ListMultipartData));
+            (ListMultipartData *) s3_pool_malloc(sizeof(ListMultipartData));
 
         if (!lmData) {
             (*(handler->responseHandler.completeCallback))
@@ -933,8 +1130,10 @@ void S3_list_multipart_uploads(S3BucketContext *bucketContext,
             return;
         }
 
-        simplexml_initialize(&(lmData->simpleXml), &listMultipartXmlCallback,
-                             lmData);
+        simplexml_initialize_ids(&(lmData->simpleXml), listMultipartPathsG,
+                                 sizeof(listMultipartPathsG) /
+                                 sizeof(listMultipartPathsG[0]),
+                                 &listMultipartXmlCallback, lmData);
 
         lmData->responsePropertiesCallback =
             handler->responseHandler.propertiesCallback;
@@ -952,6 +1151,7 @@ void S3_list_multipart_uploads(S3BucketContext *bucketContext,
         RequestParams params =
         {
             HttpRequestTypeGET,                      // httpRequestType
+            S3MetricsOperationListMultipartUploads,  // operation
             { bucketContext->hostName,               // hostName
               bucketContext->bucketName,             // bucketName
               bucketContext->protocol,               // protocol
@@ -969,13 +1169,16 @@ void S3_list_multipart_uploads(S3BucketContext *bucketContext,
             0,                                       // startByte
             0,                                       // byteCount
             0,                                       // putProperties
-            &listMultipartPropertiesCallback,        // propertiesCallback
+            handler->responseHandler.propertiesCallback ?
+            &listMultipartPropertiesCallback : 0,    // propertiesCallback
             0,                                       // toS3Callback
             0,                                       // toS3CallbackTotalSize
             &listMultipartDataCallback,              // fromS3Callback
             &listMultipartCompleteCallback,          // completeCallback
             lmData,                                  // callbackData
-            timeoutMs                                // timeoutMs
+            timeoutMs,                               // timeoutMs
+            S3ChecksumAlgorithmNone,                 // checksumAlgorithm
+            0                                        // checksum
         };
 
         // Perform the request
@@ -1045,7 +1248,7 @@ void S3_list_parts(S3BucketContext *bucketContext, const char *key,
         }
 
         ListPartsData *lpData =
-            (ListPartsData *) malloc(sizeof(ListPartsData));
+            (ListPartsData *) s3_pool_malloc(sizeof(ListPartsData));
 
         if (!lpData) {
             (*(handler->responseHandler.completeCallback))
@@ -1053,8 +1256,10 @@ void S3_list_parts(S3BucketContext *bucketContext, const char *key,
             return;
         }
 
-        simplexml_initialize(&(lpData->simpleXml), &listPartsXmlCallback,
-                             lpData);
+        simplexml_initialize_ids(&(lpData->simpleXml), listPartsPathsG,
+                                 sizeof(listPartsPathsG) /
+                                 sizeof(listPartsPathsG[0]),
+                                 &listPartsXmlCallback, lpData);
 
         lpData->responsePropertiesCallback =
             handler->responseHandler.propertiesCallback;
@@ -1076,6 +1281,7 @@ void S3_list_parts(S3BucketContext *bucketContext, const char *key,
         RequestParams params =
         {
             HttpRequestTypeGET,                      // httpRequestType
+            S3MetricsOperationListParts,             // operation
             { bucketContext->hostName,               // hostName
               bucketContext->bucketName,             // bucketName
               bucketContext->protocol,               // protocol
@@ -1093,13 +1299,16 @@ void S3_list_parts(S3BucketContext *bucketContext, const char *key,
             0,                                       // startByte
             0,                                       // byteCount
             0,                                       // putProperties
-            &listPartsPropertiesCallback,            // propertiesCallback
+            handler->responseHandler.propertiesCallback ?
+            &listPartsPropertiesCallback : 0,        // propertiesCallback
             0,                                       // toS3Callback
             0,                                       // toS3CallbackTotalSize
             &listPartsDataCallback,                  // fromS3Callback
             &listPartsCompleteCallback,              // completeCallback
             lpData,                                  // callbackData
-            timeoutMs                                // timeoutMs
+            timeoutMs,                               // timeoutMs
+            S3ChecksumAlgorithmNone,                 // checksumAlgorithm
+            0                                        // checksum
         };
 
         // Perform the request
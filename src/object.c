@@ -49,6 +49,7 @@ void S3_put_object(const S3BucketContext *bucketContext, const char *key,
     RequestParams params =
     {
         HttpRequestTypePUT,                           // httpRequestType
+        S3MetricsOperationPutObject,                  // operation
         { bucketContext->hostName,                    // hostName
           bucketContext->bucketName,                  // bucketName
           bucketContext->protocol,                    // protocol
@@ -72,7 +73,9 @@ void S3_put_object(const S3BucketContext *bucketContext, const char *key,
         0,                                            // fromS3Callback
         handler->responseHandler.completeCallback,    // completeCallback
         callbackData,                                 // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
@@ -172,7 +175,7 @@ static void copyObjectCompleteCallback(S3Status requestStatus,
 
     simplexml_deinitialize(&(coData->simpleXml));
 
-    free(coData);
+    s3_pool_free(coData);
 }
 
 
@@ -210,7 +213,7 @@ void S3_copy_object_range(const S3BucketContext *bucketContext, const char *key,
 {
     // Create the callback data
     CopyObjectData *data =
-        (CopyObjectData *) malloc(sizeof(CopyObjectData));
+        (CopyObjectData *) s3_pool_malloc(sizeof(CopyObjectData));
     if (!data) {
         (*(handler->completeCallback))(S3StatusOutOfMemory, 0, callbackData);
         return;
@@ -243,6 +246,8 @@ void S3_copy_object_range(const S3BucketContext *bucketContext, const char *key,
     RequestParams params =
     {
         HttpRequestTypeCOPY,                          // httpRequestType
+        (partNo > 0) ? S3MetricsOperationUploadPartCopy :
+          S3MetricsOperationCopyObject,               // operation
         { bucketContext->hostName,                    // hostName
           destinationBucket ? destinationBucket :
           bucketContext->bucketName,                  // bucketName
@@ -267,7 +272,9 @@ void S3_copy_object_range(const S3BucketContext *bucketContext, const char *key,
         &copyObjectDataCallback,                      // fromS3Callback
         &copyObjectCompleteCallback,                  // completeCallback
         data,                                         // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
@@ -288,6 +295,7 @@ void S3_get_object(const S3BucketContext *bucketContext, const char *key,
     RequestParams params =
     {
         HttpRequestTypeGET,                           // httpRequestType
+        S3MetricsOperationGetObject,                  // operation
         { bucketContext->hostName,                    // hostName
           bucketContext->bucketName,                  // bucketName
           bucketContext->protocol,                    // protocol
@@ -311,7 +319,9 @@ void S3_get_object(const S3BucketContext *bucketContext, const char *key,
         handler->getObjectDataCallback,               // fromS3Callback
         handler->responseHandler.completeCallback,    // completeCallback
         callbackData,                                 // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
@@ -330,6 +340,7 @@ void S3_head_object(const S3BucketContext *bucketContext, const char *key,
     RequestParams params =
     {
         HttpRequestTypeHEAD,                          // httpRequestType
+        S3MetricsOperationHeadObject,                 // operation
         { bucketContext->hostName,                    // hostName
           bucketContext->bucketName,                  // bucketName
           bucketContext->protocol,                    // protocol
@@ -353,7 +364,9 @@ void S3_head_object(const S3BucketContext *bucketContext, const char *key,
         0,                                            // fromS3Callback
         handler->completeCallback,                    // completeCallback
         callbackData,                                 // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
@@ -372,6 +385,7 @@ void S3_delete_object(const S3BucketContext *bucketContext, const char *key,
     RequestParams params =
     {
         HttpRequestTypeDELETE,                        // httpRequestType
+        S3MetricsOperationDeleteObject,               // operation
         { bucketContext->hostName,                    // hostName
           bucketContext->bucketName,                  // bucketName
           bucketContext->protocol,                    // protocol
@@ -395,7 +409,9 @@ void S3_delete_object(const S3BucketContext *bucketContext, const char *key,
         0,                                            // fromS3Callback
         handler->completeCallback,                    // completeCallback
         callbackData,                                 // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
@@ -0,0 +1,1353 @@
+/** **************************************************************************
+ * parallel_list.c
+ *
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#include <stdlib.h>
+#include <string.h>
+#include "libs3.h"
+#include "request.h"
+#include "request_context.h"
+
+
+// The contents and common prefixes of a page are copied into blocks of this
+// size as they arrive
+#define PAGE_ARENA_BLOCK_SIZE (64 * 1024)
+
+typedef struct PageArenaBlock
+{
+    struct PageArenaBlock *next;
+    int used, size;
+    char data[];
+} PageArenaBlock;
+
+
+struct ParallelListData;
+struct ListTask;
+
+
+// One page of the listing of one prefix.  In key order mode, its contents
+// are delivered in runs that interleave with the output of the prefixes
+// listed alongside them, so a page lives until its last run is delivered.
+typedef struct ListPage
+{
+    struct ListTask *task;
+
+    PageArenaBlock *blocks;
+
+    int contentsCount, contentsSize;
+    S3ListBucketContent *contents;
+
+    int commonPrefixesCount, commonPrefixesSize;
+    const char **commonPrefixes;
+
+    int isTruncated;
+    string_buffer(nextMarker, S3_MAX_KEY_SIZE);
+
+    // Number of undelivered runs of contents referring to the page
+    int refs;
+} ListPage;
+
+
+// In key order mode, the output of a task is a sequence of these, each
+// either a run of contents from a page or a task listing a common prefix
+typedef struct ListSegment
+{
+    struct ListSegment *next;
+    struct ListTask *child;
+    ListPage *page;
+    int start, count;
+} ListSegment;
+
+
+// The listing of one prefix, which is paged through one request at a time
+typedef struct ListTask
+{
+    char *prefix;
+    int depth;
+
+    // Where the next page starts; NULL for the first page
+    char *marker;
+
+    // Set once the last page of the task has been received
+    int complete;
+
+    // In key order mode, output not yet delivered
+    ListSegment *first, *last;
+} ListTask;
+
+
+typedef struct ParallelListData
+{
+    const S3BucketContext *bucketContext;
+    const char *delimiter;
+    int maxDepth;
+    int maxInFlight;
+    int ordered;
+    S3RequestContext *requestContext;
+    int timeoutMs;
+    S3ParallelListCallback *callback;
+    void *callbackData;
+
+    // In key order mode, the task for the whole listing
+    ListTask *root;
+
+    // Tasks waiting to have a page requested, as a binary heap ordered by
+    // where their next page starts, so that in key order mode the output
+    // which is needed first is fetched first
+    ListTask **pending;
+    int pendingCount, pendingSize;
+
+    // Number of list requests in flight
+    int inFlight;
+
+    // Set by the first failure, which stops the whole listing
+    S3Status status;
+} ParallelListData;
+
+
+static void parallel_stop(ParallelListData *pl, S3Status status)
+{
+    if ((status != S3StatusOK) && (pl->status == S3StatusOK)) {
+        pl->status = status;
+    }
+}
+
+
+static char *parallel_strdup(const char *str)
+{
+    int len = strlen(str) + 1;
+    char *ret = (char *) s3_malloc(len);
+    if (ret) {
+        memcpy(ret, str, len);
+    }
+    return ret;
+}
+
+
+// pages ---------------------------------------------------------------------
+
+static void *page_alloc(ListPage *page, int size)
+{
+    // Keep everything pointer-aligned
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+
+    PageArenaBlock *block = page->blocks;
+
+    if (!block || ((block->used + size) > block->size)) {
+        int blockSize = (size > PAGE_ARENA_BLOCK_SIZE) ?
+            size : PAGE_ARENA_BLOCK_SIZE;
+        block = (PageArenaBlock *)
+            s3_malloc(sizeof(PageArenaBlock) + blockSize);
+        if (!block) {
+            return 0;
+        }
+        block->next = page->blocks;
+        block->used = 0;
+        block->size = blockSize;
+        page->blocks = block;
+    }
+
+    void *ret = &(block->data[block->used]);
+    block->used += size;
+    return ret;
+}
+
+
+// Copies [str] into the page, returning NULL for NULL and setting [*oom] if
+// memory runs out
+static const char *page_strdup(ListPage *page, const char *str, int *oom)
+{
+    if (!str) {
+        return 0;
+    }
+
+    int len = strlen(str) + 1;
+    char *ret = (char *) page_alloc(page, len);
+    if (!ret) {
+        *oom = 1;
+        return 0;
+    }
+    memcpy(ret, str, len);
+    return ret;
+}
+
+
+// Grows the array at [*array] of [*size] elements of [elementSize] bytes so
+// that it can hold [needed]
+static int page_grow(void **array, int *size, int needed, int elementSize)
+{
+    if (needed <= *size) {
+        return 1;
+    }
+
+    int newSize = *size ? *size : 256;
+    while (newSize < needed) {
+        newSize *= 2;
+    }
+    void *newArray = s3_realloc(*array, newSize * elementSize);
+    if (!newArray) {
+        return 0;
+    }
+    *array = newArray;
+    *size = newSize;
+    return 1;
+}
+
+
+static ListPage *page_create(void)
+{
+    ListPage *page = (ListPage *) s3_malloc(sizeof(ListPage));
+    if (!page) {
+        return 0;
+    }
+
+    page->task = 0;
+    page->blocks = 0;
+    page->contentsCount = page->contentsSize = 0;
+    page->contents = 0;
+    page->commonPrefixesCount = page->commonPrefixesSize = 0;
+    page->commonPrefixes = 0;
+    page->isTruncated = 0;
+    string_buffer_initialize(page->nextMarker);
+    page->refs = 0;
+
+    return page;
+}
+
+
+static void page_free(ListPage *page)
+{
+    while (page->blocks) {
+        PageArenaBlock *next = page->blocks->next;
+        s3_free(page->blocks);
+        page->blocks = next;
+    }
+    s3_free(page->contents);
+    s3_free(page->commonPrefixes);
+    s3_free(page);
+}
+
+
+static void page_release(ListPage *page)
+{
+    if (!--page->refs) {
+        page_free(page);
+    }
+}
+
+
+// tasks ---------------------------------------------------------------------
+
+static ListTask *task_create(const char *prefix, int depth)
+{
+    ListTask *task = (ListTask *) s3_malloc(sizeof(ListTask));
+    if (!task) {
+        return 0;
+    }
+
+    task->prefix = parallel_strdup(prefix);
+    if (!task->prefix) {
+        s3_free(task);
+        return 0;
+    }
+    task->depth = depth;
+    task->marker = 0;
+    task->complete = 0;
+    task->first = task->last = 0;
+
+    return task;
+}
+
+
+// Frees a task along with its undelivered output and, in key order mode,
+// the tasks listing the prefixes within it
+static void task_free(ListTask *task)
+{
+    while (task->first) {
+        ListSegment *segment = task->first;
+        task->first = segment->next;
+        if (segment->child) {
+            task_free(segment->child);
+        }
+        else {
+            page_release(segment->page);
+        }
+        s3_free(segment);
+    }
+    s3_free(task->prefix);
+    s3_free(task->marker);
+    s3_free(task);
+}
+
+
+static S3Status task_append(ListTask *task, ListTask *child, ListPage *page,
+                            int start, int count)
+{
+    ListSegment *segment = (ListSegment *) s3_malloc(sizeof(ListSegment));
+    if (!segment) {
+        return S3StatusOutOfMemory;
+    }
+
+    segment->next = 0;
+    segment->child = child;
+    segment->page = page;
+    segment->start = start;
+    segment->count = count;
+    if (page) {
+        page->refs++;
+    }
+
+    if (task->last) {
+        task->last->next = segment;
+    }
+    else {
+        task->first = segment;
+    }
+    task->last = segment;
+
+    return S3StatusOK;
+}
+
+
+// Where the next page of a task starts in key order
+static const char *task_position(const ListTask *task)
+{
+    return task->marker ? task->marker : task->prefix;
+}
+
+
+// pending heap --------------------------------------------------------------
+
+static S3Status pending_push(ParallelListData *pl, ListTask *task)
+{
+    if (!page_grow((void **) &(pl->pending), &(pl->pendingSize),
+                   pl->pendingCount + 1, sizeof(ListTask *))) {
+        return S3StatusOutOfMemory;
+    }
+
+    int i = pl->pendingCount++;
+    while (i) {
+        int parent = (i - 1) / 2;
+        if (strcmp(task_position(pl->pending[parent]),
+                   task_position(task)) <= 0) {
+            break;
+        }
+        pl->pending[i] = pl->pending[parent];
+        i = parent;
+    }
+    pl->pending[i] = task;
+
+    return S3StatusOK;
+}
+
+
+static ListTask *pending_pop(ParallelListData *pl)
+{
+    ListTask *ret = pl->pending[0];
+    ListTask *task = pl->pending[--pl->pendingCount];
+
+    int i = 0;
+    while (1) {
+        int child = (2 * i) + 1;
+        if (child >= pl->pendingCount) {
+            break;
+        }
+        if (((child + 1) < pl->pendingCount) &&
+            (strcmp(task_position(pl->pending[child + 1]),
+                    task_position(pl->pending[child])) < 0)) {
+            child++;
+        }
+        if (strcmp(task_position(task),
+                   task_position(pl->pending[child])) <= 0) {
+            break;
+        }
+        pl->pending[i] = pl->pending[child];
+        i = child;
+    }
+    if (pl->pendingCount) {
+        pl->pending[i] = task;
+    }
+
+    return ret;
+}
+
+
+// delivery ------------------------------------------------------------------
+
+// Delivers, in key order, the output of [task] which has been received and
+// is not preceded by output still to come.  Returns 1 once everything the
+// task will ever produce has been delivered.
+static int parallel_deliver(ParallelListData *pl, ListTask *task)
+{
+    while (task->first && (pl->status == S3StatusOK)) {
+        ListSegment *segment = task->first;
+        if (segment->child) {
+            if (!parallel_deliver(pl, segment->child)) {
+                return 0;
+            }
+            task_free(segment->child);
+        }
+        else {
+            parallel_stop(pl, (*(pl->callback))
+                          (segment->count,
+                           &(segment->page->contents[segment->start]),
+                           pl->callbackData));
+            page_release(segment->page);
+        }
+        task->first = segment->next;
+        if (!task->first) {
+            task->last = 0;
+        }
+        s3_free(segment);
+    }
+
+    return task->complete && !task->first;
+}
+
+
+// Records the page's contents and common prefixes in key order as the
+// task's output, and queues a task for each common prefix
+static S3Status parallel_add_page(ParallelListData *pl, ListPage *page)
+{
+    ListTask *task = page->task;
+    int i = 0, j = 0;
+
+    while ((i < page->contentsCount) || (j < page->commonPrefixesCount)) {
+        int start = i;
+        while ((i < page->contentsCount) &&
+               ((j == page->commonPrefixesCount) ||
+                (strcmp(page->contents[i].key,
+                        page->commonPrefixes[j]) < 0))) {
+            i++;
+        }
+        if ((i > start) && pl->ordered) {
+            S3Status status = task_append(task, 0, page, start, i - start);
+            if (status != S3StatusOK) {
+                return status;
+            }
+        }
+        if (j < page->commonPrefixesCount) {
+            ListTask *child =
+                task_create(page->commonPrefixes[j++], task->depth + 1);
+            if (!child) {
+                return S3StatusOutOfMemory;
+            }
+            // In key order mode the child is part of this task's output
+            // from here on, and is freed with it
+            if (pl->ordered &&
+                (task_append(task, child, 0, 0, 0) != S3StatusOK)) {
+                task_free(child);
+                return S3StatusOutOfMemory;
+            }
+            if (pending_push(pl, child) != S3StatusOK) {
+                if (!pl->ordered) {
+                    task_free(child);
+                }
+                return S3StatusOutOfMemory;
+            }
+        }
+    }
+
+    if (!pl->ordered && page->contentsCount) {
+        return (*(pl->callback))(page->contentsCount, page->contents,
+                                 pl->callbackData);
+    }
+
+    return S3StatusOK;
+}
+
+
+// listing -------------------------------------------------------------------
+
+struct SplitListData;
+struct KeyRange;
+
+
+// What a list request is for: the page of a task in a delimiter fan-out, or
+// the page of a key range when splitting the key space
+typedef struct ListRequest
+{
+    ParallelListData *pl;
+    struct SplitListData *sl;
+    struct KeyRange *range;
+    ListPage *page;
+} ListRequest;
+
+
+static S3Status parallelListCallback(int isTruncated, const char *nextMarker,
+                                     int contentsCount,
+                                     const S3ListBucketContent *contents,
+                                     int commonPrefixesCount,
+                                     const char **commonPrefixes,
+                                     void *callbackData)
+{
+    ListPage *page = ((ListRequest *) callbackData)->page;
+    int i, oom = 0, fit;
+
+    page->isTruncated = isTruncated;
+    if (nextMarker && nextMarker[0]) {
+        string_buffer_initialize(page->nextMarker);
+        string_buffer_append(page->nextMarker, nextMarker,
+                             strlen(nextMarker), fit);
+        (void) fit;
+    }
+
+    if (!page_grow((void **) &(page->contents), &(page->contentsSize),
+                   page->contentsCount + contentsCount,
+                   sizeof(S3ListBucketContent)) ||
+        !page_grow((void **) &(page->commonPrefixes),
+                   &(page->commonPrefixesSize),
+                   page->commonPrefixesCount + commonPrefixesCount,
+                   sizeof(const char *))) {
+        return S3StatusOutOfMemory;
+    }
+
+    for (i = 0; i < contentsCount; i++) {
+        S3ListBucketContent *content =
+            &(page->contents[page->contentsCount++]);
+        *content = contents[i];
+        content->key = page_strdup(page, contents[i].key, &oom);
+        content->eTag = page_strdup(page, contents[i].eTag, &oom);
+        content->ownerId = page_strdup(page, contents[i].ownerId, &oom);
+        content->ownerDisplayName =
+            page_strdup(page, contents[i].ownerDisplayName, &oom);
+    }
+
+    for (i = 0; i < commonPrefixesCount; i++) {
+        page->commonPrefixes[page->commonPrefixesCount++] =
+            page_strdup(page, commonPrefixes[i], &oom);
+    }
+
+    return oom ? S3StatusOutOfMemory : S3StatusOK;
+}
+
+
+static void parallelListCompleteCallback(S3Status status,
+                                         const S3ErrorDetails *errorDetails,
+                                         void *callbackData);
+
+
+static const S3ListBucketHandler parallelListHandlerG =
+{
+    { 0, &parallelListCompleteCallback },
+    &parallelListCallback,
+    0,
+    0
+};
+
+
+static void parallelListCompleteCallback(S3Status status,
+                                         const S3ErrorDetails *errorDetails,
+                                         void *callbackData)
+{
+    (void) errorDetails;
+
+    ListRequest *request = (ListRequest *) callbackData;
+    ParallelListData *pl = request->pl;
+    ListPage *page = request->page;
+    ListTask *task = page->task;
+
+    s3_free(request);
+    pl->inFlight--;
+
+    // The page holds a reference of its own until it has been added
+    page->refs = 1;
+
+    if (pl->status != S3StatusOK) {
+        status = pl->status;
+    }
+    if (status == S3StatusOK) {
+        status = parallel_add_page(pl, page);
+    }
+
+    // The next page starts after the last key or common prefix listed, if
+    // S3 did not say where
+    const char *nextMarker = 0;
+    if ((status == S3StatusOK) && page->isTruncated) {
+        if (page->nextMarkerLen) {
+            nextMarker = page->nextMarker;
+        }
+        else {
+            const char *lastKey = page->contentsCount ?
+                page->contents[page->contentsCount - 1].key : 0;
+            const char *lastPrefix = page->commonPrefixesCount ?
+                page->commonPrefixes[page->commonPrefixesCount - 1] : 0;
+            nextMarker = (lastKey && (!lastPrefix ||
+                                      (strcmp(lastKey, lastPrefix) > 0))) ?
+                lastKey : lastPrefix;
+        }
+    }
+
+    // In key order mode the task belongs to its parent's output; otherwise
+    // it belongs to the pending heap while requeued, and is done with if not
+    int requeued = 0;
+    if (nextMarker) {
+        char *marker = parallel_strdup(nextMarker);
+        if (marker) {
+            s3_free(task->marker);
+            task->marker = marker;
+            status = pending_push(pl, task);
+            requeued = (status == S3StatusOK);
+        }
+        else {
+            status = S3StatusOutOfMemory;
+        }
+    }
+    else if (status == S3StatusOK) {
+        task->complete = 1;
+    }
+
+    page_release(page);
+
+    parallel_stop(pl, status);
+
+    if (pl->ordered) {
+        parallel_deliver(pl, pl->root);
+    }
+    else if (!requeued) {
+        task_free(task);
+    }
+}
+
+
+static void parallel_list_next_page(ParallelListData *pl, ListTask *task)
+{
+    ListRequest *request = (ListRequest *) s3_malloc(sizeof(ListRequest));
+    ListPage *page = page_create();
+    if (!request || !page) {
+        s3_free(request);
+        if (page) {
+            page_free(page);
+        }
+        if (!pl->ordered) {
+            task_free(task);
+        }
+        parallel_stop(pl, S3StatusOutOfMemory);
+        return;
+    }
+
+    page->task = task;
+
+    request->pl = pl;
+    request->sl = 0;
+    request->range = 0;
+    request->page = page;
+
+    pl->inFlight++;
+
+    // Prefixes above the greatest depth are listed with the delimiter to
+    // find the prefixes within them; the rest are listed in full
+    S3_list_bucket(pl->bucketContext, task->prefix[0] ? task->prefix : 0,
+                   task->marker, (task->depth < pl->maxDepth) ?
+                   pl->delimiter : 0, 0, pl->requestContext, pl->timeoutMs,
+                   &parallelListHandlerG, request);
+}
+
+
+// parallel list -------------------------------------------------------------
+
+S3Status S3_list_bucket_parallel(const S3BucketContext *bucketContext,
+                                 const char *prefix, const char *delimiter,
+                                 int maxDepth, int maxInFlight, int ordered,
+                                 S3RequestContext *requestContext,
+                                 int timeoutMs,
+                                 S3ParallelListCallback *callback,
+                                 void *callbackData)
+{
+    ParallelListData pl;
+
+    pl.bucketContext = bucketContext;
+    pl.delimiter = (delimiter && delimiter[0]) ? delimiter : "/";
+    pl.maxDepth = (maxDepth < 0) ? 0 : maxDepth;
+    pl.maxInFlight = (maxInFlight < 1) ? 1 : maxInFlight;
+    pl.ordered = ordered;
+    pl.timeoutMs = timeoutMs;
+    pl.callback = callback;
+    pl.callbackData = callbackData;
+    pl.root = 0;
+    pl.pending = 0;
+    pl.pendingCount = pl.pendingSize = 0;
+    pl.inFlight = 0;
+    pl.status = S3StatusOK;
+
+    ListTask *root = task_create(prefix ? prefix : "", 0);
+    if (!root) {
+        return S3StatusOutOfMemory;
+    }
+    if (pending_push(&pl, root) != S3StatusOK) {
+        task_free(root);
+        return S3StatusOutOfMemory;
+    }
+    if (ordered) {
+        pl.root = root;
+    }
+
+    if (requestContext) {
+        pl.requestContext = requestContext;
+    }
+    else {
+        S3Status status = S3_create_request_context(&(pl.requestContext));
+        if (status != S3StatusOK) {
+            task_free(root);
+            s3_free(pl.pending);
+            return status;
+        }
+    }
+
+    // The requests which the listing adds to the context are its own, so
+    // that they can be cancelled if it has to give up on the context
+    void *owner = request_context_set_owner(pl.requestContext, &pl);
+
+    while (1) {
+        // Keep as many prefixes being listed as there are free slots for,
+        // starting with those which come first in key order
+        while ((pl.status == S3StatusOK) && pl.pendingCount &&
+               (pl.inFlight < pl.maxInFlight)) {
+            parallel_list_next_page(&pl, pending_pop(&pl));
+        }
+
+        if (!pl.inFlight) {
+            break;
+        }
+
+        // Requests which the callbacks add are not the listing's
+        int requestsRemaining;
+        request_context_set_owner(pl.requestContext, owner);
+        S3Status status = request_context_wait(pl.requestContext,
+                                               &requestsRemaining);
+        request_context_set_owner(pl.requestContext, &pl);
+        if (status != S3StatusOK) {
+            parallel_stop(&pl, status);
+            // Pages still in flight belong to the tasks freed below
+            request_context_cancel(pl.requestContext, &pl);
+            break;
+        }
+    }
+
+    request_context_set_owner(pl.requestContext, owner);
+
+    if (!requestContext) {
+        S3_destroy_request_context(pl.requestContext);
+    }
+
+    // In key order mode every task is reachable from the root; otherwise
+    // only those still waiting remain
+    if (pl.root) {
+        task_free(pl.root);
+    }
+    else {
+        while (pl.pendingCount) {
+            task_free(pl.pending[--pl.pendingCount]);
+        }
+    }
+    s3_free(pl.pending);
+
+    return pl.status;
+}
+
+
+// key space splitting -------------------------------------------------------
+
+// In key order mode, a range which is not the first one still to be
+// delivered stops listing once this many of its pages are waiting
+#define SPLIT_MAX_WAITING_PAGES 4
+
+// Only ranges estimated to hold at least this many keys, two of the pages S3
+// returns, are split, so that each half is worth a request
+#define SPLIT_MIN_KEYS 2000
+
+// A range of keys after [marker], up to and including [end], which is
+// paged through one request at a time
+typedef struct KeyRange
+{
+    // The next range in key order
+    struct KeyRange *next;
+
+    // NULL for the start of the listing and the end of the listing
+    // respectively
+    char *marker;
+    char *end;
+
+    int outstanding;
+
+    // Set once the last key of the range has been listed
+    int complete;
+
+    // Set when no key could be found between marker and end to split the
+    // range at; cleared when marker moves on
+    int unsplittable;
+
+    // Keys per unit of estimated position, from the last page listed in the
+    // range or, until then, in the range it was split from
+    double density;
+
+    // In key order mode, the pages listed and not yet delivered
+    ListSegment *first, *last;
+    int waitingCount;
+} KeyRange;
+
+
+typedef struct SplitListData
+{
+    const S3BucketContext *bucketContext;
+    const char *prefix;
+    int prefixLen;
+    int maxInFlight;
+    int ordered;
+    S3RequestContext *requestContext;
+    int timeoutMs;
+    S3ParallelListCallback *callback;
+    void *callbackData;
+
+    // Ranges still being listed or, in key order mode, delivered, in key
+    // order
+    KeyRange *ranges;
+    int rangesCount;
+
+    // Number of list requests in flight
+    int inFlight;
+
+    // The bytes seen so far in keys after the prefix, and the same in
+    // order.  Positions in the key space are estimated by reading keys as
+    // fractions in base alphabetSize + 1, with digit 0 for the end of a key
+    // and each byte's digit being its place in the alphabet.
+    unsigned char seen[256];
+    unsigned char alphabet[256];
+    int alphabetSize;
+    int digits[256];
+    int alphabetChanged;
+
+    // Set by the first failure, which stops the whole listing
+    S3Status status;
+} SplitListData;
+
+
+static void split_stop(SplitListData *sl, S3Status status)
+{
+    if ((status != S3StatusOK) && (sl->status == S3StatusOK)) {
+        sl->status = status;
+    }
+}
+
+
+static KeyRange *range_create(const char *marker, const char *end)
+{
+    KeyRange *range = (KeyRange *) s3_malloc(sizeof(KeyRange));
+    if (!range) {
+        return 0;
+    }
+
+    range->next = 0;
+    range->marker = marker ? parallel_strdup(marker) : 0;
+    range->end = end ? parallel_strdup(end) : 0;
+    range->outstanding = 0;
+    range->complete = 0;
+    range->unsplittable = 0;
+    range->density = 0;
+    range->first = range->last = 0;
+    range->waitingCount = 0;
+
+    if ((marker && !range->marker) || (end && !range->end)) {
+        s3_free(range->marker);
+        s3_free(range->end);
+        s3_free(range);
+        return 0;
+    }
+
+    return range;
+}
+
+
+static void range_free(KeyRange *range)
+{
+    while (range->first) {
+        ListSegment *segment = range->first;
+        range->first = segment->next;
+        page_release(segment->page);
+        s3_free(segment);
+    }
+    s3_free(range->marker);
+    s3_free(range->end);
+    s3_free(range);
+}
+
+
+static void range_unlink(SplitListData *sl, KeyRange *range)
+{
+    KeyRange **r = &(sl->ranges);
+    while (*r != range) {
+        r = &((*r)->next);
+    }
+    *r = range->next;
+    sl->rangesCount--;
+}
+
+
+// Adds the bytes of a listed key to the alphabet
+static void split_learn_key(SplitListData *sl, const char *key)
+{
+    const unsigned char *c = (const unsigned char *) &(key[sl->prefixLen]);
+
+    for (; *c; c++) {
+        if (!sl->seen[*c]) {
+            sl->seen[*c] = 1;
+            sl->alphabetChanged = 1;
+        }
+    }
+}
+
+
+static void split_update_alphabet(SplitListData *sl)
+{
+    if (!sl->alphabetChanged) {
+        return;
+    }
+
+    // Bytes not seen share the digit of the closest seen byte below them,
+    // which keeps the digits in key order
+    int c;
+    sl->alphabetSize = 0;
+    for (c = 0; c < 256; c++) {
+        if (sl->seen[c]) {
+            sl->alphabet[sl->alphabetSize++] = c;
+        }
+        sl->digits[c] = sl->alphabetSize;
+    }
+
+    sl->alphabetChanged = 0;
+}
+
+
+// The number of digits of a key which a double can position exactly
+static int split_significant_digits(const SplitListData *sl)
+{
+    double base = sl->alphabetSize + 1, scale = base;
+    int ret = 1;
+
+    while ((ret < S3_MAX_KEY_SIZE) && ((scale * base) < 4503599627370496.0)) {
+        scale *= base;
+        ret++;
+    }
+
+    return ret;
+}
+
+
+// Estimates where [key] lies among the keys after the prefix, from 0 for
+// the first possible key up to 1 for the end of the listing, given by NULL
+static double split_position(const SplitListData *sl, const char *key)
+{
+    if (!key) {
+        return 1.0;
+    }
+
+    const unsigned char *c = (const unsigned char *) &(key[sl->prefixLen]);
+    double base = sl->alphabetSize + 1, scale = 1.0, ret = 0;
+    int i, count = split_significant_digits(sl);
+
+    for (i = 0; *c && (i < count); i++, c++) {
+        scale /= base;
+        ret += sl->digits[*c] * scale;
+    }
+
+    return ret;
+}
+
+
+// Writes the key made of alphabet bytes which lies at [position] into
+// [buffer], which holds S3_MAX_KEY_SIZE + 1 bytes
+static void split_key_at(const SplitListData *sl, double position,
+                         char *buffer)
+{
+    double base = sl->alphabetSize + 1;
+    int i, len = sl->prefixLen, count = split_significant_digits(sl);
+
+    memcpy(buffer, sl->prefix, len);
+
+    for (i = 0; (i < count) && (len < S3_MAX_KEY_SIZE); i++) {
+        position *= base;
+        int digit = (int) position;
+        position -= digit;
+        if (digit <= 0) {
+            break;
+        }
+        if (digit > sl->alphabetSize) {
+            digit = sl->alphabetSize;
+        }
+        buffer[len++] = sl->alphabet[digit - 1];
+    }
+
+    buffer[len] = 0;
+}
+
+
+// Splits the range with the most keys still to list, by estimate, in two at
+// the key estimated to lie halfway through it.  Returns the new range, which
+// covers the upper half, or NULL if no range is worth splitting.
+static KeyRange *split_range(SplitListData *sl)
+{
+    split_update_alphabet(sl);
+
+    while (1) {
+        KeyRange *range, *best = 0;
+        double bestMarker = 0, bestEnd = 0, bestKeys = SPLIT_MIN_KEYS;
+
+        // Ranges yet to list a page have no marker to estimate from
+        for (range = sl->ranges; range; range = range->next) {
+            if (range->complete || range->unsplittable || !range->marker) {
+                continue;
+            }
+            double marker = split_position(sl, range->marker);
+            double end = split_position(sl, range->end);
+            double keys = range->density * (end - marker);
+            if (keys >= bestKeys) {
+                best = range;
+                bestMarker = marker;
+                bestEnd = end;
+                bestKeys = keys;
+            }
+        }
+
+        if (!best) {
+            return 0;
+        }
+
+        char middle[S3_MAX_KEY_SIZE + 1];
+        split_key_at(sl, (bestMarker + bestEnd) / 2, middle);
+
+        if ((strcmp(middle, best->marker) <= 0) ||
+            (best->end && (strcmp(middle, best->end) >= 0))) {
+            best->unsplittable = 1;
+            continue;
+        }
+
+        char *end = parallel_strdup(middle);
+        KeyRange *upper = range_create(middle, best->end);
+        if (!end || !upper) {
+            s3_free(end);
+            if (upper) {
+                range_free(upper);
+            }
+            split_stop(sl, S3StatusOutOfMemory);
+            return 0;
+        }
+
+        // A page of the lower half still in flight may return keys of the
+        // upper half, which are dropped when it completes
+        s3_free(best->end);
+        best->end = end;
+        upper->density = best->density;
+        upper->next = best->next;
+        best->next = upper;
+        sl->rangesCount++;
+
+        return upper;
+    }
+}
+
+
+// Delivers, in key order, the pages of the first ranges which have been
+// listed, and frees the ranges which have been delivered in full
+static void split_deliver(SplitListData *sl)
+{
+    while (sl->ranges && (sl->status == S3StatusOK)) {
+        KeyRange *range = sl->ranges;
+        while (range->first && (sl->status == S3StatusOK)) {
+            ListSegment *segment = range->first;
+            split_stop(sl, (*(sl->callback))
+                       (segment->count,
+                        &(segment->page->contents[segment->start]),
+                        sl->callbackData));
+            range->first = segment->next;
+            if (!range->first) {
+                range->last = 0;
+            }
+            range->waitingCount--;
+            page_release(segment->page);
+            s3_free(segment);
+        }
+        if (range->first || !range->complete) {
+            return;
+        }
+        sl->ranges = range->next;
+        sl->rangesCount--;
+        range_free(range);
+    }
+}
+
+
+static void splitListCompleteCallback(S3Status status,
+                                      const S3ErrorDetails *errorDetails,
+                                      void *callbackData)
+{
+    (void) errorDetails;
+
+    ListRequest *request = (ListRequest *) callbackData;
+    SplitListData *sl = request->sl;
+    KeyRange *range = request->range;
+    ListPage *page = request->page;
+
+    s3_free(request);
+    sl->inFlight--;
+    range->outstanding = 0;
+
+    // The page holds a reference of its own until it has been added
+    page->refs = 1;
+
+    if (sl->status != S3StatusOK) {
+        status = sl->status;
+    }
+
+    if (status == S3StatusOK) {
+        int i, count = page->contentsCount;
+
+        for (i = 0; i < count; i++) {
+            split_learn_key(sl, page->contents[i].key);
+        }
+        split_update_alphabet(sl);
+
+        if (count > 1) {
+            double first = split_position(sl, page->contents[0].key);
+            double last = split_position(sl, page->contents[count - 1].key);
+            if (last > first) {
+                range->density = (count - 1) / (last - first);
+            }
+        }
+
+        // Keys past the end of the range belong to the next range
+        if (range->end) {
+            while (count &&
+                   (strcmp(page->contents[count - 1].key, range->end) > 0)) {
+                count--;
+            }
+        }
+
+        if (!page->isTruncated || !count || (count < page->contentsCount)) {
+            range->complete = 1;
+        }
+        else {
+            char *marker = parallel_strdup(page->contents[count - 1].key);
+            if (marker) {
+                s3_free(range->marker);
+                range->marker = marker;
+                range->unsplittable = 0;
+            }
+            else {
+                status = S3StatusOutOfMemory;
+            }
+        }
+
+        if (count && (status == S3StatusOK)) {
+            if (!sl->ordered) {
+                status = (*(sl->callback))(count, page->contents,
+                                           sl->callbackData);
+            }
+            else {
+                ListSegment *segment =
+                    (ListSegment *) s3_malloc(sizeof(ListSegment));
+                if (segment) {
+                    segment->next = 0;
+                    segment->child = 0;
+                    segment->page = page;
+                    segment->start = 0;
+                    segment->count = count;
+                    page->refs++;
+                    if (range->last) {
+                        range->last->next = segment;
+                    }
+                    else {
+                        range->first = segment;
+                    }
+                    range->last = segment;
+                    range->waitingCount++;
+                }
+                else {
+                    status = S3StatusOutOfMemory;
+                }
+            }
+        }
+    }
+
+    page_release(page);
+
+    split_stop(sl, status);
+
+    if (sl->ordered) {
+        split_deliver(sl);
+    }
+    else if (range->complete) {
+        range_unlink(sl, range);
+        range_free(range);
+    }
+}
+
+
+static const S3ListBucketHandler splitListHandlerG =
+{
+    { 0, &splitListCompleteCallback },
+    &parallelListCallback,
+    0,
+    0
+};
+
+
+static void split_list_next_page(SplitListData *sl, KeyRange *range)
+{
+    ListRequest *request = (ListRequest *) s3_malloc(sizeof(ListRequest));
+    ListPage *page = page_create();
+    if (!request || !page) {
+        s3_free(request);
+        if (page) {
+            page_free(page);
+        }
+        split_stop(sl, S3StatusOutOfMemory);
+        return;
+    }
+
+    request->pl = 0;
+    request->sl = sl;
+    request->range = range;
+    request->page = page;
+
+    range->outstanding = 1;
+    sl->inFlight++;
+
+    S3_list_bucket(sl->bucketContext, sl->prefixLen ? sl->prefix : 0,
+                   range->marker, 0, 0, sl->requestContext, sl->timeoutMs,
+                   &splitListHandlerG, request);
+}
+
+
+S3Status S3_list_bucket_split(const S3BucketContext *bucketContext,
+                              const char *prefix, int maxInFlight,
+                              int ordered, S3RequestContext *requestContext,
+                              int timeoutMs, S3ParallelListCallback *callback,
+                              void *callbackData)
+{
+    SplitListData sl;
+
+    memset(&sl, 0, sizeof(sl));
+
+    sl.bucketContext = bucketContext;
+    sl.prefix = prefix ? prefix : "";
+    sl.prefixLen = strlen(sl.prefix);
+    sl.maxInFlight = (maxInFlight < 1) ? 1 : maxInFlight;
+    sl.ordered = ordered;
+    sl.timeoutMs = timeoutMs;
+    sl.callback = callback;
+    sl.callbackData = callbackData;
+    sl.status = S3StatusOK;
+
+    if (sl.prefixLen > S3_MAX_KEY_SIZE) {
+        return S3StatusKeyTooLong;
+    }
+
+    // The listing starts as a single range, which is split once its first
+    // page gives something to estimate the key space from
+    sl.ranges = range_create(0, 0);
+    if (!sl.ranges) {
+        return S3StatusOutOfMemory;
+    }
+    sl.rangesCount = 1;
+
+    // In key order mode, ranges waiting to be delivered hold pages without
+    // listing; more ranges than requests keep the requests busy meanwhile
+    int maxRanges = sl.ordered ? (2 * sl.maxInFlight) : sl.maxInFlight;
+
+    if (requestContext) {
+        sl.requestContext = requestContext;
+    }
+    else {
+        S3Status status = S3_create_request_context(&(sl.requestContext));
+        if (status != S3StatusOK) {
+            range_free(sl.ranges);
+            return status;
+        }
+    }
+
+    // The requests which the listing adds to the context are its own, so
+    // that they can be cancelled if it has to give up on the context
+    void *owner = request_context_set_owner(sl.requestContext, &sl);
+
+    while (1) {
+        KeyRange *range = sl.ranges;
+
+        // Request the next page of each range which is ready for one,
+        // starting with those which come first in key order
+        while (range && (sl.status == S3StatusOK) &&
+               (sl.inFlight < sl.maxInFlight)) {
+            KeyRange *next = range->next;
+            if (!range->outstanding && !range->complete &&
+                (!sl.ordered || (range == sl.ranges) ||
+                 (range->waitingCount < SPLIT_MAX_WAITING_PAGES))) {
+                split_list_next_page(&sl, range);
+            }
+            range = next;
+        }
+
+        // Put any requests left idle to work on the largest ranges
+        while ((sl.status == S3StatusOK) && (sl.inFlight < sl.maxInFlight) &&
+               (sl.rangesCount < maxRanges) && (range = split_range(&sl))) {
+            split_list_next_page(&sl, range);
+        }
+
+        if (!sl.inFlight) {
+            break;
+        }
+
+        // Requests which the callbacks add are not the listing's
+        int requestsRemaining;
+        request_context_set_owner(sl.requestContext, owner);
+        S3Status status = request_context_wait(sl.requestContext,
+                                               &requestsRemaining);
+        request_context_set_owner(sl.requestContext, &sl);
+        if (status != S3StatusOK) {
+            split_stop(&sl, status);
+            // Pages still in flight belong to the ranges freed below
+            request_context_cancel(sl.requestContext, &sl);
+            break;
+        }
+    }
+
+    request_context_set_owner(sl.requestContext, owner);
+
+    if (!requestContext) {
+        S3_destroy_request_context(sl.requestContext);
+    }
+
+    while (sl.ranges) {
+        KeyRange *next = sl.ranges->next;
+        range_free(sl.ranges);
+        sl.ranges = next;
+    }
+
+    return sl.status;
+}
@@ -0,0 +1,286 @@
+/** **************************************************************************
+ * prefix_follower.c
+ *
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "libs3.h"
+#include "string_buffer.h"
+#include "util.h"
+
+
+struct S3PrefixFollower
+{
+    // The strings it references are the caller's
+    S3BucketContext bucketContext;
+
+    char *prefix;
+
+    int intervalMs, maxIntervalMs;
+
+    int timeoutMs;
+
+    S3PrefixFollowerCallback *callback;
+
+    void *callbackData;
+
+    // The marker for the next request
+    string_buffer(lastKey, S3_MAX_KEY_SIZE);
+
+    // Set while a poll is being made, by the callbacks of its requests
+    int isTruncated, keysFound;
+
+    S3Status status;
+
+    // The interval after the last poll, and when the next is due
+    int currentIntervalMs;
+
+    int64_t nextPollMs;
+};
+
+
+// Milliseconds on a clock that is not set back
+static int64_t follower_now_ms()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (((int64_t) ts.tv_sec) * 1000) + (ts.tv_nsec / 1000000);
+}
+
+
+static S3Status followerListCallback(int isTruncated, const char *nextMarker,
+                                     int contentsCount,
+                                     const S3ListBucketContent *contents,
+                                     int commonPrefixesCount,
+                                     const char **commonPrefixes,
+                                     void *callbackData)
+{
+    (void) nextMarker;
+    (void) commonPrefixesCount;
+    (void) commonPrefixes;
+
+    S3PrefixFollower *follower = (S3PrefixFollower *) callbackData;
+
+    follower->isTruncated = isTruncated;
+
+    if (!contentsCount) {
+        return S3StatusOK;
+    }
+
+    // Without a delimiter, the last key is the marker to continue from
+    const char *key = contents[contentsCount - 1].key;
+    int fit;
+    string_buffer_initialize(follower->lastKey);
+    string_buffer_append(follower->lastKey, key, strlen(key), fit);
+    if (!fit) {
+        return S3StatusKeyTooLong;
+    }
+
+    follower->keysFound = 1;
+
+    return (*(follower->callback))(contentsCount, contents, follower->lastKey,
+                                   follower->callbackData);
+}
+
+
+static void followerCompleteCallback(S3Status status,
+                                     const S3ErrorDetails *errorDetails,
+                                     void *callbackData)
+{
+    (void) errorDetails;
+
+    ((S3PrefixFollower *) callbackData)->status = status;
+}
+
+
+static const S3ListBucketHandler followerListHandlerG =
+{
+    { 0, &followerCompleteCallback },
+    &followerListCallback,
+    0,
+    0
+};
+
+
+S3Status S3_create_prefix_follower(const S3BucketContext *bucketContext,
+                                   const char *prefix,
+                                   const char *startAfter, int intervalMs,
+                                   int maxIntervalMs, int timeoutMs,
+                                   S3PrefixFollowerCallback *callback,
+                                   void *callbackData,
+                                   S3PrefixFollower **followerReturn)
+{
+    if (!prefix) {
+        prefix = "";
+    }
+
+    if (!startAfter) {
+        startAfter = "";
+    }
+
+    if (strlen(startAfter) > S3_MAX_KEY_SIZE) {
+        return S3StatusKeyTooLong;
+    }
+
+    size_t prefixLen = strlen(prefix);
+
+    S3PrefixFollower *follower = (S3PrefixFollower *)
+        s3_malloc(sizeof(S3PrefixFollower) + prefixLen + 1);
+
+    if (!follower) {
+        return S3StatusOutOfMemory;
+    }
+
+    follower->bucketContext = *bucketContext;
+    follower->prefix = (char *) &(follower[1]);
+    memcpy(follower->prefix, prefix, prefixLen + 1);
+    follower->intervalMs = (intervalMs < 0) ? 0 : intervalMs;
+    follower->maxIntervalMs = (maxIntervalMs < follower->intervalMs) ?
+        follower->intervalMs : maxIntervalMs;
+    follower->timeoutMs = timeoutMs;
+    follower->callback = callback;
+    follower->callbackData = callbackData;
+
+    int fit;
+    string_buffer_initialize(follower->lastKey);
+    string_buffer_append(follower->lastKey, startAfter, strlen(startAfter),
+                         fit);
+    (void) fit;
+
+    follower->currentIntervalMs = follower->intervalMs;
+    // The first poll is due right away
+    follower->nextPollMs = 0;
+
+    *followerReturn = follower;
+
+    return S3StatusOK;
+}
+
+
+void S3_destroy_prefix_follower(S3PrefixFollower *follower)
+{
+    s3_free(follower);
+}
+
+
+// Schedules the next poll after one which found keys if [keysFound], or
+// else after a longer interval than the last, up to the longest.  The
+// backoff starts from a floor of 1/64 of the longest interval (and at least
+// 1 ms), so that it also grows from an interval of 0.
+static void follower_schedule(S3PrefixFollower *follower, int keysFound)
+{
+    if (keysFound) {
+        follower->currentIntervalMs = follower->intervalMs;
+    }
+    else if (follower->currentIntervalMs < (follower->maxIntervalMs / 2)) {
+        int floorMs = follower->maxIntervalMs / 64;
+        if (!floorMs) {
+            floorMs = 1;
+        }
+        follower->currentIntervalMs *= 2;
+        if (follower->currentIntervalMs < floorMs) {
+            follower->currentIntervalMs = floorMs;
+        }
+    }
+    else {
+        follower->currentIntervalMs = follower->maxIntervalMs;
+    }
+
+    follower->nextPollMs = follower_now_ms() + follower->currentIntervalMs;
+}
+
+
+S3Status S3_prefix_follower_poll(S3PrefixFollower *follower)
+{
+    follower->keysFound = 0;
+
+    do {
+        follower->isTruncated = 0;
+        follower->status = S3StatusOK;
+        S3_list_bucket(&(follower->bucketContext),
+                       follower->prefix[0] ? follower->prefix : 0,
+                       follower->lastKey[0] ? follower->lastKey : 0, 0, 0, 0,
+                       follower->timeoutMs, &followerListHandlerG, follower);
+    } while ((follower->status == S3StatusOK) && follower->isTruncated);
+
+    int keysFound = follower->keysFound;
+
+    if ((follower->status == S3StatusOK) && !keysFound) {
+        follower->status = (*(follower->callback))
+            (0, 0, follower->lastKey[0] ? follower->lastKey : 0,
+             follower->callbackData);
+    }
+
+    // A poll which failed part way through still found what it reported
+    follower_schedule(follower, keysFound);
+
+    return follower->status;
+}
+
+
+int S3_prefix_follower_get_wait_ms(const S3PrefixFollower *follower)
+{
+    int64_t wait = follower->nextPollMs - follower_now_ms();
+
+    return (wait > 0) ? (int) wait : 0;
+}
+
+
+const char *S3_prefix_follower_get_last_key
+    (const S3PrefixFollower *follower)
+{
+    return follower->lastKey[0] ? follower->lastKey : 0;
+}
+
+
+S3Status S3_prefix_follower_run(S3PrefixFollower *follower)
+{
+    while (1) {
+        int waitMs = S3_prefix_follower_get_wait_ms(follower);
+
+        if (waitMs) {
+            struct timespec ts;
+            ts.tv_sec = waitMs / 1000;
+            ts.tv_nsec = (waitMs % 1000) * 1000000L;
+            // An interrupted sleep just polls early
+            nanosleep(&ts, 0);
+        }
+
+        S3Status status = S3_prefix_follower_poll(follower);
+
+        if ((status != S3StatusOK) && !S3_status_is_retryable(status)) {
+            return status;
+        }
+    }
+}
@@ -35,9 +35,10 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/utsname.h>
-#include <libxml/parser.h>
 #include "request.h"
 #include "request_context.h"
+#include "probes.h"
+#include "request_metrics.h"
 #include "response_headers_handler.h"
 
 #ifdef __APPLE__
@@ -51,12 +52,27 @@
 
 #define USER_AGENT_SIZE 256
 #define REQUEST_STACK_SIZE 32
+#define ERROR_PARSER_STACK_SIZE 8
+#define COMPUTED_VALUES_STACK_SIZE 8
 #define SIGNATURE_SCOPE_SIZE 64
 
 //#define SIGNATURE_DEBUG
 
 static int verifyPeer;
 
+// Whether the network timings of requests are collected for their complete
+// callbacks
+static int requestTimingsG;
+
+// Whether the metrics of requests are kept
+static int requestMetricsEnabledG;
+
+// The hooks registered with S3_set_trace_hooks; beginCallback is 0 if there
+// are none
+static S3TraceHooks traceHooksG;
+
+#define trace_bit(point) (1 << (point))
+
 static char userAgentG[USER_AGENT_SIZE];
 
 static pthread_mutex_t requestStackMutexG;
@@ -65,13 +81,31 @@ static Request *requestStackG[REQUEST_STACK_SIZE];
 
 static int requestStackCountG;
 
+// Error parsers are kept separately from requests, since few requests need
+// one; the stack is protected by requestStackMutexG
+static ErrorParser *errorParserStackG[ERROR_PARSER_STACK_SIZE];
+
+static int errorParserStackCountG;
+
+// Set if every request gets its error parser up front
+static int eagerErrorParsersG;
+
+// The error details passed to the complete callback of a request that did
+// not receive an error response body
+static const S3ErrorDetails emptyErrorDetailsG = { 0, 0, 0, 0, 0, 0 };
+
+// The arenas of requests not made in a request context take their blocks
+// from here
+static RequestSlab requestSlabG;
+
 char defaultHostNameG[S3_MAX_HOSTNAME_SIZE];
 
 
 typedef struct RequestComputedValues
 {
     // All x-amz- headers, in normalized form (i.e. NAME: VALUE, no other ws)
-    char *amzHeaders[S3_MAX_METADATA_COUNT + 2]; // + 2 for acl and date
+    // + 8 for acl, date, and the other x-amz- headers added by libs3
+    char *amzHeaders[S3_MAX_METADATA_COUNT + 8];
 
     // The number of x-amz- headers
     int amzHeadersCount;
@@ -96,7 +130,10 @@ typedef struct RequestComputedValues
     char canonicalURI[MAX_CANONICALIZED_RESOURCE_SIZE + 1];
 
     // Canonical sub-resource & query string
-    char canonicalQueryString[MAX_CANONICALIZED_RESOURCE_SIZE + 1];
+    char canonicalQueryString[MAX_CANONICALIZED_QUERY_SIZE + 1];
+
+    // Holds the query parameters while they are sorted
+    char queryStringScratch[MAX_CANONICALIZED_QUERY_SIZE + 1];
 
     // Cache-Control header (or empty)
     char cacheControlHeader[128];
@@ -148,9 +185,112 @@ typedef struct RequestComputedValues
 
     // Hex string of hash of request payload
     char payloadHash[S3_SHA256_DIGEST_LENGTH * 2 + 1];
+
+    // The URI, which is copied into the request's arena
+    char uri[MAX_URI_SIZE + 1];
 } RequestComputedValues;
 
 
+// RequestComputedValues are far too large to put on the stack of callers,
+// which may be running with small stacks, so they are kept on a stack of
+// their own, protected by requestStackMutexG
+static RequestComputedValues *computedValuesStackG[COMPUTED_VALUES_STACK_SIZE];
+
+static int computedValuesStackCountG;
+
+
+static RequestComputedValues *computed_values_get()
+{
+    RequestComputedValues *values = 0;
+
+    pthread_mutex_lock(&requestStackMutexG);
+
+    if (computedValuesStackCountG) {
+        values = computedValuesStackG[--computedValuesStackCountG];
+    }
+
+    pthread_mutex_unlock(&requestStackMutexG);
+
+    if (!values) {
+        values = (RequestComputedValues *)
+            s3_malloc(sizeof(RequestComputedValues));
+    }
+
+    return values;
+}
+
+
+static void computed_values_release(RequestComputedValues *values)
+{
+    pthread_mutex_lock(&requestStackMutexG);
+
+    if (computedValuesStackCountG == COMPUTED_VALUES_STACK_SIZE) {
+        pthread_mutex_unlock(&requestStackMutexG);
+        s3_free(values);
+    }
+    else {
+        computedValuesStackG[computedValuesStackCountG++] = values;
+        pthread_mutex_unlock(&requestStackMutexG);
+    }
+}
+
+
+// tracing -------------------------------------------------------------------
+
+S3Status S3_set_trace_hooks(const S3TraceHooks *hooks)
+{
+    if (!hooks) {
+        memset(&traceHooksG, 0, sizeof(traceHooksG));
+        return S3StatusOK;
+    }
+
+    if (!hooks->beginCallback || !hooks->endCallback) {
+        return S3StatusInternalError;
+    }
+
+    traceHooksG = *hooks;
+
+    return S3StatusOK;
+}
+
+
+static void trace_event_initialize(S3TraceEvent *event, S3TracePoint point,
+                                   S3MetricsOperation operation)
+{
+    memset(event, 0, sizeof(*event));
+    event->point = point;
+    event->operation = operation;
+    event->timeUs = request_metrics_now_us();
+    event->status = S3StatusOK;
+}
+
+
+// Reports that a traced request has reached [point]
+static void request_trace(Request *request, S3TracePoint point)
+{
+    S3TraceEvent event;
+
+    request->tracePending &= ~trace_bit(point);
+
+    trace_event_initialize(&event, point, request->operation);
+    event.uri = request->uri;
+    if (point >= S3TracePointHeadersReceived) {
+        event.requestId =
+            request->responseHeadersHandler.responseProperties.requestId;
+    }
+
+    if (point == S3TracePointComplete) {
+        event.status = request->status;
+        (*(traceHooksG.endCallback))
+            (request->traceSpan, &event, traceHooksG.hookData);
+    }
+    else if (traceHooksG.eventCallback) {
+        (*(traceHooksG.eventCallback))
+            (request->traceSpan, &event, traceHooksG.hookData);
+    }
+}
+
+
 // Called whenever we detect that the request headers have been completely
 // processed; which happens either when we get our first read/write callback,
 // or the request is finished being processed.  Returns nonzero on success,
@@ -179,14 +319,39 @@ static void request_headers_done(Request *request)
     response_headers_handler_done(&(request->responseHeadersHandler),
                                   request->curl);
 
+    if ((request->tracePending & trace_bit(S3TracePointHeadersReceived)) &&
+        request->httpResponseCode) {
+        request_trace(request, S3TracePointHeadersReceived);
+    }
+
+    // Work out which checksum, if any, the data received can be verified
+    // against; composite checksums of multipart objects cannot be
+    if (request->verifyChecksum) {
+        const S3ResponseProperties *properties =
+            &(request->responseHeadersHandler.responseProperties);
+        if (properties->checksumCRC64NVME &&
+            !strchr(properties->checksumCRC64NVME, '-')) {
+            request->checksumAlgorithm = S3ChecksumAlgorithmCRC64NVME;
+        }
+        else if (properties->checksumCRC32C &&
+                 !strchr(properties->checksumCRC32C, '-')) {
+            request->checksumAlgorithm = S3ChecksumAlgorithmCRC32C;
+        }
+        else {
+            request->verifyChecksum = 0;
+        }
+    }
+
     // Only make the callback if it was a successful request; otherwise we're
     // returning information about the error response itself
     if (request->propertiesCallback &&
         (request->httpResponseCode >= 200) &&
         (request->httpResponseCode <= 299)) {
+        probe1(callback__start, PROBE_CALLBACK_PROPERTIES);
         request->status = (*(request->propertiesCallback))
             (&(request->responseHeadersHandler.responseProperties),
              request->callbackData);
+        probe1(callback__end, PROBE_CALLBACK_PROPERTIES);
     }
 }
 
@@ -198,13 +363,78 @@ static size_t curl_header_func(void *ptr, size_t size, size_t nmemb,
 
     int len = size * nmemb;
 
-    response_headers_handler_add
-        (&(request->responseHeadersHandler), (char *) ptr, len);
+    // Headers are only of interest to the properties callback, to checksum
+    // verification, and to tracing, so don't bother parsing them otherwise
+    if (request->propertiesCallback || request->verifyChecksum ||
+        request->tracePending) {
+        response_headers_handler_add
+            (&(request->responseHeadersHandler), (char *) ptr, len);
+    }
 
     return len;
 }
 
 
+// Supplies the data from the toS3Callback in aws-chunked encoding, followed
+// by a trailer carrying the checksum of the data, which is computed as the
+// data goes by
+static size_t curl_read_chunked(Request *request, char *buffer, int len)
+{
+    // Send any framing that is waiting to go first
+    if (request->toS3FramingSent < request->toS3FramingLen) {
+        int count = request->toS3FramingLen - request->toS3FramingSent;
+        if (count > len) {
+            count = len;
+        }
+        memcpy(buffer, &(request->toS3Framing[request->toS3FramingSent]),
+               count);
+        request->toS3FramingSent += count;
+        return count;
+    }
+
+    // If the current chunk is empty, then the trailer has been sent
+    if (!request->toS3ChunkRemaining) {
+        return 0;
+    }
+
+    if (len > request->toS3ChunkRemaining) {
+        len = request->toS3ChunkRemaining;
+    }
+
+    probe1(callback__start, PROBE_CALLBACK_DATA_OUT);
+    int ret = (*(request->toS3Callback))
+        (len, buffer, request->callbackData);
+    probe1(callback__end, PROBE_CALLBACK_DATA_OUT);
+    if (ret < 0) {
+        request->status = S3StatusAbortedByCallback;
+        return CURL_READFUNC_ABORT;
+    }
+    if (ret > len) {
+        ret = len;
+    }
+
+    request->checksum = S3_compute_checksum
+        (request->checksumAlgorithm, request->checksum, buffer, ret);
+    request->toS3ChunkRemaining -= ret;
+    request->toS3CallbackBytesRemaining -= ret;
+
+    // At the end of each chunk, queue up the start of the next one, or the
+    // trailer if there is no more data
+    if (!request->toS3ChunkRemaining) {
+        int chunkSize = (request->toS3CallbackBytesRemaining >
+                         CHECKSUM_CHUNK_SIZE) ? CHECKSUM_CHUNK_SIZE :
+            (int) request->toS3CallbackBytesRemaining;
+        request->toS3FramingLen = checksum_chunk_framing
+            (request->checksumAlgorithm, request->checksum, 0, chunkSize,
+             request->toS3Framing);
+        request->toS3FramingSent = 0;
+        request->toS3ChunkRemaining = chunkSize;
+    }
+
+    return ret;
+}
+
+
 static size_t curl_read_func(void *ptr, size_t size, size_t nmemb, void *data)
 {
     Request *request = (Request *) data;
@@ -220,6 +450,10 @@ static size_t curl_read_func(void *ptr, size_t size, size_t nmemb, void *data)
         return CURL_READFUNC_ABORT;
     }
 
+    if (request->checksumAlgorithm) {
+        return curl_read_chunked(request, (char *) ptr, len);
+    }
+
     // If there is no data callback, or the data callback has already returned
     // contentLength bytes, return 0;
     if (!request->toS3Callback || !request->toS3CallbackBytesRemaining) {
@@ -233,8 +467,10 @@ static size_t curl_read_func(void *ptr, size_t size, size_t nmemb, void *data)
     }
 
     // Otherwise, make the data callback
+    probe1(callback__start, PROBE_CALLBACK_DATA_OUT);
     int ret = (*(request->toS3Callback))
         (len, (char *) ptr, request->callbackData);
+    probe1(callback__end, PROBE_CALLBACK_DATA_OUT);
     if (ret < 0) {
         request->status = S3StatusAbortedByCallback;
         return CURL_READFUNC_ABORT;
@@ -249,6 +485,66 @@ static size_t curl_read_func(void *ptr, size_t size, size_t nmemb, void *data)
 }
 
 
+#if LIBCURL_VERSION_NUM >= 0x075000 /* 7.80.0 */
+static int curl_prereq_func(void *data, char *primaryIp, char *localIp,
+                            int primaryPort, int localPort)
+{
+    Request *request = (Request *) data;
+
+    (void) primaryIp;
+    (void) localIp;
+    (void) primaryPort;
+    (void) localPort;
+
+    if (request->tracePending & trace_bit(S3TracePointFirstByteSent)) {
+        request_trace(request, S3TracePointFirstByteSent);
+    }
+
+    return CURL_PREREQFUNC_OK;
+}
+#endif
+
+
+static ErrorParser *error_parser_get()
+{
+    ErrorParser *errorParser = 0;
+
+    pthread_mutex_lock(&requestStackMutexG);
+
+    if (errorParserStackCountG) {
+        errorParser = errorParserStackG[--errorParserStackCountG];
+    }
+
+    pthread_mutex_unlock(&requestStackMutexG);
+
+    if (!errorParser &&
+        !(errorParser = (ErrorParser *) s3_malloc(sizeof(ErrorParser)))) {
+        return 0;
+    }
+
+    error_parser_initialize(errorParser);
+
+    return errorParser;
+}
+
+
+static void error_parser_release(ErrorParser *errorParser)
+{
+    error_parser_deinitialize(errorParser);
+
+    pthread_mutex_lock(&requestStackMutexG);
+
+    if (errorParserStackCountG == ERROR_PARSER_STACK_SIZE) {
+        pthread_mutex_unlock(&requestStackMutexG);
+        s3_free(errorParser);
+    }
+    else {
+        errorParserStackG[errorParserStackCountG++] = errorParser;
+        pthread_mutex_unlock(&requestStackMutexG);
+    }
+}
+
+
 static size_t curl_write_func(void *ptr, size_t size, size_t nmemb,
                               void *data)
 {
@@ -258,6 +554,10 @@ static size_t curl_write_func(void *ptr, size_t size, size_t nmemb,
 
     request_headers_done(request);
 
+    if (request->tracePending & trace_bit(S3TracePointFirstBodyByte)) {
+        request_trace(request, S3TracePointFirstBodyByte);
+    }
+
     if (request->status != S3StatusOK) {
         return 0;
     }
@@ -265,13 +565,24 @@ static size_t curl_write_func(void *ptr, size_t size, size_t nmemb,
     // On HTTP error, we expect to parse an HTTP error response
     if ((request->httpResponseCode < 200) ||
         (request->httpResponseCode > 299)) {
+        if (!request->errorParser &&
+            !(request->errorParser = error_parser_get())) {
+            request->status = S3StatusOutOfMemory;
+            return 0;
+        }
         request->status = error_parser_add
-            (&(request->errorParser), (char *) ptr, len);
+            (request->errorParser, (char *) ptr, len);
     }
     // If there was a callback registered, make it
     else if (request->fromS3Callback) {
+        if (request->verifyChecksum) {
+            request->checksum = S3_compute_checksum
+                (request->checksumAlgorithm, request->checksum, ptr, len);
+        }
+        probe1(callback__start, PROBE_CALLBACK_DATA_IN);
         request->status = (*(request->fromS3Callback))
             (len, (char *) ptr, request->callbackData);
+        probe1(callback__end, PROBE_CALLBACK_DATA_IN);
     }
     // Else, consider this an error - S3 has sent back data when it was not
     // expected
@@ -328,6 +639,21 @@ static S3Status append_amz_header(RequestComputedValues *values,
     return S3StatusOK;
 }
 
+// Returns the algorithm of the checksum trailer to be sent after the data of
+// the request, or S3ChecksumAlgorithmNone if the data is to be sent as is
+static S3ChecksumAlgorithm trailer_checksum_algorithm
+    (const RequestParams *params)
+{
+    if ((params->httpRequestType == HttpRequestTypePUT) &&
+        params->toS3Callback && params->putProperties &&
+        checksum_header_name(params->putProperties->checksumAlgorithm)) {
+        return params->putProperties->checksumAlgorithm;
+    }
+
+    return S3ChecksumAlgorithmNone;
+}
+
+
 // This function 'normalizes' all x-amz-meta headers provided in
 // params->requestHeaders, which means it removes all whitespace from
 // them such that they all look exactly like this:
@@ -417,6 +743,44 @@ static S3Status compose_amz_headers(const RequestParams *params,
                           params->bucketContext.securityToken);
     }
 
+    // Initiating a multipart upload declares the checksum of the parts
+    if ((params->httpRequestType == HttpRequestTypePOST) && properties &&
+        checksum_algorithm_name(properties->checksumAlgorithm)) {
+        append_amz_header(values, 0, "x-amz-checksum-algorithm",
+                          checksum_algorithm_name
+                          (properties->checksumAlgorithm));
+        append_amz_header(values, 0, "x-amz-checksum-type", "FULL_OBJECT");
+    }
+
+    // Completing a multipart upload may give the full-object checksum, which
+    // S3 then checks the assembled object against
+    if (params->checksum && checksum_header_name(params->checksumAlgorithm)) {
+        append_amz_header(values, 0,
+                          checksum_header_name(params->checksumAlgorithm),
+                          params->checksum);
+        append_amz_header(values, 0, "x-amz-checksum-type", "FULL_OBJECT");
+    }
+
+    // Ask for the stored checksum of objects to be verified; ranges of
+    // objects don't have one
+    if ((params->httpRequestType == HttpRequestTypeGET) &&
+        params->getConditions && params->getConditions->verifyChecksum &&
+        !params->startByte && !params->byteCount) {
+        append_amz_header(values, 0, "x-amz-checksum-mode", "ENABLED");
+    }
+
+    S3ChecksumAlgorithm trailerAlgorithm = trailer_checksum_algorithm(params);
+
+    if (trailerAlgorithm) {
+        char decodedLength[64];
+        snprintf(decodedLength, sizeof(decodedLength), "%llu",
+                 (unsigned long long) params->toS3CallbackTotalSize);
+        append_amz_header(values, 0, "x-amz-decoded-content-length",
+                          decodedLength);
+        append_amz_header(values, 0, "x-amz-trailer",
+                          checksum_header_name(trailerAlgorithm));
+    }
+
     if (!forceUnsignedPayload
         && (params->httpRequestType == HttpRequestTypeGET
             || params->httpRequestType == HttpRequestTypeCOPY
@@ -435,6 +799,9 @@ static S3Status compose_amz_headers(const RequestParams *params,
             snprintf(&(values->payloadHash[i * 2]), 3, "%02x", md[i]);
         }
     }
+    else if (trailerAlgorithm) {
+        strcpy(values->payloadHash, "STREAMING-UNSIGNED-PAYLOAD-TRAILER");
+    }
     else {
         // TODO: figure out how to manage signed payloads
         strcpy(values->payloadHash, "UNSIGNED-PAYLOAD");
@@ -562,10 +929,21 @@ static S3Status compose_standard_headers(const RequestParams *params,
                   S3StatusBadContentDispositionFilename,
                   S3StatusContentDispositionFilenameTooLong);
 
-    // ContentEncoding
-    do_put_header("Content-Encoding: %s", contentEncoding,
-                  contentEncodingHeader, S3StatusBadContentEncoding,
-                  S3StatusContentEncodingTooLong);
+    // ContentEncoding; aws-chunked must come first if it is used
+    if (trailer_checksum_algorithm(params)) {
+        do_put_header("Content-Encoding: aws-chunked,%s", contentEncoding,
+                      contentEncodingHeader, S3StatusBadContentEncoding,
+                      S3StatusContentEncodingTooLong);
+        if (!values->contentEncodingHeader[0]) {
+            strcpy(values->contentEncodingHeader,
+                   "Content-Encoding: aws-chunked");
+        }
+    }
+    else {
+        do_put_header("Content-Encoding: %s", contentEncoding,
+                      contentEncodingHeader, S3StatusBadContentEncoding,
+                      S3StatusContentEncodingTooLong);
+    }
 
     // Expires
     if (params->putProperties && (params->putProperties->expires >= 0)) {
@@ -697,8 +1075,10 @@ static void kv_gnome_sort(const char **values, int size, char delim)
 // Canonicalizes the signature headers into the canonicalizedSignatureHeaders buffer
 static void canonicalize_signature_headers(RequestComputedValues *values)
 {
-    // Make a copy of the headers that will be sorted
-    const char *sortedHeaders[S3_MAX_METADATA_COUNT + 3];
+    // Make a copy of the headers that will be sorted; + 4 for the
+    // content-type, host, range and content-md5 headers
+    const char *sortedHeaders[(sizeof(values->amzHeaders) /
+                               sizeof(values->amzHeaders[0])) + 4];
 
     memcpy(sortedHeaders, values->amzHeaders,
            (values->amzHeadersCount * sizeof(sortedHeaders[0])));
@@ -815,8 +1195,10 @@ static void canonicalize_resource(const S3BucketContext *context,
 #undef append
 }
 
-static void sort_query_string(const char *queryString, char *result,
-                              unsigned int result_size)
+// Sorts the parameters of queryString into result; scratch, which must be as
+// large as result, holds the parameters while they are sorted
+static void sort_query_string(const char *queryString, char *scratch,
+                              char *result, unsigned int result_size)
 {
 #ifdef SIGNATURE_DEBUG
     printf("\n--\nsort_and_urlencode\nqueryString: %s\n", queryString);
@@ -831,11 +1213,8 @@ static void sort_query_string(const char *queryString, char *result,
 
     const char* params[numParams];
 
-    // Where did strdup go?!??
-    int queryStringLen = strlen(queryString);
-    char *buf = (char *) malloc(queryStringLen + 1);
-    char *tok = buf;
-    strcpy(tok, queryString);
+    char *tok = scratch;
+    snprintf(tok, result_size, "%s", queryString);
     const char *token = NULL;
     char *save = NULL;
     unsigned int i = 0;
@@ -844,6 +1223,8 @@ static void sort_query_string(const char *queryString, char *result,
         tok = NULL;
         params[i++] = token;
     }
+    // Empty parameters are skipped, and a truncated copy has fewer
+    numParams = i;
 
     kv_gnome_sort(params, numParams, '=');
 
@@ -866,27 +1247,34 @@ static void sort_query_string(const char *queryString, char *result,
         result[len - 1] = 0;
     }
 #undef append
-
-    free(buf);
 }
 
 
 // Canonicalize the query string part of the request into a buffer
-static void canonicalize_query_string(const char *queryParams,
-                                      const char *subResource,
-                                      char *buffer, unsigned int buffer_size)
+static S3Status canonicalize_query_string(const char *queryParams,
+                                          const char *subResource,
+                                          char *scratch, char *buffer,
+                                          unsigned int buffer_size)
 {
-    int len = 0;
+    unsigned int len = 0;
 
     *buffer = 0;
 
-#define append(str) len += snprintf(&(buffer[len]), buffer_size - len, "%s", str)
+#define append(str)                                                     \
+    do {                                                                \
+        len += snprintf(&(buffer[len]), buffer_size - len, "%s", str);  \
+        if (len >= buffer_size) {                                       \
+            return S3StatusQueryParamsTooLong;                          \
+        }                                                               \
+    } while (0)
 
     if (queryParams && queryParams[0]) {
-        char sorted[strlen(queryParams) * 2];
-        sorted[0] = '\0';
-        sort_query_string(queryParams, sorted, sizeof(sorted));
-        append(sorted);
+        // Sorting only reorders the parameters, so they fit if they did
+        if (strlen(queryParams) >= buffer_size) {
+            return S3StatusQueryParamsTooLong;
+        }
+        sort_query_string(queryParams, scratch, buffer, buffer_size);
+        len = strlen(buffer);
     }
 
     if (subResource && subResource[0]) {
@@ -900,6 +1288,8 @@ static void canonicalize_query_string(const char *queryParams,
     }
 
 #undef append
+
+    return S3StatusOK;
 }
 
 
@@ -1147,6 +1537,34 @@ static S3Status compose_uri(char *buffer, int bufferSize,
     return S3StatusOK;
 }
 
+// Appends a copy of [header] to the request's header list after [*last],
+// allocating both from the request's arena.  Returns zero if out of memory.
+static int append_request_header(Request *request, struct curl_slist **last,
+                                 const char *header)
+{
+    struct curl_slist *entry = (struct curl_slist *) request_arena_alloc
+        (&(request->arena), sizeof(struct curl_slist));
+
+    if (!entry || !(entry->data = request_arena_strndup
+                    (&(request->arena), header, strlen(header)))) {
+        return 0;
+    }
+
+    entry->next = 0;
+
+    if (*last) {
+        (*last)->next = entry;
+    }
+    else {
+        request->headers = entry;
+    }
+
+    *last = entry;
+
+    return 1;
+}
+
+
 // Sets up the curl handle given the completely computed RequestParams
 static S3Status setup_curl(Request *request,
                            const RequestParams *params,
@@ -1229,26 +1647,41 @@ static S3Status setup_curl(Request *request,
     }
 
 
+    // The header list is built in the request's arena, so that it does not
+    // have to be allocated and freed by curl_slist_append for each request
+    struct curl_slist *lastHeader = 0;
+
+#define append_header(header)                                           \
+    do {                                                                \
+        if (!append_request_header(request, &lastHeader, header)) {     \
+            return S3StatusOutOfMemory;                                 \
+        }                                                               \
+    } while (0)
+
     // Append standard headers
 #define append_standard_header(fieldName)                               \
     if (values-> fieldName [0]) {                                       \
-        request->headers = curl_slist_append(request->headers,          \
-                                             values-> fieldName);       \
+        append_header(values-> fieldName);                              \
     }
 
     // Would use CURLOPT_INFILESIZE_LARGE, but it is buggy in libcurl
     if ((params->httpRequestType == HttpRequestTypePUT) ||
         (params->httpRequestType == HttpRequestTypePOST)) {
         char header[256];
+        S3ChecksumAlgorithm trailerAlgorithm =
+            trailer_checksum_algorithm(params);
+        uint64_t contentLength = params->toS3CallbackTotalSize;
+        if (trailerAlgorithm) {
+            contentLength = checksum_chunked_length(trailerAlgorithm,
+                                                    contentLength);
+        }
         snprintf(header, sizeof(header), "Content-Length: %llu",
-                 (unsigned long long) params->toS3CallbackTotalSize);
-        request->headers = curl_slist_append(request->headers, header);
-        request->headers = curl_slist_append(request->headers,
-                                             "Transfer-Encoding:");
+                 (unsigned long long) contentLength);
+        append_header(header);
+        append_header("Transfer-Encoding:");
     }
     else if (params->httpRequestType == HttpRequestTypeCOPY) {
-        request->headers = curl_slist_append(request->headers,
-                                             "Transfer-Encoding:");
+        append_header("Transfer-Encoding:");
     }
 
     append_standard_header(hostHeader);
@@ -1268,10 +1701,12 @@ static S3Status setup_curl(Request *request,
     // Append x-amz- headers
     int i;
     for (i = 0; i < values->amzHeadersCount; i++) {
-        request->headers =
-            curl_slist_append(request->headers, values->amzHeaders[i]);
+        append_header(values->amzHeaders[i]);
     }
 
+#undef append_standard_header
+#undef append_header
+
     // Set the HTTP headers
     curl_easy_setopt_safe(CURLOPT_HTTPHEADER, request->headers);
 
@@ -1305,11 +1740,8 @@ static S3Status setup_curl(Request *request,
 
 static void request_deinitialize(Request *request)
 {
-    if (request->headers) {
-        curl_slist_free_all(request->headers);
-    }
-
-    error_parser_deinitialize(&(request->errorParser));
+    // The headers were allocated in the request's arena
+    request->headers = 0;
 
     // curl_easy_reset prevents connections from being re-used for some
     // reason.  This makes HTTP Keep-Alive meaningless and is very bad for
@@ -1320,11 +1752,13 @@ static void request_deinitialize(Request *request)
 
 
 static S3Status request_get(const RequestParams *params,
-                            const RequestComputedValues *values,
-                            const S3RequestContext *context,
+                            RequestComputedValues *values,
+                            S3RequestContext *context,
                             Request **reqReturn)
 {
     Request *request = 0;
+    S3Metrics *metrics = !requestMetricsEnabledG ? 0 :
+        context ? &(context->metrics) : &requestMetricsG;
 
     // Try to get one from the request stack.  We hold the lock for the
     // shortest time possible here.
@@ -1338,15 +1772,20 @@ static S3Status request_get(const RequestParams *params,
 
     // If we got one, deinitialize it for re-use
     if (request) {
+        probe0(handle__pool__hit);
         request_deinitialize(request);
     }
     // Else there wasn't one available in the request stack, so create one
     else {
-        if (!(request = (Request *) malloc(sizeof(Request)))) {
+        probe0(handle__pool__miss);
+        if (metrics) {
+            request_metrics_add(metrics->handlePoolMisses, 1);
+        }
+        if (!(request = (Request *) s3_malloc(sizeof(Request)))) {
             return S3StatusOutOfMemory;
         }
         if (!(request->curl = curl_easy_init())) {
-            free(request);
+            s3_free(request);
             return S3StatusFailedToInitializeRequest;
         }
     }
@@ -1359,25 +1798,40 @@ static S3Status request_get(const RequestParams *params,
     // an error occurs
     request->status = S3StatusOK;
 
+    request->metrics = metrics;
+    request->operation = params->operation;
+    request->startUs = request_metrics_now_us();
+
     S3Status status;
 
     // Start out with no headers
     request->headers = 0;
 
-    // Compute the URL
+    request_arena_initialize(&(request->arena),
+                             context ? &(context->slab) : &requestSlabG);
+
+    // Compute the URL, and copy it into the arena
     if ((status = compose_uri
-         (request->uri, sizeof(request->uri),
+         (values->uri, sizeof(values->uri),
           &(params->bucketContext), values->urlEncodedKey,
           params->subResource, params->queryParams)) != S3StatusOK) {
         curl_easy_cleanup(request->curl);
-        free(request);
+        s3_free(request);
         return status;
     }
 
+    if (!(request->uri = request_arena_strndup
+          (&(request->arena), values->uri, strlen(values->uri)))) {
+        curl_easy_cleanup(request->curl);
+        s3_free(request);
+        return S3StatusOutOfMemory;
+    }
+
     // Set all of the curl handle options
     if ((status = setup_curl(request, params, values)) != S3StatusOK) {
+        request_arena_deinitialize(&(request->arena));
         curl_easy_cleanup(request->curl);
-        free(request);
+        s3_free(request);
         return status;
     }
 
@@ -1385,8 +1839,9 @@ static S3Status request_get(const RequestParams *params,
         (status = context->setupCurlCallback(
                 context->curlm, request->curl,
                 context->setupCurlCallbackData)) != S3StatusOK) {
+        request_arena_deinitialize(&(request->arena));
         curl_easy_cleanup(request->curl);
-        free(request);
+        s3_free(request);
         return status;
     }
 
@@ -1396,17 +1851,42 @@ static S3Status request_get(const RequestParams *params,
 
     request->toS3CallbackBytesRemaining = params->toS3CallbackTotalSize;
 
+    request->checksumAlgorithm = trailer_checksum_algorithm(params);
+
+    request->checksum = 0;
+
+    request->verifyChecksum =
+        ((params->httpRequestType == HttpRequestTypeGET) &&
+         params->getConditions && params->getConditions->verifyChecksum &&
+         !params->startByte && !params->byteCount);
+
+    request->toS3ChunkRemaining = 0;
+
+    request->toS3FramingLen = request->toS3FramingSent = 0;
+
+    if (request->checksumAlgorithm) {
+        request->toS3ChunkRemaining =
+            (params->toS3CallbackTotalSize > CHECKSUM_CHUNK_SIZE) ?
+            CHECKSUM_CHUNK_SIZE : (int) params->toS3CallbackTotalSize;
+        request->toS3FramingLen = checksum_chunk_framing
+            (request->checksumAlgorithm, 0, 1, request->toS3ChunkRemaining,
+             request->toS3Framing);
+    }
+
     request->fromS3Callback = params->fromS3Callback;
 
     request->completeCallback = params->completeCallback;
 
     request->callbackData = params->callbackData;
 
-    response_headers_handler_initialize(&(request->responseHeadersHandler));
+    response_headers_handler_initialize(&(request->responseHeadersHandler),
+                                        &(request->arena));
 
     request->propertiesCallbackMade = 0;
 
-    error_parser_initialize(&(request->errorParser));
+    // If this fails, the error parser is got once an error body arrives, as
+    // usual
+    request->errorParser = eagerErrorParsersG ? error_parser_get() : 0;
 
     *reqReturn = request;
 
@@ -1418,12 +1898,22 @@ static void request_destroy(Request *request)
 {
     request_deinitialize(request);
     curl_easy_cleanup(request->curl);
-    free(request);
+    s3_free(request);
 }
 
 
 static void request_release(Request *request)
 {
+    if (request->errorParser) {
+        error_parser_release(request->errorParser);
+        request->errorParser = 0;
+    }
+
+    // The arena's block goes back to its slab now, since the request context
+    // that the slab belongs to may be gone by the time this Request is used
+    // again
+    request_arena_deinitialize(&(request->arena));
+
     pthread_mutex_lock(&requestStackMutexG);
 
     // If the request stack is full, destroy this one
@@ -1442,16 +1932,70 @@ static void request_release(Request *request)
 }
 
 
+// curl allocates through these when S3_set_allocator has been used
+static void *curl_malloc_func(size_t size)
+{
+    return s3_malloc(size);
+}
+
+
+static void curl_free_func(void *ptr)
+{
+    s3_free(ptr);
+}
+
+
+static void *curl_realloc_func(void *ptr, size_t size)
+{
+    return s3_realloc(ptr, size);
+}
+
+
+static char *curl_strdup_func(const char *str)
+{
+    size_t size = strlen(str) + 1;
+    char *copy = (char *) s3_malloc(size);
+
+    if (copy) {
+        memcpy(copy, str, size);
+    }
+
+    return copy;
+}
+
+
+static void *curl_calloc_func(size_t count, size_t size)
+{
+    void *ptr = s3_malloc(count * size);
+
+    if (ptr) {
+        memset(ptr, 0, count * size);
+    }
+
+    return ptr;
+}
+
+
 S3Status request_api_initialize(const char *userAgentInfo, int flags,
                                 const char *defaultHostName)
 {
-    if (curl_global_init(CURL_GLOBAL_ALL &
-                         ~((flags & S3_INIT_WINSOCK) ? 0 : CURL_GLOBAL_WIN32))
-        != CURLE_OK) {
+    long curlFlags = CURL_GLOBAL_ALL &
+        ~((flags & S3_INIT_WINSOCK) ? 0 : CURL_GLOBAL_WIN32);
+    CURLcode code = s3_allocator_is_set() ?
+        curl_global_init_mem(curlFlags, &curl_malloc_func, &curl_free_func,
+                             &curl_realloc_func, &curl_strdup_func,
+                             &curl_calloc_func) :
+        curl_global_init(curlFlags);
+
+    if (code != CURLE_OK) {
         return S3StatusInternalError;
     }
     verifyPeer = (flags & S3_INIT_VERIFY_PEER) != 0;
 
+    requestTimingsG = (flags & S3_INIT_REQUEST_TIMINGS) != 0;
+
+    requestMetricsEnabledG = (flags & S3_INIT_METRICS) != 0;
+
     if (!defaultHostName) {
         defaultHostName = S3_DEFAULT_HOSTNAME;
     }
@@ -1465,6 +2009,12 @@ S3Status request_api_initialize(const char *userAgentInfo, int flags,
 
     requestStackCountG = 0;
 
+    errorParserStackCountG = 0;
+
+    computedValuesStackCountG = 0;
+
+    request_slab_initialize(&requestSlabG);
+
     if (!userAgentInfo || !*userAgentInfo) {
         userAgentInfo = "Unknown";
     }
@@ -1483,7 +2033,6 @@ S3Status request_api_initialize(const char *userAgentInfo, int flags,
              "Mozilla/4.0 (Compatible; %s; libs3 %s.%s; %s)",
              userAgentInfo, LIBS3_VER_MAJOR, LIBS3_VER_MINOR, platform);
 
-    xmlInitParser();
     return S3StatusOK;
 }
 
@@ -1492,10 +2041,19 @@ void request_api_deinitialize()
 {
     pthread_mutex_destroy(&requestStackMutexG);
 
-    xmlCleanupParser();
     while (requestStackCountG--) {
         request_destroy(requestStackG[requestStackCountG]);
     }
+
+    while (errorParserStackCountG--) {
+        s3_free(errorParserStackG[errorParserStackCountG]);
+    }
+
+    while (computedValuesStackCountG--) {
+        s3_free(computedValuesStackG[computedValuesStackCountG]);
+    }
+
+    request_slab_deinitialize(&requestSlabG);
 }
 
 static S3Status setup_request(const RequestParams *params,
@@ -1541,9 +2099,12 @@ static S3Status setup_request(const RequestParams *params,
     canonicalize_resource(&params->bucketContext, computed->urlEncodedKey,
                           computed->canonicalURI,
                           sizeof(computed->canonicalURI));
-    canonicalize_query_string(params->queryParams, params->subResource,
-                              computed->canonicalQueryString,
-                              sizeof(computed->canonicalQueryString));
+    if ((status = canonicalize_query_string
+         (params->queryParams, params->subResource,
+          computed->queryStringScratch, computed->canonicalQueryString,
+          sizeof(computed->canonicalQueryString))) != S3StatusOK) {
+        return status;
+    }
 
     // Compose Authorization header
     if ((status = compose_auth_header(params, computed)) != S3StatusOK) {
@@ -1563,26 +2124,81 @@ static S3Status setup_request(const RequestParams *params,
 
 void request_perform(const RequestParams *params, S3RequestContext *context)
 {
-    Request *request;
+    Request *request = 0;
     S3Status status;
     int verifyPeerRequest = verifyPeer;
     CURLcode curlstatus;
-
-#define return_status(status)                                           \
-    (*(params->completeCallback))(status, 0, params->callbackData);     \
+    int traced = (traceHooksG.beginCallback != 0);
+    void *traceSpan = 0;
+    S3MetricsOperation operation = params->operation;
+    S3TraceEvent event;
+
+#define return_status(completeStatus)                                   \
+    if (traced) {                                                       \
+        trace_event_initialize(&event, S3TracePointComplete, operation); \
+        event.status = completeStatus;                                  \
+        (*(traceHooksG.endCallback))                                    \
+            (traceSpan, &event, traceHooksG.hookData);                  \
+    }                                                                   \
+    (*(params->completeCallback))                                       \
+        (completeStatus, 0, params->callbackData);                      \
     return
 
+    probe3(request__start, operation, params->bucketContext.bucketName,
+           params->key);
+
+    if (traced) {
+        trace_event_initialize(&event, S3TracePointRequestCreated, operation);
+        event.bucketName = params->bucketContext.bucketName;
+        event.key = params->key;
+        traceSpan = (*(traceHooksG.beginCallback))
+            (&event, traceHooksG.hookData);
+    }
+
     // These will hold the computed values
-    RequestComputedValues computed;
+    RequestComputedValues *computed = computed_values_get();
 
-    if ((status = setup_request(params, &computed, 0)) != S3StatusOK) {
-        return_status(status);
+    if (!computed) {
+        return_status(S3StatusOutOfMemory);
+    }
+
+    probe1(sign__start, operation);
+    status = setup_request(params, computed, 0);
+    probe1(sign__end, status);
+
+    if (status == S3StatusOK) {
+        if (traced && traceHooksG.eventCallback) {
+            trace_event_initialize(&event, S3TracePointSigningDone,
+                                   operation);
+            (*(traceHooksG.eventCallback))
+                (traceSpan, &event, traceHooksG.hookData);
+        }
+        // Get an initialized Request structure now
+        status = request_get(params, computed, context, &request);
     }
 
-    // Get an initialized Request structure now
-    if ((status = request_get(params, &computed, context, &request)) != S3StatusOK) {
+    // The computed values are only needed to set the request up
+    computed_values_release(computed);
+
+    if (status != S3StatusOK) {
         return_status(status);
     }
+
+    request->traceSpan = traceSpan;
+    request->tracePending = 0;
+    if (traced) {
+        request->tracePending =
+            trace_bit(S3TracePointFirstByteSent) |
+            trace_bit(S3TracePointHeadersReceived) |
+            trace_bit(S3TracePointFirstBodyByte) |
+            trace_bit(S3TracePointComplete);
+#if LIBCURL_VERSION_NUM >= 0x075000 /* 7.80.0 */
+        curl_easy_setopt(request->curl, CURLOPT_PREREQFUNCTION,
+                         &curl_prereq_func);
+        curl_easy_setopt(request->curl, CURLOPT_PREREQDATA, request);
+#endif
+        request_trace(request, S3TracePointHandleAcquired);
+    }
     if (context && context->verifyPeerSet) {
         verifyPeerRequest = context->verifyPeerSet;
     }
@@ -1598,8 +2214,10 @@ void request_perform(const RequestParams *params, S3RequestContext *context)
 
     // If a RequestContext was provided, add the request to the curl multi
     if (context) {
+        request->owner = context->owner;
         CURLMcode code = curl_multi_add_handle(context->curlm, request->curl);
         if (code == CURLM_OK) {
+            probe1(request__queued, request);
             if (context->requests) {
                 request->prev = context->requests->prev;
                 request->next = context->requests;
@@ -1632,6 +2250,50 @@ void request_perform(const RequestParams *params, S3RequestContext *context)
 }
 
 
+// Fills in [timings] with what curl measured of the request's transfer
+static void request_get_timings(Request *request, S3RequestTimings *timings)
+{
+    CURL *curl = request->curl;
+
+#if LIBCURL_VERSION_NUM >= 0x073d00 /* 7.61.0 */
+    curl_off_t value;
+#define get_info(info, field, scale)                                    \
+    timings->field = (curl_easy_getinfo(curl, info##_T, &value) ==      \
+                      CURLE_OK) ? value : 0
+#else
+    // The older curl reports times as a double number of seconds, which
+    // must be scaled before it is truncated
+    double value;
+#define get_info(info, field, scale)                                    \
+    timings->field = (curl_easy_getinfo(curl, info, &value) ==          \
+                      CURLE_OK) ? (int64_t) (value * (scale)) : 0
+#endif
+
+    get_info(CURLINFO_NAMELOOKUP_TIME, nameLookupUs, 1000000);
+    get_info(CURLINFO_CONNECT_TIME, connectUs, 1000000);
+    get_info(CURLINFO_APPCONNECT_TIME, appConnectUs, 1000000);
+    get_info(CURLINFO_PRETRANSFER_TIME, preTransferUs, 1000000);
+    get_info(CURLINFO_STARTTRANSFER_TIME, startTransferUs, 1000000);
+    get_info(CURLINFO_TOTAL_TIME, totalUs, 1000000);
+    get_info(CURLINFO_SIZE_UPLOAD, bytesUploaded, 1);
+    get_info(CURLINFO_SIZE_DOWNLOAD, bytesDownloaded, 1);
+
+#undef get_info
+
+    char *remoteIp = 0;
+    if ((curl_easy_getinfo(curl, CURLINFO_PRIMARY_IP, &remoteIp) !=
+         CURLE_OK) || !remoteIp) {
+        remoteIp = (char *) "";
+    }
+    timings->remoteIp = remoteIp;
+
+    // A connection was used but none had to be made for this request
+    long connects = 0;
+    curl_easy_getinfo(curl, CURLINFO_NUM_CONNECTS, &connects);
+    timings->connectionReused = remoteIp[0] && !connects;
+}
+
+
 void request_finish(Request *request)
 {
     // If we haven't detected this already, we now know that the headers are
@@ -1641,8 +2303,10 @@ void request_finish(Request *request)
     // If there was no error processing the request, then possibly there was
     // an S3 error parsed, which should be converted into the request status
     if (request->status == S3StatusOK) {
-        error_parser_convert_status(&(request->errorParser),
-                                    &(request->status));
+        if (request->errorParser) {
+            error_parser_convert_status(request->errorParser,
+                                        &(request->status));
+        }
         // If there still was no error recorded, then it is possible that
         // there was in fact an error but that there was no error XML
         // detailing the error
@@ -1702,16 +2366,74 @@ void request_finish(Request *request)
                 break;
             }
         }
+        // Check the data received against the checksum S3 sent for it
+        else if ((request->status == S3StatusOK) &&
+                 request->verifyChecksum) {
+            const S3ResponseProperties *properties =
+                &(request->responseHeadersHandler.responseProperties);
+            char checksum[S3_MAX_CHECKSUM_SIZE];
+            S3_encode_checksum(request->checksumAlgorithm, request->checksum,
+                               checksum);
+            if (strcmp(checksum, (request->checksumAlgorithm ==
+                                  S3ChecksumAlgorithmCRC32C) ?
+                       properties->checksumCRC32C :
+                       properties->checksumCRC64NVME)) {
+                request->status = S3StatusChecksumMismatch;
+            }
+        }
+    }
+
+    const S3ErrorDetails *errorDetails = request->errorParser ?
+        &(request->errorParser->s3ErrorDetails) : &emptyErrorDetailsG;
+
+    // Asking curl for the timings is only worth it if something uses them
+    S3RequestTimings timings;
+    if (requestTimingsG || request->metrics || PROBES_ENABLED) {
+        request_get_timings(request, &timings);
+    }
+    else {
+        memset(&timings, 0, sizeof(timings));
+        timings.remoteIp = "";
     }
 
+    int64_t latencyUs = request_metrics_now_us() - request->startUs;
+
+    if (request->metrics) {
+        request_metrics_record(request->metrics, request->operation,
+                               request->status, latencyUs, &timings);
+    }
+
+    probe6(request__finish, request, request->operation, request->status,
+           timings.bytesUploaded, timings.bytesDownloaded, latencyUs);
+
+    if (request->tracePending) {
+        request_trace(request, S3TracePointComplete);
+    }
+
+    // If timings were asked for, pass a copy of the error details carrying
+    // them
+    S3ErrorDetails timedErrorDetails;
+    if (requestTimingsG) {
+        timedErrorDetails = *errorDetails;
+        timedErrorDetails.timings = &timings;
+        errorDetails = &timedErrorDetails;
+    }
+
+    probe1(callback__start, PROBE_CALLBACK_COMPLETE);
     (*(request->completeCallback))
-        (request->status, &(request->errorParser.s3ErrorDetails),
-         request->callbackData);
+        (request->status, errorDetails, request->callbackData);
+    probe1(callback__end, PROBE_CALLBACK_COMPLETE);
 
     request_release(request);
 }
 
 
+void request_set_eager_error_parsers(int eager)
+{
+    eagerErrorParsersG = eager;
+}
+
+
 S3Status request_curl_code_to_status(CURLcode code)
 {
     switch (code) {
@@ -1757,36 +2479,47 @@ S3Status S3_generate_authenticated_query_string
         expires = MAX_EXPIRES;
     }
 
+    // The request is not performed here, so its operation is never counted
     RequestParams params =
-    { http_request_method_to_type(httpMethod), *bucketContext, key, NULL,
-        resource,
-        NULL, NULL, NULL, 0, 0, NULL, NULL, NULL, 0, NULL, NULL, NULL, 0};
+    { http_request_method_to_type(httpMethod), S3MetricsOperationGetObject,
+        *bucketContext, key, NULL, resource,
+        NULL, NULL, NULL, 0, 0, NULL, NULL, NULL, 0, NULL, NULL, NULL, 0,
+        S3ChecksumAlgorithmNone, NULL};
 
-    RequestComputedValues computed;
-    S3Status status = setup_request(&params, &computed, 1);
+    RequestComputedValues *computed = computed_values_get();
+    if (!computed) {
+        return S3StatusOutOfMemory;
+    }
+
+    S3Status status = setup_request(&params, computed, 1);
     if (status != S3StatusOK) {
+        computed_values_release(computed);
         return status;
     }
 
     // Finally, compose the URI, with params
     char queryParams[sizeof("X-Amz-Algorithm=AWS4-HMAC-SHA256") +
                      sizeof("&X-Amz-Credential=") +
-                     sizeof(computed.authCredential) +
+                     sizeof(computed->authCredential) +
                      sizeof("&X-Amz-Date=") +
-                     sizeof(computed.requestDateISO8601) +
+                     sizeof(computed->requestDateISO8601) +
                      sizeof("&X-Amz-Expires=") + 64 +
                      sizeof("&X-Amz-SignedHeaders=") +
-                     sizeof(computed.signedHeaders) +
+                     sizeof(computed->signedHeaders) +
                      sizeof("&X-Amz-Signature=") +
-                     sizeof(computed.requestSignatureHex) + 1];
+                     sizeof(computed->requestSignatureHex) + 1];
     snprintf(queryParams, sizeof(queryParams),
              "X-Amz-Algorithm=AWS4-HMAC-SHA256&X-Amz-Credential=%s"
              "&X-Amz-Date=%s&X-Amz-Expires=%d"
              "&X-Amz-SignedHeaders=%s&X-Amz-Signature=%s",
-             computed.authCredential, computed.requestDateISO8601, expires,
-             computed.signedHeaders, computed.requestSignatureHex);
+             computed->authCredential, computed->requestDateISO8601, expires,
+             computed->signedHeaders, computed->requestSignatureHex);
+
+    status = compose_uri(buffer, S3_MAX_AUTHENTICATED_QUERY_STRING_SIZE,
+                         bucketContext, computed->urlEncodedKey, resource,
+                         queryParams);
 
-    return compose_uri(buffer, S3_MAX_AUTHENTICATED_QUERY_STRING_SIZE,
-                       bucketContext, computed.urlEncodedKey, resource,
-                       queryParams);
+    computed_values_release(computed);
+
+    return status;
 }
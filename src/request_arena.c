@@ -0,0 +1,201 @@
+/** **************************************************************************
+ * request_arena.c
+ * 
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#include <stdlib.h>
+#include <string.h>
+#include "request_arena.h"
+#include "util.h"
+
+// Chunks, overflow blocks, and the slab blocks held by an arena start with a
+// link to the next one, padded so that what follows keeps the alignment that
+// malloc gave
+#define LINK_SIZE 16
+
+// Alignment of allocations made by request_arena_alloc
+#define ALLOC_ALIGN 8
+
+#define next_link(p) (*((void **) (p)))
+
+
+// slab ----------------------------------------------------------------------
+
+void request_slab_initialize(RequestSlab *slab)
+{
+    pthread_mutex_init(&(slab->mutex), 0);
+    slab->freeBlocks = 0;
+    slab->chunks = 0;
+}
+
+
+void request_slab_deinitialize(RequestSlab *slab)
+{
+    while (slab->chunks) {
+        void *next = next_link(slab->chunks);
+        s3_free(slab->chunks);
+        slab->chunks = next;
+    }
+
+    slab->freeBlocks = 0;
+
+    pthread_mutex_destroy(&(slab->mutex));
+}
+
+
+static char *slab_get_block(RequestSlab *slab)
+{
+    char *block;
+
+    pthread_mutex_lock(&(slab->mutex));
+
+    if (!slab->freeBlocks) {
+        char *chunk = (char *) s3_malloc
+            (LINK_SIZE + (REQUEST_SLAB_CHUNK_BLOCKS * REQUEST_SLAB_BLOCK_SIZE));
+        if (!chunk) {
+            pthread_mutex_unlock(&(slab->mutex));
+            return 0;
+        }
+        next_link(chunk) = slab->chunks;
+        slab->chunks = chunk;
+        // Put the blocks of the new chunk on the free list
+        int i;
+        for (i = REQUEST_SLAB_CHUNK_BLOCKS - 1; i >= 0; i--) {
+            block = &(chunk[LINK_SIZE + (i * REQUEST_SLAB_BLOCK_SIZE)]);
+            next_link(block) = slab->freeBlocks;
+            slab->freeBlocks = block;
+        }
+    }
+
+    block = (char *) slab->freeBlocks;
+    slab->freeBlocks = next_link(block);
+
+    pthread_mutex_unlock(&(slab->mutex));
+
+    return block;
+}
+
+
+static void slab_put_block(RequestSlab *slab, char *block)
+{
+    pthread_mutex_lock(&(slab->mutex));
+
+    next_link(block) = slab->freeBlocks;
+    slab->freeBlocks = block;
+
+    pthread_mutex_unlock(&(slab->mutex));
+}
+
+
+// arena ---------------------------------------------------------------------
+
+void request_arena_initialize(RequestArena *arena, RequestSlab *slab)
+{
+    arena->slab = slab;
+    arena->blocks = 0;
+    arena->current = 0;
+    arena->currentSize = arena->currentUsed = 0;
+    arena->overflows = 0;
+}
+
+
+static void *arena_alloc(RequestArena *arena, int size, int align)
+{
+    int offset = (arena->currentUsed + (align - 1)) & ~(align - 1);
+
+    if ((offset + size) > arena->currentSize) {
+        // Take another slab block, if the allocation fits in one
+        if (size <= (REQUEST_SLAB_BLOCK_SIZE - LINK_SIZE)) {
+            char *block = slab_get_block(arena->slab);
+            if (!block) {
+                return 0;
+            }
+            next_link(block) = arena->blocks;
+            arena->blocks = block;
+            arena->current = &(block[LINK_SIZE]);
+            arena->currentSize = REQUEST_SLAB_BLOCK_SIZE - LINK_SIZE;
+        }
+        // Else spill into a new overflow block
+        else {
+            int overflowSize = (size > REQUEST_ARENA_OVERFLOW_SIZE) ?
+                size : REQUEST_ARENA_OVERFLOW_SIZE;
+            char *overflow = (char *) s3_malloc(LINK_SIZE + overflowSize);
+            if (!overflow) {
+                return 0;
+            }
+            next_link(overflow) = arena->overflows;
+            arena->overflows = overflow;
+            arena->current = &(overflow[LINK_SIZE]);
+            arena->currentSize = overflowSize;
+        }
+        arena->currentUsed = offset = 0;
+    }
+
+    arena->currentUsed = offset + size;
+
+    return &(arena->current[offset]);
+}
+
+
+void *request_arena_alloc(RequestArena *arena, int size)
+{
+    return arena_alloc(arena, size, ALLOC_ALIGN);
+}
+
+
+char *request_arena_strndup(RequestArena *arena, const char *str, int len)
+{
+    char *copy = (char *) arena_alloc(arena, len + 1, 1);
+
+    if (copy) {
+        memcpy(copy, str, len);
+        copy[len] = 0;
+    }
+
+    return copy;
+}
+
+
+void request_arena_deinitialize(RequestArena *arena)
+{
+    while (arena->blocks) {
+        void *next = next_link(arena->blocks);
+        slab_put_block(arena->slab, (char *) arena->blocks);
+        arena->blocks = next;
+    }
+
+    while (arena->overflows) {
+        void *next = next_link(arena->overflows);
+        s3_free(arena->overflows);
+        arena->overflows = next;
+    }
+
+    request_arena_initialize(arena, arena->slab);
+}
@@ -32,7 +32,9 @@
 
 #include <curl/curl.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/select.h>
+#include "probes.h"
 #include "request.h"
 #include "request_context.h"
 
@@ -43,7 +45,7 @@ S3Status S3_create_request_context_ex(S3RequestContext **requestContextReturn,
                                       void *setupCurlCallbackData)
 {
     *requestContextReturn = 
-        (S3RequestContext *) malloc(sizeof(S3RequestContext));
+        (S3RequestContext *) s3_malloc(sizeof(S3RequestContext));
     
     if (!*requestContextReturn) {
         return S3StatusOutOfMemory;
@@ -55,7 +57,7 @@ S3Status S3_create_request_context_ex(S3RequestContext **requestContextReturn,
     }
     else {
         if (!((*requestContextReturn)->curlm = curl_multi_init())) {
-            free(*requestContextReturn);
+            s3_free(*requestContextReturn);
             return S3StatusOutOfMemory;
         }
 
@@ -67,6 +69,9 @@ S3Status S3_create_request_context_ex(S3RequestContext **requestContextReturn,
     (*requestContextReturn)->verifyPeerSet = 0;
     (*requestContextReturn)->setupCurlCallback = setupCurlCallback;
     (*requestContextReturn)->setupCurlCallbackData = setupCurlCallbackData;
+    request_slab_initialize(&((*requestContextReturn)->slab));
+    memset(&((*requestContextReturn)->metrics), 0, sizeof(S3Metrics));
+    (*requestContextReturn)->owner = 0;
 
     return S3StatusOK;
 }
@@ -96,7 +101,37 @@ void S3_destroy_request_context(S3RequestContext *requestContext)
     if (requestContext->curl_mode == S3CurlModeMultiPerform)
         curl_multi_cleanup(requestContext->curlm);
 
-    free(requestContext);
+    request_slab_deinitialize(&(requestContext->slab));
+
+    s3_free(requestContext);
+}
+
+
+S3Status request_context_wait(S3RequestContext *requestContext,
+                              int *requestsRemainingReturn)
+{
+    fd_set readfds, writefds, exceptfds;
+    FD_ZERO(&readfds);
+    FD_ZERO(&writefds);
+    FD_ZERO(&exceptfds);
+    int maxfd;
+    S3Status status = S3_get_request_context_fdsets
+        (requestContext, &readfds, &writefds, &exceptfds, &maxfd);
+    if (status != S3StatusOK) {
+        return status;
+    }
+    // curl will return -1 if it hasn't even created any fds yet because
+    // none of the connections have started yet.  In this case, don't
+    // do the select at all, because it will wait forever; instead, just
+    // skip it and go straight to running the underlying CURL handles
+    if (maxfd != -1) {
+        int64_t timeout = S3_get_request_context_timeout(requestContext);
+        struct timeval tv = { timeout / 1000, (timeout % 1000) * 1000 };
+        select(maxfd + 1, &readfds, &writefds, &exceptfds,
+               (timeout == -1) ? 0 : &tv);
+    }
+    return S3_runonce_request_context(requestContext,
+                                      requestsRemainingReturn);
 }
 
 
@@ -104,28 +139,8 @@ S3Status S3_runall_request_context(S3RequestContext *requestContext)
 {
     int requestsRemaining;
     do {
-        fd_set readfds, writefds, exceptfds;
-        FD_ZERO(&readfds);
-        FD_ZERO(&writefds);
-        FD_ZERO(&exceptfds);
-        int maxfd;
-        S3Status status = S3_get_request_context_fdsets
-            (requestContext, &readfds, &writefds, &exceptfds, &maxfd);
-        if (status != S3StatusOK) {
-            return status;
-        }
-        // curl will return -1 if it hasn't even created any fds yet because
-        // none of the connections have started yet.  In this case, don't
-        // do the select at all, because it will wait forever; instead, just
-        // skip it and go straight to running the underlying CURL handles
-        if (maxfd != -1) {
-            int64_t timeout = S3_get_request_context_timeout(requestContext);
-            struct timeval tv = { timeout / 1000, (timeout % 1000) * 1000 };
-            select(maxfd + 1, &readfds, &writefds, &exceptfds,
-                   (timeout == -1) ? 0 : &tv);
-        }
-        status = S3_runonce_request_context(requestContext,
-                                            &requestsRemaining);
+        S3Status status = request_context_wait(requestContext,
+                                               &requestsRemaining);
         if (status != S3StatusOK) {
             return status;
         }
@@ -135,6 +150,68 @@ S3Status S3_runall_request_context(S3RequestContext *requestContext)
 }
 
 
+// Removes the request from the list of requests
+static void request_context_unlink(S3RequestContext *requestContext,
+                                   Request *request)
+{
+    if (request->prev == request->next) {
+        // It was the only one on the list
+        requestContext->requests = 0;
+    }
+    else {
+        // It doesn't matter what the order of them are, so just in case
+        // request was at the head of the list, put the one after request to
+        // the head of the list
+        requestContext->requests = request->next;
+        request->prev->next = request->next;
+        request->next->prev = request->prev;
+    }
+}
+
+
+void *request_context_set_owner(S3RequestContext *requestContext,
+                                void *owner)
+{
+    void *previous = requestContext->owner;
+
+    requestContext->owner = owner;
+
+    return previous;
+}
+
+
+// Returns a request in the context that belongs to [owner], or 0 if none
+static Request *request_context_find(S3RequestContext *requestContext,
+                                     void *owner)
+{
+    Request *r = requestContext->requests, *rFirst = r;
+
+    if (r) do {
+        if (r->owner == owner) {
+            return r;
+        }
+        r = r->next;
+    } while (r != rFirst);
+
+    return 0;
+}
+
+
+void request_context_cancel(S3RequestContext *requestContext, void *owner)
+{
+    Request *r;
+
+    // Finishing a request makes callbacks which may add or complete others,
+    // so the list is searched again from the start after each one
+    while ((r = request_context_find(requestContext, owner))) {
+        request_context_unlink(requestContext, r);
+        r->status = S3StatusInterrupted;
+        curl_multi_remove_handle(requestContext->curlm, r->curl);
+        request_finish(r);
+    }
+}
+
+
 static S3Status process_request_context(S3RequestContext *requestContext, int *retry)
 {
     CURLMsg *msg;
@@ -151,19 +228,7 @@ static S3Status process_request_context(S3RequestContext *requestContext, int *r
                               (char **) (char *) &request) != CURLE_OK) {
             return S3StatusInternalError;
         }
-        // Remove the request from the list of requests
-        if (request->prev == request->next) {
-            // It was the only one on the list
-            requestContext->requests = 0;
-        }
-        else {
-            // It doesn't matter what the order of them are, so just in
-            // case request was at the head of the list, put the one after
-            // request to the head of the list
-            requestContext->requests = request->next;
-            request->prev->next = request->next;
-            request->next->prev = request->prev;
-        }
+        request_context_unlink(requestContext, request);
         if ((msg->data.result != CURLE_OK) &&
             (request->status == S3StatusOK)) {
             request->status = request_curl_code_to_status(
@@ -173,6 +238,7 @@ static S3Status process_request_context(S3RequestContext *requestContext, int *r
                                      msg->easy_handle) != CURLM_OK) {
             return S3StatusInternalError;
         }
+        probe2(context__request__done, request, msg->data.result);
         // Finish the request, ensuring that all callbacks have been made,
         // and also releases the request
         request_finish(request);
@@ -0,0 +1,327 @@
+/** **************************************************************************
+ * request_metrics.c
+ * 
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#include <curl/curl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "request_context.h"
+#include "request_metrics.h"
+
+// Durations of less than this many microseconds have a bucket each; above
+// it, each power of two is split into this many buckets
+#define HISTOGRAM_SUB_BUCKETS 4
+
+// log2(HISTOGRAM_SUB_BUCKETS)
+#define HISTOGRAM_SUB_BUCKET_BITS 2
+
+// The power of two below which durations are counted precisely; longer ones
+// fall into the last bucket
+#define HISTOGRAM_MAX_BITS 36
+
+S3Metrics requestMetricsG;
+
+static const char *operationNamesG[S3MetricsOperationCount] =
+{
+    "ListBuckets", "GetBucketLocation", "CreateBucket", "DeleteBucket",
+    "ListObjects", "PutObject", "CopyObject", "GetObject", "HeadObject",
+    "DeleteObject", "DeleteObjects", "GetACL", "PutACL",
+    "GetBucketLifecycle", "PutBucketLifecycle", "GetBucketLogging",
+    "PutBucketLogging", "CreateMultipartUpload", "UploadPart",
+    "UploadPartCopy", "CompleteMultipartUpload", "AbortMultipartUpload",
+    "ListMultipartUploads", "ListParts"
+};
+
+
+// recording -----------------------------------------------------------------
+
+int64_t request_metrics_now_us()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (((int64_t) now.tv_sec) * 1000000) + (now.tv_nsec / 1000);
+}
+
+
+static int histogram_bucket(uint64_t us)
+{
+    if (us < HISTOGRAM_SUB_BUCKETS) {
+        return (int) us;
+    }
+
+    if (us >> HISTOGRAM_MAX_BITS) {
+        return S3_METRICS_HISTOGRAM_BUCKET_COUNT - 1;
+    }
+
+    // Find the power of two, and which quarter of it the duration is in
+    int bits = HISTOGRAM_SUB_BUCKET_BITS;
+    while (us >> (bits + 1)) {
+        bits++;
+    }
+    int shift = bits - HISTOGRAM_SUB_BUCKET_BITS;
+
+    return (HISTOGRAM_SUB_BUCKETS + (shift * HISTOGRAM_SUB_BUCKETS) +
+            (int) ((us >> shift) & (HISTOGRAM_SUB_BUCKETS - 1)));
+}
+
+
+static void histogram_record(S3MetricsHistogram *histogram, int64_t us)
+{
+    if (us < 0) {
+        us = 0;
+    }
+
+    request_metrics_add(histogram->count, 1);
+    request_metrics_add(histogram->sumUs, us);
+    request_metrics_add(histogram->buckets[histogram_bucket(us)], 1);
+}
+
+
+void request_metrics_record(S3Metrics *metrics, S3MetricsOperation operation,
+                            S3Status status, int64_t durationUs,
+                            const S3RequestTimings *timings)
+{
+    request_metrics_add(metrics->requests[operation][status], 1);
+
+    histogram_record(&(metrics->durations[operation]), durationUs);
+
+    histogram_record(&(metrics->queueTimes), durationUs - timings->totalUs);
+
+    if (timings->bytesUploaded) {
+        request_metrics_add(metrics->bytesUploaded, timings->bytesUploaded);
+    }
+
+    if (timings->bytesDownloaded) {
+        request_metrics_add(metrics->bytesDownloaded,
+                            timings->bytesDownloaded);
+    }
+
+    if (S3_status_is_retryable(status)) {
+        request_metrics_add(metrics->retryableFailures, 1);
+    }
+
+    if (status == S3StatusErrorSlowDown) {
+        request_metrics_add(metrics->throttles, 1);
+    }
+
+    if (timings->connectionReused) {
+        request_metrics_add(metrics->connectionsReused, 1);
+    }
+    else if (timings->remoteIp[0]) {
+        request_metrics_add(metrics->connectionsNew, 1);
+    }
+}
+
+
+// snapshot ------------------------------------------------------------------
+
+void S3_get_metrics(S3RequestContext *requestContext, S3Metrics *metrics)
+{
+    // S3Metrics consists only of uint64_t counters, which are read
+    // atomically one at a time
+    uint64_t *from = (uint64_t *)
+        (requestContext ? &(requestContext->metrics) : &requestMetricsG);
+    uint64_t *to = (uint64_t *) metrics;
+    unsigned int i;
+
+    for (i = 0; i < (sizeof(S3Metrics) / sizeof(uint64_t)); i++) {
+        to[i] = __sync_fetch_and_add(&(from[i]), 0);
+    }
+}
+
+
+uint64_t S3_metrics_histogram_bucket_limit(int bucket)
+{
+    if (bucket < HISTOGRAM_SUB_BUCKETS) {
+        return bucket + 1;
+    }
+
+    int shift = (bucket - HISTOGRAM_SUB_BUCKETS) / HISTOGRAM_SUB_BUCKETS;
+    int sub = (bucket - HISTOGRAM_SUB_BUCKETS) % HISTOGRAM_SUB_BUCKETS;
+
+    return ((uint64_t) (HISTOGRAM_SUB_BUCKETS + sub + 1)) << shift;
+}
+
+
+// prometheus ----------------------------------------------------------------
+
+typedef struct RenderBuffer
+{
+    char *buffer;
+
+    int bufferSize;
+
+    int len;
+} RenderBuffer;
+
+
+static void render(RenderBuffer *rb, const char *format, ...)
+{
+    va_list args;
+    int remaining = (rb->len < rb->bufferSize) ? (rb->bufferSize - rb->len) : 0;
+
+    va_start(args, format);
+    int len = vsnprintf(remaining ? &(rb->buffer[rb->len]) : 0, remaining,
+                        format, args);
+    va_end(args);
+
+    if (len > 0) {
+        rb->len += len;
+    }
+}
+
+
+// Renders a number of microseconds as seconds
+static void render_seconds(RenderBuffer *rb, uint64_t us)
+{
+    render(rb, "%llu.%06llu", (unsigned long long) (us / 1000000),
+           (unsigned long long) (us % 1000000));
+}
+
+
+// Renders the samples of a histogram; [labels] are rendered before the le
+// label of each bucket, and are empty or end with a comma
+static void render_histogram(RenderBuffer *rb, const char *name,
+                             const char *labels,
+                             const S3MetricsHistogram *histogram)
+{
+    uint64_t cumulative = 0;
+    int i;
+
+    for (i = 0; i < (S3_METRICS_HISTOGRAM_BUCKET_COUNT - 1); i++) {
+        cumulative += histogram->buckets[i];
+        uint64_t limit = S3_metrics_histogram_bucket_limit(i);
+        // Only powers of two become Prometheus buckets
+        if (limit & (limit - 1)) {
+            continue;
+        }
+        render(rb, "%s_bucket{%sle=\"", name, labels);
+        render_seconds(rb, limit);
+        render(rb, "\"} %llu\n", (unsigned long long) cumulative);
+    }
+
+    render(rb, "%s_bucket{%sle=\"+Inf\"} %llu\n", name, labels,
+           (unsigned long long) histogram->count);
+
+    // The labels in braces, without the trailing comma, if there are any
+    char braced[64];
+    int labelsLen = strlen(labels);
+    if (labelsLen) {
+        snprintf(braced, sizeof(braced), "{%.*s}", labelsLen - 1, labels);
+    }
+    else {
+        braced[0] = 0;
+    }
+    render(rb, "%s_sum%s ", name, braced);
+    render_seconds(rb, histogram->sumUs);
+    render(rb, "\n%s_count%s %llu\n", name, braced,
+           (unsigned long long) histogram->count);
+}
+
+
+static void render_counter(RenderBuffer *rb, const char *name,
+                           const char *help, uint64_t value)
+{
+    render(rb, "# HELP %s %s\n# TYPE %s counter\n%s %llu\n", name, help,
+           name, name, (unsigned long long) value);
+}
+
+
+int S3_render_metrics_prometheus(const S3Metrics *metrics, char *buffer,
+                                 int bufferSize)
+{
+    RenderBuffer rb = { buffer, bufferSize, 0 };
+    char labels[64];
+    int op, status;
+
+    if (bufferSize > 0) {
+        buffer[0] = 0;
+    }
+
+    render(&rb, "# HELP s3_requests_total Requests completed, by operation "
+           "and status.\n# TYPE s3_requests_total counter\n");
+    for (op = 0; op < S3MetricsOperationCount; op++) {
+        for (status = 0; status < S3_METRICS_STATUS_COUNT; status++) {
+            if (metrics->requests[op][status]) {
+                render(&rb, "s3_requests_total{operation=\"%s\","
+                       "status=\"%s\"} %llu\n", operationNamesG[op],
+                       S3_get_status_name((S3Status) status),
+                       (unsigned long long) metrics->requests[op][status]);
+            }
+        }
+    }
+
+    render(&rb, "# HELP s3_request_duration_seconds Time from the start of "
+           "requests until they completed.\n"
+           "# TYPE s3_request_duration_seconds histogram\n");
+    for (op = 0; op < S3MetricsOperationCount; op++) {
+        if (metrics->durations[op].count) {
+            snprintf(labels, sizeof(labels), "operation=\"%s\",",
+                     operationNamesG[op]);
+            render_histogram(&rb, "s3_request_duration_seconds", labels,
+                             &(metrics->durations[op]));
+        }
+    }
+
+    render(&rb, "# HELP s3_request_queue_seconds Time of requests not spent "
+           "in their transfer.\n# TYPE s3_request_queue_seconds histogram\n");
+    render_histogram(&rb, "s3_request_queue_seconds", "",
+                     &(metrics->queueTimes));
+
+    render_counter(&rb, "s3_bytes_uploaded_total",
+                   "Bytes of request bodies sent.", metrics->bytesUploaded);
+    render_counter(&rb, "s3_bytes_downloaded_total",
+                   "Bytes of response bodies received.",
+                   metrics->bytesDownloaded);
+    render_counter(&rb, "s3_retryable_failures_total",
+                   "Requests completed with a retryable status.",
+                   metrics->retryableFailures);
+    render_counter(&rb, "s3_throttles_total",
+                   "Requests completed with SlowDown.", metrics->throttles);
+
+    render(&rb, "# HELP s3_connections_total Requests sent, by whether their "
+           "connection was new or reused.\n"
+           "# TYPE s3_connections_total counter\n"
+           "s3_connections_total{connection=\"new\"} %llu\n"
+           "s3_connections_total{connection=\"reused\"} %llu\n",
+           (unsigned long long) metrics->connectionsNew,
+           (unsigned long long) metrics->connectionsReused);
+
+    render_counter(&rb, "s3_handle_pool_misses_total",
+                   "Requests for which a new curl handle was created.",
+                   metrics->handlePoolMisses);
+
+    return rb.len;
+}
@@ -36,7 +36,168 @@
 #include "response_headers_handler.h"
 
 
-void response_headers_handler_initialize(ResponseHeadersHandler *handler)
+// Response header dispatch ---------------------------------------------------
+
+// Headers are dispatched through a perfect hash of the header name, computed
+// from its length and its first and last characters.  Header names consist
+// only of letters, digits and '-', all of which are made lower case by
+// or-ing in 0x20.
+#define RESPONSE_HEADER_HASH_SIZE 32
+
+#define response_header_hash(name, len)                                 \
+    (((len) + ((name)[0] | 0x20) + (4 * ((name)[(len) - 1] | 0x20))) &  \
+     (RESPONSE_HEADER_HASH_SIZE - 1))
+
+typedef enum
+{
+    ResponseHeaderRequestId,
+    ResponseHeaderRequestId2,
+    ResponseHeaderContentType,
+    ResponseHeaderContentLength,
+    ResponseHeaderServer,
+    ResponseHeaderETag,
+    ResponseHeaderChecksumCRC32C,
+    ResponseHeaderChecksumCRC64NVME,
+    ResponseHeaderServerSideEncryption
+} ResponseHeader;
+
+typedef struct ResponseHeaderName
+{
+    const char *name;
+    int nameLen;
+} ResponseHeaderName;
+
+#define RESPONSE_HEADER_NAME(name) { name, sizeof(name) - 1 }
+
+// Indexed by ResponseHeader
+static const ResponseHeaderName responseHeaderNamesG[] =
+{
+    RESPONSE_HEADER_NAME("x-amz-request-id"),
+    RESPONSE_HEADER_NAME("x-amz-id-2"),
+    RESPONSE_HEADER_NAME("content-type"),
+    RESPONSE_HEADER_NAME("content-length"),
+    RESPONSE_HEADER_NAME("server"),
+    RESPONSE_HEADER_NAME("etag"),
+    RESPONSE_HEADER_NAME("x-amz-checksum-crc32c"),
+    RESPONSE_HEADER_NAME("x-amz-checksum-crc64nvme"),
+    RESPONSE_HEADER_NAME("x-amz-server-side-encryption")
+};
+
+// Maps each hash value to one more than the ResponseHeader having that hash,
+// or to 0 if no header has that hash.  Regenerate this if a header is added
+// to responseHeaderNamesG; no two headers may share a hash value.
+static const signed char responseHeaderSlotsG[RESPONSE_HEADER_HASH_SIZE] =
+{
+    0, 5, 0, 3, 8, 6, 0, 0, 0, 0, 2, 0, 9, 0, 0, 0,
+    0, 4, 0, 0, 0, 0, 0, 0, 1, 7, 0, 0, 0, 0, 0, 0
+};
+
+
+// Returns the ResponseHeader named by the given header name, or -1 if it is
+// not one that is parsed into S3ResponseProperties
+static int lookup_response_header(const char *name, int nameLen)
+{
+    int slot = responseHeaderSlotsG[response_header_hash(name, nameLen)];
+
+    if (!slot) {
+        return -1;
+    }
+
+    const ResponseHeaderName *entry = &(responseHeaderNamesG[slot - 1]);
+
+    if ((entry->nameLen != nameLen) ||
+        strncasecmp(name, entry->name, nameLen)) {
+        return -1;
+    }
+
+    return slot - 1;
+}
+
+
+// Extra response headers -----------------------------------------------------
+
+// The headers registered by S3_set_extra_response_headers, hashed with
+// response_header_hash into extraResponseHeaderSlotsG with linear probing
+typedef struct ExtraResponseHeaderName
+{
+    char name[S3_MAX_EXTRA_RESPONSE_HEADER_NAME_SIZE + 1];
+    int nameLen;
+} ExtraResponseHeaderName;
+
+static ExtraResponseHeaderName
+    extraResponseHeaderNamesG[S3_MAX_EXTRA_RESPONSE_HEADERS];
+
+static int extraResponseHeadersCountG = 0;
+
+static signed char extraResponseHeaderSlotsG[RESPONSE_HEADER_HASH_SIZE];
+
+
+S3Status S3_set_extra_response_headers(int count, const char **names)
+{
+    int i;
+
+    if (count > S3_MAX_EXTRA_RESPONSE_HEADERS) {
+        return S3StatusHeadersTooLong;
+    }
+
+    for (i = 0; i < count; i++) {
+        const char *c = names[i];
+        while (*c && (*c != ':') && !is_blank(*c) &&
+               ((unsigned char) *c > ' ') && ((unsigned char) *c < 127)) {
+            c++;
+        }
+        if (*c || (c == names[i])) {
+            return S3StatusBadResponseHeaderName;
+        }
+        if ((c - names[i]) > S3_MAX_EXTRA_RESPONSE_HEADER_NAME_SIZE) {
+            return S3StatusHeadersTooLong;
+        }
+    }
+
+    memset(extraResponseHeaderSlotsG, 0, sizeof(extraResponseHeaderSlotsG));
+
+    for (i = 0; i < count; i++) {
+        ExtraResponseHeaderName *entry = &(extraResponseHeaderNamesG[i]);
+        entry->nameLen = strlen(names[i]);
+        memcpy(entry->name, names[i], entry->nameLen + 1);
+        int hash = response_header_hash(entry->name, entry->nameLen);
+        while (extraResponseHeaderSlotsG[hash]) {
+            hash = (hash + 1) & (RESPONSE_HEADER_HASH_SIZE - 1);
+        }
+        extraResponseHeaderSlotsG[hash] = i + 1;
+    }
+
+    extraResponseHeadersCountG = count;
+
+    return S3StatusOK;
+}
+
+
+// Returns the registered name of the extra response header matching the
+// given header name, or 0 if it was not registered
+static const char *lookup_extra_response_header(const char *name, int nameLen)
+{
+    int hash = response_header_hash(name, nameLen);
+    int slot;
+
+    while ((slot = extraResponseHeaderSlotsG[hash])) {
+        const ExtraResponseHeaderName *entry =
+            &(extraResponseHeaderNamesG[slot - 1]);
+        if ((entry->nameLen == nameLen) &&
+            !strncasecmp(name, entry->name, nameLen)) {
+            return entry->name;
+        }
+        hash = (hash + 1) & (RESPONSE_HEADER_HASH_SIZE - 1);
+    }
+
+    return 0;
+}
+
+
+// Response headers handler ---------------------------------------------------
+
+void response_headers_handler_initialize(ResponseHeadersHandler *handler,
+                                         RequestArena *arena)
 {
     handler->responseProperties.requestId = 0;
     handler->responseProperties.requestId2 = 0;
@@ -48,9 +209,69 @@ void response_headers_handler_initialize(ResponseHeadersHandler *handler)
     handler->responseProperties.metaDataCount = 0;
     handler->responseProperties.metaData = 0;
     handler->responseProperties.usesServerSideEncryption = 0;
+    handler->responseProperties.checksumCRC32C = 0;
+    handler->responseProperties.checksumCRC64NVME = 0;
+    handler->responseProperties.extraHeadersCount = 0;
+    handler->responseProperties.extraHeaders = 0;
     handler->done = 0;
-    string_multibuffer_initialize(handler->responsePropertyStrings);
-    string_multibuffer_initialize(handler->responseMetaDataStrings);
+    handler->arena = arena;
+    handler->metaData = handler->extraHeaders = 0;
+}
+
+
+// Adds a header to the front of the given list, copying its name unless
+// [copyName] is 0, and its value.  Headers are dropped if out of memory.
+static void add_header_entry(ResponseHeadersHandler *handler,
+                             ResponseHeaderEntry **list, int *count,
+                             const char *name, int nameLen, int copyName,
+                             const char *value, int valueLen)
+{
+    ResponseHeaderEntry *entry = (ResponseHeaderEntry *)
+        request_arena_alloc(handler->arena, sizeof(ResponseHeaderEntry));
+
+    if (!entry) {
+        return;
+    }
+
+    entry->nameValue.name = copyName ?
+        request_arena_strndup(handler->arena, name, nameLen) : name;
+    entry->nameValue.value =
+        request_arena_strndup(handler->arena, value, valueLen);
+    if (!entry->nameValue.name || !entry->nameValue.value) {
+        return;
+    }
+
+    entry->next = *list;
+    *list = entry;
+    (*count)++;
+}
+
+
+// Makes an array of the [count] headers on the given list, in the order in
+// which they were received
+static const S3NameValue *make_header_array(ResponseHeadersHandler *handler,
+                                            const ResponseHeaderEntry *list,
+                                            int *count)
+{
+    if (!*count) {
+        return 0;
+    }
+
+    S3NameValue *array = (S3NameValue *) request_arena_alloc
+        (handler->arena, *count * sizeof(S3NameValue));
+
+    if (!array) {
+        *count = 0;
+        return 0;
+    }
+
+    int i = *count;
+    while (i--) {
+        array[i] = list->nameValue;
+        list = list->next;
+    }
+
+    return array;
 }
 
 
@@ -67,14 +288,6 @@ void response_headers_handler_add(ResponseHeadersHandler *handler,
         return;
     }
 
-    // If we've already filled up the response headers, ignore this data.
-    // This sucks, but it shouldn't happen - S3 should not be sending back
-    // really long headers.
-    if (handler->responsePropertyStringsSize == 
-        (sizeof(handler->responsePropertyStrings) - 1)) {
-        return;
-    }
-
     // It should not be possible to have a header line less than 3 long
     if (len < 3) {
         return;
@@ -96,7 +309,7 @@ void response_headers_handler_add(ResponseHeadersHandler *handler,
         end++;
     }
 
-    if (end == header) {
+    if (end <= header) {
         // totally bogus
         return;
     }
@@ -111,6 +324,11 @@ void response_headers_handler_add(ResponseHeadersHandler *handler,
     
     int namelen = c - header;
 
+    // Lines without a colon, such as the status line, are not headers
+    if (!*c || !namelen) {
+        return;
+    }
+
     // Now walk c past the colon
     c++;
     // Now skip whitespace to the beginning of the value
@@ -118,92 +336,78 @@ void response_headers_handler_add(ResponseHeadersHandler *handler,
         c++;
     }
 
-    int valuelen = (end - c) + 1, fit;
+    int valuelen = end - c;
 
-    if (!strncasecmp(header, "x-amz-request-id", namelen)) {
-        responseProperties->requestId = 
-            string_multibuffer_current(handler->responsePropertyStrings);
-        string_multibuffer_add(handler->responsePropertyStrings, c, 
-                               valuelen, fit);
-    }
-    else if (!strncasecmp(header, "x-amz-id-2", namelen)) {
-        responseProperties->requestId2 = 
-            string_multibuffer_current(handler->responsePropertyStrings);
-        string_multibuffer_add(handler->responsePropertyStrings, c, 
-                               valuelen, fit);
-    }
-    else if (!strncasecmp(header, "Content-Type", namelen)) {
-        responseProperties->contentType = 
-            string_multibuffer_current(handler->responsePropertyStrings);
-        string_multibuffer_add(handler->responsePropertyStrings, c, 
-                               valuelen, fit);
-    }
-    else if (!strncasecmp(header, "Content-Length", namelen)) {
-        handler->responseProperties.contentLength = 0;
-        while (*c) {
-            handler->responseProperties.contentLength *= 10;
-            handler->responseProperties.contentLength += (*c++ - '0');
+    if (extraResponseHeadersCountG) {
+        const char *extraName = lookup_extra_response_header(header, namelen);
+        if (extraName && (responseProperties->extraHeadersCount <
+                          S3_MAX_EXTRA_RESPONSE_HEADERS)) {
+            add_header_entry(handler, &(handler->extraHeaders),
+                             &(responseProperties->extraHeadersCount),
+                             extraName, 0, 0, c, valuelen);
         }
     }
-    else if (!strncasecmp(header, "Server", namelen)) {
-        responseProperties->server = 
-            string_multibuffer_current(handler->responsePropertyStrings);
-        string_multibuffer_add(handler->responsePropertyStrings, c, 
-                               valuelen, fit);
-    }
-    else if ((!strncasecmp(header, "ETag", namelen)) 
-         || (!strncasecmp(header, "Etag", namelen))) { // some servers reply with Etag header
-        responseProperties->eTag = 
-            string_multibuffer_current(handler->responsePropertyStrings);
-        string_multibuffer_add(handler->responsePropertyStrings, c, 
-                               valuelen, fit);
-    }
-    else if (!strncasecmp(header, S3_METADATA_HEADER_NAME_PREFIX, 
-                      sizeof(S3_METADATA_HEADER_NAME_PREFIX) - 1)) {
-        // Make sure there is room for another x-amz-meta header
-        if (handler->responseProperties.metaDataCount ==
-            sizeof(handler->responseMetaData)) {
-            return;
-        }
-        // Copy the name in
-        char *metaName = &(header[sizeof(S3_METADATA_HEADER_NAME_PREFIX) - 1]);
-        int metaNameLen = 
-            (namelen - (sizeof(S3_METADATA_HEADER_NAME_PREFIX) - 1));
-        char *copiedName = 
-            string_multibuffer_current(handler->responseMetaDataStrings);
-        string_multibuffer_add(handler->responseMetaDataStrings, metaName,
-                               metaNameLen, fit);
-        if (!fit) {
-            return;
-        }
 
-        // Copy the value in
-        char *copiedValue = 
-            string_multibuffer_current(handler->responseMetaDataStrings);
-        string_multibuffer_add(handler->responseMetaDataStrings,
-                               c, valuelen, fit);
-        if (!fit) {
-            return;
+    if ((namelen > (int) (sizeof(S3_METADATA_HEADER_NAME_PREFIX) - 1)) &&
+        !strncasecmp(header, S3_METADATA_HEADER_NAME_PREFIX,
+                     sizeof(S3_METADATA_HEADER_NAME_PREFIX) - 1)) {
+        if (responseProperties->metaDataCount < (int) S3_MAX_METADATA_COUNT) {
+            add_header_entry
+                (handler, &(handler->metaData),
+                 &(responseProperties->metaDataCount),
+                 &(header[sizeof(S3_METADATA_HEADER_NAME_PREFIX) - 1]),
+                 namelen - (sizeof(S3_METADATA_HEADER_NAME_PREFIX) - 1), 1,
+                 c, valuelen);
         }
+        return;
+    }
 
-        if (!handler->responseProperties.metaDataCount) {
-            handler->responseProperties.metaData = 
-                handler->responseMetaData;
+    switch (lookup_response_header(header, namelen)) {
+    case ResponseHeaderRequestId:
+        responseProperties->requestId =
+            request_arena_strndup(handler->arena, c, valuelen);
+        break;
+    case ResponseHeaderRequestId2:
+        responseProperties->requestId2 =
+            request_arena_strndup(handler->arena, c, valuelen);
+        break;
+    case ResponseHeaderContentType:
+        responseProperties->contentType =
+            request_arena_strndup(handler->arena, c, valuelen);
+        break;
+    case ResponseHeaderContentLength:
+        responseProperties->contentLength = 0;
+        while ((*c >= '0') && (*c <= '9')) {
+            responseProperties->contentLength *= 10;
+            responseProperties->contentLength += (*c++ - '0');
         }
-
-        S3NameValue *metaHeader = 
-            &(handler->responseMetaData
-              [handler->responseProperties.metaDataCount++]);
-        metaHeader->name = copiedName;
-        metaHeader->value = copiedValue;
-    }
-    else if (!strncasecmp(header, "x-amz-server-side-encryption", namelen)) {
+        break;
+    case ResponseHeaderServer:
+        responseProperties->server =
+            request_arena_strndup(handler->arena, c, valuelen);
+        break;
+    case ResponseHeaderETag:
+        responseProperties->eTag =
+            request_arena_strndup(handler->arena, c, valuelen);
+        break;
+    case ResponseHeaderChecksumCRC32C:
+        responseProperties->checksumCRC32C =
+            request_arena_strndup(handler->arena, c, valuelen);
+        break;
+    case ResponseHeaderChecksumCRC64NVME:
+        responseProperties->checksumCRC64NVME =
+            request_arena_strndup(handler->arena, c, valuelen);
+        break;
+    case ResponseHeaderServerSideEncryption:
         if (!strncmp(c, "AES256", sizeof("AES256") - 1)) {
             responseProperties->usesServerSideEncryption = 1;
         }
         // Ignore other values - only AES256 is expected, anything else is
         // assumed to be "None" or some other value indicating no server-side
         // encryption
+        break;
+    default:
+        break;
     }
 }
 
@@ -218,5 +422,13 @@ void response_headers_handler_done(ResponseHeadersHandler *handler, CURL *curl)
         handler->responseProperties.lastModified = lastModified;
     }
     
+    handler->responseProperties.metaData = make_header_array
+        (handler, handler->metaData,
+         &(handler->responseProperties.metaDataCount));
+
+    handler->responseProperties.extraHeaders = make_header_array
+        (handler, handler->extraHeaders,
+         &(handler->responseProperties.extraHeadersCount));
+
     handler->done = 1;
 }
@@ -71,7 +71,11 @@ static S3UriStyle uriStyleG = S3UriStylePath;
 static int retriesG = 5;
 static int timeoutMsG = 0;
 static int verifyPeerG = 0;
+static int requestTimingsG = 0;
+static int showMetricsG = 0;
 static const char *awsRegionG = NULL;
+static const char *extraHeadersG[S3_MAX_EXTRA_RESPONSE_HEADERS];
+static int extraHeadersCountG = 0;
 
 
 // Environment variables, saved as globals ----------------------------------
@@ -166,6 +170,36 @@ static char putenvBufG[256];
 #define TARGET_PREFIX_PREFIX_LEN (sizeof(TARGET_PREFIX_PREFIX) - 1)
 #define HTTP_METHOD_PREFIX "method="
 #define HTTP_METHOD_PREFIX_LEN (sizeof(HTTP_METHOD_PREFIX) - 1)
+#define JOURNAL_PREFIX "journal="
+#define JOURNAL_PREFIX_LEN (sizeof(JOURNAL_PREFIX) - 1)
+#define CHECKSUM_PREFIX "checksum="
+#define CHECKSUM_PREFIX_LEN (sizeof(CHECKSUM_PREFIX) - 1)
+#define VERIFY_CHECKSUM_PREFIX "verifyChecksum="
+#define VERIFY_CHECKSUM_PREFIX_LEN (sizeof(VERIFY_CHECKSUM_PREFIX) - 1)
+#define CONCURRENCY_PREFIX "concurrency="
+#define CONCURRENCY_PREFIX_LEN (sizeof(CONCURRENCY_PREFIX) - 1)
+#define LIST_VERSION_PREFIX "listVersion="
+#define LIST_VERSION_PREFIX_LEN (sizeof(LIST_VERSION_PREFIX) - 1)
+#define OPERATION_PREFIX "operation="
+#define OPERATION_PREFIX_LEN (sizeof(OPERATION_PREFIX) - 1)
+#define DESTINATION_PREFIX "destination="
+#define DESTINATION_PREFIX_LEN (sizeof(DESTINATION_PREFIX) - 1)
+#define DEPTH_PREFIX "depth="
+#define DEPTH_PREFIX_LEN (sizeof(DEPTH_PREFIX) - 1)
+#define SPLIT_PREFIX "split="
+#define SPLIT_PREFIX_LEN (sizeof(SPLIT_PREFIX) - 1)
+#define MATCH_PREFIX "match="
+#define MATCH_PREFIX_LEN (sizeof(MATCH_PREFIX) - 1)
+#define MIN_SIZE_PREFIX "minSize="
+#define MIN_SIZE_PREFIX_LEN (sizeof(MIN_SIZE_PREFIX) - 1)
+#define MAX_SIZE_PREFIX "maxSize="
+#define MAX_SIZE_PREFIX_LEN (sizeof(MAX_SIZE_PREFIX) - 1)
+#define MODIFIED_SINCE_PREFIX "modifiedSince="
+#define MODIFIED_SINCE_PREFIX_LEN (sizeof(MODIFIED_SINCE_PREFIX) - 1)
+#define INTERVAL_PREFIX "interval="
+#define INTERVAL_PREFIX_LEN (sizeof(INTERVAL_PREFIX) - 1)
+#define MAX_INTERVAL_PREFIX "maxInterval="
+#define MAX_INTERVAL_PREFIX_LEN (sizeof(MAX_INTERVAL_PREFIX) - 1)
 
 
 // util ----------------------------------------------------------------------
@@ -175,7 +209,9 @@ static void S3_init()
     S3Status status;
     const char *hostname = getenv("S3_HOSTNAME");
 
-    if ((status = S3_initialize("s3", verifyPeerG|S3_INIT_ALL, hostname))
+    if ((status = S3_initialize("s3", verifyPeerG|requestTimingsG|
+                                (showMetricsG ? S3_INIT_METRICS : 0)|
+                                S3_INIT_ALL, hostname))
         != S3StatusOK) {
         fprintf(stderr, "Failed to initialize libs3: %s\n",
                 S3_get_status_name(status));
@@ -186,7 +222,9 @@ static void S3_init()
 
 static void printError()
 {
-    if (statusG < S3StatusErrorAccessDenied) {
+    // Only the errors from S3 come with details
+    if ((statusG < S3StatusErrorAccessDenied) ||
+        (statusG > S3StatusHttpErrorUnknown)) {
         fprintf(stderr, "\nERROR: %s\n", S3_get_status_name(statusG));
     }
     else {
@@ -214,6 +252,12 @@ static void usageExit(FILE *out)
 "                          (default is 0)\n"
 "   -v/--verify-peer     : verify peer SSL certificate (default is no)\n"
 "   -g/--region <REGION> : use <REGION> for request authorization\n"
+"   -H/--header <NAME>   : capture response header <NAME> and show it with\n"
+"                          the response properties; may be repeated\n"
+"   -T/--timings         : show the network timings of each request on\n"
+"                          stderr\n"
+"   -m/--metrics         : show the metrics of the requests made, in the\n"
+"                          Prometheus text format, on stderr at exit\n"
 "\n"
 "   Environment:\n"
 "\n"
@@ -242,6 +286,22 @@ static void usageExit(FILE *out)
 "   delete               : Delete a bucket or key\n"
 "     <bucket>[/<key>]   : Bucket or bucket/key to delete\n"
 "\n"
+"   deletemany           : Delete many keys using multi-object delete\n"
+"     <bucket>           : Bucket to delete keys from\n"
+"     [filename]         : Input filename listing one key per line (default\n"
+"                          is stdin)\n"
+"     [concurrency]      : Number of delete requests of up to 1000 keys each\n"
+"                          to keep in flight (default is 4)\n"
+"\n"
+"   bulk                 : Apply an operation to every key under a prefix\n"
+"     <bucket>           : Bucket to list\n"
+"     <operation>        : head, delete, or copy\n"
+"     [prefix]           : Prefix of the keys to operate on\n"
+"     [destination]      : For copy, <bucket>[/<prefix>] to copy to; the\n"
+"                          destination prefix replaces the source prefix\n"
+"     [concurrency]      : Number of requests to keep in flight (default\n"
+"                          is 16, or 4 for delete)\n"
+"\n"
 "   list                 : List bucket contents\n"
 "     <bucket>           : Bucket to list\n"
 "     [prefix]           : Prefix for results set\n"
@@ -249,6 +309,34 @@ static void usageExit(FILE *out)
 "     [delimiter]        : Delimiter for rolling up results set\n"
 "     [maxkeys]          : Maximum number of keys to return in results set\n"
 "     [allDetails]       : Show full details for each key\n"
+"     [listVersion]      : 2 to use ListObjectsV2, in which case marker is\n"
+"                          used as start-after and owners are only fetched\n"
+"                          with allDetails (default is 1)\n"
+"     [concurrency]      : List prefixes in parallel with this many requests\n"
+"                          in flight; delimiter (default is /) then separates\n"
+"                          the levels of prefixes, and marker and maxkeys\n"
+"                          cannot be used\n"
+"     [depth]            : With concurrency, the number of levels of prefixes\n"
+"                          to list in parallel (default is 1)\n"
+"     [split]            : With concurrency, true to list ranges of the key\n"
+"                          space in parallel instead of prefixes, for keys\n"
+"                          not organized by delimiter\n"
+"     [match]            : Only list keys matching this glob pattern, in\n"
+"                          which * also matches /\n"
+"     [minSize]          : Only list keys of at least this many bytes\n"
+"     [maxSize]          : Only list keys of at most this many bytes\n"
+"     [modifiedSince]    : Only list keys modified at or after this time,\n"
+"                          in ISO 8601 format\n"
+"\n"
+"   follow               : Print keys as they are added to a prefix whose\n"
+"                          keys are added in increasing order, until killed\n"
+"     <bucket>           : Bucket to follow\n"
+"     [prefix]           : Prefix to follow\n"
+"     [marker]           : Only print keys after this one\n"
+"     [interval]         : Milliseconds between polls while keys are being\n"
+"                          added (default is 5000)\n"
+"     [maxInterval]      : Longest milliseconds between polls while no keys\n"
+"                          are being added (default is 60000)\n"
 "\n"
 "   getacl               : Get the ACL of a bucket or key\n"
 "     <bucket>[/<key>]   : Bucket or bucket/key to get the ACL of\n"
@@ -298,6 +386,12 @@ static void usageExit(FILE *out)
 "                          encryption for the object\n"
 "     [upload-id]        : Upload-id of a uncomplete multipart upload, if you \n"
 "                          want to continue to put the object, you must specifil\n"
+"     [journal]          : Filename of a journal recording the progress of a\n"
+"                          multipart put; if the put is interrupted, running\n"
+"                          it again with the same journal resumes it\n"
+"     [checksum]         : Checksum to compute as the data is sent and have\n"
+"                          S3 verify and store: crc32c or crc64nvme; not\n"
+"                          with upload-id\n"
 "\n"
 "   copy                 : Copies an object; if any options are set, the "
                           "entire\n"
@@ -333,6 +427,11 @@ static void usageExit(FILE *out)
 "                          match this string\n"
 "     [startByte]        : First byte of byte range to return\n"
 "     [byteCount]        : Number of bytes of byte range to return\n"
+"     [journal]          : Filename of a journal recording the progress of\n"
+"                          the get; if the get is interrupted, running it\n"
+"                          again with the same journal resumes it\n"
+"     [verifyChecksum]   : Whether or not to verify the data received against\n"
+"                          the checksum stored with the object\n"
 "\n"
 "   head                 : Gets only the headers of an object, implies -s\n"
 "     <bucket>/<key>     : Bucket/key of object to get headers of\n"
@@ -767,6 +866,9 @@ static struct option longOptionsG[] =
     { "timeout",              required_argument,  0,  't' },
     { "verify-peer",          no_argument,        0,  'v' },
     { "region",               required_argument,  0,  'g' },
+    { "header",               required_argument,  0,  'H' },
+    { "timings",              no_argument,        0,  'T' },
+    { "metrics",              no_argument,        0,  'm' },
     { 0,                      0,                  0,   0  }
 };
 
@@ -815,6 +917,12 @@ static S3Status responsePropertiesCallback
     if (properties->usesServerSideEncryption) {
         printf("UsesServerSideEncryption: true\n");
     }
+    print_nonnull("Checksum-CRC32C", checksumCRC32C);
+    print_nonnull("Checksum-CRC64NVME", checksumCRC64NVME);
+    for (i = 0; i < properties->extraHeadersCount; i++) {
+        printf("%s: %s\n", properties->extraHeaders[i].name,
+               properties->extraHeaders[i].value);
+    }
 
     return S3StatusOK;
 }
@@ -858,6 +966,36 @@ static void responseCompleteCallback(S3Status status,
                             error->extraDetails[i].value);
         }
     }
+    if (error && error->timings) {
+        const S3RequestTimings *t = error->timings;
+        fprintf(stderr, "Timings (us): lookup %lld, connect %lld, "
+                "appconnect %lld, pretransfer %lld, starttransfer %lld, "
+                "total %lld\n", (long long) t->nameLookupUs,
+                (long long) t->connectUs, (long long) t->appConnectUs,
+                (long long) t->preTransferUs, (long long) t->startTransferUs,
+                (long long) t->totalUs);
+        fprintf(stderr, "Bytes: up %llu, down %llu; remote %s%s\n",
+                (unsigned long long) t->bytesUploaded,
+                (unsigned long long) t->bytesDownloaded,
+                t->remoteIp[0] ? t->remoteIp : "(none)",
+                t->connectionReused ? ", connection reused" : "");
+    }
+}
+
+
+// Prints the metrics of the requests made without a request context
+static void printMetrics()
+{
+    S3Metrics metrics;
+    S3_get_metrics(0, &metrics);
+
+    int len = S3_render_metrics_prometheus(&metrics, 0, 0);
+    char *text = (char *) malloc(len + 1);
+    if (text) {
+        S3_render_metrics_prometheus(&metrics, text, len + 1);
+        fputs(text, stderr);
+        free(text);
+    }
 }
 
 
@@ -1140,6 +1278,7 @@ typedef struct list_bucket_callback_data
     char nextMarker[1024];
     int keyCount;
     int allDetails;
+    int listVersion;
 } list_bucket_callback_data;
 
 
@@ -1180,8 +1319,10 @@ static S3Status listBucketCallback(int isTruncated, const char *nextMarker,
     // This is tricky.  S3 doesn't return the NextMarker if there is no
     // delimiter.  Why, I don't know, since it's still useful for paging
     // through results.  We want NextMarker to be the last content in the
-    // list, so set it to that if necessary.
-    if ((!nextMarker || !nextMarker[0]) && contentsCount) {
+    // list, so set it to that if necessary.  ListObjectsV2 always returns a
+    // continuation token instead.
+    if ((data->listVersion == 1) && (!nextMarker || !nextMarker[0]) &&
+        contentsCount) {
         nextMarker = contents[contentsCount - 1].key;
     }
     if (nextMarker) {
@@ -1266,7 +1407,8 @@ static S3Status listBucketCallback(int isTruncated, const char *nextMarker,
 
 static void list_bucket(const char *bucketName, const char *prefix,
                         const char *marker, const char *delimiter,
-                        int maxkeys, int allDetails)
+                        int maxkeys, int allDetails, int listVersion,
+                        const S3ListBucketFilter *filter)
 {
     S3_init();
 
@@ -1285,24 +1427,34 @@ static void list_bucket(const char *bucketName, const char *prefix,
     S3ListBucketHandler listBucketHandler =
     {
         { &responsePropertiesCallback, &responseCompleteCallback },
-        &listBucketCallback
+        &listBucketCallback,
+        0,
+        filter
     };
 
     list_bucket_callback_data data;
 
-    if (marker) {
+    if (marker && (listVersion == 1)) {
         snprintf(data.nextMarker, sizeof(data.nextMarker), "%s", marker);
     } else {
         data.nextMarker[0] = 0;
     }
     data.keyCount = 0;
     data.allDetails = allDetails;
+    data.listVersion = listVersion;
 
     do {
         data.isTruncated = 0;
         do {
-            S3_list_bucket(&bucketContext, prefix, data.nextMarker,
-                           delimiter, maxkeys, 0, timeoutMsG, &listBucketHandler, &data);
+            if (listVersion == 2) {
+                S3_list_bucket_v2(&bucketContext, prefix, data.nextMarker,
+                                  marker, delimiter, maxkeys, allDetails, 0,
+                                  timeoutMsG, &listBucketHandler, &data);
+            }
+            else {
+                S3_list_bucket(&bucketContext, prefix, data.nextMarker,
+                               delimiter, maxkeys, 0, timeoutMsG, &listBucketHandler, &data);
+            }
         } while (S3_status_is_retryable(statusG) && should_retry());
         if (statusG != S3StatusOK) {
             break;
@@ -1322,6 +1474,64 @@ static void list_bucket(const char *bucketName, const char *prefix,
 }
 
 
+static S3Status parallelListBucketCallback(int contentsCount,
+                                           const S3ListBucketContent *contents,
+                                           void *callbackData)
+{
+    return listBucketCallback(0, 0, contentsCount, contents, 0, 0,
+                              callbackData);
+}
+
+
+static void list_bucket_parallel(const char *bucketName, const char *prefix,
+                                 const char *delimiter, int depth, int split,
+                                 int concurrency, int allDetails)
+{
+    S3_init();
+
+    S3BucketContext bucketContext =
+    {
+        0,
+        bucketName,
+        protocolG,
+        uriStyleG,
+        accessKeyIdG,
+        secretAccessKeyG,
+        0,
+        awsRegionG
+    };
+
+    list_bucket_callback_data data;
+
+    data.nextMarker[0] = 0;
+    data.keyCount = 0;
+    data.allDetails = allDetails;
+    data.listVersion = 1;
+
+    if (split) {
+        statusG = S3_list_bucket_split(&bucketContext, prefix, concurrency, 1,
+                                       0, timeoutMsG,
+                                       &parallelListBucketCallback, &data);
+    }
+    else {
+        statusG = S3_list_bucket_parallel(&bucketContext, prefix, delimiter,
+                                          depth, concurrency, 1, 0, timeoutMsG,
+                                          &parallelListBucketCallback, &data);
+    }
+
+    if (statusG == S3StatusOK) {
+        if (!data.keyCount) {
+            printListBucketHeader(allDetails);
+        }
+    }
+    else {
+        printError();
+    }
+
+    S3_deinitialize();
+}
+
+
 static void list(int argc, char **argv, int optindex)
 {
     if (optindex == argc) {
@@ -1332,7 +1542,11 @@ static void list(int argc, char **argv, int optindex)
     const char *bucketName = 0;
 
     const char *prefix = 0, *marker = 0, *delimiter = 0;
-    int maxkeys = 0, allDetails = 0;
+    int maxkeys = 0, allDetails = 0, listVersion = 1;
+    int concurrency = 0, depth = 1, split = 0;
+    S3ListBucketFilter filter;
+    memset(&filter, 0, sizeof(filter));
+    int filtered = 0;
     while (optindex < argc) {
         char *param = argv[optindex++];
 
@@ -1348,6 +1562,31 @@ static void list(int argc, char **argv, int optindex)
         else if (!strncmp(param, MAXKEYS_PREFIX, MAXKEYS_PREFIX_LEN)) {
             maxkeys = convertInt(&(param[MAXKEYS_PREFIX_LEN]), "maxkeys");
         }
+        else if (!strncmp(param, LIST_VERSION_PREFIX,
+                          LIST_VERSION_PREFIX_LEN)) {
+            listVersion = convertInt(&(param[LIST_VERSION_PREFIX_LEN]),
+                                     "listVersion");
+            if ((listVersion != 1) && (listVersion != 2)) {
+                fprintf(stderr, "\nERROR: Invalid listVersion: %d\n",
+                        listVersion);
+                usageExit(stderr);
+            }
+        }
+        else if (!strncmp(param, CONCURRENCY_PREFIX, CONCURRENCY_PREFIX_LEN)) {
+            concurrency = convertInt(&(param[CONCURRENCY_PREFIX_LEN]),
+                                     "concurrency");
+        }
+        else if (!strncmp(param, DEPTH_PREFIX, DEPTH_PREFIX_LEN)) {
+            depth = convertInt(&(param[DEPTH_PREFIX_LEN]), "depth");
+        }
+        else if (!strncmp(param, SPLIT_PREFIX, SPLIT_PREFIX_LEN)) {
+            const char *sp = &(param[SPLIT_PREFIX_LEN]);
+            if (!strcmp(sp, "true") || !strcmp(sp, "TRUE") ||
+                !strcmp(sp, "yes") || !strcmp(sp, "YES") ||
+                !strcmp(sp, "1")) {
+                split = 1;
+            }
+        }
         else if (!strncmp(param, ALL_DETAILS_PREFIX,
                           ALL_DETAILS_PREFIX_LEN)) {
             const char *ad = &(param[ALL_DETAILS_PREFIX_LEN]);
@@ -1357,6 +1596,31 @@ static void list(int argc, char **argv, int optindex)
                 allDetails = 1;
             }
         }
+        else if (!strncmp(param, MATCH_PREFIX, MATCH_PREFIX_LEN)) {
+            filter.keyPattern = &(param[MATCH_PREFIX_LEN]);
+            filtered = 1;
+        }
+        else if (!strncmp(param, MIN_SIZE_PREFIX, MIN_SIZE_PREFIX_LEN)) {
+            filter.minSize = convertInt(&(param[MIN_SIZE_PREFIX_LEN]),
+                                        "minSize");
+            filtered = 1;
+        }
+        else if (!strncmp(param, MAX_SIZE_PREFIX, MAX_SIZE_PREFIX_LEN)) {
+            filter.maxSize = convertInt(&(param[MAX_SIZE_PREFIX_LEN]),
+                                        "maxSize");
+            filtered = 1;
+        }
+        else if (!strncmp(param, MODIFIED_SINCE_PREFIX,
+                          MODIFIED_SINCE_PREFIX_LEN)) {
+            filter.modifiedSince =
+                parseIso8601Time(&(param[MODIFIED_SINCE_PREFIX_LEN]));
+            if (filter.modifiedSince < 0) {
+                fprintf(stderr, "\nERROR: Invalid modifiedSince time "
+                        "value; ISO 8601 time format required\n");
+                usageExit(stderr);
+            }
+            filtered = 1;
+        }
         else if (!bucketName) {
             bucketName = param;
         }
@@ -1366,9 +1630,23 @@ static void list(int argc, char **argv, int optindex)
         }
     }
 
-    if (bucketName) {
+    if (bucketName && concurrency) {
+        if (filtered) {
+            fprintf(stderr, "\nERROR: match, minSize, maxSize and "
+                    "modifiedSince cannot be used with concurrency\n");
+            usageExit(stderr);
+        }
+        if (marker || maxkeys) {
+            fprintf(stderr, "\nERROR: marker and maxkeys cannot be used "
+                    "with concurrency\n");
+            usageExit(stderr);
+        }
+        list_bucket_parallel(bucketName, prefix, delimiter, depth, split,
+                             concurrency, allDetails);
+    }
+    else if (bucketName) {
         list_bucket(bucketName, prefix, marker, delimiter, maxkeys,
-                    allDetails);
+                    allDetails, listVersion, filtered ? &filter : 0);
     }
     else {
         list_service(allDetails);
@@ -1394,6 +1672,10 @@ typedef struct UploadManager{
     char **etags;
     int next_etags_pos;
 
+    //checksum of each part, if requested and returned by S3
+    S3ChecksumAlgorithm checksumAlgorithm;
+    char **checksums;
+
     //used for commit Upload
     growbuffer *gb;
     int remaining;
@@ -1965,6 +2247,384 @@ static void abort_multipart_upload(int argc, char **argv, int optindex)
 }
 
 
+// follow prefix -------------------------------------------------------------
+
+static S3Status followCallback(int contentsCount,
+                               const S3ListBucketContent *contents,
+                               const char *lastKey, void *callbackData)
+{
+    (void) lastKey;
+    (void) callbackData;
+
+    int i;
+
+    for (i = 0; i < contentsCount; i++) {
+        printf("%s\n", contents[i].key);
+    }
+
+    fflush(stdout);
+
+    return S3StatusOK;
+}
+
+
+static void follow_prefix(int argc, char **argv, int optindex)
+{
+    const char *bucketName = 0, *prefix = 0, *marker = 0;
+    int interval = 5000, maxInterval = 60000;
+
+    while (optindex < argc) {
+        char *param = argv[optindex++];
+
+        if (!strncmp(param, PREFIX_PREFIX, PREFIX_PREFIX_LEN)) {
+            prefix = &(param[PREFIX_PREFIX_LEN]);
+        }
+        else if (!strncmp(param, MARKER_PREFIX, MARKER_PREFIX_LEN)) {
+            marker = &(param[MARKER_PREFIX_LEN]);
+        }
+        else if (!strncmp(param, INTERVAL_PREFIX, INTERVAL_PREFIX_LEN)) {
+            interval = convertInt(&(param[INTERVAL_PREFIX_LEN]), "interval");
+        }
+        else if (!strncmp(param, MAX_INTERVAL_PREFIX,
+                          MAX_INTERVAL_PREFIX_LEN)) {
+            maxInterval = convertInt(&(param[MAX_INTERVAL_PREFIX_LEN]),
+                                     "maxInterval");
+        }
+        else if (!bucketName) {
+            bucketName = param;
+        }
+        else {
+            fprintf(stderr, "\nERROR: Unknown param: %s\n", param);
+            usageExit(stderr);
+        }
+    }
+
+    if (!bucketName) {
+        fprintf(stderr, "\nERROR: Missing parameter: bucket\n");
+        usageExit(stderr);
+    }
+
+    S3_init();
+
+    S3BucketContext bucketContext =
+    {
+        0,
+        bucketName,
+        protocolG,
+        uriStyleG,
+        accessKeyIdG,
+        secretAccessKeyG,
+        0,
+        awsRegionG
+    };
+
+    S3PrefixFollower *follower;
+
+    statusG = S3_create_prefix_follower(&bucketContext, prefix, marker,
+                                        interval, maxInterval, timeoutMsG,
+                                        &followCallback, 0, &follower);
+
+    if (statusG == S3StatusOK) {
+        statusG = S3_prefix_follower_run(follower);
+        S3_destroy_prefix_follower(follower);
+    }
+
+    printError();
+
+    S3_deinitialize();
+}
+
+
+// delete many ---------------------------------------------------------------
+
+static int deleteManyErrorsG = 0;
+
+static S3Status deleteManyResultCallback(const char *key, S3Status status,
+                                         const char *errorMessage,
+                                         void *callbackData)
+{
+    (void) callbackData;
+
+    if (status != S3StatusOK) {
+        fprintf(stderr, "ERROR: %s: %s%s%s\n", key,
+                S3_get_status_name(status), errorMessage ? ": " : "",
+                errorMessage ? errorMessage : "");
+        deleteManyErrorsG++;
+    }
+
+    return S3StatusOK;
+}
+
+
+static void delete_many(int argc, char **argv, int optindex)
+{
+    if (optindex == argc) {
+        fprintf(stderr, "\nERROR: Missing parameter: bucket\n");
+        usageExit(stderr);
+    }
+
+    const char *bucketName = argv[optindex++];
+
+    const char *filename = 0;
+    int concurrency = 4;
+
+    while (optindex < argc) {
+        char *param = argv[optindex++];
+        if (!strncmp(param, FILENAME_PREFIX, FILENAME_PREFIX_LEN)) {
+            filename = &(param[FILENAME_PREFIX_LEN]);
+        }
+        else if (!strncmp(param, CONCURRENCY_PREFIX, CONCURRENCY_PREFIX_LEN)) {
+            concurrency = atoi(&(param[CONCURRENCY_PREFIX_LEN]));
+            if (concurrency < 1) {
+                fprintf(stderr, "\nERROR: Invalid concurrency: %s\n",
+                        &(param[CONCURRENCY_PREFIX_LEN]));
+                usageExit(stderr);
+            }
+        }
+        else {
+            fprintf(stderr, "\nERROR: Unknown param: %s\n", param);
+            usageExit(stderr);
+        }
+    }
+
+    FILE *infile;
+
+    if (filename) {
+        if (!(infile = fopen(filename, "r" FOPEN_EXTRA_FLAGS))) {
+            fprintf(stderr, "\nERROR: Failed to open input file %s: ",
+                    filename);
+            perror(0);
+            exit(-1);
+        }
+    }
+    else {
+        infile = stdin;
+    }
+
+    S3_init();
+
+    S3BucketContext bucketContext =
+    {
+        0,
+        bucketName,
+        protocolG,
+        uriStyleG,
+        accessKeyIdG,
+        secretAccessKeyG,
+        0,
+        awsRegionG
+    };
+
+    S3DeleteObjectsHandler deleteObjectsHandler =
+    {
+        { &responsePropertiesCallback, &responseCompleteCallback },
+        &deleteManyResultCallback
+    };
+
+    S3BulkDeleter *bulkDeleter;
+    S3Status status = S3_create_bulk_deleter
+        (&bucketContext, 1, concurrency, 0, timeoutMsG, &deleteObjectsHandler,
+         0, &bulkDeleter);
+    if (status != S3StatusOK) {
+        fprintf(stderr, "\nERROR: Failed to create bulk deleter: %s\n",
+                S3_get_status_name(status));
+        exit(-1);
+    }
+
+    // Keys are read a line at a time; a key may not contain a newline
+    char key[S3_MAX_KEY_SIZE + 2];
+    while ((status == S3StatusOK) && fgets(key, sizeof(key), infile)) {
+        int len = strlen(key);
+        if (len && (key[len - 1] == '\n')) {
+            key[--len] = 0;
+        }
+        if (len) {
+            status = S3_bulk_deleter_add_key(bulkDeleter, key);
+        }
+    }
+
+    if (status == S3StatusOK) {
+        status = S3_bulk_deleter_finish(bulkDeleter);
+    }
+
+    S3_destroy_bulk_deleter(bulkDeleter);
+
+    if (infile != stdin) {
+        fclose(infile);
+    }
+
+    if (status != S3StatusOK) {
+        // The error details, if any, are those of the last batch to fail
+        statusG = status;
+        printError();
+    }
+    else if (deleteManyErrorsG) {
+        fprintf(stderr, "\nERROR: %d keys could not be deleted\n",
+                deleteManyErrorsG);
+    }
+
+    S3_deinitialize();
+}
+
+
+// bulk ----------------------------------------------------------------------
+
+static int bulkCountG = 0, bulkErrorsG = 0;
+
+static S3Status bulkPropertiesCallback(const char *key,
+                                       const S3ResponseProperties *properties,
+                                       void *callbackData)
+{
+    (void) callbackData;
+
+    printf("%-60s  %12llu  %s\n", key,
+           (unsigned long long) properties->contentLength,
+           properties->eTag ? properties->eTag : "");
+
+    return S3StatusOK;
+}
+
+
+static S3Status bulkResultCallback(const char *key, S3Status status,
+                                   const S3ErrorDetails *errorDetails,
+                                   void *callbackData)
+{
+    (void) callbackData;
+
+    if (status == S3StatusOK) {
+        bulkCountG++;
+    }
+    else {
+        fprintf(stderr, "ERROR: %s: %s%s%s\n", key,
+                S3_get_status_name(status),
+                (errorDetails && errorDetails->message) ? ": " : "",
+                (errorDetails && errorDetails->message) ?
+                errorDetails->message : "");
+        bulkErrorsG++;
+    }
+
+    return S3StatusOK;
+}
+
+
+static void bulk(int argc, char **argv, int optindex)
+{
+    if (optindex == argc) {
+        fprintf(stderr, "\nERROR: Missing parameter: bucket\n");
+        usageExit(stderr);
+    }
+
+    const char *bucketName = argv[optindex++];
+
+    const char *operationName = 0, *prefix = 0;
+    char *destination = 0;
+    int concurrency = 0;
+
+    while (optindex < argc) {
+        char *param = argv[optindex++];
+        if (!strncmp(param, OPERATION_PREFIX, OPERATION_PREFIX_LEN)) {
+            operationName = &(param[OPERATION_PREFIX_LEN]);
+        }
+        else if (!strncmp(param, PREFIX_PREFIX, PREFIX_PREFIX_LEN)) {
+            prefix = &(param[PREFIX_PREFIX_LEN]);
+        }
+        else if (!strncmp(param, DESTINATION_PREFIX, DESTINATION_PREFIX_LEN)) {
+            destination = &(param[DESTINATION_PREFIX_LEN]);
+        }
+        else if (!strncmp(param, CONCURRENCY_PREFIX, CONCURRENCY_PREFIX_LEN)) {
+            concurrency = atoi(&(param[CONCURRENCY_PREFIX_LEN]));
+            if (concurrency < 1) {
+                fprintf(stderr, "\nERROR: Invalid concurrency: %s\n",
+                        &(param[CONCURRENCY_PREFIX_LEN]));
+                usageExit(stderr);
+            }
+        }
+        else {
+            fprintf(stderr, "\nERROR: Unknown param: %s\n", param);
+            usageExit(stderr);
+        }
+    }
+
+    S3BulkOperation operation;
+
+    if (!operationName) {
+        fprintf(stderr, "\nERROR: Missing parameter: operation\n");
+        usageExit(stderr);
+    }
+    else if (!strcmp(operationName, "head")) {
+        operation = S3BulkOperationHead;
+    }
+    else if (!strcmp(operationName, "delete")) {
+        operation = S3BulkOperationDelete;
+    }
+    else if (!strcmp(operationName, "copy")) {
+        operation = S3BulkOperationCopy;
+    }
+    else {
+        fprintf(stderr, "\nERROR: Unknown operation: %s\n", operationName);
+        usageExit(stderr);
+    }
+
+    // Split destination bucket/prefix
+    const char *destinationBucket = 0, *destinationPrefix = 0;
+    if (destination) {
+        destinationBucket = destination;
+        char *slash = destination;
+        while (*slash && (*slash != '/')) {
+            slash++;
+        }
+        if (*slash) {
+            *slash++ = 0;
+            destinationPrefix = slash;
+        }
+    }
+    if ((operation == S3BulkOperationCopy) && !destinationBucket) {
+        fprintf(stderr, "\nERROR: Missing parameter: destination\n");
+        usageExit(stderr);
+    }
+
+    if (!concurrency) {
+        concurrency = (operation == S3BulkOperationDelete) ? 4 : 16;
+    }
+
+    S3_init();
+
+    S3BucketContext bucketContext =
+    {
+        0,
+        bucketName,
+        protocolG,
+        uriStyleG,
+        accessKeyIdG,
+        secretAccessKeyG,
+        0,
+        awsRegionG
+    };
+
+    // Only head results are printed; the others are just counted
+    S3BulkHandler bulkHandler =
+    {
+        (operation == S3BulkOperationHead) ? &bulkPropertiesCallback : 0,
+        &bulkResultCallback,
+        0
+    };
+
+    S3Status status = S3_bulk_operation
+        (&bucketContext, prefix, operation, destinationBucket,
+         destinationPrefix, concurrency, 0, timeoutMsG, &bulkHandler, 0);
+
+    if (status != S3StatusOK) {
+        fprintf(stderr, "\nERROR: %s\n", S3_get_status_name(status));
+    }
+    else if (bulkErrorsG) {
+        fprintf(stderr, "\nERROR: %d keys failed; %d succeeded\n",
+                bulkErrorsG, bulkCountG);
+    }
+
+    S3_deinitialize();
+}
+
+
 // delete object -------------------------------------------------------------
 
 static void delete_object(int argc, char **argv, int optindex)
@@ -2091,6 +2751,15 @@ S3Status MultipartResponseProperiesCallback
     const char *etag = properties->eTag;
     data->manager->etags[seq - 1] = strdup(etag);
     data->manager->next_etags_pos = seq;
+    const char *checksum =
+        (data->manager->checksumAlgorithm == S3ChecksumAlgorithmCRC32C) ?
+        properties->checksumCRC32C :
+        (data->manager->checksumAlgorithm == S3ChecksumAlgorithmCRC64NVME) ?
+        properties->checksumCRC64NVME : 0;
+    if (checksum) {
+        free(data->manager->checksums[seq - 1]);
+        data->manager->checksums[seq - 1] = strdup(checksum);
+    }
     return S3StatusOK;
 }
 
@@ -2188,6 +2857,7 @@ static void put_object(int argc, char **argv, int optindex,
     const char *bucketName = argv[optindex++];
     const char *key = slash;
     const char *uploadId = 0;
+    const char *journalFile = 0;
     const char *filename = 0;
     uint64_t contentLength = 0;
     const char *cacheControl = 0, *contentType = 0, *md5 = 0;
@@ -2198,6 +2868,7 @@ static void put_object(int argc, char **argv, int optindex,
     S3NameValue metaProperties[S3_MAX_METADATA_COUNT];
     char useServerSideEncryption = 0;
     int noStatus = 0;
+    S3ChecksumAlgorithm checksumAlgorithm = S3ChecksumAlgorithmNone;
 
     while (optindex < argc) {
         char *param = argv[optindex++];
@@ -2238,6 +2909,9 @@ static void put_object(int argc, char **argv, int optindex,
                           UPLOAD_ID_PREFIX_LEN)) {
             uploadId = &(param[UPLOAD_ID_PREFIX_LEN]);
         }
+        else if (!strncmp(param, JOURNAL_PREFIX, JOURNAL_PREFIX_LEN)) {
+            journalFile = &(param[JOURNAL_PREFIX_LEN]);
+        }
         else if (!strncmp(param, EXPIRES_PREFIX, EXPIRES_PREFIX_LEN)) {
             expires = parseIso8601Time(&(param[EXPIRES_PREFIX_LEN]));
             if (expires < 0) {
@@ -2308,12 +2982,39 @@ static void put_object(int argc, char **argv, int optindex,
                 noStatus = 1;
             }
         }
+        else if (!strncmp(param, CHECKSUM_PREFIX, CHECKSUM_PREFIX_LEN)) {
+            const char *val = &(param[CHECKSUM_PREFIX_LEN]);
+            if (!strcasecmp(val, "crc32c")) {
+                checksumAlgorithm = S3ChecksumAlgorithmCRC32C;
+            }
+            else if (!strcasecmp(val, "crc64nvme")) {
+                checksumAlgorithm = S3ChecksumAlgorithmCRC64NVME;
+            }
+            else {
+                fprintf(stderr, "\nERROR: Unknown checksum: %s\n", val);
+                usageExit(stderr);
+            }
+        }
         else {
             fprintf(stderr, "\nERROR: Unknown param: %s\n", param);
             usageExit(stderr);
         }
     }
 
+    if (journalFile && !filename && !srcSize) {
+        fprintf(stderr, "\nERROR: put journal requires a filename "
+                "parameter\n");
+        usageExit(stderr);
+    }
+
+    // The checksums of the parts already uploaded are needed to complete
+    // the upload, and S3 does not list them
+    if (uploadId && checksumAlgorithm) {
+        fprintf(stderr, "\nERROR: put checksum cannot be used with "
+                "upload-id\n");
+        usageExit(stderr);
+    }
+
     put_object_callback_data data;
 
     data.infile = 0;
@@ -2403,7 +3104,8 @@ static void put_object(int argc, char **argv, int optindex,
         cannedAcl,
         metaPropertiesCount,
         metaProperties,
-        useServerSideEncryption
+        useServerSideEncryption,
+        checksumAlgorithm
     };
 
     if (contentLength <= MULTIPART_CHUNK_SIZE) {
@@ -2472,6 +3174,46 @@ static void put_object(int argc, char **argv, int optindex,
 
         manager.etags = (char **) malloc(sizeof(char *) * totalSeq);
         manager.next_etags_pos = 0;
+        manager.checksumAlgorithm = checksumAlgorithm;
+        manager.checksums = (char **) calloc(totalSeq, sizeof(char *));
+
+        // The upload declares the checksum algorithm of its parts, so that S3
+        // can check that they all use it
+        S3PutProperties initialProperties;
+        memset(&initialProperties, 0, sizeof(initialProperties));
+        initialProperties.expires = -1;
+        initialProperties.checksumAlgorithm = checksumAlgorithm;
+
+        S3TransferJournal *journal = 0;
+        int journalDone = 0;
+
+        if (journalFile) {
+            char transferId[2048];
+            // The checksum algorithm is part of the transfer, as the upload
+            // is initiated with it
+            snprintf(transferId, sizeof(transferId), "put %s/%s %llu%s",
+                     bucketName, key, (unsigned long long) contentLength,
+                     (checksumAlgorithm == S3ChecksumAlgorithmCRC32C) ?
+                     " crc32c" :
+                     (checksumAlgorithm == S3ChecksumAlgorithmCRC64NVME) ?
+                     " crc64nvme" : "");
+            S3Status status = S3_open_transfer_journal
+                (journalFile, transferId, 0, &journal);
+            if (status != S3StatusOK) {
+                fprintf(stderr, "\nERROR: Failed to open journal %s: %s\n",
+                        journalFile, S3_get_status_name(status));
+                goto clean;
+            }
+            // Resume the upload recorded in the journal, unless the caller
+            // explicitly named one
+            if (!uploadId && S3_transfer_journal_get_upload_id(journal)) {
+                manager.upload_id =
+                    strdup(S3_transfer_journal_get_upload_id(journal));
+                printf("Resuming upload %s from journal\n",
+                       manager.upload_id);
+                goto upload;
+            }
+        }
 
         if (uploadId) {
             manager.upload_id = strdup(uploadId);
@@ -2486,7 +3228,9 @@ static void put_object(int argc, char **argv, int optindex,
         }
 
         do {
-            S3_initiate_multipart(&bucketContext, key,0, &handler,0, timeoutMsG, &manager);
+            S3_initiate_multipart(&bucketContext, key,
+                                  checksumAlgorithm ? &initialProperties : 0,
+                                  &handler,0, timeoutMsG, &manager);
         } while (S3_status_is_retryable(statusG) && should_retry());
 
         if (manager.upload_id == 0 || statusG != S3StatusOK) {
@@ -2495,8 +3239,49 @@ static void put_object(int argc, char **argv, int optindex,
         }
 
 upload:
+        if (journal && (!S3_transfer_journal_get_upload_id(journal) ||
+                        strcmp(S3_transfer_journal_get_upload_id(journal),
+                               manager.upload_id))) {
+            S3Status status = S3_transfer_journal_set_upload_id
+                (journal, manager.upload_id);
+            if (status != S3StatusOK) {
+                fprintf(stderr, "\nERROR: Failed to write journal %s: %s\n",
+                        journalFile, S3_get_status_name(status));
+                goto clean;
+            }
+        }
         todoContentLength -= MULTIPART_CHUNK_SIZE * manager.next_etags_pos;
         for (seq = manager.next_etags_pos + 1; seq <= totalSeq; seq++) {
+            if (journal) {
+                const char *eTag =
+                    S3_transfer_journal_get_part_etag(journal, seq);
+                const char *checksum =
+                    S3_transfer_journal_get_part_checksum(journal, seq);
+                // A part recorded without the checksum needed to complete
+                // the upload is sent again
+                if (eTag && (checksum || !checksumAlgorithm)) {
+                    printf("Skipping Part Seq %d, recorded in journal\n",
+                           seq);
+                    manager.etags[seq - 1] = strdup(eTag);
+                    if (checksum) {
+                        manager.checksums[seq - 1] = strdup(checksum);
+                    }
+                    manager.next_etags_pos = seq;
+                    contentLength -= MULTIPART_CHUNK_SIZE;
+                    todoContentLength -= MULTIPART_CHUNK_SIZE;
+                    continue;
+                }
+                // Parts before this one may have been skipped, so the input
+                // file position must be set explicitly
+                if (data.infile &&
+                    fseeko(data.infile, (off_t) MULTIPART_CHUNK_SIZE *
+                           (seq - 1), SEEK_SET)) {
+                    fprintf(stderr, "\nERROR: Failed to seek input file %s: ",
+                            filename);
+                    perror(0);
+                    goto clean;
+                }
+            }
             partData.manager = &manager;
             partData.seq = seq;
             if (partData.put_object_data.gb==NULL) {
@@ -2552,6 +3337,16 @@ upload:
                 printError();
                 goto clean;
             }
+            if (journal) {
+                S3Status status = S3_transfer_journal_add_part
+                    (journal, seq, manager.etags[seq - 1],
+                     manager.checksums[seq - 1]);
+                if (status != S3StatusOK) {
+                    fprintf(stderr, "\nERROR: Failed to write journal %s: "
+                            "%s\n", journalFile, S3_get_status_name(status));
+                    goto clean;
+                }
+            }
             contentLength -= MULTIPART_CHUNK_SIZE;
             todoContentLength -= MULTIPART_CHUNK_SIZE;
         }
@@ -2562,34 +3357,86 @@ upload:
                                   strlen("<CompleteMultipartUpload>"));
         char buf[256];
         int n;
+        // The object checksum follows from the part checksums, if they are
+        // all known
+        const char *checksumElement =
+            (checksumAlgorithm == S3ChecksumAlgorithmCRC32C) ?
+            "ChecksumCRC32C" : "ChecksumCRC64NVME";
+        int haveChecksums = (checksumAlgorithm != S3ChecksumAlgorithmNone);
+        uint64_t objectChecksum = 0;
+        for (i = 0; haveChecksums && (i < totalSeq); i++) {
+            uint64_t partChecksum;
+            uint64_t partLength = (i == (totalSeq - 1)) ?
+                (totalContentLength - ((uint64_t) MULTIPART_CHUNK_SIZE * i)) :
+                MULTIPART_CHUNK_SIZE;
+            if (!S3_decode_checksum(checksumAlgorithm, manager.checksums[i],
+                                    &partChecksum)) {
+                haveChecksums = 0;
+                break;
+            }
+            objectChecksum = i ? S3_combine_checksums
+                (checksumAlgorithm, objectChecksum, partChecksum, partLength) :
+                partChecksum;
+        }
         for (i = 0; i < totalSeq; i++) {
-            n = snprintf(buf, sizeof(buf), "<Part><PartNumber>%d</PartNumber>"
-                         "<ETag>%s</ETag></Part>", i + 1, manager.etags[i]);
+            if (haveChecksums) {
+                n = snprintf(buf, sizeof(buf), "<Part><PartNumber>%d"
+                             "</PartNumber><ETag>%s</ETag><%s>%s</%s></Part>",
+                             i + 1, manager.etags[i], checksumElement,
+                             manager.checksums[i], checksumElement);
+            }
+            else {
+                n = snprintf(buf, sizeof(buf), "<Part><PartNumber>%d"
+                             "</PartNumber><ETag>%s</ETag></Part>", i + 1,
+                             manager.etags[i]);
+            }
             size += growbuffer_append(&(manager.gb), buf, n);
         }
         size += growbuffer_append(&(manager.gb), "</CompleteMultipartUpload>",
                                   strlen("</CompleteMultipartUpload>"));
         manager.remaining = size;
 
+        // S3 checks the object it assembles against the object checksum
+        char checksum[S3_MAX_CHECKSUM_SIZE];
+        if (haveChecksums) {
+            S3_encode_checksum(checksumAlgorithm, objectChecksum, checksum);
+        }
+
         do {
-            S3_complete_multipart_upload(&bucketContext, key, &commit_handler,
-                                         manager.upload_id, manager.remaining,
-                                         0, timeoutMsG, &manager);
+            S3_complete_multipart_upload_checksum
+                (&bucketContext, key, &commit_handler, manager.upload_id,
+                 manager.remaining,
+                 haveChecksums ? checksumAlgorithm : S3ChecksumAlgorithmNone,
+                 haveChecksums ? checksum : 0, 0, timeoutMsG, &manager);
         } while (S3_status_is_retryable(statusG) && should_retry());
         if (statusG != S3StatusOK) {
             printError();
             goto clean;
         }
+        journalDone = 1;
+        if (haveChecksums) {
+            printf("%s: %s\n", checksumElement, checksum);
+        }
 
     clean:
+        if (journal) {
+            S3_close_transfer_journal(journal, journalDone);
+            if (journalDone) {
+                remove(journalFile);
+            }
+        }
         if(manager.upload_id) {
             free(manager.upload_id);
         }
         for (i = 0; i < manager.next_etags_pos; i++) {
             free(manager.etags[i]);
         }
+        for (i = 0; i < totalSeq; i++) {
+            free(manager.checksums[i]);
+        }
         growbuffer_destroy(manager.gb);
         free(manager.etags);
+        free(manager.checksums);
     }
 
     S3_deinitialize();
@@ -2666,7 +3513,9 @@ static void copy_object(int argc, char **argv, int optindex)
     S3ListBucketHandler listBucketHandler =
     {
         { &responsePropertiesCallback, &responseCompleteCallback },
-        &copyListKeyCallback
+        &copyListKeyCallback,
+        0,
+        0
     };
     // Find size of existing key to determine if MP required
     do {
@@ -2824,7 +3673,8 @@ static void copy_object(int argc, char **argv, int optindex)
         cannedAcl,
         metaPropertiesCount,
         metaProperties,
-        useServerSideEncryption
+        useServerSideEncryption,
+        S3ChecksumAlgorithmNone
     };
 
     S3ResponseHandler responseHandler =
@@ -2866,15 +3716,62 @@ static void copy_object(int argc, char **argv, int optindex)
 
 // get object ----------------------------------------------------------------
 
+// How many bytes a journaled get writes between journal records
+#define GET_JOURNAL_INTERVAL (8 << 20)
+
+typedef struct get_object_callback_data
+{
+    FILE *outfile;
+    S3TransferJournal *journal;
+    // Object offset of the first byte written but not yet journaled, and
+    // the number of such bytes
+    uint64_t journalOffset, journalPending;
+} get_object_callback_data;
+
+
+static S3Status get_object_journal_flush(get_object_callback_data *data)
+{
+    if (!data->journalPending) {
+        return S3StatusOK;
+    }
+
+    // The bytes must have left stdio before the journal says they are there
+    if (fflush(data->outfile)) {
+        return S3StatusAbortedByCallback;
+    }
+
+    S3Status status = S3_transfer_journal_add_range
+        (data->journal, data->journalOffset, data->journalPending);
+
+    if (status == S3StatusOK) {
+        data->journalOffset += data->journalPending;
+        data->journalPending = 0;
+    }
+
+    return status;
+}
+
+
 static S3Status getObjectDataCallback(int bufferSize, const char *buffer,
                                       void *callbackData)
 {
-    FILE *outfile = (FILE *) callbackData;
+    get_object_callback_data *data =
+        (get_object_callback_data *) callbackData;
+
+    size_t wrote = fwrite(buffer, 1, bufferSize, data->outfile);
 
-    size_t wrote = fwrite(buffer, 1, bufferSize, outfile);
+    if (wrote < (size_t) bufferSize) {
+        return S3StatusAbortedByCallback;
+    }
+
+    if (data->journal) {
+        data->journalPending += wrote;
+        if (data->journalPending >= GET_JOURNAL_INTERVAL) {
+            return get_object_journal_flush(data);
+        }
+    }
 
-    return ((wrote < (size_t) bufferSize) ?
-            S3StatusAbortedByCallback : S3StatusOK);
+    return S3StatusOK;
 }
 
 
@@ -2904,6 +3801,8 @@ static void get_object(int argc, char **argv, int optindex)
     int64_t ifModifiedSince = -1, ifNotModifiedSince = -1;
     const char *ifMatch = 0, *ifNotMatch = 0;
     uint64_t startByte = 0, byteCount = 0;
+    const char *journalFile = 0;
+    int verifyChecksum = 0;
 
     while (optindex < argc) {
         char *param = argv[optindex++];
@@ -2947,6 +3846,18 @@ static void get_object(int argc, char **argv, int optindex)
             byteCount = convertInt
                 (&(param[BYTE_COUNT_PREFIX_LEN]), "byteCount");
         }
+        else if (!strncmp(param, JOURNAL_PREFIX, JOURNAL_PREFIX_LEN)) {
+            journalFile = &(param[JOURNAL_PREFIX_LEN]);
+        }
+        else if (!strncmp(param, VERIFY_CHECKSUM_PREFIX,
+                          VERIFY_CHECKSUM_PREFIX_LEN)) {
+            const char *val = &(param[VERIFY_CHECKSUM_PREFIX_LEN]);
+            if (!strcmp(val, "true") || !strcmp(val, "TRUE") ||
+                !strcmp(val, "yes") || !strcmp(val, "YES") ||
+                !strcmp(val, "1")) {
+                verifyChecksum = 1;
+            }
+        }
         else {
             fprintf(stderr, "\nERROR: Unknown param: %s\n", param);
             usageExit(stderr);
@@ -2979,10 +3890,37 @@ static void get_object(int argc, char **argv, int optindex)
         fprintf(stderr, "\nERROR: get -s requires a filename parameter\n");
         usageExit(stderr);
     }
+    else if (journalFile) {
+        fprintf(stderr, "\nERROR: get journal requires a filename "
+                "parameter\n");
+        usageExit(stderr);
+    }
     else {
         outfile = stdout;
     }
 
+    get_object_callback_data data;
+
+    data.outfile = outfile;
+    data.journal = 0;
+    data.journalOffset = startByte;
+    data.journalPending = 0;
+
+    if (journalFile) {
+        char transferId[2048];
+        snprintf(transferId, sizeof(transferId), "get %s/%s %llu %llu",
+                 bucketName, key, (unsigned long long) startByte,
+                 (unsigned long long) byteCount);
+        S3Status status = S3_open_transfer_journal
+            (journalFile, transferId, 0, &(data.journal));
+        if (status != S3StatusOK) {
+            fprintf(stderr, "\nERROR: Failed to open journal %s: %s\n",
+                    journalFile, S3_get_status_name(status));
+            fclose(outfile);
+            exit(-1);
+        }
+    }
+
     S3_init();
 
     S3BucketContext bucketContext =
@@ -3002,7 +3940,8 @@ static void get_object(int argc, char **argv, int optindex)
         ifModifiedSince,
         ifNotModifiedSince,
         ifMatch,
-        ifNotMatch
+        ifNotMatch,
+        verifyChecksum
     };
 
     S3GetObjectHandler getObjectHandler =
@@ -3012,14 +3951,58 @@ static void get_object(int argc, char **argv, int optindex)
     };
 
     do {
-        S3_get_object(&bucketContext, key, &getConditions, startByte,
-                      byteCount, 0, 0, &getObjectHandler, outfile);
+        uint64_t requestStartByte = startByte, requestByteCount = byteCount;
+        if (data.journal) {
+            // Resume after the bytes that the journal says are already in
+            // the output file; this also makes retries resume rather than
+            // restart
+            if (get_object_journal_flush(&data) != S3StatusOK) {
+                statusG = S3StatusJournalIOError;
+                break;
+            }
+            requestStartByte =
+                S3_transfer_journal_get_range_end(data.journal, startByte);
+            if (byteCount) {
+                if (requestStartByte >= (startByte + byteCount)) {
+                    statusG = S3StatusOK;
+                    break;
+                }
+                requestByteCount -= (requestStartByte - startByte);
+            }
+            if (fseeko(outfile, (off_t) (requestStartByte - startByte),
+                       SEEK_SET)) {
+                fprintf(stderr, "\nERROR: Failed to seek output file %s: ",
+                        filename);
+                perror(0);
+                statusG = S3StatusAbortedByCallback;
+                break;
+            }
+            if (requestStartByte > startByte) {
+                printf("Resuming get at byte %llu from journal\n",
+                       (unsigned long long) requestStartByte);
+            }
+            data.journalOffset = requestStartByte;
+        }
+        S3_get_object(&bucketContext, key, &getConditions, requestStartByte,
+                      requestByteCount, 0, 0, &getObjectHandler, &data);
     } while (S3_status_is_retryable(statusG) && should_retry());
 
     if (statusG != S3StatusOK) {
         printError();
     }
 
+    if (data.journal) {
+        int done = (statusG == S3StatusOK);
+        if (!done) {
+            // Keep whatever arrived before the failure
+            get_object_journal_flush(&data);
+        }
+        S3_close_transfer_journal(data.journal, done);
+        if (done) {
+            remove(journalFile);
+        }
+    }
+
     fclose(outfile);
 
     S3_deinitialize();
@@ -3892,7 +4875,7 @@ int main(int argc, char **argv)
     // Parse args
     while (1) {
         int idx = 0;
-        int c = getopt_long(argc, argv, "vfhusr:t:g:", longOptionsG, &idx);
+        int c = getopt_long(argc, argv, "vfhusr:t:g:H:Tm", longOptionsG, &idx);
 
         if (c == -1) {
             // End of options
@@ -3938,6 +4921,23 @@ int main(int argc, char **argv)
         case 'g':
             awsRegionG = strdup(optarg);
             break;
+        case 'H':
+            if (extraHeadersCountG == S3_MAX_EXTRA_RESPONSE_HEADERS) {
+                fprintf(stderr, "\nERROR: Too many headers; at most %d "
+                        "may be captured\n", S3_MAX_EXTRA_RESPONSE_HEADERS);
+                usageExit(stderr);
+            }
+            extraHeadersG[extraHeadersCountG++] = optarg;
+            break;
+        case 'T':
+            requestTimingsG = S3_INIT_REQUEST_TIMINGS;
+            break;
+        case 'm':
+            if (!showMetricsG) {
+                showMetricsG = 1;
+                atexit(&printMetrics);
+            }
+            break;
         default:
             fprintf(stderr, "\nERROR: Unknown option: -%c\n", c);
             // Usage exit
@@ -3953,6 +4953,16 @@ int main(int argc, char **argv)
 
     const char *command = argv[optind++];
 
+    if (extraHeadersCountG) {
+        S3Status status = S3_set_extra_response_headers(extraHeadersCountG,
+                                                        extraHeadersG);
+        if (status != S3StatusOK) {
+            fprintf(stderr, "\nERROR: Invalid --header: %s\n",
+                    S3_get_status_name(status));
+            usageExit(stderr);
+        }
+    }
+
     if (!strcmp(command, "help")) {
         fprintf(stdout, "\ns3 is a program for performing single requests "
                 "to Amazon S3.\n");
@@ -3977,6 +4987,9 @@ int main(int argc, char **argv)
     else if (!strcmp(command, "test")) {
         test_bucket(argc, argv, optind);
     }
+    else if (!strcmp(command, "follow")) {
+        follow_prefix(argc, argv, optind);
+    }
     else if (!strcmp(command, "create")) {
         create_bucket(argc, argv, optind);
     }
@@ -4001,6 +5014,12 @@ int main(int argc, char **argv)
             delete_bucket(argc, argv, optind);
         }
     }
+    else if (!strcmp(command, "deletemany")) {
+        delete_many(argc, argv, optind);
+    }
+    else if (!strcmp(command, "bulk")) {
+        bulk(argc, argv, optind);
+    }
     else if (!strcmp(command, "put")) {
         put_object(argc, argv, optind, NULL, NULL, 0);
     }
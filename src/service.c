@@ -132,7 +132,7 @@ static void completeCallback(S3Status requestStatus,
 
     simplexml_deinitialize(&(cbData->simpleXml));
 
-    free(cbData);
+    s3_pool_free(cbData);
 }
 
 
@@ -145,7 +145,7 @@ void S3_list_service(S3Protocol protocol, const char *accessKeyId,
 {
     // Create and set up the callback data
     XmlCallbackData *data =
-        (XmlCallbackData *) malloc(sizeof(XmlCallbackData));
+        (XmlCallbackData *) s3_pool_malloc(sizeof(XmlCallbackData));
     if (!data) {
         (*(handler->responseHandler.completeCallback))
             (S3StatusOutOfMemory, 0, callbackData);
@@ -169,6 +169,7 @@ void S3_list_service(S3Protocol protocol, const char *accessKeyId,
     RequestParams params =
     {
         HttpRequestTypeGET,                           // httpRequestType
+        S3MetricsOperationListBuckets,                // operation
         { hostName,                                   // hostName
           0,                                          // bucketName
           protocol,                                   // protocol
@@ -192,7 +193,9 @@ void S3_list_service(S3Protocol protocol, const char *accessKeyId,
         &dataCallback,                                // fromS3Callback
         &completeCallback,                            // completeCallback
         data,                                         // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
@@ -294,7 +294,7 @@ static void getBlsCompleteCallback(S3Status requestStatus,
     (*(gsData->responseCompleteCallback))
         (requestStatus, s3ErrorDetails, gsData->callbackData);
 
-    free(gsData);
+    s3_pool_free(gsData);
 }
 
 
@@ -309,7 +309,7 @@ void S3_get_server_access_logging(const S3BucketContext *bucketContext,
                                   void *callbackData)
 {
     // Create the callback data
-    GetBlsData *gsData = (GetBlsData *) malloc(sizeof(GetBlsData));
+    GetBlsData *gsData = (GetBlsData *) s3_pool_malloc(sizeof(GetBlsData));
     if (!gsData) {
         (*(handler->completeCallback))(S3StatusOutOfMemory, 0, callbackData);
         return;
@@ -330,6 +330,7 @@ void S3_get_server_access_logging(const S3BucketContext *bucketContext,
     RequestParams params =
     {
         HttpRequestTypeGET,                           // httpRequestType
+        S3MetricsOperationGetBucketLogging,           // operation
         { bucketContext->hostName,                    // hostName
           bucketContext->bucketName,                  // bucketName
           bucketContext->protocol,                    // protocol
@@ -353,7 +354,9 @@ void S3_get_server_access_logging(const S3BucketContext *bucketContext,
         &getBlsDataCallback,                          // fromS3Callback
         &getBlsCompleteCallback,                      // completeCallback
         gsData,                                       // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
@@ -492,7 +495,7 @@ static void setSalCompleteCallback(S3Status requestStatus,
     (*(paData->responseCompleteCallback))
         (requestStatus, s3ErrorDetails, paData->callbackData);
 
-    free(paData);
+    s3_pool_free(paData);
 }
 
 
@@ -511,7 +514,7 @@ void S3_set_server_access_logging(const S3BucketContext *bucketContext,
         return;
     }
 
-    SetSalData *data = (SetSalData *) malloc(sizeof(SetSalData));
+    SetSalData *data = (SetSalData *) s3_pool_malloc(sizeof(SetSalData));
     if (!data) {
         (*(handler->completeCallback))(S3StatusOutOfMemory, 0, callbackData);
         return;
@@ -523,7 +526,7 @@ void S3_set_server_access_logging(const S3BucketContext *bucketContext,
          &(data->salXmlDocumentLen), data->salXmlDocument,
          sizeof(data->salXmlDocument));
     if (status != S3StatusOK) {
-        free(data);
+        s3_pool_free(data);
         (*(handler->completeCallback))(status, 0, callbackData);
         return;
     }
@@ -538,6 +541,7 @@ void S3_set_server_access_logging(const S3BucketContext *bucketContext,
     RequestParams params =
     {
         HttpRequestTypePUT,                           // httpRequestType
+        S3MetricsOperationPutBucketLogging,           // operation
         { bucketContext->hostName,                    // hostName
           bucketContext->bucketName,                  // bucketName
           bucketContext->protocol,                    // protocol
@@ -561,7 +565,9 @@ void S3_set_server_access_logging(const S3BucketContext *bucketContext,
         0,                                            // fromS3Callback
         &setSalCompleteCallback,                      // completeCallback
         data,                                         // callbackData
-        timeoutMs                                     // timeoutMs
+        timeoutMs,                                    // timeoutMs
+        S3ChecksumAlgorithmNone,                      // checksumAlgorithm
+        0                                             // checksum
     };
 
     // Perform the request
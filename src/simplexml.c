@@ -30,80 +30,200 @@
  *
  ************************************************************************** **/
 
-#include <libxml/parser.h>
 #include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "probes.h"
 #include "simplexml.h"
 
-// Use libxml2 for parsing XML.  XML is severely overused in modern
-// computing.  It is useful for only a very small subset of tasks, but
-// software developers who don't know better and are afraid to go against the
-// grain use it for everything, and in most cases, it is completely
-// inappropriate.  Usually, the document structure is severely under-specified
-// as well, as is the case with S3.  We do our best by just caring about the
-// most important aspects of the S3 "XML document" responses: the elements and
-// their values.  The SAX API (just about the lamest API ever devised and
-// proof that XML sucks - well, the real proof is how crappy all of the XML
-// parsing libraries are, including libxml2 - but I digress) is used here
-// because we don't need much from the parser and SAX is fast and low memory.
+// XML is severely overused in modern computing.  It is useful for only a
+// very small subset of tasks, but software developers who don't know better
+// and are afraid to go against the grain use it for everything, and in most
+// cases, it is completely inappropriate.  Usually, the document structure is
+// severely under-specified as well, as is the case with S3.  We do our best
+// by just caring about the most important aspects of the S3 "XML document"
+// responses: the elements and their values.
+//
+// Rather than a general purpose XML parser, this is a tokenizer for the
+// subset of XML that S3 returns: elements, whose attributes are skipped,
+// text, the predefined entities and character references, and CDATA
+// sections.  The XML declaration, comments, processing instructions and
+// DOCTYPE declarations are skipped.  Text is handed to the callback straight
+// from the caller's buffer wherever possible, and the buffer is scanned for
+// the bytes which end a run of text 16 at a time where SSE2 is available.
+// Any of it may be split across calls to simplexml_add().
+//
+// Callers which know the paths that they are interested in may give a table
+// of them, in which case each element is looked up once as it is started and
+// the callback is given the id of its path.
 //
 // Note that for simplicity we assume all ASCII here.  No attempts are made to
 // detect non-ASCII sequences in utf-8 and convert them into ASCII in any way.
 // S3 appears to only use ASCII anyway.
 
 
-static xmlEntityPtr saxGetEntity(void *user_data, const xmlChar *name)
+typedef enum
+{
+    SimpleXmlStateText,
+    SimpleXmlStateEntity,
+    SimpleXmlStateTagOpen,
+    SimpleXmlStateStartTagName,
+    SimpleXmlStateStartTagAttributes,
+    SimpleXmlStateEndTagName,
+    SimpleXmlStateEndTagClose,
+    SimpleXmlStateBang,
+    SimpleXmlStateComment,
+    SimpleXmlStateCdata,
+    SimpleXmlStateProcessingInstruction,
+    SimpleXmlStateDeclaration
+} SimpleXmlState;
+
+
+#define CDATA_START "[CDATA["
+#define CDATA_START_LEN (sizeof(CDATA_START) - 1)
+
+
+static int is_space(char c)
+{
+    return ((c == ' ') || (c == '\t') || (c == '\n') || (c == '\r'));
+}
+
+
+// Returns the offset in [data] of the first byte which ends a run of text:
+// '<', '&' or '\r'; or [len] if there is none
+static int find_text_end(const char *data, int len)
 {
-    (void) user_data;
+    int i = 0;
+
+#ifdef __SSE2__
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i cr = _mm_set1_epi8('\r');
+
+    for (; (i + 16) <= len; i += 16) {
+        __m128i bytes = _mm_loadu_si128((const __m128i *) &(data[i]));
+        int mask = _mm_movemask_epi8
+            (_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, lt),
+                                       _mm_cmpeq_epi8(bytes, amp)),
+                          _mm_cmpeq_epi8(bytes, cr)));
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+
+    for (; i < len; i++) {
+        char c = data[i];
+        if ((c == '<') || (c == '&') || (c == '\r')) {
+            return i;
+        }
+    }
 
-    return xmlGetPredefinedEntity(name);
+    return len;
 }
 
 
-static void saxStartElement(void *user_data, const xmlChar *nameUtf8,
-                            const xmlChar **attr)
+static void simplexml_fail(SimpleXml *simpleXml)
 {
-    (void) attr;
+    if (simpleXml->status == S3StatusOK) {
+        simpleXml->status = S3StatusXmlParseFailure;
+    }
+}
 
-    SimpleXml *simpleXml = (SimpleXml *) user_data;
 
-    if (simpleXml->status != S3StatusOK) {
+static void simplexml_call(SimpleXml *simpleXml, const char *data, int len)
+{
+    if (!simpleXml->paths) {
+        simpleXml->status = (*(simpleXml->callback))
+            (simpleXml->elementPath, data, len, simpleXml->callbackData);
         return;
     }
-    
-    // Assume that name has no non-ASCII in it
-    char *name = (char *) nameUtf8;
 
-    // Append the element to the element path
-    int len = strlen(name);
+    // The element is known only if all of its ancestors are
+    int elementId = (simpleXml->knownDepth == simpleXml->depth) ?
+        simpleXml->elementIds[simpleXml->knownDepth - 1] : -1;
 
-    if ((simpleXml->elementPathLen + len + 1) >= 
-        (int) sizeof(simpleXml->elementPath)) {
-        // Cannot handle this element, stop!
-        simpleXml->status = S3StatusXmlParseFailure;
+    simpleXml->status = (*(simpleXml->idCallback))
+        (elementId, simpleXml->elementPath, data, len,
+         simpleXml->callbackData);
+}
+
+
+static void simplexml_text(SimpleXml *simpleXml, const char *data, int len)
+{
+    if (simpleXml->depth) {
+        simplexml_call(simpleXml, data, len);
         return;
     }
 
-    if (simpleXml->elementPathLen) {
-        simpleXml->elementPath[simpleXml->elementPathLen++] = '/';
+    // Outside of the document element only white space, and a byte order
+    // mark, may appear
+    int i;
+    for (i = 0; i < len; i++) {
+        unsigned char c = data[i];
+        if (!is_space(c) && (c != 0xEF) && (c != 0xBB) && (c != 0xBF)) {
+            simplexml_fail(simpleXml);
+            return;
+        }
     }
-    strcpy(&(simpleXml->elementPath[simpleXml->elementPathLen]), name);
-    simpleXml->elementPathLen += len;
 }
 
 
-static void saxEndElement(void *user_data, const xmlChar *name)
+// Appends a byte of the name of an element being started to the element
+// path
+static void simplexml_name_byte(SimpleXml *simpleXml, char c)
 {
-    (void) name;
+    // Leave room for the terminating zero
+    if ((simpleXml->elementPathLen + 1) >=
+        (int) sizeof(simpleXml->elementPath)) {
+        // Cannot handle this element, stop!
+        simplexml_fail(simpleXml);
+        return;
+    }
+
+    simpleXml->elementPath[simpleXml->elementPathLen++] = c;
+}
 
-    SimpleXml *simpleXml = (SimpleXml *) user_data;
 
-    if (simpleXml->status != S3StatusOK) {
+// Looks up the element just started in the table of known paths, if its
+// parent is known; nameOffset is the offset of its name in the element path
+static void simplexml_start_element(SimpleXml *simpleXml, int nameOffset)
+{
+    if ((simpleXml->knownDepth != (simpleXml->depth - 1)) ||
+        (simpleXml->knownDepth == SIMPLEXML_MAX_KNOWN_DEPTH)) {
         return;
     }
 
+    const char *elementPath = simpleXml->elementPath;
+    int elementPathLen = simpleXml->elementPathLen;
+
+    // Paths sharing the parent's prefix differ in their names, so compare
+    // those first, starting with their last bytes
+    char last = elementPath[elementPathLen - 1];
+    int i;
+    for (i = 0; i < simpleXml->pathsCount; i++) {
+        const SimpleXmlPath *path = &(simpleXml->paths[i]);
+        if ((path->pathLen == elementPathLen) &&
+            (path->path[elementPathLen - 1] == last) &&
+            !memcmp(&(path->path[nameOffset]), &(elementPath[nameOffset]),
+                    elementPathLen - nameOffset - 1) &&
+            !memcmp(path->path, elementPath, nameOffset)) {
+            simpleXml->elementIds[simpleXml->knownDepth++] = path->id;
+            return;
+        }
+    }
+}
+
+
+static void simplexml_end_element(SimpleXml *simpleXml)
+{
     // Call back with 0 data
-    simpleXml->status = (*(simpleXml->callback))
-        (simpleXml->elementPath, 0, 0, simpleXml->callbackData);
+    simplexml_call(simpleXml, 0, 0);
+
+    if (simpleXml->knownDepth == simpleXml->depth) {
+        simpleXml->knownDepth--;
+    }
 
     while ((simpleXml->elementPathLen > 0) &&
            (simpleXml->elementPath[simpleXml->elementPathLen] != '/')) {
@@ -111,103 +231,424 @@ static void saxEndElement(void *user_data, const xmlChar *name)
     }
 
     simpleXml->elementPath[simpleXml->elementPathLen] = 0;
+    simpleXml->depth--;
 }
 
 
-static void saxCharacters(void *user_data, const xmlChar *ch, int len)
+static void simplexml_entity(SimpleXml *simpleXml)
 {
-    SimpleXml *simpleXml = (SimpleXml *) user_data;
+    const char *name = simpleXml->token;
+    char decoded[4];
+    int len = 0;
 
-    if (simpleXml->status != S3StatusOK) {
-        return;
+    if (!strcmp(name, "lt")) {
+        decoded[len++] = '<';
     }
-
-    simpleXml->status = (*(simpleXml->callback))
-        (simpleXml->elementPath, (char *) ch, len, simpleXml->callbackData);
-}
-
-
-static void saxError(void *user_data, const char *msg, ...)
-{
-    (void) msg;
-
-    SimpleXml *simpleXml = (SimpleXml *) user_data;
-
-    if (simpleXml->status != S3StatusOK) {
+    else if (!strcmp(name, "gt")) {
+        decoded[len++] = '>';
+    }
+    else if (!strcmp(name, "amp")) {
+        decoded[len++] = '&';
+    }
+    else if (!strcmp(name, "quot")) {
+        decoded[len++] = '"';
+    }
+    else if (!strcmp(name, "apos")) {
+        decoded[len++] = '\'';
+    }
+    else if (name[0] == '#') {
+        // A character reference, which is written out as utf-8
+        unsigned long code = 0;
+        int hex = (name[1] == 'x'), i = hex ? 2 : 1;
+        if (!name[i]) {
+            simplexml_fail(simpleXml);
+            return;
+        }
+        for (; name[i]; i++) {
+            char c = name[i];
+            int digit;
+            if ((c >= '0') && (c <= '9')) {
+                digit = c - '0';
+            }
+            else if (hex && (c >= 'a') && (c <= 'f')) {
+                digit = c - 'a' + 10;
+            }
+            else if (hex && (c >= 'A') && (c <= 'F')) {
+                digit = c - 'A' + 10;
+            }
+            else {
+                simplexml_fail(simpleXml);
+                return;
+            }
+            code = (code * (hex ? 16 : 10)) + digit;
+            if (code > 0x10FFFF) {
+                simplexml_fail(simpleXml);
+                return;
+            }
+        }
+        if (!code || ((code >= 0xD800) && (code <= 0xDFFF))) {
+            simplexml_fail(simpleXml);
+            return;
+        }
+        if (code < 0x80) {
+            decoded[len++] = code;
+        }
+        else if (code < 0x800) {
+            decoded[len++] = 0xC0 | (code >> 6);
+            decoded[len++] = 0x80 | (code & 0x3F);
+        }
+        else if (code < 0x10000) {
+            decoded[len++] = 0xE0 | (code >> 12);
+            decoded[len++] = 0x80 | ((code >> 6) & 0x3F);
+            decoded[len++] = 0x80 | (code & 0x3F);
+        }
+        else {
+            decoded[len++] = 0xF0 | (code >> 18);
+            decoded[len++] = 0x80 | ((code >> 12) & 0x3F);
+            decoded[len++] = 0x80 | ((code >> 6) & 0x3F);
+            decoded[len++] = 0x80 | (code & 0x3F);
+        }
+    }
+    else {
+        simplexml_fail(simpleXml);
         return;
     }
 
-    simpleXml->status = S3StatusXmlParseFailure;
+    simplexml_text(simpleXml, decoded, len);
 }
 
 
-static struct _xmlSAXHandler saxHandlerG =
-{
-    0, // internalSubsetSAXFunc
-    0, // isStandaloneSAXFunc
-    0, // hasInternalSubsetSAXFunc
-    0, // hasExternalSubsetSAXFunc
-    0, // resolveEntitySAXFunc
-    &saxGetEntity, // getEntitySAXFunc
-    0, // entityDeclSAXFunc
-    0, // notationDeclSAXFunc
-    0, // attributeDeclSAXFunc
-    0, // elementDeclSAXFunc
-    0, // unparsedEntityDeclSAXFunc
-    0, // setDocumentLocatorSAXFunc
-    0, // startDocumentSAXFunc
-    0, // endDocumentSAXFunc
-    &saxStartElement, // startElementSAXFunc
-    &saxEndElement, // endElementSAXFunc
-    0, // referenceSAXFunc
-    &saxCharacters, // charactersSAXFunc
-    0, // ignorableWhitespaceSAXFunc
-    0, // processingInstructionSAXFunc
-    0, // commentSAXFunc
-    0, // warningSAXFunc
-    &saxError, // errorSAXFunc
-    &saxError, // fatalErrorSAXFunc
-    0, // getParameterEntitySAXFunc
-    &saxCharacters, // cdataBlockSAXFunc
-    0, // externalSubsetSAXFunc
-    0, // initialized
-    0, // _private
-    0, // startElementNsSAX2Func
-    0, // endElementNsSAX2Func
-    0 // xmlStructuredErrorFunc serror;
-};
-
-void simplexml_initialize(SimpleXml *simpleXml, 
+void simplexml_initialize(SimpleXml *simpleXml,
                           SimpleXmlCallback *callback, void *callbackData)
 {
     simpleXml->callback = callback;
+    simpleXml->idCallback = 0;
     simpleXml->callbackData = callbackData;
+    simpleXml->paths = 0;
+    simpleXml->pathsCount = 0;
+    simpleXml->knownDepth = 0;
+    simpleXml->elementPath[0] = 0;
     simpleXml->elementPathLen = 0;
+    simpleXml->state = SimpleXmlStateText;
+    simpleXml->depth = 0;
+    simpleXml->matchOffset = 0;
+    simpleXml->quote = 0;
+    simpleXml->emptyElement = 0;
+    simpleXml->markCount = 0;
+    simpleXml->bracketDepth = 0;
+    simpleXml->afterCarriageReturn = 0;
+    simpleXml->tokenLen = 0;
     simpleXml->status = S3StatusOK;
-    simpleXml->xmlParser = 0;
+}
+
+
+void simplexml_initialize_ids(SimpleXml *simpleXml,
+                              const SimpleXmlPath *paths, int pathsCount,
+                              SimpleXmlIdCallback *callback,
+                              void *callbackData)
+{
+    simplexml_initialize(simpleXml, 0, callbackData);
+
+    simpleXml->idCallback = callback;
+    simpleXml->paths = paths;
+    simpleXml->pathsCount = pathsCount;
 }
 
 
 void simplexml_deinitialize(SimpleXml *simpleXml)
 {
-    if (simpleXml->xmlParser) {
-        xmlFreeParserCtxt(simpleXml->xmlParser);
-    }
+    (void) simpleXml;
 }
 
 
 S3Status simplexml_add(SimpleXml *simpleXml, const char *data, int dataLen)
 {
-    if (!simpleXml->xmlParser &&
-        (!(simpleXml->xmlParser = xmlCreatePushParserCtxt
-           (&saxHandlerG, simpleXml, 0, 0, 0)))) {
-        return S3StatusInternalError;
+    const char *end = &(data[dataLen]);
+
+    probe1(xml__parse__start, dataLen);
+
+    while ((data < end) && (simpleXml->status == S3StatusOK)) {
+        switch (simpleXml->state) {
+        case SimpleXmlStateText: {
+            // Line ends are normalized to a newline
+            if (simpleXml->afterCarriageReturn) {
+                simpleXml->afterCarriageReturn = 0;
+                if (*data == '\n') {
+                    data++;
+                    break;
+                }
+            }
+            int len = find_text_end(data, end - data);
+            if (len) {
+                simplexml_text(simpleXml, data, len);
+                data += len;
+                break;
+            }
+            char c = *data++;
+            if (c == '<') {
+                simpleXml->state = SimpleXmlStateTagOpen;
+            }
+            else if (c == '&') {
+                simpleXml->tokenLen = 0;
+                simpleXml->state = SimpleXmlStateEntity;
+            }
+            else {
+                simplexml_text(simpleXml, "\n", 1);
+                simpleXml->afterCarriageReturn = 1;
+            }
+            break;
+        }
+
+        case SimpleXmlStateEntity: {
+            char c = *data++;
+            if (c == ';') {
+                simpleXml->token[simpleXml->tokenLen] = 0;
+                simpleXml->state = SimpleXmlStateText;
+                simplexml_entity(simpleXml);
+            }
+            else if (simpleXml->tokenLen ==
+                     (int) (sizeof(simpleXml->token) - 1)) {
+                simplexml_fail(simpleXml);
+            }
+            else {
+                simpleXml->token[simpleXml->tokenLen++] = c;
+            }
+            break;
+        }
+
+        case SimpleXmlStateTagOpen: {
+            char c = *data;
+            if (c == '/') {
+                data++;
+                if (!simpleXml->depth) {
+                    simplexml_fail(simpleXml);
+                    break;
+                }
+                // The name must match the last element of the path
+                int offset = simpleXml->elementPathLen;
+                while ((offset > 0) &&
+                       (simpleXml->elementPath[offset - 1] != '/')) {
+                    offset--;
+                }
+                simpleXml->matchOffset = offset;
+                simpleXml->state = SimpleXmlStateEndTagName;
+            }
+            else if (c == '!') {
+                data++;
+                simpleXml->tokenLen = 0;
+                simpleXml->state = SimpleXmlStateBang;
+            }
+            else if (c == '?') {
+                data++;
+                simpleXml->markCount = 0;
+                simpleXml->state = SimpleXmlStateProcessingInstruction;
+            }
+            else if (is_space(c) || (c == '>') || (c == '/')) {
+                simplexml_fail(simpleXml);
+            }
+            else {
+                // Append the element to the element path
+                if (simpleXml->elementPathLen) {
+                    simplexml_name_byte(simpleXml, '/');
+                }
+                simpleXml->depth++;
+                simpleXml->matchOffset = simpleXml->elementPathLen;
+                simpleXml->state = SimpleXmlStateStartTagName;
+            }
+            break;
+        }
+
+        case SimpleXmlStateStartTagName: {
+            char c = *data;
+            if (is_space(c) || (c == '>') || (c == '/')) {
+                simpleXml->elementPath[simpleXml->elementPathLen] = 0;
+                if (simpleXml->paths) {
+                    simplexml_start_element(simpleXml,
+                                            simpleXml->matchOffset);
+                }
+                simpleXml->quote = 0;
+                simpleXml->emptyElement = 0;
+                simpleXml->state = SimpleXmlStateStartTagAttributes;
+            }
+            else {
+                simplexml_name_byte(simpleXml, c);
+                data++;
+            }
+            break;
+        }
+
+        case SimpleXmlStateStartTagAttributes: {
+            // Attributes are skipped, minding quoted values
+            char c = *data++;
+            if (simpleXml->quote) {
+                if (c == simpleXml->quote) {
+                    simpleXml->quote = 0;
+                }
+            }
+            else if (c == '>') {
+                simpleXml->state = SimpleXmlStateText;
+                if (simpleXml->emptyElement) {
+                    simplexml_end_element(simpleXml);
+                }
+            }
+            else if ((c == '"') || (c == '\'')) {
+                simpleXml->quote = c;
+                simpleXml->emptyElement = 0;
+            }
+            else if (c == '/') {
+                simpleXml->emptyElement = 1;
+            }
+            else if (!is_space(c)) {
+                simpleXml->emptyElement = 0;
+            }
+            break;
+        }
+
+        case SimpleXmlStateEndTagName: {
+            char c = *data++;
+            if (is_space(c) || (c == '>')) {
+                if (simpleXml->matchOffset != simpleXml->elementPathLen) {
+                    simplexml_fail(simpleXml);
+                }
+                else if (c == '>') {
+                    simpleXml->state = SimpleXmlStateText;
+                    simplexml_end_element(simpleXml);
+                }
+                else {
+                    simpleXml->state = SimpleXmlStateEndTagClose;
+                }
+            }
+            else if ((simpleXml->matchOffset == simpleXml->elementPathLen) ||
+                     (simpleXml->elementPath[simpleXml->matchOffset++] !=
+                      c)) {
+                simplexml_fail(simpleXml);
+            }
+            break;
+        }
+
+        case SimpleXmlStateEndTagClose: {
+            char c = *data++;
+            if (c == '>') {
+                simpleXml->state = SimpleXmlStateText;
+                simplexml_end_element(simpleXml);
+            }
+            else if (!is_space(c)) {
+                simplexml_fail(simpleXml);
+            }
+            break;
+        }
+
+        case SimpleXmlStateBang: {
+            // Collect enough to tell a comment or CDATA section from a
+            // declaration
+            char c = *data++;
+            simpleXml->token[simpleXml->tokenLen++] = c;
+            int len = simpleXml->tokenLen;
+            if ((len == 2) && !strncmp(simpleXml->token, "--", 2)) {
+                simpleXml->markCount = 0;
+                simpleXml->state = SimpleXmlStateComment;
+            }
+            else if (!strncmp(simpleXml->token, CDATA_START, len)) {
+                if (len == CDATA_START_LEN) {
+                    simpleXml->markCount = 0;
+                    simpleXml->state = SimpleXmlStateCdata;
+                }
+            }
+            else if ((len == 1) && (c == '-')) {
+                // May yet be a comment
+            }
+            else if (c == '>') {
+                // An empty declaration; no other byte collected can be '>'
+                simpleXml->state = SimpleXmlStateText;
+            }
+            else {
+                int i;
+                simpleXml->bracketDepth = 0;
+                for (i = 0; i < len; i++) {
+                    simpleXml->bracketDepth += (simpleXml->token[i] == '[');
+                }
+                simpleXml->state = SimpleXmlStateDeclaration;
+            }
+            break;
+        }
+
+        case SimpleXmlStateComment: {
+            if ((simpleXml->markCount >= 2) && (*data == '>')) {
+                data++;
+                simpleXml->state = SimpleXmlStateText;
+            }
+            else if (*data == '-') {
+                simpleXml->markCount++;
+                data++;
+            }
+            else {
+                simpleXml->markCount = 0;
+                const char *dash = (const char *) memchr(data, '-', end - data);
+                data = dash ? dash : end;
+            }
+            break;
+        }
+
+        case SimpleXmlStateCdata: {
+            if ((simpleXml->markCount >= 2) && (*data == '>')) {
+                // Any ']' before the final two were part of the text
+                while (simpleXml->markCount > 2) {
+                    simplexml_text(simpleXml, "]", 1);
+                    simpleXml->markCount--;
+                }
+                data++;
+                simpleXml->state = SimpleXmlStateText;
+            }
+            else if (*data == ']') {
+                simpleXml->markCount++;
+                data++;
+            }
+            else {
+                while (simpleXml->markCount &&
+                       (simpleXml->status == S3StatusOK)) {
+                    simplexml_text(simpleXml, "]", 1);
+                    simpleXml->markCount--;
+                }
+                const char *bracket =
+                    (const char *) memchr(data, ']', end - data);
+                int len = (bracket ? bracket : end) - data;
+                if (simpleXml->status == S3StatusOK) {
+                    simplexml_text(simpleXml, data, len);
+                }
+                data += len;
+            }
+            break;
+        }
+
+        case SimpleXmlStateProcessingInstruction: {
+            char c = *data++;
+            if (simpleXml->markCount && (c == '>')) {
+                simpleXml->state = SimpleXmlStateText;
+            }
+            else {
+                simpleXml->markCount = (c == '?');
+            }
+            break;
+        }
+
+        default: { // SimpleXmlStateDeclaration
+            // Skipped along with any internal subset in brackets
+            char c = *data++;
+            if (c == '[') {
+                simpleXml->bracketDepth++;
+            }
+            else if ((c == ']') && simpleXml->bracketDepth) {
+                simpleXml->bracketDepth--;
+            }
+            else if ((c == '>') && !simpleXml->bracketDepth) {
+                simpleXml->state = SimpleXmlStateText;
+            }
+            break;
+        }
+        }
     }
 
-    if (xmlParseChunk((xmlParserCtxtPtr) simpleXml->xmlParser, 
-                      data, dataLen, 0)) {
-        return S3StatusXmlParseFailure;
-    }
+    probe1(xml__parse__end, simpleXml->status);
 
     return simpleXml->status;
 }
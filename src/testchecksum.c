@@ -0,0 +1,411 @@
+/** **************************************************************************
+ * testchecksum.c
+ *
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+// Checks the CRC32C and CRC64NVME checksums against known answers and
+// against bit-at-a-time reference implementations, S3_combine_checksums()
+// against checksums of whole buffers, and the base64 encoding and decoding
+// of checksums.  checksum.c is included rather than linked so that both the
+// table driven and the SSE 4.2 CRC32C implementations can be checked, not
+// just the one that the running CPU selects.
+
+#include "checksum.c"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static long checksG, failuresG;
+
+
+#define check(cond, ...)                                                \
+    do {                                                                \
+        checksG++;                                                      \
+        if (!(cond)) {                                                  \
+            failuresG++;                                                \
+            fprintf(stderr, "ERROR: " __VA_ARGS__);                     \
+            fprintf(stderr, "\n");                                      \
+        }                                                               \
+    } while (0)
+
+
+// reference implementations ------------------------------------------------
+
+static uint32_t reference_crc32c(const unsigned char *data, size_t length)
+{
+    uint32_t crc = 0xFFFFFFFFU;
+    int j;
+
+    while (length--) {
+        crc ^= *data++;
+        for (j = 0; j < 8; j++) {
+            crc = (crc & 1) ? ((crc >> 1) ^ CRC32C_POLY) : (crc >> 1);
+        }
+    }
+
+    return ~crc;
+}
+
+
+static uint64_t reference_crc64nvme(const unsigned char *data, size_t length)
+{
+    uint64_t crc = 0xFFFFFFFFFFFFFFFFULL;
+    int j;
+
+    while (length--) {
+        crc ^= *data++;
+        for (j = 0; j < 8; j++) {
+            crc = (crc & 1) ? ((crc >> 1) ^ CRC64NVME_POLY) : (crc >> 1);
+        }
+    }
+
+    return ~crc;
+}
+
+
+// checks -------------------------------------------------------------------
+
+static const S3ChecksumAlgorithm algorithmsG[] =
+    { S3ChecksumAlgorithmCRC32C, S3ChecksumAlgorithmCRC64NVME };
+
+static const char *algorithmNamesG[] = { "CRC32C", "CRC64NVME" };
+
+
+// Known answers: the standard check value of each algorithm, the CRC32C
+// test vectors of RFC 3720 B.4, and their base64 encodings as S3 sends them
+static void check_known_answers()
+{
+    static const char *checkValue = "123456789";
+    unsigned char buf[32];
+    char encoded[S3_MAX_CHECKSUM_SIZE];
+    int i;
+
+    uint64_t crc32c = S3_compute_checksum
+        (S3ChecksumAlgorithmCRC32C, 0, checkValue, strlen(checkValue));
+    check(crc32c == 0xE3069283ULL, "CRC32C check value %llx",
+          (unsigned long long) crc32c);
+    S3_encode_checksum(S3ChecksumAlgorithmCRC32C, crc32c, encoded);
+    check(!strcmp(encoded, "4waSgw=="), "CRC32C check value encoded as %s",
+          encoded);
+
+    uint64_t crc64 = S3_compute_checksum
+        (S3ChecksumAlgorithmCRC64NVME, 0, checkValue, strlen(checkValue));
+    check(crc64 == 0xAE8B14860A799888ULL, "CRC64NVME check value %llx",
+          (unsigned long long) crc64);
+    S3_encode_checksum(S3ChecksumAlgorithmCRC64NVME, crc64, encoded);
+    check(!strcmp(encoded, "rosUhgp5mIg="),
+          "CRC64NVME check value encoded as %s", encoded);
+
+    memset(buf, 0, sizeof(buf));
+    check(S3_compute_checksum(S3ChecksumAlgorithmCRC32C, 0, buf,
+                              sizeof(buf)) == 0x8A9136AAULL,
+          "CRC32C of 32 zero bytes");
+
+    memset(buf, 0xFF, sizeof(buf));
+    check(S3_compute_checksum(S3ChecksumAlgorithmCRC32C, 0, buf,
+                              sizeof(buf)) == 0x62A8AB43ULL,
+          "CRC32C of 32 0xFF bytes");
+
+    for (i = 0; i < 32; i++) {
+        buf[i] = i;
+    }
+    check(S3_compute_checksum(S3ChecksumAlgorithmCRC32C, 0, buf,
+                              sizeof(buf)) == 0x46DD794EULL,
+          "CRC32C of 32 incrementing bytes");
+
+    for (i = 0; i < 32; i++) {
+        buf[i] = 31 - i;
+    }
+    check(S3_compute_checksum(S3ChecksumAlgorithmCRC32C, 0, buf,
+                              sizeof(buf)) == 0x113FDB5CULL,
+          "CRC32C of 32 decrementing bytes");
+
+    // Nothing to checksum leaves the checksum as it was
+    check(S3_compute_checksum(S3ChecksumAlgorithmCRC32C, 0x1234, buf, 0) ==
+          0x1234, "CRC32C of no data");
+    check(S3_compute_checksum(S3ChecksumAlgorithmNone, 0, buf, 32) == 0,
+          "checksum of no algorithm");
+}
+
+
+// Checks each implementation against the reference for every length up to
+// a few slicing-by-8 blocks, from every alignment, in one call and split in
+// two at every point
+static void check_kernels(const unsigned char *data)
+{
+    int hasSse42 = 0;
+    size_t offset, length, split;
+
+#if defined(__GNUC__) && defined(__x86_64__)
+    hasSse42 = __builtin_cpu_supports("sse4.2");
+#endif
+
+    if (!hasSse42) {
+        printf("SSE 4.2 is not available; checking only the table driven "
+               "CRC32C\n");
+    }
+
+    for (offset = 0; offset < 8; offset++) {
+        for (length = 0; length <= 80; length++) {
+            const unsigned char *d = &(data[offset]);
+            uint32_t ref32 = reference_crc32c(d, length);
+            uint64_t ref64 = reference_crc64nvme(d, length);
+
+            for (split = 0; split <= length; split++) {
+                uint32_t sw = ~crc32c_update_sw
+                    (crc32c_update_sw(0xFFFFFFFFU, d, split), &(d[split]),
+                     length - split);
+                check(sw == ref32, "table CRC32C of %zu bytes at offset %zu "
+                      "split at %zu", length, offset, split);
+
+                uint64_t sw64 = ~crc64nvme_update_sw
+                    (crc64nvme_update_sw(~0ULL, d, split), &(d[split]),
+                     length - split);
+                check(sw64 == ref64, "table CRC64NVME of %zu bytes at offset "
+                      "%zu split at %zu", length, offset, split);
+
+#if defined(__GNUC__) && defined(__x86_64__)
+                if (hasSse42) {
+                    uint32_t hw = ~crc32c_update_sse42
+                        (crc32c_update_sse42(0xFFFFFFFFU, d, split),
+                         &(d[split]), length - split);
+                    check(hw == ref32, "SSE 4.2 CRC32C of %zu bytes at "
+                          "offset %zu split at %zu", length, offset, split);
+                }
+#endif
+            }
+        }
+    }
+
+    // And a long buffer, through the public interface
+    check(S3_compute_checksum(S3ChecksumAlgorithmCRC32C, 0, &(data[3]),
+                              65536) == reference_crc32c(&(data[3]), 65536),
+          "CRC32C of 64 KiB");
+    check(S3_compute_checksum(S3ChecksumAlgorithmCRC64NVME, 0, &(data[5]),
+                              65536) ==
+          reference_crc64nvme(&(data[5]), 65536), "CRC64NVME of 64 KiB");
+}
+
+
+static void check_combine(const unsigned char *data)
+{
+    static const int lengths[] =
+        { 0, 1, 2, 3, 7, 8, 9, 63, 64, 65, 1000, 4096, 65535, 65536 };
+    int a, i, j;
+
+    for (a = 0; a < 2; a++) {
+        S3ChecksumAlgorithm algorithm = algorithmsG[a];
+
+        for (i = 0; i < (int) (sizeof(lengths) / sizeof(lengths[0])); i++) {
+            for (j = 0; j < (int) (sizeof(lengths) / sizeof(lengths[0]));
+                 j++) {
+                int length1 = lengths[i], length2 = lengths[j];
+                uint64_t crc1 = S3_compute_checksum
+                    (algorithm, 0, data, length1);
+                uint64_t crc2 = S3_compute_checksum
+                    (algorithm, 0, &(data[length1]), length2);
+                uint64_t whole = S3_compute_checksum
+                    (algorithm, 0, data, length1 + length2);
+                check(S3_combine_checksums(algorithm, crc1, crc2, length2) ==
+                      whole, "combining %s checksums of %d and %d bytes",
+                      algorithmNamesG[a], length1, length2);
+            }
+        }
+
+        // The checksum of an object uploaded in parts, from those of its
+        // parts
+        uint64_t combined = 0;
+        int offset = 0, part = 1;
+        while (offset < 131072) {
+            int partLength = (part * 7919) % 20000;
+            if ((offset + partLength) > 131072) {
+                partLength = 131072 - offset;
+            }
+            combined = S3_combine_checksums
+                (algorithm, combined, S3_compute_checksum
+                 (algorithm, 0, &(data[offset]), partLength), partLength);
+            offset += partLength;
+            part++;
+        }
+        check(combined == S3_compute_checksum(algorithm, 0, data, 131072),
+              "combining %s checksums of %d parts",
+              algorithmNamesG[a], part - 1);
+
+        // Lengths beyond those of any buffer: combining with the checksum of
+        // zero bytes must match extending by zero bytes a piece at a time
+        static const unsigned char zeros[65536];
+        uint64_t crc = S3_compute_checksum(algorithm, 0, data, 100);
+        uint64_t extended = crc;
+        for (i = 0; i < 80; i++) {
+            extended = S3_compute_checksum(algorithm, extended, zeros,
+                                           sizeof(zeros));
+        }
+        uint64_t zerosCrc = 0;
+        for (i = 0; i < 80; i++) {
+            zerosCrc = S3_compute_checksum(algorithm, zerosCrc, zeros,
+                                           sizeof(zeros));
+        }
+        check(S3_combine_checksums(algorithm, crc, zerosCrc,
+                                   80 * sizeof(zeros)) == extended,
+              "combining %s checksum with %d zero bytes",
+              algorithmNamesG[a],
+              (int) (80 * sizeof(zeros)));
+    }
+
+    check(S3_combine_checksums(S3ChecksumAlgorithmNone, 1, 2, 3) == 0,
+          "combining checksums of no algorithm");
+}
+
+
+static void check_encoding()
+{
+    static const uint64_t values[] =
+        { 0, 1, 0xFF, 0x80000000ULL, 0xFFFFFFFFULL, 0x0123456789ABCDEFULL,
+          0xFFFFFFFFFFFFFFFFULL };
+    char encoded[S3_MAX_CHECKSUM_SIZE];
+    uint64_t decoded;
+    int a, i;
+
+    for (a = 0; a < 2; a++) {
+        S3ChecksumAlgorithm algorithm = algorithmsG[a];
+        uint64_t mask = (algorithm == S3ChecksumAlgorithmCRC32C) ?
+            0xFFFFFFFFULL : 0xFFFFFFFFFFFFFFFFULL;
+        int expectedLen = (algorithm == S3ChecksumAlgorithmCRC32C) ? 8 : 12;
+
+        for (i = 0; i < (int) (sizeof(values) / sizeof(values[0])); i++) {
+            uint64_t value = values[i] & mask;
+            int len = S3_encode_checksum(algorithm, value, encoded);
+            check((len == expectedLen) && ((int) strlen(encoded) == len),
+                  "encoded %s checksum %llx has length %d",
+                  algorithmNamesG[a],
+                  (unsigned long long) value, len);
+            check(S3_decode_checksum(algorithm, encoded, &decoded) &&
+                  (decoded == value), "decoding %s checksum %s",
+                  algorithmNamesG[a], encoded);
+        }
+    }
+
+    S3_encode_checksum(S3ChecksumAlgorithmCRC32C, 0, encoded);
+    check(!strcmp(encoded, "AAAAAA=="), "zero CRC32C encoded as %s",
+          encoded);
+    S3_encode_checksum(S3ChecksumAlgorithmCRC64NVME, 0xFFFFFFFFFFFFFFFFULL,
+                       encoded);
+    check(!strcmp(encoded, "//////////8="), "all ones CRC64NVME encoded as %s",
+          encoded);
+    check(!S3_encode_checksum(S3ChecksumAlgorithmNone, 1, encoded) &&
+          !encoded[0], "encoding a checksum of no algorithm");
+
+    // Padding is optional on decoding
+    check(S3_decode_checksum(S3ChecksumAlgorithmCRC32C, "4waSgw", &decoded) &&
+          (decoded == 0xE3069283ULL), "decoding unpadded CRC32C");
+
+    // Malformed and mismatched checksums are rejected
+    static const struct
+    {
+        S3ChecksumAlgorithm algorithm;
+        const char *str;
+    } bad[] =
+    {
+        { S3ChecksumAlgorithmCRC32C, "" },
+        { S3ChecksumAlgorithmCRC32C, "4waS" },
+        { S3ChecksumAlgorithmCRC32C, "4waSg*==" },
+        { S3ChecksumAlgorithmCRC32C, "rosUhgp5mIg=" },
+        { S3ChecksumAlgorithmCRC32C, "4waSgw==-3" },
+        { S3ChecksumAlgorithmCRC64NVME, "4waSgw==" },
+        { S3ChecksumAlgorithmCRC64NVME, "rosUhgp5mIgA" },
+        { S3ChecksumAlgorithmNone, "4waSgw==" }
+    };
+    for (i = 0; i < (int) (sizeof(bad) / sizeof(bad[0])); i++) {
+        decoded = 0x5A5A;
+        check(!S3_decode_checksum(bad[i].algorithm, bad[i].str, &decoded) &&
+              (decoded == 0x5A5A), "decoding malformed checksum \"%s\"",
+              bad[i].str);
+    }
+    check(!S3_decode_checksum(S3ChecksumAlgorithmCRC32C, 0, &decoded),
+          "decoding a NULL checksum");
+}
+
+
+// The Content-Length given for an aws-chunked body must be that of the
+// framing and data actually sent
+static void check_chunked_length()
+{
+    static const uint64_t lengths[] =
+        { 0, 1, 15, 16, CHECKSUM_CHUNK_SIZE - 1, CHECKSUM_CHUNK_SIZE,
+          CHECKSUM_CHUNK_SIZE + 1, (3 * CHECKSUM_CHUNK_SIZE) + 4095 };
+    char framing[CHECKSUM_FRAMING_SIZE];
+    int a, i;
+
+    for (a = 0; a < 2; a++) {
+        for (i = 0; i < (int) (sizeof(lengths) / sizeof(lengths[0])); i++) {
+            uint64_t remaining = lengths[i], total = 0;
+            int first = 1;
+            while (remaining) {
+                int chunk = (remaining > CHECKSUM_CHUNK_SIZE) ?
+                    CHECKSUM_CHUNK_SIZE : (int) remaining;
+                total += checksum_chunk_framing(algorithmsG[a], 0, first,
+                                                chunk, framing) + chunk;
+                remaining -= chunk;
+                first = 0;
+            }
+            total += checksum_chunk_framing(algorithmsG[a], ~0ULL, first, 0,
+                                            framing);
+            check(total == checksum_chunked_length(algorithmsG[a],
+                                                   lengths[i]),
+                  "aws-chunked length of %llu bytes of %s",
+                  (unsigned long long) lengths[i],
+                  algorithmNamesG[a]);
+        }
+    }
+}
+
+
+int main()
+{
+    static unsigned char data[(2 * 65536) + 16];
+    unsigned int i, seed = 1;
+
+    for (i = 0; i < sizeof(data); i++) {
+        seed = (seed * 1103515245) + 12345;
+        data[i] = (unsigned char) (seed >> 16);
+    }
+
+    pthread_once(&checksumOnceG, &checksum_initialize);
+
+    check_known_answers();
+    check_kernels(data);
+    check_combine(data);
+    check_encoding();
+    check_chunked_length();
+
+    printf("%ld checks, %ld failures\n", checksG, failuresG);
+
+    return failuresG ? -1 : 0;
+}
@@ -0,0 +1,676 @@
+/** **************************************************************************
+ * testlistingindex.c
+ *
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "libs3.h"
+
+// Checks listing indexes built from a bucket that a child process serves
+// ListObjectsV2 requests for: that a full refresh indexes every key, that
+// S3_listing_index_find() and S3_listing_index_search() find keys and the
+// bounds of prefixes, that refreshing changed prefixes replaces only the
+// keys under them, that an append-only refresh lists only what follows the
+// last key, that a failed refresh leaves the index as it was, and that
+// index files which are damaged, or of another bucket or prefix, are
+// rejected.
+//
+// Pages hold PAGE_SIZE keys and continuation tokens are longer than any key,
+// so that tokens are passed back exactly as given is checked too.
+
+#define PAGE_SIZE 2
+
+#define TOKEN_PADDING 2000
+
+// Last modified time of every object, 2020-01-01T00:00:00Z
+#define LAST_MODIFIED 1577836800
+
+static long checksG = 0;
+
+static long failuresG = 0;
+
+#define check(condition, ...)                                           \
+    do {                                                                \
+        checksG++;                                                      \
+        if (!(condition)) {                                             \
+            failuresG++;                                                \
+            fprintf(stderr, "ERROR: " __VA_ARGS__);                     \
+            fprintf(stderr, "\n");                                      \
+        }                                                               \
+    } while (0)
+
+
+typedef struct TestObject
+{
+    const char *key;
+    uint64_t size;
+} TestObject;
+
+
+// server -------------------------------------------------------------------
+
+// Decodes the url encoded value of query parameter [name] of [request] into
+// [value], returning nonzero if it is there
+static int query_param(const char *request, const char *name, char *value,
+                       int valueSize)
+{
+    const char *query = strchr(request, '?');
+    const char *end = strchr(request, ' ');
+    int nameLen = strlen(name);
+
+    if (end) {
+        end = strchr(end + 1, ' ');
+    }
+
+    while (query && (query < end)) {
+        query++;
+        if (!strncmp(query, name, nameLen) && (query[nameLen] == '=')) {
+            const char *src = &(query[nameLen + 1]);
+            int len = 0;
+            while ((src < end) && (*src != '&') && (len < (valueSize - 1))) {
+                if ((*src == '%') && src[1] && src[2]) {
+                    char hex[3] = { src[1], src[2], 0 };
+                    value[len++] = (char) strtol(hex, 0, 16);
+                    src += 3;
+                }
+                else {
+                    value[len++] = *src++;
+                }
+            }
+            value[len] = 0;
+            return 1;
+        }
+        query = strchr(query, '&');
+    }
+
+    return 0;
+}
+
+
+static void write_response(int fd, const char *status, const char *body)
+{
+    char headers[256];
+    int bodyLen = strlen(body);
+    int headersLen = snprintf(headers, sizeof(headers),
+                              "HTTP/1.1 %s\r\n"
+                              "Content-Type: application/xml\r\n"
+                              "Content-Length: %d\r\n"
+                              "Connection: close\r\n"
+                              "\r\n", status, bodyLen);
+
+    if ((write(fd, headers, headersLen) != headersLen) ||
+        (write(fd, body, bodyLen) != bodyLen)) {
+        // The client will report the failure
+    }
+}
+
+
+// Answers a ListObjectsV2 request for [objects], which are sorted by key, or
+// if there are none, denies access
+static void serve_list(int fd, const char *request,
+                       const TestObject *objects, int objectsCount)
+{
+    static const char errorFormat[] =
+        "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+        "<Error><Code>%s</Code><Message>%s</Message></Error>";
+    char body[16384], prefix[1024], startAfter[1024], token[4096];
+    int len, i, start = 0;
+
+    if (!objects) {
+        snprintf(body, sizeof(body), errorFormat, "AccessDenied",
+                 "Access Denied");
+        write_response(fd, "403 Forbidden", body);
+        return;
+    }
+
+    if (!query_param(request, "prefix", prefix, sizeof(prefix))) {
+        prefix[0] = 0;
+    }
+    if (!query_param(request, "start-after", startAfter,
+                     sizeof(startAfter))) {
+        startAfter[0] = 0;
+    }
+
+    // Tokens are TOKEN_PADDING 'x's followed by the position to continue
+    // from
+    if (query_param(request, "continuation-token", token, sizeof(token))) {
+        for (i = 0; (i < TOKEN_PADDING) && (token[i] == 'x'); i++) {
+        }
+        if ((i < TOKEN_PADDING) || !token[i]) {
+            snprintf(body, sizeof(body), errorFormat, "InvalidArgument",
+                     "The continuation token provided is incorrect");
+            write_response(fd, "400 Bad Request", body);
+            return;
+        }
+        start = atoi(&(token[i]));
+    }
+
+    len = snprintf(body, sizeof(body),
+                   "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                   "<ListBucketResult><Name>bucket</Name>"
+                   "<Prefix>%s</Prefix><MaxKeys>%d</MaxKeys>", prefix,
+                   PAGE_SIZE);
+
+    int count = 0, position = 0, isTruncated = 0;
+    for (i = 0; i < objectsCount; i++) {
+        if (strncmp(objects[i].key, prefix, strlen(prefix)) ||
+            (strcmp(objects[i].key, startAfter) <= 0)) {
+            continue;
+        }
+        if (position++ < start) {
+            continue;
+        }
+        if (count == PAGE_SIZE) {
+            isTruncated = 1;
+            memset(token, 'x', TOKEN_PADDING);
+            snprintf(&(token[TOKEN_PADDING]), sizeof(token) - TOKEN_PADDING,
+                     "%d", start + count);
+            break;
+        }
+        len += snprintf(&(body[len]), sizeof(body) - len,
+                        "<Contents><Key>%s</Key>"
+                        "<LastModified>2020-01-01T00:00:00.000Z"
+                        "</LastModified><ETag>e%llu</ETag>"
+                        "<Size>%llu</Size>"
+                        "<StorageClass>STANDARD</StorageClass></Contents>",
+                        objects[i].key, (unsigned long long) objects[i].size,
+                        (unsigned long long) objects[i].size);
+        count++;
+    }
+
+    if (isTruncated) {
+        snprintf(&(body[len]), sizeof(body) - len,
+                 "<IsTruncated>true</IsTruncated>"
+                 "<NextContinuationToken>%s</NextContinuationToken>"
+                 "</ListBucketResult>", token);
+    }
+    else {
+        snprintf(&(body[len]), sizeof(body) - len,
+                 "<IsTruncated>false</IsTruncated></ListBucketResult>");
+    }
+
+    write_response(fd, "200 OK", body);
+}
+
+
+static void serve_requests(int listenFd, const TestObject *objects,
+                           int objectsCount)
+{
+    while (1) {
+        int fd = accept(listenFd, 0, 0);
+        if (fd < 0) {
+            continue;
+        }
+        // Read the request up to the end of its headers; list requests have
+        // no body
+        char request[16384];
+        int requestLen = 0;
+        while (requestLen < (int) (sizeof(request) - 1)) {
+            int n = read(fd, &(request[requestLen]),
+                         sizeof(request) - 1 - requestLen);
+            if (n <= 0) {
+                break;
+            }
+            requestLen += n;
+            if ((requestLen >= 4) &&
+                !memcmp(&(request[requestLen - 4]), "\r\n\r\n", 4)) {
+                break;
+            }
+        }
+        request[requestLen] = 0;
+        serve_list(fd, request, objects, objectsCount);
+        close(fd);
+    }
+}
+
+
+// Serves [objects] until stop_server() is called, returning the server's
+// pid
+static pid_t start_server(int listenFd, const TestObject *objects,
+                          int objectsCount)
+{
+    pid_t server = fork();
+
+    if (server < 0) {
+        perror("ERROR: failed to fork");
+        exit(-1);
+    }
+    if (!server) {
+        serve_requests(listenFd, objects, objectsCount);
+        _exit(0);
+    }
+
+    return server;
+}
+
+
+static void stop_server(pid_t server)
+{
+    kill(server, SIGTERM);
+    waitpid(server, 0, 0);
+}
+
+
+// checks -------------------------------------------------------------------
+
+// Checks that [index] holds exactly [objects]
+static void check_contents(const char *what, const S3ListingIndex *index,
+                           const TestObject *objects, int objectsCount)
+{
+    uint64_t count = S3_listing_index_count(index);
+    int i;
+
+    check(count == (uint64_t) objectsCount, "%s: %llu keys, expected %d",
+          what, (unsigned long long) count, objectsCount);
+
+    for (i = 0; i < objectsCount; i++) {
+        S3ListBucketContent content;
+        char eTag[64];
+        snprintf(eTag, sizeof(eTag), "e%llu",
+                 (unsigned long long) objects[i].size);
+        if (!S3_listing_index_get(index, i, &content)) {
+            check(0, "%s: no key at %d, expected %s", what, i,
+                  objects[i].key);
+            continue;
+        }
+        check(!strcmp(content.key, objects[i].key) &&
+              (content.size == objects[i].size) &&
+              !strcmp(content.eTag, eTag) &&
+              (content.lastModified == LAST_MODIFIED),
+              "%s: %s (%llu) at %d, expected %s (%llu)", what, content.key,
+              (unsigned long long) content.size, i, objects[i].key,
+              (unsigned long long) objects[i].size);
+    }
+
+    S3ListBucketContent content;
+    check(!S3_listing_index_get(index, objectsCount, &content),
+          "%s: a key past the end", what);
+}
+
+
+static void check_lookups(const S3ListingIndex *index)
+{
+    S3ListBucketContent content;
+
+    check(S3_listing_index_find(index, "b/2", &content) &&
+          !strcmp(content.key, "b/2") && (content.size == 4),
+          "find of b/2");
+    check(S3_listing_index_find(index, "a/1", 0), "find of the first key");
+    check(S3_listing_index_find(index, "d", 0), "find of the last key");
+    check(!S3_listing_index_find(index, "b", 0), "find of a prefix");
+    check(!S3_listing_index_find(index, "b/22", 0), "find of a missing key");
+    check(!S3_listing_index_find(index, "", 0), "find of the empty key");
+    check(!S3_listing_index_find(index, "e", 0), "find past the last key");
+
+    // Positions of a/1 a/2 b/1 b/2 b/3 c/1 d
+    static const struct
+    {
+        const char *key;
+        uint64_t position;
+    } searches[] =
+    {
+        { "", 0 },
+        { "a/1", 0 },
+        { "a/10", 1 },
+        { "b", 2 },
+        { "b/", 2 },
+        { "b/2", 3 },
+        { "b/22", 4 },
+        { "c", 5 },
+        { "c/1", 5 },
+        { "c/1/", 6 },
+        { "d", 6 },
+        { "zz", 7 }
+    };
+    unsigned int i;
+
+    for (i = 0; i < (sizeof(searches) / sizeof(searches[0])); i++) {
+        uint64_t position = S3_listing_index_search(index, searches[i].key);
+        check(position == searches[i].position,
+              "search of \"%s\" gave %llu, expected %llu", searches[i].key,
+              (unsigned long long) position,
+              (unsigned long long) searches[i].position);
+    }
+}
+
+
+static void check_refreshes(int listenFd, const char *path,
+                            const S3BucketContext *bucketContext)
+{
+    static const TestObject initial[] =
+    {
+        { "a/1", 1 }, { "a/2", 2 }, { "b/1", 3 }, { "b/2", 4 },
+        { "b/3", 5 }, { "c/1", 6 }, { "d", 7 }
+    };
+    // b/ and c/ change; a/3 is added and d deleted, which are not seen
+    // since their prefixes are not relisted
+    static const TestObject changed[] =
+    {
+        { "a/1", 1 }, { "a/2", 2 }, { "a/3", 8 }, { "b/1", 30 },
+        { "b/4", 9 }, { "c/1", 6 }, { "c/2", 10 }
+    };
+    static const TestObject relisted[] =
+    {
+        { "a/1", 1 }, { "a/2", 2 }, { "b/1", 30 }, { "b/4", 9 },
+        { "c/1", 6 }, { "c/2", 10 }, { "d", 7 }
+    };
+    // a/9 is added before the last key, so an append-only refresh misses it
+    static const TestObject appended[] =
+    {
+        { "a/1", 1 }, { "a/9", 13 }, { "d", 7 }, { "e", 11 }, { "f", 12 }
+    };
+    static const TestObject appendedIndex[] =
+    {
+        { "a/1", 1 }, { "a/2", 2 }, { "b/1", 30 }, { "b/4", 9 },
+        { "c/1", 6 }, { "c/2", 10 }, { "d", 7 }, { "e", 11 }, { "f", 12 }
+    };
+#define countof(objects) ((int) (sizeof(objects) / sizeof(objects[0])))
+
+    S3ListingIndex *index;
+    S3Status status;
+    pid_t server;
+
+    unlink(path);
+
+    status = S3_open_listing_index(path, "bucket", 0, &index);
+    check(status == S3StatusOK, "open of a missing index: %s",
+          S3_get_status_name(status));
+    if (status != S3StatusOK) {
+        return;
+    }
+    check(S3_listing_index_count(index) == 0, "a missing index has keys");
+    check(!S3_listing_index_find(index, "a/1", 0), "find in an empty index");
+    check(S3_listing_index_search(index, "a/1") == 0,
+          "search of an empty index");
+
+    server = start_server(listenFd, initial, countof(initial));
+    status = S3_refresh_listing_index(index, bucketContext, 0, 0, 0, 0);
+    stop_server(server);
+    check(status == S3StatusOK, "full refresh: %s",
+          S3_get_status_name(status));
+    check_contents("full refresh", index, initial, countof(initial));
+    check_lookups(index);
+
+    // Out of order and nested prefixes
+    const char *changedPrefixes[] = { "c/", "b/", "b/4" };
+    server = start_server(listenFd, changed, countof(changed));
+    status = S3_refresh_listing_index(index, bucketContext, 0, 3,
+                                      changedPrefixes, 0);
+    stop_server(server);
+    check(status == S3StatusOK, "refresh of changed prefixes: %s",
+          S3_get_status_name(status));
+    check_contents("refresh of changed prefixes", index, relisted,
+                   countof(relisted));
+
+    server = start_server(listenFd, appended, countof(appended));
+    status = S3_refresh_listing_index(index, bucketContext, 1, 0, 0, 0);
+    stop_server(server);
+    check(status == S3StatusOK, "append-only refresh: %s",
+          S3_get_status_name(status));
+    check_contents("append-only refresh", index, appendedIndex,
+                   countof(appendedIndex));
+
+    // A failed listing leaves the index as it was
+    server = start_server(listenFd, 0, 0);
+    status = S3_refresh_listing_index(index, bucketContext, 0, 0, 0, 0);
+    stop_server(server);
+    check(status == S3StatusErrorAccessDenied, "failed refresh gave %s",
+          S3_get_status_name(status));
+    check_contents("failed refresh", index, appendedIndex,
+                   countof(appendedIndex));
+
+    S3BucketContext otherBucket = *bucketContext;
+    otherBucket.bucketName = "other";
+    status = S3_refresh_listing_index(index, &otherBucket, 0, 0, 0, 0);
+    check(status == S3StatusListingIndexMismatch,
+          "refresh of another bucket gave %s", S3_get_status_name(status));
+
+    S3_close_listing_index(index);
+
+    // The index is read back from its file
+    status = S3_open_listing_index(path, "bucket", "", &index);
+    check(status == S3StatusOK, "reopen: %s", S3_get_status_name(status));
+    if (status == S3StatusOK) {
+        check_contents("reopen", index, appendedIndex, countof(appendedIndex));
+        S3_close_listing_index(index);
+    }
+
+    // Changed prefixes must be under the indexed prefix
+    char prefixPath[1024];
+    snprintf(prefixPath, sizeof(prefixPath), "%.1000s.prefix", path);
+    unlink(prefixPath);
+    status = S3_open_listing_index(prefixPath, "bucket", "b/", &index);
+    check(status == S3StatusOK, "open with a prefix: %s",
+          S3_get_status_name(status));
+    if (status == S3StatusOK) {
+        const char *outsidePrefixes[] = { "b/1", "c/" };
+        status = S3_refresh_listing_index(index, bucketContext, 0, 2,
+                                          outsidePrefixes, 0);
+        check(status == S3StatusListingIndexMismatch,
+              "refresh of a prefix outside the index gave %s",
+              S3_get_status_name(status));
+
+        server = start_server(listenFd, initial, countof(initial));
+        status = S3_refresh_listing_index(index, bucketContext, 0, 0, 0, 0);
+        stop_server(server);
+        check(status == S3StatusOK, "refresh with a prefix: %s",
+              S3_get_status_name(status));
+        check_contents("refresh with a prefix", index, &(initial[2]), 3);
+        S3_close_listing_index(index);
+    }
+    unlink(prefixPath);
+
+#undef countof
+}
+
+
+// Writes [len] bytes of [data] to [path]
+static int write_file(const char *path, const char *data, long len)
+{
+    FILE *f = fopen(path, "wb");
+
+    if (!f) {
+        return 0;
+    }
+
+    int ok = (fwrite(data, 1, len, f) == (size_t) len);
+
+    return (fclose(f) == 0) && ok;
+}
+
+
+// Opens [data] written to [path] as an index of [bucketName] and [prefix],
+// and checks that this gives [expected]
+static void check_open(const char *what, const char *path, const char *data,
+                       long len, const char *bucketName, const char *prefix,
+                       S3Status expected)
+{
+    S3ListingIndex *index;
+
+    if (!write_file(path, data, len)) {
+        check(0, "%s: could not write %s", what, path);
+        return;
+    }
+
+    S3Status status = S3_open_listing_index(path, bucketName, prefix,
+                                            &index);
+    check(status == expected, "%s: open gave %s, expected %s", what,
+          S3_get_status_name(status), S3_get_status_name(expected));
+
+    if (status == S3StatusOK) {
+        S3_close_listing_index(index);
+    }
+}
+
+
+// Checks that index files which are damaged, or of another bucket or
+// prefix, are rejected; [path] holds a valid index of "bucket"
+static void check_validation(const char *path)
+{
+    // The header fields that are damaged; see listing_index.c
+    enum
+    {
+        magicOffset = 0,
+        countOffset = 8,
+        recordsOffset = 16,
+        stringsSizeOffset = 32
+    };
+
+    FILE *f = fopen(path, "rb");
+    char *data = 0, *damaged = 0;
+    long len = 0;
+
+    if (f && !fseek(f, 0, SEEK_END) && ((len = ftell(f)) > 0) &&
+        !fseek(f, 0, SEEK_SET) && (data = (char *) malloc(len)) &&
+        (damaged = (char *) malloc(len)) &&
+        (fread(data, 1, len, f) == (size_t) len)) {
+    }
+    else {
+        len = 0;
+    }
+    if (f) {
+        fclose(f);
+    }
+    check(len, "could not read %s", path);
+    if (!len) {
+        free(data);
+        free(damaged);
+        return;
+    }
+
+    char copyPath[1024];
+    snprintf(copyPath, sizeof(copyPath), "%.1000s.copy", path);
+    uint64_t value;
+
+    check_open("copy", copyPath, data, len, "bucket", "", S3StatusOK);
+
+    check_open("other bucket", copyPath, data, len, "other", "",
+               S3StatusListingIndexMismatch);
+
+    check_open("other prefix", copyPath, data, len, "bucket", "a/",
+               S3StatusListingIndexMismatch);
+
+    memcpy(damaged, data, len);
+    damaged[magicOffset] ^= 1;
+    check_open("bad magic", copyPath, damaged, len, "bucket", "",
+               S3StatusListingIndexCorrupt);
+
+    check_open("short header", copyPath, data, 10, "bucket", "",
+               S3StatusListingIndexCorrupt);
+
+    check_open("truncated", copyPath, data, len - 1, "bucket", "",
+               S3StatusListingIndexCorrupt);
+
+    memcpy(damaged, data, len);
+    memcpy(&value, &(damaged[countOffset]), sizeof(value));
+    value++;
+    memcpy(&(damaged[countOffset]), &value, sizeof(value));
+    check_open("count too large", copyPath, damaged, len, "bucket", "",
+               S3StatusListingIndexCorrupt);
+
+    // The first field of the first record is the offset of its key
+    memcpy(damaged, data, len);
+    memcpy(&value, &(damaged[recordsOffset]), sizeof(value));
+    uint64_t stringsSize;
+    memcpy(&stringsSize, &(damaged[stringsSizeOffset]), sizeof(stringsSize));
+    memcpy(&(damaged[value]), &stringsSize, sizeof(stringsSize));
+    check_open("key outside the strings", copyPath, damaged, len, "bucket",
+               "", S3StatusListingIndexCorrupt);
+
+    // The last byte terminates the last string
+    memcpy(damaged, data, len);
+    damaged[len - 1] = 'x';
+    check_open("unterminated string", copyPath, damaged, len, "bucket", "",
+               S3StatusListingIndexCorrupt);
+
+    unlink(copyPath);
+    free(data);
+    free(damaged);
+}
+
+
+int main()
+{
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((listenFd < 0) ||
+        bind(listenFd, (struct sockaddr *) &addr, sizeof(addr)) ||
+        listen(listenFd, 64) ||
+        getsockname(listenFd, (struct sockaddr *) &addr, &addrLen)) {
+        perror("ERROR: failed to listen");
+        return -1;
+    }
+
+    char hostName[64];
+    snprintf(hostName, sizeof(hostName), "127.0.0.1:%d",
+             ntohs(addr.sin_port));
+
+    if (S3_initialize("testlistingindex", S3_INIT_ALL, hostName) !=
+        S3StatusOK) {
+        fprintf(stderr, "ERROR: failed to initialize libs3\n");
+        return -1;
+    }
+
+    S3BucketContext bucketContext =
+    {
+        0, "bucket", S3ProtocolHTTP, S3UriStylePath, "AKIDEXAMPLE", "secret",
+        0, "us-east-1"
+    };
+
+    char path[1024];
+    snprintf(path, sizeof(path), "/tmp/testlistingindex.%d", (int) getpid());
+
+    check_refreshes(listenFd, path, &bucketContext);
+
+    check_validation(path);
+
+    unlink(path);
+
+    S3_deinitialize();
+
+    close(listenFd);
+
+    printf("%ld checks, %ld failures\n", checksG, failuresG);
+
+    return failuresG ? -1 : 0;
+}
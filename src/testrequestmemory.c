@@ -0,0 +1,515 @@
+/** **************************************************************************
+ * testrequestmemory.c
+ *
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <curl/curl.h>
+#include "libs3.h"
+#include "request.h"
+
+// Measures the resident memory taken by each request in flight in a request
+// context, both with error parsers allocated up front for every request, as
+// they used to be, and only once an error body arrives, as they now are.
+// Checks that error responses are still reported in full.  Also
+// checks, through an allocator set with S3_set_allocator, that once warmed up
+// GET, PUT and HEAD requests make no heap allocations in libs3.  A child
+// process serves requests for the "missing" key with a 404 NoSuchKey error,
+// and all others with an empty success.
+//
+// The number of bytes per request in flight may be given as an argument, in
+// which case the test fails if more than that is used once error parsers are
+// allocated lazily.
+
+#define REQUEST_COUNT 20000
+
+#define ERROR_REQUEST_COUNT 50
+
+#define ERROR_MESSAGE "The specified key does not exist."
+
+#define WARM_UP_REQUEST_COUNT 10
+
+#define STEADY_REQUEST_COUNT 100
+
+static const char errorResponseG[] =
+    "HTTP/1.1 404 Not Found\r\n"
+    "Content-Type: application/xml\r\n"
+    "Content-Length: %d\r\n"
+    "Connection: close\r\n"
+    "\r\n"
+    "%s";
+
+static const char errorBodyG[] =
+    "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+    "<Error><Code>NoSuchKey</Code><Message>" ERROR_MESSAGE "</Message>"
+    "<Key>key</Key><RequestId>4442587FB7D0A2F9</RequestId></Error>";
+
+static const char successResponseG[] =
+    "HTTP/1.1 200 OK\r\n"
+    "ETag: \"d41d8cd98f00b204e9800998ecf8427e\"\r\n"
+    "Content-Length: 0\r\n"
+    "Connection: close\r\n"
+    "\r\n";
+
+static long failuresG = 0;
+
+// The number of allocations made through the allocator given to libs3
+static long allocationsG = 0;
+
+
+// server -------------------------------------------------------------------
+
+static void serve_requests(int listenFd)
+{
+    char response[1024];
+    int responseLen = snprintf(response, sizeof(response), errorResponseG,
+                               (int) (sizeof(errorBodyG) - 1), errorBodyG);
+
+    while (1) {
+        int fd = accept(listenFd, 0, 0);
+        if (fd < 0) {
+            continue;
+        }
+        // Read the request up to the end of its headers; none of the
+        // requests made have a body, the PUTs being of empty objects
+        char request[8192];
+        int requestLen = 0;
+        while (requestLen < (int) (sizeof(request) - 1)) {
+            int n = read(fd, &(request[requestLen]),
+                         sizeof(request) - 1 - requestLen);
+            if (n <= 0) {
+                break;
+            }
+            requestLen += n;
+            if ((requestLen >= 4) &&
+                !memcmp(&(request[requestLen - 4]), "\r\n\r\n", 4)) {
+                break;
+            }
+        }
+        request[requestLen] = 0;
+        const char *reply = response;
+        int replyLen = responseLen;
+        if (!strstr(request, "/missing ")) {
+            reply = successResponseG;
+            replyLen = sizeof(successResponseG) - 1;
+        }
+        if (write(fd, reply, replyLen) != replyLen) {
+            // The client will report the failure
+        }
+        close(fd);
+    }
+}
+
+
+// requests -----------------------------------------------------------------
+
+typedef struct CallbackData
+{
+    int completed;
+    S3Status status;
+    char message[256];
+} CallbackData;
+
+
+static S3Status propertiesCallback(const S3ResponseProperties *properties,
+                                   void *callbackData)
+{
+    (void) properties;
+    (void) callbackData;
+
+    return S3StatusOK;
+}
+
+
+static void completeCallback(S3Status status, const S3ErrorDetails *error,
+                             void *callbackData)
+{
+    CallbackData *data = (CallbackData *) callbackData;
+
+    data->completed++;
+    data->status = status;
+    snprintf(data->message, sizeof(data->message), "%s",
+             (error && error->message) ? error->message : "");
+}
+
+
+static S3ResponseHandler responseHandlerG =
+{
+    &propertiesCallback, &completeCallback
+};
+
+
+static S3Status getObjectDataCallback(int bufferSize, const char *buffer,
+                                      void *callbackData)
+{
+    (void) bufferSize;
+    (void) buffer;
+    (void) callbackData;
+
+    return S3StatusOK;
+}
+
+
+static S3GetObjectHandler getObjectHandlerG =
+{
+    { &propertiesCallback, &completeCallback }, &getObjectDataCallback
+};
+
+
+static int putObjectDataCallback(int bufferSize, char *buffer,
+                                 void *callbackData)
+{
+    (void) bufferSize;
+    (void) buffer;
+    (void) callbackData;
+
+    return 0;
+}
+
+
+static S3PutObjectHandler putObjectHandlerG =
+{
+    { &propertiesCallback, &completeCallback }, &putObjectDataCallback
+};
+
+
+// allocator ----------------------------------------------------------------
+
+static void *countingMalloc(size_t size, void *userData)
+{
+    (void) userData;
+
+    allocationsG++;
+
+    return malloc(size);
+}
+
+
+static void *countingRealloc(void *ptr, size_t size, void *userData)
+{
+    (void) userData;
+
+    allocationsG++;
+
+    return realloc(ptr, size);
+}
+
+
+static void countingFree(void *ptr, void *userData)
+{
+    (void) userData;
+
+    free(ptr);
+}
+
+
+// checks -------------------------------------------------------------------
+
+// Returns the resident set size of this process, in bytes, or -1 if it
+// cannot be found
+static long resident_bytes()
+{
+    FILE *f = fopen("/proc/self/statm", "r");
+    long size, resident;
+
+    if (!f) {
+        return -1;
+    }
+
+    int count = fscanf(f, "%ld %ld", &size, &resident);
+    fclose(f);
+
+    return (count == 2) ? (resident * sysconf(_SC_PAGESIZE)) : -1;
+}
+
+
+static void check_errors(const S3BucketContext *bucketContext)
+{
+    int i;
+
+    for (i = 0; i < ERROR_REQUEST_COUNT; i++) {
+        CallbackData data;
+        memset(&data, 0, sizeof(data));
+        S3_get_object(bucketContext, "missing", 0, 0, 0, 0, 0,
+                      &getObjectHandlerG, &data);
+        if ((data.completed != 1) ||
+            (data.status != S3StatusErrorNoSuchKey) ||
+            strcmp(data.message, ERROR_MESSAGE)) {
+            fprintf(stderr, "ERROR: request %d completed %d times with "
+                    "status %s, message \"%s\"\n", i, data.completed,
+                    S3_get_status_name(data.status), data.message);
+            failuresG++;
+            return;
+        }
+    }
+}
+
+
+// Performs [count] each of GET, PUT and HEAD requests, returning nonzero if
+// any of them failed
+static int steady_requests(const S3BucketContext *bucketContext, int count)
+{
+    int i;
+
+    for (i = 0; i < count; i++) {
+        CallbackData data;
+        memset(&data, 0, sizeof(data));
+        S3_get_object(bucketContext, "key", 0, 0, 0, 0, 0,
+                      &getObjectHandlerG, &data);
+        S3_put_object(bucketContext, "key", 0, 0, 0, 0,
+                      &putObjectHandlerG, &data);
+        S3_head_object(bucketContext, "key", 0, 0, &responseHandlerG, &data);
+        if ((data.completed != 3) || (data.status != S3StatusOK)) {
+            fprintf(stderr, "ERROR: request %d completed %d of 3 times with "
+                    "status %s\n", i, data.completed,
+                    S3_get_status_name(data.status));
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+
+static void check_steady_allocations(const S3BucketContext *bucketContext)
+{
+    if (steady_requests(bucketContext, WARM_UP_REQUEST_COUNT)) {
+        failuresG++;
+        return;
+    }
+
+    long before = allocationsG;
+
+    if (steady_requests(bucketContext, STEADY_REQUEST_COUNT)) {
+        failuresG++;
+        return;
+    }
+
+    long allocations = allocationsG - before;
+
+    printf("%d GET, PUT and HEAD requests after warm-up: %ld allocations\n",
+           STEADY_REQUEST_COUNT, allocations);
+
+    if (allocations) {
+        fprintf(stderr, "ERROR: warmed up requests allocated memory\n");
+        failuresG++;
+    }
+}
+
+
+// Returns the resident bytes taken by each of REQUEST_COUNT requests in
+// flight, or -1 if resident memory is not available, or -2 on failure
+static long request_bytes(const S3BucketContext *bucketContext)
+{
+    S3RequestContext *requestContext;
+    CallbackData data;
+    int i;
+
+    if (S3_create_request_context(&requestContext) != S3StatusOK) {
+        fprintf(stderr, "ERROR: failed to create request context\n");
+        return -2;
+    }
+
+    memset(&data, 0, sizeof(data));
+
+    long before = resident_bytes();
+
+    // None of these requests is performed; they are only added to the
+    // request context
+    for (i = 0; i < REQUEST_COUNT; i++) {
+        S3_head_object(bucketContext, "key", requestContext, 0,
+                       &responseHandlerG, &data);
+    }
+
+    long after = resident_bytes();
+
+    S3_destroy_request_context(requestContext);
+
+    if (data.completed != REQUEST_COUNT) {
+        fprintf(stderr, "ERROR: %d of %d requests completed\n",
+                data.completed, REQUEST_COUNT);
+        return -2;
+    }
+
+    if ((before < 0) || (after < 0)) {
+        return -1;
+    }
+
+    return (after - before) / REQUEST_COUNT;
+}
+
+
+// Runs request_bytes() in a child process, so that the memory freed by one
+// measurement is not reused by the next
+static long request_bytes_in_child(const S3BucketContext *bucketContext,
+                                   int eagerErrorParsers)
+{
+    int fds[2];
+    long bytes = -2;
+
+    if (pipe(fds)) {
+        perror("ERROR: failed to create pipe");
+        return -2;
+    }
+
+    pid_t child = fork();
+    if (child < 0) {
+        perror("ERROR: failed to fork");
+        close(fds[0]);
+        close(fds[1]);
+        return -2;
+    }
+    if (!child) {
+        close(fds[0]);
+        request_set_eager_error_parsers(eagerErrorParsers);
+        bytes = request_bytes(bucketContext);
+        if (write(fds[1], &bytes, sizeof(bytes)) != sizeof(bytes)) {
+            // The parent will report the failure
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    if (read(fds[0], &bytes, sizeof(bytes)) != sizeof(bytes)) {
+        bytes = -2;
+    }
+    close(fds[0]);
+    waitpid(child, 0, 0);
+
+    return bytes;
+}
+
+
+static void measure_requests(const S3BucketContext *bucketContext,
+                             long maxBytesPerRequest)
+{
+    long eager = request_bytes_in_child(bucketContext, 1);
+    long lazy = request_bytes_in_child(bucketContext, 0);
+
+    if ((eager == -2) || (lazy == -2)) {
+        failuresG++;
+        return;
+    }
+
+    if ((eager == -1) || (lazy == -1)) {
+        printf("resident memory is not available on this platform\n");
+        return;
+    }
+
+    printf("%d requests in flight, bytes resident each:\n"
+           "  error parsers allocated up front: %ld\n"
+           "  error parsers allocated lazily:   %ld (%ld fewer)\n",
+           REQUEST_COUNT, eager, lazy, eager - lazy);
+
+    if (maxBytesPerRequest && (lazy > maxBytesPerRequest)) {
+        fprintf(stderr, "ERROR: more than %ld bytes resident per request\n",
+                maxBytesPerRequest);
+        failuresG++;
+    }
+}
+
+
+int main(int argc, char **argv)
+{
+    long maxBytesPerRequest = (argc > 1) ? atol(argv[1]) : 0;
+
+    int listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    socklen_t addrLen = sizeof(addr);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if ((listenFd < 0) ||
+        bind(listenFd, (struct sockaddr *) &addr, sizeof(addr)) ||
+        listen(listenFd, 64) ||
+        getsockname(listenFd, (struct sockaddr *) &addr, &addrLen)) {
+        perror("ERROR: failed to listen");
+        return -1;
+    }
+
+    pid_t server = fork();
+    if (server < 0) {
+        perror("ERROR: failed to fork");
+        return -1;
+    }
+    if (!server) {
+        serve_requests(listenFd);
+        _exit(0);
+    }
+    close(listenFd);
+
+    char hostName[64];
+    snprintf(hostName, sizeof(hostName), "127.0.0.1:%d",
+             ntohs(addr.sin_port));
+
+    // Initialize curl first, so that libs3 leaves curl's allocator alone and
+    // only libs3's own allocations are counted
+    curl_global_init(CURL_GLOBAL_ALL);
+
+    if ((S3_set_allocator(&countingMalloc, &countingRealloc, &countingFree,
+                          0) != S3StatusOK) ||
+        (S3_initialize("testrequestmemory", S3_INIT_ALL, hostName) !=
+         S3StatusOK)) {
+        fprintf(stderr, "ERROR: failed to initialize libs3\n");
+        kill(server, SIGTERM);
+        return -1;
+    }
+
+    S3BucketContext bucketContext =
+    {
+        0, "bucket", S3ProtocolHTTP, S3UriStylePath, "AKIDEXAMPLE", "secret",
+        0, "us-east-1"
+    };
+
+    check_errors(&bucketContext);
+
+    check_steady_allocations(&bucketContext);
+
+    measure_requests(&bucketContext, maxBytesPerRequest);
+
+    S3_deinitialize();
+
+    curl_global_cleanup();
+
+    kill(server, SIGTERM);
+    waitpid(server, 0, 0);
+
+    printf("%ld failures\n", failuresG);
+
+    return failuresG ? -1 : 0;
+}
@@ -0,0 +1,563 @@
+/** **************************************************************************
+ * testtransferjournal.c
+ *
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "libs3.h"
+
+// Checks transfer journals: that the upload id, parts with and without
+// checksums, and ranges recorded are replayed when a journal is re-opened,
+// that a new upload id forgets the parts of the previous one, that a journal
+// whose last record is corrupt or torn off is re-opened with the records
+// before it and has the rest of the file scrubbed, that the journal grows
+// past its initial mapping, and that files of another transfer, or which
+// are not journals, are rejected.
+//
+// The checks of damaged journals rely on the file format described in
+// transfer_journal.c: a 64 byte header, followed by records each made of a
+// 4 byte checksum, 2 byte type, 2 byte payload length, and the payload,
+// padded to a multiple of 8 bytes.
+
+#define TRANSFER_ID "bucket/key/1048576"
+
+#define HEADER_SIZE 64
+
+#define RECORD_HEADER 8
+
+#define ALIGN(x) (((x) + 7) & ~((off_t) 7))
+
+static long checksG = 0;
+
+static long failuresG = 0;
+
+#define check(condition, ...)                                           \
+    do {                                                                \
+        checksG++;                                                      \
+        if (!(condition)) {                                             \
+            failuresG++;                                                \
+            fprintf(stderr, "ERROR: " __VA_ARGS__);                     \
+            fprintf(stderr, "\n");                                      \
+        }                                                               \
+    } while (0)
+
+
+// helpers ------------------------------------------------------------------
+
+static S3TransferJournal *open_journal(const char *path)
+{
+    S3TransferJournal *journal;
+
+    S3Status status = S3_open_transfer_journal(path, TRANSFER_ID, 0,
+                                               &journal);
+    check(status == S3StatusOK, "opening %s: %s", path,
+          S3_get_status_name(status));
+
+    return (status == S3StatusOK) ? journal : 0;
+}
+
+
+static int string_is(const char *str, const char *expected)
+{
+    return (str && expected) ? !strcmp(str, expected) : (str == expected);
+}
+
+
+static void part_etag(int partNumber, char *buffer, int bufferSize)
+{
+    snprintf(buffer, bufferSize, "\"%032x\"", partNumber * 2654435761u);
+}
+
+
+// Returns the offset of the last record in the journal file at [path] and
+// its size, including padding, in *sizeReturn, or -1 if there is none
+static off_t last_record(const char *path, off_t *sizeReturn)
+{
+    int fd = open(path, O_RDONLY);
+    off_t offset = HEADER_SIZE, last = -1;
+    unsigned char header[RECORD_HEADER];
+
+    while ((lseek(fd, offset, SEEK_SET) == offset) &&
+           (read(fd, header, sizeof(header)) == sizeof(header))) {
+        uint32_t checksum;
+        uint16_t length;
+        memcpy(&checksum, header, sizeof(checksum));
+        memcpy(&length, &(header[6]), sizeof(length));
+        if (!checksum) {
+            break;
+        }
+        last = offset;
+        *sizeReturn = RECORD_HEADER + ALIGN(length);
+        offset += *sizeReturn;
+    }
+
+    close(fd);
+
+    return last;
+}
+
+
+// Truncates the file at [path] to [size] bytes, returning nonzero on success
+static int truncate_file(const char *path, off_t size)
+{
+    int fd = open(path, O_RDWR);
+    int ok = (fd != -1) && !ftruncate(fd, size);
+
+    if (fd != -1) {
+        close(fd);
+    }
+
+    return ok;
+}
+
+
+// Returns nonzero if every byte of the file at [path] from [offset] on is
+// zero
+static int zero_from(const char *path, off_t offset)
+{
+    int fd = open(path, O_RDONLY);
+    char buf[4096];
+    ssize_t len;
+    int zero = 1, i;
+
+    lseek(fd, offset, SEEK_SET);
+
+    while (zero && ((len = read(fd, buf, sizeof(buf))) > 0)) {
+        for (i = 0; i < len; i++) {
+            if (buf[i]) {
+                zero = 0;
+                break;
+            }
+        }
+    }
+
+    close(fd);
+
+    return zero;
+}
+
+
+// checks -------------------------------------------------------------------
+
+static void check_replay(const char *path)
+{
+    char etag[64];
+    int i;
+
+    unlink(path);
+
+    S3TransferJournal *journal = open_journal(path);
+    if (!journal) {
+        return;
+    }
+
+    check(!S3_transfer_journal_get_upload_id(journal),
+          "new journal has an upload id");
+    check(!S3_transfer_journal_get_part_etag(journal, 1),
+          "new journal has a part");
+    check(S3_transfer_journal_get_range_end(journal, 0) == 0,
+          "new journal has a range");
+
+    check(S3_transfer_journal_set_upload_id(journal, "upload-1") ==
+          S3StatusOK, "setting the upload id");
+    for (i = 1; i <= 5; i++) {
+        part_etag(i, etag, sizeof(etag));
+        check(S3_transfer_journal_add_part
+              (journal, i, etag, (i == 3) ? "4waSgw==" : 0) == S3StatusOK,
+              "adding part %d", i);
+    }
+    check(S3_transfer_journal_add_range(journal, 0, 100) == S3StatusOK,
+          "adding a range");
+    check(S3_transfer_journal_add_range(journal, 200, 100) == S3StatusOK,
+          "adding a range");
+    check(S3_transfer_journal_add_range(journal, 500, 0) == S3StatusOK,
+          "adding an empty range");
+    check(S3_transfer_journal_get_range_end(journal, 0) == 100,
+          "range end before the gap is filled");
+    check(S3_transfer_journal_add_range(journal, 100, 100) == S3StatusOK,
+          "adding a range");
+
+    // Part numbers outside those allowed by S3 are refused
+    check(S3_transfer_journal_add_part(journal, 0, "x", 0) != S3StatusOK,
+          "adding part 0");
+    check(S3_transfer_journal_add_part(journal, 10001, "x", 0) !=
+          S3StatusOK, "adding part 10001");
+
+    S3_close_transfer_journal(journal, 0);
+
+    if (!(journal = open_journal(path))) {
+        return;
+    }
+
+    check(string_is(S3_transfer_journal_get_upload_id(journal), "upload-1"),
+          "replayed upload id");
+    for (i = 1; i <= 5; i++) {
+        part_etag(i, etag, sizeof(etag));
+        check(string_is(S3_transfer_journal_get_part_etag(journal, i), etag),
+              "replayed ETag of part %d", i);
+        check(string_is(S3_transfer_journal_get_part_checksum(journal, i),
+                        (i == 3) ? "4waSgw==" : 0),
+              "replayed checksum of part %d", i);
+    }
+    check(!S3_transfer_journal_get_part_etag(journal, 6),
+          "replayed a part never added");
+    check(S3_transfer_journal_get_range_end(journal, 0) == 300,
+          "replayed ranges are merged");
+    check(S3_transfer_journal_get_range_end(journal, 150) == 300,
+          "range end from within a range");
+    check(S3_transfer_journal_get_range_end(journal, 300) == 300,
+          "range end after the ranges");
+    check(S3_transfer_journal_get_range_end(journal, 500) == 500,
+          "an empty range was recorded");
+
+    // A new upload id forgets the parts of the previous one, on replay too
+    check(S3_transfer_journal_set_upload_id(journal, "upload-2") ==
+          S3StatusOK, "setting a new upload id");
+    check(!S3_transfer_journal_get_part_etag(journal, 1),
+          "part of the previous upload id");
+    check(S3_transfer_journal_add_part(journal, 2, "\"new\"", 0) ==
+          S3StatusOK, "adding a part of the new upload id");
+
+    S3_close_transfer_journal(journal, 0);
+
+    if (!(journal = open_journal(path))) {
+        return;
+    }
+
+    check(string_is(S3_transfer_journal_get_upload_id(journal), "upload-2"),
+          "replayed new upload id");
+    check(!S3_transfer_journal_get_part_etag(journal, 1),
+          "replayed part of the previous upload id");
+    check(string_is(S3_transfer_journal_get_part_etag(journal, 2), "\"new\""),
+          "replayed part of the new upload id");
+    check(S3_transfer_journal_get_range_end(journal, 0) == 300,
+          "ranges survive a new upload id");
+
+    // A discarded journal starts afresh
+    S3_close_transfer_journal(journal, 1);
+
+    struct stat statbuf;
+    check(!stat(path, &statbuf) && (statbuf.st_size == 0),
+          "discarded journal is truncated");
+
+    if (!(journal = open_journal(path))) {
+        return;
+    }
+    check(!S3_transfer_journal_get_upload_id(journal) &&
+          !S3_transfer_journal_get_part_etag(journal, 2) &&
+          (S3_transfer_journal_get_range_end(journal, 0) == 0),
+          "discarded journal is re-opened empty");
+    S3_close_transfer_journal(journal, 0);
+}
+
+
+// Writes a journal recording parts 1 to 3, returning nonzero on success.
+// Part 3 is given a long checksum so that its record is longer than the one
+// that replaces it, leaving some of it to be scrubbed.
+static int write_parts(const char *path)
+{
+    char etag[64];
+    int i;
+
+    unlink(path);
+
+    S3TransferJournal *journal = open_journal(path);
+    if (!journal) {
+        return 0;
+    }
+
+    S3_transfer_journal_set_upload_id(journal, "upload");
+    for (i = 1; i <= 3; i++) {
+        part_etag(i, etag, sizeof(etag));
+        S3_transfer_journal_add_part
+            (journal, i, etag, (i == 3) ?
+             "AAAAAA==AAAAAA==AAAAAA==AAAAAA==AAAAAA==AAAAAA==" : "AAAAAA==");
+    }
+
+    S3_close_transfer_journal(journal, 0);
+
+    return 1;
+}
+
+
+// Re-opens the journal at [path], which should have lost part 3, checks
+// that the rest of the file was scrubbed, and that appending to it works
+static void check_damaged(const char *path, off_t lastOffset,
+                          const char *what)
+{
+    char etag[64];
+    int i;
+
+    S3TransferJournal *journal = open_journal(path);
+    if (!journal) {
+        return;
+    }
+
+    for (i = 1; i <= 2; i++) {
+        part_etag(i, etag, sizeof(etag));
+        check(string_is(S3_transfer_journal_get_part_etag(journal, i), etag),
+              "%s: part %d before the damage", what, i);
+    }
+    check(!S3_transfer_journal_get_part_etag(journal, 3),
+          "%s: damaged part 3 was replayed", what);
+
+    // Appending overwrites the damaged record
+    part_etag(4, etag, sizeof(etag));
+    check(S3_transfer_journal_add_part(journal, 4, etag, 0) == S3StatusOK,
+          "%s: appending", what);
+
+    S3_close_transfer_journal(journal, 0);
+
+    off_t size;
+    check(last_record(path, &size) == lastOffset,
+          "%s: appended record is not where the damaged one was", what);
+    check(zero_from(path, lastOffset + size),
+          "%s: the file is not scrubbed after the last record", what);
+
+    if (!(journal = open_journal(path))) {
+        return;
+    }
+    check(string_is(S3_transfer_journal_get_part_etag(journal, 4), etag) &&
+          !S3_transfer_journal_get_part_etag(journal, 3),
+          "%s: replay after appending", what);
+    check(string_is(S3_transfer_journal_get_upload_id(journal), "upload"),
+          "%s: upload id", what);
+    S3_close_transfer_journal(journal, 0);
+}
+
+
+static void check_tail_damage(const char *path)
+{
+    off_t offset, size;
+    int fd;
+
+    // A record whose payload does not match its checksum, as when a crash
+    // tears the record being written
+    if (!write_parts(path) || ((offset = last_record(path, &size)) < 0)) {
+        return;
+    }
+    fd = open(path, O_RDWR);
+    char c;
+    if ((lseek(fd, offset + RECORD_HEADER + 5, SEEK_SET) >= 0) &&
+        (read(fd, &c, 1) == 1)) {
+        c ^= 0x20;
+        check((lseek(fd, offset + RECORD_HEADER + 5, SEEK_SET) >= 0) &&
+              (write(fd, &c, 1) == 1), "corrupting the journal");
+    }
+    close(fd);
+    check_damaged(path, offset, "corrupt tail");
+
+    // A record cut short by truncating the file
+    if (!write_parts(path) || ((offset = last_record(path, &size)) < 0)) {
+        return;
+    }
+    check(truncate_file(path, offset + RECORD_HEADER + 8),
+          "truncating the journal");
+    check_damaged(path, offset, "truncated tail");
+}
+
+
+static void check_growth(const char *path)
+{
+    char etag[64], checksum[16];
+    int i, ok = 1;
+
+    unlink(path);
+
+    S3TransferJournal *journal = open_journal(path);
+    if (!journal) {
+        return;
+    }
+
+    S3_transfer_journal_set_upload_id(journal, "upload");
+
+    // Far more than fits in the initial 64 KiB mapping, with parts added
+    // out of order and ranges in between
+    for (i = 0; i < 5000; i++) {
+        int partNumber = ((i * 7) % 5000) + 1;
+        part_etag(partNumber, etag, sizeof(etag));
+        snprintf(checksum, sizeof(checksum), "%08d", partNumber);
+        if ((S3_transfer_journal_add_part(journal, partNumber, etag,
+                                          checksum) != S3StatusOK) ||
+            (S3_transfer_journal_add_range(journal, (uint64_t) i * 2, 1) !=
+             S3StatusOK)) {
+            ok = 0;
+        }
+    }
+    check(ok, "recording past the initial mapping");
+
+    struct stat statbuf;
+    check(!stat(path, &statbuf) && (statbuf.st_size > (64 * 1024)),
+          "journal did not grow");
+
+    // Strings returned before growth would have been invalidated; those
+    // returned now must be in the current mapping
+    for (i = 1, ok = 1; i <= 5000; i++) {
+        part_etag(i, etag, sizeof(etag));
+        snprintf(checksum, sizeof(checksum), "%08d", i);
+        if (!string_is(S3_transfer_journal_get_part_etag(journal, i), etag) ||
+            !string_is(S3_transfer_journal_get_part_checksum(journal, i),
+                       checksum)) {
+            ok = 0;
+        }
+    }
+    check(ok, "parts after growth");
+
+    S3_close_transfer_journal(journal, 0);
+
+    if (!(journal = open_journal(path))) {
+        return;
+    }
+
+    for (i = 1, ok = 1; i <= 5000; i++) {
+        part_etag(i, etag, sizeof(etag));
+        snprintf(checksum, sizeof(checksum), "%08d", i);
+        if (!string_is(S3_transfer_journal_get_part_etag(journal, i), etag) ||
+            !string_is(S3_transfer_journal_get_part_checksum(journal, i),
+                       checksum)) {
+            ok = 0;
+        }
+    }
+    check(ok, "parts replayed after growth");
+    check(string_is(S3_transfer_journal_get_upload_id(journal), "upload"),
+          "upload id replayed after growth");
+    for (i = 0, ok = 1; i < 5000; i++) {
+        if ((S3_transfer_journal_get_range_end(journal, i * 2) !=
+             (uint64_t) (i * 2) + 1) ||
+            (S3_transfer_journal_get_range_end(journal, (i * 2) + 1) !=
+             (uint64_t) (i * 2) + 1)) {
+            ok = 0;
+        }
+    }
+    check(ok, "ranges replayed after growth");
+
+    // A record too long for the format is refused, and the journal is
+    // still usable afterwards
+    char *longEtag = (char *) malloc(70000);
+    memset(longEtag, 'e', 69999);
+    longEtag[69999] = 0;
+    check(S3_transfer_journal_add_part(journal, 1, longEtag, 0) ==
+          S3StatusJournalRecordTooLong, "adding a record too long");
+    free(longEtag);
+    check(S3_transfer_journal_add_part(journal, 1, "\"short\"", 0) ==
+          S3StatusOK, "adding a part after a record too long");
+
+    S3_close_transfer_journal(journal, 0);
+
+    if (!(journal = open_journal(path))) {
+        return;
+    }
+    check(string_is(S3_transfer_journal_get_part_etag(journal, 1),
+                    "\"short\""), "replay after a record too long");
+    S3_close_transfer_journal(journal, 0);
+}
+
+
+static void check_validation(const char *path)
+{
+    S3TransferJournal *journal;
+    char garbage[HEADER_SIZE * 2];
+    int fd;
+
+    if (!write_parts(path)) {
+        return;
+    }
+
+    check(S3_open_transfer_journal(path, "bucket/other/1", 0, &journal) ==
+          S3StatusJournalMismatch, "opening a journal of another transfer");
+
+    memset(garbage, 'x', sizeof(garbage));
+    unlink(path);
+    fd = open(path, O_RDWR | O_CREAT, 0600);
+    check(write(fd, garbage, sizeof(garbage)) == sizeof(garbage),
+          "writing a file that is not a journal");
+    close(fd);
+    check(S3_open_transfer_journal(path, TRANSFER_ID, 0, &journal) ==
+          S3StatusJournalCorrupt, "opening a file that is not a journal");
+
+    if (!write_parts(path)) {
+        return;
+    }
+    struct stat statbuf;
+    stat(path, &statbuf);
+    check(truncate_file(path, statbuf.st_size - 3), "truncating the journal");
+    check(S3_open_transfer_journal(path, TRANSFER_ID, 0, &journal) ==
+          S3StatusJournalCorrupt,
+          "opening a journal whose size is not a multiple of 8");
+
+    check(S3_open_transfer_journal("/nonexistent/journal", TRANSFER_ID, 0,
+                                   &journal) == S3StatusJournalIOError,
+          "opening a journal in a directory that does not exist");
+
+    // A synchronously written journal replays the same way
+    unlink(path);
+    if (S3_open_transfer_journal(path, TRANSFER_ID, S3_JOURNAL_SYNC,
+                                 &journal) == S3StatusOK) {
+        check(S3_transfer_journal_add_part(journal, 1, "\"sync\"", 0) ==
+              S3StatusOK, "adding a part synchronously");
+        S3_close_transfer_journal(journal, 0);
+        if ((journal = open_journal(path))) {
+            check(string_is(S3_transfer_journal_get_part_etag(journal, 1),
+                            "\"sync\""), "replaying a synchronous journal");
+            S3_close_transfer_journal(journal, 0);
+        }
+    }
+    else {
+        check(0, "opening a synchronous journal");
+    }
+}
+
+
+int main()
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "/tmp/testtransferjournal.%d",
+             (int) getpid());
+
+    check_replay(path);
+
+    check_tail_damage(path);
+
+    check_growth(path);
+
+    check_validation(path);
+
+    unlink(path);
+
+    printf("%ld checks, %ld failures\n", checksG, failuresG);
+
+    return failuresG ? -1 : 0;
+}
@@ -0,0 +1,333 @@
+/** **************************************************************************
+ * testutil.c
+ * 
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "util.h"
+
+// Checks parseIso8601Time() and parseUnsignedInt() against the mktime() and
+// isdigit() based implementations that they replaced, which are run with the
+// time zone set to UTC so that they give the intended results.  Every date
+// of years 0000 to 9999, every two digit month and day of a range of years,
+// and every two digit hour, minute and second are checked, along with
+// fractions, offsets and malformed times.
+
+
+// reference implementations ------------------------------------------------
+
+static int checkString(const char *str, const char *format)
+{
+    while (*format) {
+        if (*format == 'd') {
+            if (!isdigit(*str)) {
+                return 0;
+            }
+        }
+        else if (*str != *format) {
+            return 0;
+        }
+        str++, format++;
+    }
+
+    return 1;
+}
+
+
+static int64_t referenceParseIso8601Time(const char *str)
+{
+    if (!checkString(str, "dddd-dd-ddTdd:dd:dd")) {
+        return -1;
+    }
+
+#define nextnum() (((*str - '0') * 10) + (*(str + 1) - '0'))
+
+    struct tm stm;
+    memset(&stm, 0, sizeof(stm));
+
+    stm.tm_year = (nextnum() - 19) * 100;
+    str += 2;
+    stm.tm_year += nextnum();
+    str += 3;
+
+    stm.tm_mon = nextnum() - 1;
+    str += 3;
+
+    stm.tm_mday = nextnum();
+    str += 3;
+
+    stm.tm_hour = nextnum();
+    str += 3;
+
+    stm.tm_min = nextnum();
+    str += 3;
+
+    stm.tm_sec = nextnum();
+    str += 2;
+
+    stm.tm_isdst = -1;
+
+    int64_t ret = mktime(&stm);
+
+    if (*str == '.') {
+        str++;
+        while (isdigit(*str)) {
+            str++;
+        }
+    }
+
+    if (checkString(str, "-dd:dd") || checkString(str, "+dd:dd")) {
+        int sign = (*str++ == '-') ? -1 : 1;
+        int hours = nextnum();
+        str += 3;
+        int minutes = nextnum();
+        ret += (-sign * (((hours * 60) + minutes) * 60));
+    }
+
+#undef nextnum
+
+    return ret;
+}
+
+
+static uint64_t referenceParseUnsignedInt(const char *str)
+{
+    while (is_blank(*str)) {
+        str++;
+    }
+
+    uint64_t ret = 0;
+
+    while (isdigit(*str)) {
+        ret *= 10;
+        ret += (*str++ - '0');
+    }
+
+    return ret;
+}
+
+
+// checks -------------------------------------------------------------------
+
+static long failuresG, checksG;
+
+
+static void check_time(const char *str)
+{
+    int64_t expected = referenceParseIso8601Time(str);
+    int64_t actual = parseIso8601Time(str);
+
+    checksG++;
+
+    if (actual != expected) {
+        if (failuresG++ < 20) {
+            fprintf(stderr, "ERROR: %s: expected %lld, got %lld\n", str,
+                    (long long) expected, (long long) actual);
+        }
+    }
+}
+
+
+static void check_int(const char *str)
+{
+    uint64_t expected = referenceParseUnsignedInt(str);
+    uint64_t actual = parseUnsignedInt(str);
+
+    checksG++;
+
+    if (actual != expected) {
+        if (failuresG++ < 20) {
+            fprintf(stderr, "ERROR: %s: expected %llu, got %llu\n", str,
+                    (unsigned long long) expected,
+                    (unsigned long long) actual);
+        }
+    }
+}
+
+
+static int is_leap(int year)
+{
+    return (!(year % 4) && (year % 100)) || !(year % 400);
+}
+
+
+static void check_dates()
+{
+    static const int monthDays[12] =
+        { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+
+    char str[64];
+    int year, month, day, n = 0;
+
+    // Every date of every year that can be written
+    for (year = 0; year <= 9999; year++) {
+        for (month = 1; month <= 12; month++) {
+            int days = monthDays[month - 1] + ((month == 2) && is_leap(year));
+            for (day = 1; day <= days; day++, n++) {
+                snprintf(str, sizeof(str), "%04d-%02d-%02dT%02d:%02d:%02dZ",
+                         year, month, day, n % 24, (n / 24) % 60,
+                         (n / 7) % 60);
+                check_time(str);
+            }
+        }
+    }
+
+    // Months and days out of range, which roll over as mktime() rolls them
+    for (year = 1890; year <= 2110; year++) {
+        for (month = 0; month <= 99; month++) {
+            for (day = 0; day <= 99; day++) {
+                snprintf(str, sizeof(str), "%04d-%02d-%02dT12:00:00Z", year,
+                         month, day);
+                check_time(str);
+            }
+        }
+    }
+}
+
+
+static void check_times()
+{
+    char str[64];
+    int hour, minute, second;
+
+    for (hour = 0; hour <= 99; hour++) {
+        for (minute = 0; minute <= 99; minute++) {
+            for (second = 0; second <= 99; second++) {
+                snprintf(str, sizeof(str), "2008-02-29T%02d:%02d:%02d.000Z",
+                         hour, minute, second);
+                check_time(str);
+            }
+        }
+    }
+}
+
+
+static void check_suffixes()
+{
+    static const char *suffixes[] =
+    {
+        "", "Z", ".", ".0", ".123Z", ".123456789Z", "+00:00", "-00:00",
+        "+05:30", "-08:00", "+99:99", ".5-03:00", ".5+14:00", "+5:30",
+        "-08:0", "-08-00", "+", "Zjunk", " 12", "1"
+    };
+
+    char str[64];
+    unsigned int i, year;
+
+    for (year = 1960; year <= 2040; year += 3) {
+        for (i = 0; i < (sizeof(suffixes) / sizeof(suffixes[0])); i++) {
+            snprintf(str, sizeof(str), "%04u-07-04T23:59:59%s", year,
+                     suffixes[i]);
+            check_time(str);
+        }
+    }
+}
+
+
+static void check_malformed()
+{
+    const char *valid = "2008-02-11T15:04:05.000Z";
+    static const char replacements[] = "0a-T:Z. \001";
+
+    char str[64];
+    int len = strlen(valid), i;
+    unsigned int r;
+
+    // Every truncation
+    for (i = 0; i <= len; i++) {
+        snprintf(str, sizeof(str), "%.*s", i, valid);
+        check_time(str);
+    }
+
+    // Every byte replaced with each of a set of bytes
+    for (i = 0; i < len; i++) {
+        for (r = 0; r < (sizeof(replacements) - 1); r++) {
+            snprintf(str, sizeof(str), "%s", valid);
+            str[i] = replacements[r];
+            check_time(str);
+        }
+    }
+}
+
+
+static void check_ints()
+{
+    static const char *ints[] =
+    {
+        "", "0", "7", "  42", "\t9", "12x", "x12", "-5", "+5", " \t 123 ",
+        "18446744073709551615", "18446744073709551616",
+        "99999999999999999999999", "000000000000000000001"
+    };
+
+    char str[64];
+    unsigned int i;
+
+    for (i = 0; i < (sizeof(ints) / sizeof(ints[0])); i++) {
+        check_int(ints[i]);
+    }
+
+    for (i = 0; i < 1000000; i++) {
+        snprintf(str, sizeof(str), "%u", i * 2654435761u);
+        check_int(str);
+    }
+}
+
+
+int main()
+{
+    // The reference gives the intended results only in UTC
+    setenv("TZ", "UTC", 1);
+    tzset();
+
+    check_dates();
+    check_times();
+    check_suffixes();
+    check_malformed();
+    check_ints();
+
+    // Parsing must not depend on the local time zone
+    setenv("TZ", "America/New_York", 1);
+    tzset();
+
+    checksG++;
+    if (parseIso8601Time("2008-07-01T12:00:00Z") != 1214913600) {
+        failuresG++;
+        fprintf(stderr, "ERROR: parsing depends on the local time zone\n");
+    }
+
+    printf("%ld checks, %ld failures\n", checksG, failuresG);
+
+    return failuresG ? -1 : 0;
+}
@@ -0,0 +1,747 @@
+/** **************************************************************************
+ * transfer_journal.c
+ *
+ * Copyright 2008 Bryan Ischo <bryan@ischo.com>
+ *
+ * This file is part of libs3.
+ *
+ * libs3 is free software: you can redistribute it and/or modify it under the
+ * terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, version 3 or above of the License.  You can also
+ * redistribute and/or modify it under the terms of the GNU General Public
+ * License, version 2 or above of the License.
+ *
+ * In addition, as a special exception, the copyright holders give
+ * permission to link the code of this library and its programs with the
+ * OpenSSL library, and distribute linked combinations including the two.
+ *
+ * libs3 is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * version 3 along with libs3, in a file named COPYING.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ * You should also have received a copy of the GNU General Public License
+ * version 2 along with libs3, in a file named COPYING-GPLv2.  If not, see
+ * <http://www.gnu.org/licenses/>.
+ *
+ ************************************************************************** **/
+
+#include <stdlib.h>
+#include <string.h>
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+#include "libs3.h"
+#include "util.h"
+
+
+#ifdef _WIN32
+
+/* The journal is a shared file mapping, which is not implemented for
+ * Windows; a journal cannot be opened there, so none of the other functions
+ * can be called with one.
+ */
+
+S3Status S3_open_transfer_journal(const char *path, const char *transferId,
+                                  int flags,
+                                  S3TransferJournal **journalReturn)
+{
+    (void) path;
+    (void) transferId;
+    (void) flags;
+    (void) journalReturn;
+    return S3StatusNotSupported;
+}
+
+
+void S3_close_transfer_journal(S3TransferJournal *journal, int discard)
+{
+    (void) journal;
+    (void) discard;
+}
+
+
+const char *S3_transfer_journal_get_upload_id(S3TransferJournal *journal)
+{
+    (void) journal;
+    return 0;
+}
+
+
+S3Status S3_transfer_journal_set_upload_id(S3TransferJournal *journal,
+                                           const char *uploadId)
+{
+    (void) journal;
+    (void) uploadId;
+    return S3StatusNotSupported;
+}
+
+
+S3Status S3_transfer_journal_add_part(S3TransferJournal *journal,
+                                      int partNumber, const char *eTag,
+                                      const char *checksum)
+{
+    (void) journal;
+    (void) partNumber;
+    (void) eTag;
+    (void) checksum;
+    return S3StatusNotSupported;
+}
+
+
+const char *S3_transfer_journal_get_part_etag(S3TransferJournal *journal,
+                                              int partNumber)
+{
+    (void) journal;
+    (void) partNumber;
+    return 0;
+}
+
+
+const char *S3_transfer_journal_get_part_checksum(S3TransferJournal *journal,
+                                                  int partNumber)
+{
+    (void) journal;
+    (void) partNumber;
+    return 0;
+}
+
+
+S3Status S3_transfer_journal_add_range(S3TransferJournal *journal,
+                                       uint64_t start, uint64_t length)
+{
+    (void) journal;
+    (void) start;
+    (void) length;
+    return S3StatusNotSupported;
+}
+
+
+uint64_t S3_transfer_journal_get_range_end(S3TransferJournal *journal,
+                                           uint64_t start)
+{
+    (void) journal;
+    return start;
+}
+
+#else
+
+
+// The journal file is a fixed header followed by a sequence of records, each
+// of which is 8-byte aligned:
+//
+//   uint32_t checksum  (FNV-1a over type, length, and payload; never 0)
+//   uint16_t type
+//   uint16_t length    (of the payload)
+//   payload
+//
+// The file is always extended with zeroes ahead of the records written to
+// it, so a zero checksum marks the end of the journal.  A record is written
+// payload first and checksum last; a record that was torn by a crash fails
+// its checksum and it, and everything after it, is ignored and overwritten
+// by the next append.
+
+#define JOURNAL_MAGIC            "libs3tj1"
+#define JOURNAL_MAGIC_SIZE       8
+#define JOURNAL_HEADER_SIZE      64
+#define JOURNAL_RECORD_HEADER    8
+#define JOURNAL_INITIAL_SIZE     (64 * 1024)
+
+// Part numbers allowed by S3
+#define JOURNAL_MAX_PART_NUMBER  10000
+
+#define JOURNAL_ALIGN(x)         (((x) + 7) & ~((size_t) 7))
+
+typedef enum
+{
+    JournalRecordTypeTransferId         = 1,
+    JournalRecordTypeUploadId           = 2,
+    JournalRecordTypePart               = 3,
+    JournalRecordTypeRange              = 4
+} JournalRecordType;
+
+
+typedef struct JournalRange
+{
+    uint64_t start, end;
+} JournalRange;
+
+
+typedef struct JournalPart
+{
+    // Offsets of the ETag and checksum in the part record, or 0
+    size_t eTagOffset, checksumOffset;
+} JournalPart;
+
+
+struct S3TransferJournal
+{
+    int fd;
+
+    int flags;
+
+    char *map;
+
+    size_t mapSize;
+
+    // Offset at which the next record will be written
+    size_t end;
+
+    // Offset of the payload of the most recent upload id record, or 0
+    size_t uploadIdOffset;
+
+    // Indexed by part number
+    JournalPart *parts;
+
+    int partsCount;
+
+    // Sorted, non-overlapping, non-adjacent completed byte ranges
+    JournalRange *ranges;
+
+    int rangesCount, rangesSize;
+};
+
+
+static uint32_t journal_checksum(uint16_t type, uint16_t length,
+                                 const char *payload)
+{
+    uint32_t hash = 2166136261U;
+    unsigned char prefix[4] = { (unsigned char) (type & 0xFF),
+                                (unsigned char) (type >> 8),
+                                (unsigned char) (length & 0xFF),
+                                (unsigned char) (length >> 8) };
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        hash = (hash ^ prefix[i]) * 16777619U;
+    }
+    for (i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char) payload[i]) * 16777619U;
+    }
+
+    return hash ? hash : 1;
+}
+
+
+static S3Status journal_map(S3TransferJournal *journal, size_t size)
+{
+    // The file is grown and mapped anew before the old mapping is let go
+    // of, so that a failure to grow leaves the journal as it was
+    if (ftruncate(journal->fd, size) == -1) {
+        return S3StatusJournalIOError;
+    }
+
+    void *map = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     journal->fd, 0);
+    if (map == MAP_FAILED) {
+        return S3StatusJournalIOError;
+    }
+
+    if (journal->map) {
+        munmap(journal->map, journal->mapSize);
+    }
+
+    journal->map = (char *) map;
+    journal->mapSize = size;
+
+    return S3StatusOK;
+}
+
+
+// Notes the part record whose payload, of [length] bytes, is at
+// [payloadOffset]: the part number, the ETag, and optionally the checksum,
+// each string NUL-terminated
+static S3Status journal_note_part(S3TransferJournal *journal,
+                                  size_t payloadOffset, size_t length)
+{
+    const char *payload = &(journal->map[payloadOffset]);
+    uint32_t partNumber;
+
+    if (length < (sizeof(partNumber) + 1)) {
+        return S3StatusJournalCorrupt;
+    }
+
+    memcpy(&partNumber, payload, sizeof(partNumber));
+
+    if ((partNumber == 0) || (partNumber > JOURNAL_MAX_PART_NUMBER)) {
+        return S3StatusJournalCorrupt;
+    }
+
+    size_t eTagOffset = sizeof(partNumber);
+    const char *nul = (const char *) memchr
+        (&(payload[eTagOffset]), 0, length - eTagOffset);
+    if (!nul) {
+        return S3StatusJournalCorrupt;
+    }
+
+    size_t checksumOffset = (nul - payload) + 1;
+    if (checksumOffset == length) {
+        checksumOffset = 0;
+    }
+    else if (!memchr(&(payload[checksumOffset]), 0,
+                     length - checksumOffset)) {
+        return S3StatusJournalCorrupt;
+    }
+
+    if ((int) partNumber >= journal->partsCount) {
+        int count = journal->partsCount ? journal->partsCount : 64;
+        while (count <= (int) partNumber) {
+            count *= 2;
+        }
+        JournalPart *parts = (JournalPart *) s3_realloc
+            (journal->parts, count * sizeof(JournalPart));
+        if (!parts) {
+            return S3StatusOutOfMemory;
+        }
+        memset(&(parts[journal->partsCount]), 0,
+               (count - journal->partsCount) * sizeof(JournalPart));
+        journal->parts = parts;
+        journal->partsCount = count;
+    }
+
+    JournalPart *part = &(journal->parts[partNumber]);
+    part->eTagOffset = payloadOffset + eTagOffset;
+    part->checksumOffset = checksumOffset ?
+        (payloadOffset + checksumOffset) : 0;
+
+    return S3StatusOK;
+}
+
+
+static S3Status journal_note_range(S3TransferJournal *journal,
+                                   uint64_t start, uint64_t end)
+{
+    int i = 0;
+
+    // Find the first range that could touch [start, end)
+    while ((i < journal->rangesCount) && (journal->ranges[i].end < start)) {
+        i++;
+    }
+
+    // Absorb every range that overlaps or abuts the new one
+    int j = i;
+    while ((j < journal->rangesCount) && (journal->ranges[j].start <= end)) {
+        if (journal->ranges[j].start < start) {
+            start = journal->ranges[j].start;
+        }
+        if (journal->ranges[j].end > end) {
+            end = journal->ranges[j].end;
+        }
+        j++;
+    }
+
+    if (j == i) {
+        // Pure insertion
+        if (journal->rangesCount == journal->rangesSize) {
+            int size = journal->rangesSize ? (2 * journal->rangesSize) : 16;
+            JournalRange *ranges = (JournalRange *) s3_realloc
+                (journal->ranges, size * sizeof(JournalRange));
+            if (!ranges) {
+                return S3StatusOutOfMemory;
+            }
+            journal->ranges = ranges;
+            journal->rangesSize = size;
+        }
+        memmove(&(journal->ranges[i + 1]), &(journal->ranges[i]),
+                (journal->rangesCount - i) * sizeof(JournalRange));
+        journal->rangesCount++;
+    }
+    else if (j > (i + 1)) {
+        // Collapse ranges [i, j) into slot i
+        memmove(&(journal->ranges[i + 1]), &(journal->ranges[j]),
+                (journal->rangesCount - j) * sizeof(JournalRange));
+        journal->rangesCount -= (j - i - 1);
+    }
+
+    journal->ranges[i].start = start;
+    journal->ranges[i].end = end;
+
+    return S3StatusOK;
+}
+
+
+// Applies a validated record to the in-memory indexes
+static S3Status journal_apply(S3TransferJournal *journal, uint16_t type,
+                              uint16_t length, size_t payloadOffset)
+{
+    const char *payload = &(journal->map[payloadOffset]);
+
+    switch (type) {
+    case JournalRecordTypeUploadId:
+        journal->uploadIdOffset = payloadOffset;
+        // Parts recorded belong to the previous upload id, if any
+        if (journal->parts) {
+            memset(journal->parts, 0,
+                   journal->partsCount * sizeof(JournalPart));
+        }
+        return S3StatusOK;
+    case JournalRecordTypePart:
+        return journal_note_part(journal, payloadOffset, length);
+    case JournalRecordTypeRange: {
+        uint64_t range[2];
+        if (length != sizeof(range)) {
+            return S3StatusJournalCorrupt;
+        }
+        memcpy(range, payload, sizeof(range));
+        if (!range[1]) {
+            return S3StatusOK;
+        }
+        return journal_note_range(journal, range[0], range[0] + range[1]);
+    }
+    default:
+        return S3StatusJournalCorrupt;
+    }
+}
+
+
+// Appends a record of [type] whose payload is the concatenation of [data1],
+// [data2], and [data3]; returns the offset of the payload in
+// *payloadOffsetReturn
+static S3Status journal_append(S3TransferJournal *journal, uint16_t type,
+                               const void *data1, size_t len1,
+                               const void *data2, size_t len2,
+                               const void *data3, size_t len3,
+                               size_t *payloadOffsetReturn)
+{
+    size_t length = len1 + len2 + len3;
+
+    if (length > 0xFFFF) {
+        return S3StatusJournalRecordTooLong;
+    }
+
+    // Always leave room for a zero terminating checksum after the record
+    size_t needed = journal->end + JOURNAL_RECORD_HEADER +
+        JOURNAL_ALIGN(length) + JOURNAL_RECORD_HEADER;
+
+    if (needed > journal->mapSize) {
+        size_t size = journal->mapSize;
+        while (size < needed) {
+            size *= 2;
+        }
+        S3Status status = journal_map(journal, size);
+        if (status != S3StatusOK) {
+            return status;
+        }
+    }
+
+    char *record = &(journal->map[journal->end]);
+    uint16_t type16 = type, length16 = (uint16_t) length;
+    memcpy(&(record[JOURNAL_RECORD_HEADER]), data1, len1);
+    if (len2) {
+        memcpy(&(record[JOURNAL_RECORD_HEADER + len1]), data2, len2);
+    }
+    if (len3) {
+        memcpy(&(record[JOURNAL_RECORD_HEADER + len1 + len2]), data3, len3);
+    }
+    memset(&(record[JOURNAL_RECORD_HEADER + length]), 0,
+           JOURNAL_ALIGN(length) - length + JOURNAL_RECORD_HEADER);
+    memcpy(&(record[4]), &type16, sizeof(type16));
+    memcpy(&(record[6]), &length16, sizeof(length16));
+
+    if (journal->flags & S3_JOURNAL_SYNC) {
+        // Make sure the payload is on disk before the checksum which
+        // validates it can be
+        if (msync(journal->map, journal->mapSize, MS_SYNC) == -1) {
+            return S3StatusJournalIOError;
+        }
+    }
+
+    uint32_t checksum = journal_checksum
+        (type16, length16, &(record[JOURNAL_RECORD_HEADER]));
+    memcpy(record, &checksum, sizeof(checksum));
+
+    if (journal->flags & S3_JOURNAL_SYNC) {
+        if (msync(journal->map, journal->mapSize, MS_SYNC) == -1) {
+            return S3StatusJournalIOError;
+        }
+    }
+
+    *payloadOffsetReturn = journal->end + JOURNAL_RECORD_HEADER;
+    journal->end += JOURNAL_RECORD_HEADER + JOURNAL_ALIGN(length);
+
+    return S3StatusOK;
+}
+
+
+// Reads all valid records, leaving journal->end at the first invalid one
+static S3Status journal_replay(S3TransferJournal *journal,
+                               const char *transferId)
+{
+    size_t transferIdLen = strlen(transferId);
+    int sawTransferId = 0;
+
+    journal->end = JOURNAL_HEADER_SIZE;
+
+    while ((journal->end + JOURNAL_RECORD_HEADER) <= journal->mapSize) {
+        const char *record = &(journal->map[journal->end]);
+        uint32_t checksum;
+        uint16_t type, length;
+        memcpy(&checksum, record, sizeof(checksum));
+        memcpy(&type, &(record[4]), sizeof(type));
+        memcpy(&length, &(record[6]), sizeof(length));
+
+        if (!checksum) {
+            break;
+        }
+        if ((journal->end + JOURNAL_RECORD_HEADER + JOURNAL_ALIGN(length)) >
+            journal->mapSize) {
+            break;
+        }
+        if (checksum != journal_checksum
+            (type, length, &(record[JOURNAL_RECORD_HEADER]))) {
+            break;
+        }
+
+        size_t payloadOffset = journal->end + JOURNAL_RECORD_HEADER;
+
+        if (!sawTransferId) {
+            // The first record must identify the transfer
+            if ((type != JournalRecordTypeTransferId) ||
+                (length != transferIdLen) ||
+                memcmp(&(journal->map[payloadOffset]), transferId, length)) {
+                return S3StatusJournalMismatch;
+            }
+            sawTransferId = 1;
+        }
+        else {
+            S3Status status = journal_apply(journal, type, length,
+                                            payloadOffset);
+            if (status != S3StatusOK) {
+                return status;
+            }
+        }
+
+        journal->end = payloadOffset + JOURNAL_ALIGN(length);
+    }
+
+    if (!sawTransferId) {
+        size_t offset;
+        journal->end = JOURNAL_HEADER_SIZE;
+        return journal_append(journal, JournalRecordTypeTransferId,
+                              transferId, transferIdLen, 0, 0, 0, 0,
+                              &offset);
+    }
+
+    // Scrub whatever follows the last valid record so that a torn record
+    // cannot be mistaken for a valid one later on
+    memset(&(journal->map[journal->end]), 0,
+           journal->mapSize - journal->end);
+
+    return S3StatusOK;
+}
+
+
+S3Status S3_open_transfer_journal(const char *path, const char *transferId,
+                                  int flags,
+                                  S3TransferJournal **journalReturn)
+{
+    S3TransferJournal *journal =
+        (S3TransferJournal *) s3_malloc(sizeof(S3TransferJournal));
+
+    if (!journal) {
+        return S3StatusOutOfMemory;
+    }
+
+    memset(journal, 0, sizeof(S3TransferJournal));
+    journal->flags = flags;
+
+    if ((journal->fd = open(path, O_RDWR | O_CREAT, 0600)) == -1) {
+        s3_free(journal);
+        return S3StatusJournalIOError;
+    }
+
+    S3Status status;
+    struct stat statbuf;
+
+    if (fstat(journal->fd, &statbuf) == -1) {
+        status = S3StatusJournalIOError;
+        goto error;
+    }
+
+    if (statbuf.st_size == 0) {
+        // New journal
+        if ((status = journal_map(journal, JOURNAL_INITIAL_SIZE)) !=
+            S3StatusOK) {
+            goto error;
+        }
+        memcpy(journal->map, JOURNAL_MAGIC, JOURNAL_MAGIC_SIZE);
+    }
+    else if ((statbuf.st_size < JOURNAL_HEADER_SIZE) ||
+             (statbuf.st_size % 8)) {
+        status = S3StatusJournalCorrupt;
+        goto error;
+    }
+    else {
+        if ((status = journal_map(journal, statbuf.st_size)) != S3StatusOK) {
+            goto error;
+        }
+        if (memcmp(journal->map, JOURNAL_MAGIC, JOURNAL_MAGIC_SIZE)) {
+            status = S3StatusJournalCorrupt;
+            goto error;
+        }
+    }
+
+    if ((status = journal_replay(journal, transferId)) != S3StatusOK) {
+        goto error;
+    }
+
+    *journalReturn = journal;
+
+    return S3StatusOK;
+
+ error:
+    S3_close_transfer_journal(journal, 0);
+    return status;
+}
+
+
+void S3_close_transfer_journal(S3TransferJournal *journal, int discard)
+{
+    if (journal->map) {
+        if (!discard) {
+            msync(journal->map, journal->mapSize, MS_SYNC);
+        }
+        munmap(journal->map, journal->mapSize);
+    }
+
+    if (discard) {
+        // Truncating first means that even if the caller fails to remove
+        // the file, it will not be used to resume the completed transfer
+        if (ftruncate(journal->fd, 0) == -1) {
+            // Nothing more can be done
+        }
+    }
+
+    close(journal->fd);
+
+    s3_free(journal->parts);
+    s3_free(journal->ranges);
+    s3_free(journal);
+}
+
+
+const char *S3_transfer_journal_get_upload_id(S3TransferJournal *journal)
+{
+    return journal->uploadIdOffset ?
+        &(journal->map[journal->uploadIdOffset]) : 0;
+}
+
+
+S3Status S3_transfer_journal_set_upload_id(S3TransferJournal *journal,
+                                           const char *uploadId)
+{
+    size_t payloadOffset;
+
+    // Include the terminating NUL so that the upload id can be returned
+    // directly from the mapped journal
+    S3Status status = journal_append
+        (journal, JournalRecordTypeUploadId, uploadId, strlen(uploadId) + 1,
+         0, 0, 0, 0, &payloadOffset);
+
+    if (status == S3StatusOK) {
+        status = journal_apply(journal, JournalRecordTypeUploadId,
+                               strlen(uploadId) + 1, payloadOffset);
+    }
+
+    return status;
+}
+
+
+S3Status S3_transfer_journal_add_part(S3TransferJournal *journal,
+                                      int partNumber, const char *eTag,
+                                      const char *checksum)
+{
+    if ((partNumber <= 0) || (partNumber > JOURNAL_MAX_PART_NUMBER)) {
+        return S3StatusJournalCorrupt;
+    }
+
+    uint32_t partNumber32 = partNumber;
+    size_t eTagLen = strlen(eTag) + 1;
+    size_t checksumLen = checksum ? (strlen(checksum) + 1) : 0;
+    size_t payloadOffset;
+
+    S3Status status = journal_append
+        (journal, JournalRecordTypePart, &partNumber32, sizeof(partNumber32),
+         eTag, eTagLen, checksum, checksumLen, &payloadOffset);
+
+    if (status == S3StatusOK) {
+        status = journal_note_part
+            (journal, payloadOffset,
+             sizeof(partNumber32) + eTagLen + checksumLen);
+    }
+
+    return status;
+}
+
+
+const char *S3_transfer_journal_get_part_etag(S3TransferJournal *journal,
+                                              int partNumber)
+{
+    if ((partNumber <= 0) || (partNumber >= journal->partsCount) ||
+        !journal->parts[partNumber].eTagOffset) {
+        return 0;
+    }
+
+    return &(journal->map[journal->parts[partNumber].eTagOffset]);
+}
+
+
+const char *S3_transfer_journal_get_part_checksum(S3TransferJournal *journal,
+                                                  int partNumber)
+{
+    if ((partNumber <= 0) || (partNumber >= journal->partsCount) ||
+        !journal->parts[partNumber].checksumOffset) {
+        return 0;
+    }
+
+    return &(journal->map[journal->parts[partNumber].checksumOffset]);
+}
+
+
+S3Status S3_transfer_journal_add_range(S3TransferJournal *journal,
+                                       uint64_t start, uint64_t length)
+{
+    if (!length) {
+        return S3StatusOK;
+    }
+
+    uint64_t range[2] = { start, length };
+    size_t payloadOffset;
+
+    S3Status status = journal_append
+        (journal, JournalRecordTypeRange, range, sizeof(range), 0, 0, 0, 0,
+         &payloadOffset);
+
+    if (status == S3StatusOK) {
+        status = journal_note_range(journal, start, start + length);
+    }
+
+    return status;
+}
+
+
+uint64_t S3_transfer_journal_get_range_end(S3TransferJournal *journal,
+                                           uint64_t start)
+{
+    int i;
+
+    for (i = 0; i < journal->rangesCount; i++) {
+        if (journal->ranges[i].start > start) {
+            break;
+        }
+        if (journal->ranges[i].end > start) {
+            return journal->ranges[i].end;
+        }
+    }
+
+    return start;
+}
+
+#endif
@@ -35,30 +35,6 @@
 #include "util.h"
 
 
-// Convenience utility for making the code look nicer.  Tests a string
-// against a format; only the characters specified in the format are
-// checked (i.e. if the string is longer than the format, the string still
-// checks out ok).  Format characters are:
-// d - is a digit
-// anything else - is that character
-// Returns nonzero the string checks out, zero if it does not.
-static int checkString(const char *str, const char *format)
-{
-    while (*format) {
-        if (*format == 'd') {
-            if (!isdigit(*str)) {
-                return 0;
-            }
-        }
-        else if (*str != *format) {
-            return 0;
-        }
-        str++, format++;
-    }
-
-    return 1;
-}
-
 /*
  * Encode rules:
  * 1. Every byte except: 'A'-'Z', 'a'-'z', '0'-'9', '-', '.', '_', and '~'
@@ -97,62 +73,96 @@ int urlEncode(char *dest, const char *src, int maxSrcSize, int encodeSlash)
 }
 
 
-int64_t parseIso8601Time(const char *str)
+// Days from the start of a year beginning in March to the start of each
+// month, January and February being the last months of that year, so that
+// a leap day falls at the end of the year
+static const int daysBeforeMonthG[12] =
 {
-    // Check to make sure that it has a valid format
-    if (!checkString(str, "dddd-dd-ddTdd:dd:dd")) {
-        return -1;
-    }
+    306, 337, 0, 31, 61, 92, 122, 153, 184, 214, 245, 275
+};
 
-#define nextnum() (((*str - '0') * 10) + (*(str + 1) - '0'))
 
-    // Convert it
-    struct tm stm;
-    memset(&stm, 0, sizeof(stm));
+// Returns the number of days from 1970-01-01 to the given date of the
+// proleptic Gregorian calendar.  [month] is 1 to 12; [day] may be out of
+// the range of the month, in which case the date is counted on from the
+// start of the month as mktime() would.
+static int64_t days_from_civil(int64_t year, int month, int day)
+{
+    // Count years from March
+    year -= (month <= 2);
 
-    stm.tm_year = (nextnum() - 19) * 100;
-    str += 2;
-    stm.tm_year += nextnum();
-    str += 3;
+    // 400 year eras have a fixed number of days
+    int64_t era = ((year >= 0) ? year : (year - 399)) / 400;
+    int yearOfEra = (int) (year - (era * 400));
+    int dayOfEra = (yearOfEra * 365) + (yearOfEra / 4) - (yearOfEra / 100) +
+        daysBeforeMonthG[month - 1] + day - 1;
+
+    // 719468 is the number of days from 0000-03-01 to 1970-01-01
+    return (era * 146097) + dayOfEra - 719468;
+}
 
-    stm.tm_mon = nextnum() - 1;
-    str += 3;
 
-    stm.tm_mday = nextnum();
-    str += 3;
+#define digit_value(c) ((unsigned) ((c) - '0'))
 
-    stm.tm_hour = nextnum();
-    str += 3;
+#define is_digit(c) (digit_value(c) < 10)
 
-    stm.tm_min = nextnum();
-    str += 3;
 
-    stm.tm_sec = nextnum();
-    str += 2;
+int64_t parseIso8601Time(const char *str)
+{
+    // Check to make sure that it has a valid format; this stops at the
+    // first byte that does not match, so never reads past the end of str
+    static const char format[] = "dddd-dd-ddTdd:dd:dd";
+
+    int i;
+    for (i = 0; i < (int) (sizeof(format) - 1); i++) {
+        if ((format[i] == 'd') ? !is_digit(str[i]) : (str[i] != format[i])) {
+            return -1;
+        }
+    }
 
-    stm.tm_isdst = -1;
+#define nextnum(offset) ((digit_value(str[offset]) * 10) +              \
+                         digit_value(str[(offset) + 1]))
 
-    int64_t ret = mktime(&stm);
+    int year = (nextnum(0) * 100) + nextnum(2);
+    int month = nextnum(5);
+    int day = nextnum(8);
+    int hour = nextnum(11);
+    int minute = nextnum(14);
+    int second = nextnum(17);
+
+    str += sizeof(format) - 1;
+
+    // Months out of range roll over into the year, as they do for mktime()
+    if ((month < 1) || (month > 12)) {
+        year += (month + 11) / 12 - 1;
+        month = ((month + 11) % 12) + 1;
+    }
+
+    int64_t ret = (days_from_civil(year, month, day) * 86400) +
+        (hour * 3600) + (minute * 60) + second;
 
     // Skip the millis
 
     if (*str == '.') {
         str++;
-        while (isdigit(*str)) {
+        while (is_digit(*str)) {
             str++;
         }
     }
 
-    if (checkString(str, "-dd:dd") || checkString(str, "+dd:dd")) {
-        int sign = (*str++ == '-') ? -1 : 1;
-        int hours = nextnum();
-        str += 3;
-        int minutes = nextnum();
+    if (((str[0] == '-') || (str[0] == '+')) && is_digit(str[1]) &&
+        is_digit(str[2]) && (str[3] == ':') && is_digit(str[4]) &&
+        is_digit(str[5])) {
+        int sign = (str[0] == '-') ? -1 : 1;
+        int hours = nextnum(1);
+        int minutes = nextnum(4);
         ret += (-sign * (((hours * 60) + minutes) * 60));
     }
     // Else it should be Z to be a conformant time string, but we just assume
     // that it is rather than enforcing that
 
+#undef nextnum
+
     return ret;
 }
 
@@ -166,9 +176,8 @@ uint64_t parseUnsignedInt(const char *str)
 
     uint64_t ret = 0;
 
-    while (isdigit(*str)) {
-        ret *= 10;
-        ret += (*str++ - '0');
+    while (is_digit(*str)) {
+        ret = (ret * 10) + digit_value(*str++);
     }
 
     return ret;